@@ -38,6 +38,11 @@ public:
     //      to set it to 3*requiredSize to avoid blocking the render thread (usually the UI thread).
     explicit CircularBuffer(size_t bufferSize);
 
+    // Creates a buffer that uses the given memory, which it doesn't own. Such a buffer must
+    // never be circularized, it's used to record commands in a scratch memory.
+    // See CommandStream::createSubStream().
+    CircularBuffer(void* data, size_t size) noexcept;
+
     // can't be moved or copy-constructed
     CircularBuffer(CircularBuffer const& rhs) = delete;
     CircularBuffer(CircularBuffer&& rhs) noexcept = delete;
@@ -74,6 +79,7 @@ private:
     // pointer to the beginning of the circular buffer (constant)
     void* mData = nullptr;
     int mUsesAshmem = -1;
+    bool mOwnsData = true;
 
     // size of the circular buffer (constant)
     size_t mSize = 0;
@@ -229,6 +229,7 @@ public:
         using Cmd = COMMAND_TYPE(methodName);                                                   \
         void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
         new(p) Cmd(mDispatcher->methodName##_, APPLY(std::move, params));                       \
+        mCommandCount++;                                                                        \
     }
 
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params)                    \
@@ -244,6 +245,7 @@ public:
         using Cmd = COMMAND_TYPE(methodName##R);                                                \
         void* const p = allocateCommand(CommandBase::align(sizeof(Cmd)));                       \
         new(p) Cmd(mDispatcher->methodName##_, RetType(result), APPLY(std::move, params));      \
+        mCommandCount++;                                                                        \
         return result;                                                                          \
     }
 
@@ -264,6 +266,35 @@ public:
 
     void execute(void* buffer);
 
+    /*
+     * Returns a CommandStream that records into 'buffer' instead of this stream's CircularBuffer.
+     * This allows several threads to record commands in parallel, each into its own buffer.
+     * The recorded commands are then appended to this stream with splice(), in order.
+     *
+     * Commands recorded this way are moved with memcpy(), so only commands with trivially
+     * copyable parameters can be used (e.g. bind* and draw). allocate() and queueCommand()
+     * must not be used.
+     */
+    CommandStream createSubStream(CircularBuffer& buffer) const noexcept {
+        CommandStream stream(*this);
+        stream.mCurrentBuffer = &buffer;
+        stream.debugThreading();
+        return stream;
+    }
+
+    /*
+     * Appends the commands recorded in [begin, end) by a sub-stream, see createSubStream().
+     * commandCount is the number of commands in that range, as returned by the sub-stream's
+     * getCommandCount().
+     */
+    void splice(void const* begin, void const* end, uint32_t commandCount) noexcept;
+
+    /*
+     * Number of driver commands recorded by this stream so far, for profiling. This includes
+     * queueCommand(), but not the memory obtained with allocate().
+     */
+    uint32_t getCommandCount() const noexcept { return mCommandCount; }
+
     /*
      * queueCommand() allows to queue a lambda function as a command.
      * This is much less efficient than using the Driver* API.
@@ -299,6 +330,8 @@ private:
 
     bool mUsePerformanceCounter = false;
 
+    uint32_t mCommandCount = 0;     // see getCommandCount()
+
     inline void* allocateCommand(size_t size) {
         assert(mThreadId == std::this_thread::get_id());
         return mCurrentBuffer->allocate(size);
@@ -42,8 +42,14 @@ CircularBuffer::CircularBuffer(size_t size) {
     mHead = mData;
 }
 
+CircularBuffer::CircularBuffer(void* data, size_t size) noexcept
+        : mData(data), mOwnsData(false), mSize(size), mTail(data), mHead(data) {
+}
+
 CircularBuffer::~CircularBuffer() noexcept {
-    dealloc();
+    if (mOwnsData) {
+        dealloc();
+    }
 }
 
 // If the system support mmap(), use it for creating a "hard circular buffer" where two virtual
@@ -143,6 +149,7 @@ void CircularBuffer::dealloc() noexcept {
 
 
 void CircularBuffer::circularize() noexcept {
+    assert(mOwnsData);
     if (mUsesAshmem > 0) {
         intptr_t overflow = intptr_t(mHead) - (intptr_t(mData) + ssize_t(mSize));
         if (overflow >= 0) {
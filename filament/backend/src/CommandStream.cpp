@@ -23,6 +23,8 @@
 
 #include <functional>
 
+#include <string.h>
+
 #ifdef ANDROID
 #include <sys/system_properties.h>
 #endif
@@ -107,8 +109,16 @@ void CommandStream::execute(void* buffer) {
     }
 }
 
+void CommandStream::splice(void const* begin, void const* end, uint32_t commandCount) noexcept {
+    const size_t size = size_t((char const*)end - (char const*)begin);
+    assert(size == CommandBase::align(size));
+    memcpy(allocateCommand(size), begin, size);
+    mCommandCount += commandCount;
+}
+
 void CommandStream::queueCommand(std::function<void()> command) {
     new(allocateCommand(CustomCommand::align(sizeof(CustomCommand)))) CustomCommand(std::move(command));
+    mCommandCount++;
 }
 
 template<typename... ARGS>
@@ -43,6 +43,12 @@ public:
      */
     void copyIntoBuffer(void* src, size_t size);
 
+    /**
+     * Update size bytes of the buffer at byteOffset with data inside src. The rest of the buffer
+     * keeps its content, which is copied if a new buffer allocation is needed.
+     */
+    void copyIntoBuffer(void* src, size_t size, size_t byteOffset);
+
     /**
      * Denotes that this buffer is used for a draw call ensuring that its allocation remains valid
      * until the end of the current frame.
@@ -212,6 +212,11 @@ void NoopDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor
     scheduleDestroy(std::move(data));
 }
 
+void NoopDriver::updateUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& data,
+        uint32_t byteOffset) {
+    scheduleDestroy(std::move(data));
+}
+
 void NoopDriver::updateSamplerGroup(Handle<HwSamplerGroup> sbh,
         SamplerGroup&& samplerGroup) {
 }
@@ -286,6 +291,10 @@ void NoopDriver::blit(TargetBufferFlags buffers,
 void NoopDriver::draw(PipelineState pipelineState, Handle<HwRenderPrimitive> rph) {
 }
 
+void NoopDriver::drawInstanced(PipelineState pipelineState, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
+}
+
 void NoopDriver::beginTimerQuery(Handle<HwTimerQuery> tqh) {
 }
 
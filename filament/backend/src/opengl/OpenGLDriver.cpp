@@ -1566,6 +1566,28 @@ void OpenGLDriver::loadUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescript
     scheduleDestroy(std::move(p));
 }
 
+void OpenGLDriver::updateUniformBuffer(Handle<HwUniformBuffer> ubh, BufferDescriptor&& p,
+        uint32_t byteOffset) {
+    DEBUG_MARKER()
+
+    GLUniformBuffer* ub = handle_cast<GLUniformBuffer *>(ubh);
+
+    // STREAM buffers are orphaned by each load, so their content can't be partially updated
+    assert(ub->gl.ubo.usage != BufferUsage::STREAM);
+    assert(byteOffset + p.size <= ub->gl.ubo.capacity);
+
+    auto& gl = mContext;
+    if (p.size > 0) {
+        gl.bindBuffer(GL_UNIFORM_BUFFER, ub->gl.ubo.id);
+        glBufferSubData(GL_UNIFORM_BUFFER, byteOffset, p.size, p.buffer);
+        // keep track of the initialized part of the buffer, see bindUniformBufferRange()
+        ub->gl.ubo.size = std::max(ub->gl.ubo.size, uint32_t(byteOffset + p.size));
+    }
+    scheduleDestroy(std::move(p));
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 void OpenGLDriver::updateBuffer(GLenum target,
         GLBuffer* buffer, BufferDescriptor const& p, uint32_t alignment) noexcept {
     assert(buffer->capacity >= p.size);
@@ -2998,6 +3020,35 @@ void OpenGLDriver::draw(PipelineState state, Handle<HwRenderPrimitive> rph) {
     CHECK_GL_ERROR(utils::slog.e)
 }
 
+void OpenGLDriver::drawInstanced(PipelineState state, Handle<HwRenderPrimitive> rph,
+        uint32_t instanceCount) {
+    DEBUG_MARKER()
+    auto& gl = mContext;
+
+    OpenGLProgram* p = handle_cast<OpenGLProgram*>(state.program);
+
+    // see draw()
+    if (FILAMENT_ENABLE_MATDBG && UTILS_UNLIKELY(!p->isValid())) {
+        return;
+    }
+
+    useProgram(p);
+
+    const GLRenderPrimitive* rp = handle_cast<const GLRenderPrimitive *>(rph);
+    gl.bindVertexArray(&rp->gl);
+
+    setRasterState(state.rasterState);
+
+    gl.polygonOffset(state.polygonOffset.slope, state.polygonOffset.constant);
+
+    setViewportScissor(state.scissor);
+
+    glDrawElementsInstanced(GLenum(rp->type), rp->count, rp->gl.indicesType,
+            reinterpret_cast<const void*>(rp->offset), GLsizei(instanceCount));
+
+    CHECK_GL_ERROR(utils::slog.e)
+}
+
 // explicit instantiation of the Dispatcher
 template class backend::ConcreteDispatcher<OpenGLDriver>;
 
@@ -22,9 +22,14 @@
 #include <filament/Box.h>
 #include <filament/Frustum.h>
 #include "details/Culler.h"
+#include "components/TransformManager.h"
+#include "RenderPass.h"
 
 #include <utils/Allocator.h>
+#include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
 
+#include <algorithm>
 #include <vector>
 #include <random>
 
@@ -89,6 +94,19 @@ BENCHMARK_F(FilamentFixture, boxCulling)(benchmark::State& state) {
         benchmark::ClobberMemory();
         pc.stop();
         state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+        state.SetLabel(Culler::Test::getKernelName());
+    }
+}
+
+BENCHMARK_F(FilamentFixture, boxCullingPortable)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            Culler::Test::intersectsPortable(visibles, frustum, boxesCenter.data(), boxesExtent.data(), BATCH_SIZE);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
     }
 }
 
@@ -101,5 +119,142 @@ BENCHMARK_F(FilamentFixture, sphereCulling)(benchmark::State& state) {
         benchmark::ClobberMemory();
         pc.stop();
         state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
+        state.SetLabel(Culler::Test::getKernelName());
+    }
+}
+
+BENCHMARK_F(FilamentFixture, sphereCullingPortable)(benchmark::State& state) {
+    {
+        PerformanceCounters pc(state);
+        for (auto _ : state) {
+            Culler::Test::intersectsPortable(visibles, frustum, spheres.data(), BATCH_SIZE);
+        }
+        benchmark::ClobberMemory();
+        pc.stop();
+        state.SetItemsProcessed(state.iterations() * BATCH_SIZE);
     }
 }
+
+class CommandsFixture : public benchmark::Fixture {
+protected:
+    using Command = RenderPass::Command;
+
+    JobSystem js;
+    ScratchBuffer scratch;
+    std::vector<Command> commands;
+    std::vector<Command> sorted;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        js.adopt();
+
+        // generate a mix of depth and color commands, with keys similar to the real ones
+        std::default_random_engine gen; // NOLINT
+        std::uniform_int_distribution<uint32_t> rand;
+        const size_t count = size_t(state.range(0));
+        commands.resize(count);
+        sorted.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            const uint32_t priority = rand(gen) % 8u;
+            Command& cmd = commands[i];
+            if (i & 1u) {
+                cmd.key = uint64_t(RenderPass::Pass::COLOR);
+                cmd.key |= RenderPass::makeField(priority, RenderPass::PRIORITY_MASK, RenderPass::PRIORITY_SHIFT);
+                cmd.key |= RenderPass::makeField(rand(gen) % 1024u, RenderPass::Z_BUCKET_MASK, RenderPass::Z_BUCKET_SHIFT);
+                cmd.key |= RenderPass::makeMaterialSortingKey(rand(gen) % 64u, rand(gen) % 256u);
+            } else {
+                cmd.key = uint64_t(RenderPass::Pass::DEPTH);
+                cmd.key |= RenderPass::makeField(priority, RenderPass::PRIORITY_MASK, RenderPass::PRIORITY_SHIFT);
+                cmd.key |= RenderPass::makeField(rand(gen), RenderPass::DISTANCE_BITS_MASK, RenderPass::DISTANCE_BITS_SHIFT);
+            }
+        }
+    }
+
+    void TearDown(const benchmark::State&) override {
+        js.emancipate();
+    }
+};
+
+BENCHMARK_DEFINE_F(CommandsFixture, stdSortCommands)(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(commands.begin(), commands.end(), sorted.begin());
+        state.ResumeTiming();
+        std::sort(sorted.begin(), sorted.end());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * commands.size());
+}
+
+BENCHMARK_DEFINE_F(CommandsFixture, radixSortCommands)(benchmark::State& state) {
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::copy(commands.begin(), commands.end(), sorted.begin());
+        state.ResumeTiming();
+        RenderPass::sortCommands(js, scratch, sorted.data(), sorted.data() + sorted.size());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * commands.size());
+}
+
+BENCHMARK_REGISTER_F(CommandsFixture, stdSortCommands)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+BENCHMARK_REGISTER_F(CommandsFixture, radixSortCommands)->RangeMultiplier(4)->Range(1 << 10, 1 << 20);
+
+class TransformsFixture : public benchmark::Fixture {
+protected:
+    JobSystem js;
+    FTransformManager tcm{ &js };
+    std::vector<Entity> entities;
+
+public:
+    void SetUp(const benchmark::State& state) override {
+        js.adopt();
+
+        // a wide hierarchy, similar to a crowd of skinned characters
+        std::default_random_engine gen; // NOLINT
+        const size_t count = size_t(state.range(0));
+        entities.resize(count);
+        EntityManager::get().create(count, entities.data());
+        for (size_t i = 0; i < count; i++) {
+            Entity const parent = i < 64 ? Entity{} :
+                    entities[std::uniform_int_distribution<size_t>(i / 2 - 32, i - 1)(gen)];
+            tcm.create(entities[i], tcm.getInstance(parent), mat4f{});
+        }
+    }
+
+    void TearDown(const benchmark::State&) override {
+        for (Entity e : entities) {
+            tcm.destroy(e);
+        }
+        EntityManager::get().destroy(entities.size(), entities.data());
+        js.emancipate();
+    }
+
+    void updateTransforms(benchmark::State& state) {
+        float t = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            t += 1.0f;
+            tcm.openLocalTransformTransaction();
+            for (Entity e : entities) {
+                tcm.setTransform(tcm.getInstance(e), mat4f::translation(float3{ t, 0, 0 }));
+            }
+            state.ResumeTiming();
+            tcm.commitLocalTransformTransaction();
+        }
+        benchmark::ClobberMemory();
+        state.SetItemsProcessed(state.iterations() * entities.size());
+    }
+};
+
+BENCHMARK_DEFINE_F(TransformsFixture, serialTransformUpdate)(benchmark::State& state) {
+    updateTransforms(state);
+}
+
+BENCHMARK_DEFINE_F(TransformsFixture, parallelTransformUpdate)(benchmark::State& state) {
+    tcm.setParallelTransformUpdateEnabled(true);
+    updateTransforms(state);
+}
+
+BENCHMARK_REGISTER_F(TransformsFixture, serialTransformUpdate)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
+BENCHMARK_REGISTER_F(TransformsFixture, parallelTransformUpdate)->RangeMultiplier(8)->Range(1 << 12, 1 << 18);
@@ -85,6 +85,9 @@ public:
     using Instance = utils::EntityInstance<RenderableManager>;
     using PrimitiveType = backend::PrimitiveType;
 
+    //! Maximum number of levels of detail of a renderable, see Builder::levelOfDetail()
+    static constexpr uint8_t MAX_LEVEL_OF_DETAIL_COUNT = 8;
+
     /**
      * Checks if the given entity already has a renderable component.
      */
@@ -154,6 +157,37 @@ public:
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t count) noexcept; //!< \overload
         Builder& geometry(size_t index, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices) noexcept; //!< \overload
 
+        /**
+         * Specifies the geometry data for a primitive at a coarser level of detail.
+         *
+         * All the levels of detail have the same number of primitives, which share their
+         * material and blend order. A primitive whose geometry is not specified at a given level
+         * uses the geometry of the previous level.
+         *
+         * @param index zero-based index of the primitive, must be less than the count passed to Builder constructor
+         * @param level level of detail, between 1 and MAX_LEVEL_OF_DETAIL_COUNT - 1 (level 0 is
+         *              set by the geometry() overloads without a level)
+         *
+         * \see levelOfDetail(), and geometry() for the other parameters
+         */
+        Builder& geometry(size_t index, uint8_t level, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices, size_t offset, size_t count) noexcept;
+        Builder& geometry(size_t index, uint8_t level, PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices) noexcept; //!< \overload
+
+        /**
+         * Sets the screen size below which a level of detail is used.
+         *
+         * The screen size is the projected diameter of the bounding sphere of the renderable's
+         * bounding box, divided by the height of the viewport. The View selects the coarsest
+         * level whose screen size is larger than the renderable's. Screen sizes must decrease
+         * with the level, and default to 0.5^level.
+         *
+         * @param level level of detail, between 1 and MAX_LEVEL_OF_DETAIL_COUNT - 1
+         * @param screenSize the level is used below this screen size
+         *
+         * \see View::setLevelOfDetailOptions()
+         */
+        Builder& levelOfDetail(uint8_t level, float screenSize) noexcept;
+
         /**
          * Binds a material instance to the specified primitive.
          *
@@ -261,6 +295,26 @@ public:
          */
         Builder& morphing(bool enable) noexcept;
 
+        /**
+         * Draws the renderable's geometry several times with different transforms, 1 by default.
+         *
+         * Each instance is placed by its own transform, relative to the renderable's transform.
+         * The bounding box of the renderable is the one of a single instance, the instances are
+         * culled individually and all the visible ones are drawn with a single draw call per
+         * primitive. The materials can get the index of the instance being drawn with
+         * getInstanceIndex() in the vertex shader.
+         *
+         * Instanced renderables can't use skinning. Their materials should set the
+         * `instanced` property, so that the transforms of the instances have high precision.
+         *
+         * See also RenderableManager::setInstanceTransforms(), which can be called on a per-frame
+         * basis to move the instances.
+         *
+         * @param instanceCount the number of instances, up to 128
+         * @param transforms the initial transforms (one for each instance), identity if null
+         */
+        Builder& instances(size_t instanceCount, math::mat4f const* transforms = nullptr) noexcept;
+
         /**
          * Sets an ordering index for blended primitives that all live at the same Z value.
          *
@@ -269,6 +323,25 @@ public:
          */
         Builder& blendOrder(size_t primitiveIndex, uint16_t order) noexcept;
 
+        /**
+         * Sets a simplified triangle mesh used to hide other renderables when occlusion culling
+         * is enabled on the View, none by default.
+         *
+         * The mesh is in the local space of the renderable, it must be entirely contained
+         * within the renderable's actual geometry (e.g. the inside walls of a building), and
+         * should have a small number of triangles. The data is copied when the renderable is
+         * built, the pointers must stay valid until then.
+         *
+         * @param vertices positions of the occluder's vertices
+         * @param vertexCount number of vertices
+         * @param indices vertex indices, 3 per triangle
+         * @param indexCount number of indices, a multiple of 3
+         *
+         * \see View::setOcclusionCullingOptions(), RenderableManager::setOccluder()
+         */
+        Builder& occluder(math::float3 const* vertices, size_t vertexCount,
+                uint16_t const* indices, size_t indexCount) noexcept;
+
         /**
          * Adds the Renderable component to an entity.
          *
@@ -384,6 +457,21 @@ public:
     void setBones(Instance instance, Bone const* transforms, size_t boneCount = 1, size_t offset = 0) noexcept;
     void setBones(Instance instance, math::mat4f const* transforms, size_t boneCount = 1, size_t offset = 0) noexcept; //!< \overload
 
+    /**
+     * Updates the transforms of the instances in the range [offset, offset + count).
+     * The instances must be pre-allocated using Builder::instances(), the transforms past the
+     * last instance are ignored.
+     */
+    void setInstanceTransforms(Instance instance, math::mat4f const* transforms,
+            size_t count = 1, size_t offset = 0) noexcept;
+
+    /**
+     * Gets the number of instances of the renderable, 1 if it's not instanced.
+     *
+     * \see Builder::instances()
+     */
+    size_t getInstanceCount(Instance instance) const noexcept;
+
     /**
      * Updates the vertex morphing weights on a renderable, all zeroes by default.
      *
@@ -394,6 +482,15 @@ public:
      */
     void setMorphWeights(Instance instance, math::float4 const& weights) noexcept;
 
+    /**
+     * Changes the occluder mesh of a renderable, the data is copied. Passing no indices removes
+     * the occluder.
+     *
+     * \see Builder::occluder()
+     */
+    void setOccluder(Instance instance, math::float3 const* vertices, size_t vertexCount,
+            uint16_t const* indices, size_t indexCount) noexcept;
+
     /**
      * Gets the bounding box used for frustum culling.
      *
@@ -417,7 +514,14 @@ public:
     size_t getPrimitiveCount(Instance instance) const noexcept;
 
     /**
-     * Changes the material instance binding for the given primitive.
+     * Gets the immutable number of levels of detail of the given renderable.
+     *
+     * \see Builder::levelOfDetail()
+     */
+    size_t getLevelOfDetailCount(Instance instance) const noexcept;
+
+    /**
+     * Changes the material instance binding for the given primitive, at all the levels of detail.
      *
      * \see Builder::material()
      */
@@ -430,7 +534,7 @@ public:
     MaterialInstance* getMaterialInstanceAt(Instance instance, size_t primitiveIndex) const noexcept;
 
     /**
-     * Changes the geometry for the given primitive.
+     * Changes the geometry for the given primitive, at the most detailed level.
      *
      * \see Builder::geometry()
      */
@@ -439,7 +543,8 @@ public:
             size_t offset, size_t count) noexcept;
 
     /**
-     * Changes the active range of indices or topology for the given primitive.
+     * Changes the active range of indices or topology for the given primitive, at the most
+     * detailed level.
      *
      * \see Builder::geometry()
      */
@@ -447,7 +552,8 @@ public:
             PrimitiveType type, size_t offset, size_t count) noexcept;
 
     /**
-     * Changes the ordering index for blended primitives that all live at the same Z value.
+     * Changes the ordering index for blended primitives that all live at the same Z value, at
+     * all the levels of detail.
      *
      * \see Builder::blendOrder()
      *
@@ -131,6 +131,61 @@ public:
      * @return Whether the given entity is in the Scene.
      */
     bool hasEntity(utils::Entity entity) const noexcept;
+
+    /**
+     * Enables or disables incremental preparation of the Scene.
+     *
+     * By default, the world transform and bounding box of every Renderable in the Scene is
+     * recomputed each frame. When incremental preparation is enabled, only the Renderables
+     * whose transform, bounding box, visibility or morph weights changed since the previous
+     * frame are updated. Likewise, the per-renderable uniforms are kept in a persistent buffer
+     * and only those of the Renderables that changed are uploaded to the GPU. This is beneficial
+     * for mostly static scenes, but uses more memory.
+     *
+     * Adding or removing entities, or creating or destroying components, causes the next
+     * frame to update all Renderables.
+     *
+     * @param enabled true to enable incremental preparation, false otherwise (default).
+     */
+    void setIncrementalPreparationEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether incremental preparation is enabled.
+     *
+     * @return true if incremental preparation is enabled, false otherwise.
+     * @see setIncrementalPreparationEnabled
+     */
+    bool isIncrementalPreparationEnabled() const noexcept;
+
+    /**
+     * Enables or disables the culling hierarchy of the Scene.
+     *
+     * By default, each Renderable's bounding box is tested against the frustum of the camera and
+     * of the shadow maps. When the culling hierarchy is enabled, a bounding volume hierarchy
+     * is kept over the bounding boxes of the Renderables, which allows to skip the ones that are
+     * far from the frustum. This is beneficial for large scenes (many thousands of Renderables)
+     * of which only a small fraction is visible at a time. The hierarchy is refit when
+     * Renderables move, and rebuilt when entities are added or removed, or when too many
+     * Renderables moved.
+     *
+     * The culling hierarchy requires incremental preparation, and is ignored otherwise.
+     *
+     * When enabled, a hierarchy is also kept over the bounding spheres of the point and spot
+     * lights of scenes with more than a thousand of them, whether or not incremental preparation
+     * is enabled. It is refit only for the lights that moved.
+     *
+     * @param enabled true to enable the culling hierarchy, false otherwise (default).
+     * @see setIncrementalPreparationEnabled
+     */
+    void setCullingHierarchyEnabled(bool enabled) noexcept;
+
+    /**
+     * Returns whether the culling hierarchy is enabled.
+     *
+     * @return true if the culling hierarchy is enabled, false otherwise.
+     * @see setCullingHierarchyEnabled
+     */
+    bool isCullingHierarchyEnabled() const noexcept;
 };
 
 } // namespace filament
@@ -23,6 +23,7 @@
 #include <utils/EntityInstance.h>
 
 #include <math/mathfwd.h>
+#include <math/quat.h>
 
 #include <iterator>
 
@@ -202,6 +203,45 @@ public:
      */
     void setTransform(Instance ci, const math::mat4f& localTransform) noexcept;
 
+    /**
+     * Sets the local transforms of many transform components at once.
+     *
+     * The world transforms of the components and of their descendants are then computed in a
+     * single pass over the hierarchy, which is much faster than calling setTransform() for
+     * each component. This is useful for animation or physics systems.
+     *
+     * @param instances         Array of \p count instances of the components to update.
+     * @param localTransforms   Array of \p count local transforms (i.e. relative to the parent).
+     * @param count             Number of components to update.
+     *
+     * @note If the hierarchy changed since the last call to setTransforms() or
+     *       commitLocalTransformTransaction(), the components are sorted like
+     *       commitLocalTransformTransaction() does, which invalidates their Instance.
+     *       During a local transform transaction, the world transforms are computed by
+     *       commitLocalTransformTransaction() instead.
+     *
+     * @see setTransform(), setParallelTransformUpdateEnabled()
+     */
+    void setTransforms(Instance const* instances,
+            const math::mat4f* localTransforms, size_t count) noexcept;
+
+    /**
+     * Sets the local transforms of many transform components at once, from their translation,
+     * rotation and scale. Each local transform is translation * rotation * scale, and like with
+     * setTransform(Instance, const math::float3&, const math::quatf&, const math::float3&),
+     * the translation, rotation and scale are kept.
+     *
+     * @param instances     Array of \p count instances of the components to update.
+     * @param translations  Array of \p count translations.
+     * @param rotations     Array of \p count unit quaternions.
+     * @param scales        Array of \p count scales, or nullptr to not scale the components.
+     * @param count         Number of components to update.
+     *
+     * @see setTransforms(Instance const*, const math::mat4f*, size_t)
+     */
+    void setTransforms(Instance const* instances, const math::float3* translations,
+            const math::quatf* rotations, const math::float3* scales, size_t count) noexcept;
+
     /**
      * Returns the local transform of a transform component.
      * @param ci The instance of the transform component to query the local transform from.
@@ -211,6 +251,78 @@ public:
      */
     const math::mat4f& getTransform(Instance ci) const noexcept;
 
+    /**
+     * Sets a local transform of a transform component from a translation, a rotation and a
+     * scale. The local transform is translation * rotation * scale.
+     *
+     * The translation, rotation and scale are stored along with the local transform, so that
+     * setTranslation(), setRotation() and setScale() can change one of them without having to
+     * decompose the local transform. This is typically useful for animation.
+     *
+     * @param ci            The instance of the transform component to set the local transform to.
+     * @param translation   The translation, relative to the parent.
+     * @param rotation      The rotation, a unit quaternion.
+     * @param scale         The scale.
+     * @see setTranslation(), setRotation(), setScale()
+     */
+    void setTransform(Instance ci, const math::float3& translation,
+            const math::quatf& rotation, const math::float3& scale) noexcept;
+
+    /**
+     * Sets the translation of the local transform of a transform component, keeping its
+     * rotation and scale.
+     *
+     * @param ci            The instance of the transform component.
+     * @param translation   The translation, relative to the parent.
+     * @note If the local transform was last set with a matrix, it is decomposed once.
+     * @see setTransform(Instance, const math::float3&, const math::quatf&, const math::float3&)
+     */
+    void setTranslation(Instance ci, const math::float3& translation) noexcept;
+
+    /**
+     * Sets the rotation of the local transform of a transform component, keeping its
+     * translation and scale.
+     *
+     * @param ci        The instance of the transform component.
+     * @param rotation  The rotation, a unit quaternion.
+     * @note If the local transform was last set with a matrix, it is decomposed once.
+     * @see setTransform(Instance, const math::float3&, const math::quatf&, const math::float3&)
+     */
+    void setRotation(Instance ci, const math::quatf& rotation) noexcept;
+
+    /**
+     * Sets the scale of the local transform of a transform component, keeping its
+     * translation and rotation.
+     *
+     * @param ci    The instance of the transform component.
+     * @param scale The scale.
+     * @note If the local transform was last set with a matrix, it is decomposed once.
+     * @see setTransform(Instance, const math::float3&, const math::quatf&, const math::float3&)
+     */
+    void setScale(Instance ci, const math::float3& scale) noexcept;
+
+    /**
+     * Returns the translation of the local transform of a transform component.
+     * @param ci The instance of the transform component.
+     * @return The translation, relative to the parent.
+     */
+    math::float3 getTranslation(Instance ci) const noexcept;
+
+    /**
+     * Returns the rotation of the local transform of a transform component.
+     * @param ci The instance of the transform component.
+     * @return The rotation, as a unit quaternion. If the local transform was set with a matrix,
+     *         this is computed from it.
+     */
+    math::quatf getRotation(Instance ci) const noexcept;
+
+    /**
+     * Returns the scale of the local transform of a transform component.
+     * @param ci The instance of the transform component.
+     * @return The scale. If the local transform was set with a matrix, this is computed from it.
+     */
+    math::float3 getScale(Instance ci) const noexcept;
+
     /**
      * Return the world transform of a transform component.
      * @param ci The instance of the transform component to query the world transform from.
@@ -247,6 +359,31 @@ public:
      * @see openLocalTransformTransaction(), setTransform()
      */
     void commitLocalTransformTransaction() noexcept;
+
+    /**
+     * Enables or disables the parallel computation of world transforms by
+     * commitLocalTransformTransaction().
+     *
+     * When enabled, commitLocalTransformTransaction() keeps the transform components sorted by
+     * their depth in the hierarchy (the roots first, then their children, and so on), and
+     * computes the world transforms of each level in parallel. This is useful with very large
+     * hierarchies, say tens of thousands of transforms or more. setTransforms() computes the
+     * world transforms in parallel as well.
+     *
+     * @param enable true to compute the world transforms in parallel. Disabled by default.
+     *
+     * @note The components are sorted again only when the hierarchy changed since the last
+     *       commit. Like with the default mode, this invalidates their Instance.
+     *
+     * @see commitLocalTransformTransaction()
+     */
+    void setParallelTransformUpdateEnabled(bool enable) noexcept;
+
+    /**
+     * Returns whether the world transforms are computed in parallel.
+     * @see setParallelTransformUpdateEnabled()
+     */
+    bool isParallelTransformUpdateEnabled() const noexcept;
 };
 
 } // namespace filament
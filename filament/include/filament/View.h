@@ -187,6 +187,63 @@ public:
         bool enabled = false;                       //!< enables or disables the vignette effect
     };
 
+    /**
+     * Options to control the occlusion culling of renderables on the CPU.
+     *
+     * When enabled, the occluder meshes of the visible renderables (see
+     * RenderableManager::Builder::occluder()) are rasterized into a low resolution depth buffer,
+     * and renderables entirely hidden behind them are not drawn. Shadow casters are not
+     * affected.
+     *
+     * @see setOcclusionCullingOptions, getOcclusionCullingStatistics
+     */
+    struct OcclusionCullingOptions {
+        uint16_t resolution = 256;  //!< width of the depth buffer in pixels, between 64 and 1024. The height follows the viewport's aspect ratio.
+        bool enabled = false;       //!< enables or disables occlusion culling
+    };
+
+    /**
+     * Statistics of the occlusion culling of the last frame.
+     *
+     * @see getOcclusionCullingStatistics
+     */
+    struct OcclusionCullingStatistics {
+        uint32_t occluderCount = 0; //!< number of occluders rasterized
+        uint32_t testedCount = 0;   //!< number of renderables tested against the occluders
+        uint32_t culledCount = 0;   //!< number of renderables found hidden by the occluders
+        float cpuTime = 0.0f;       //!< time spent on occlusion culling, in milliseconds
+    };
+
+    /**
+     * Options to control the selection of the levels of detail of renderables, and the culling
+     * of small renderables.
+     *
+     * Both are based on the screen size of renderables: the projected diameter of the bounding
+     * sphere of their bounding box, divided by the viewport's height.
+     *
+     * @see setLevelOfDetailOptions, RenderableManager::Builder::levelOfDetail()
+     */
+    struct LevelOfDetailOptions {
+        /**
+         * Added to the level of detail selected for each renderable, positive values select
+         * coarser levels. The result is clamped to the levels of each renderable.
+         */
+        int8_t bias = 0;
+
+        /**
+         * Relative margin around the screen sizes of the levels of detail, which renderables
+         * must cross to switch to another level. This avoids switching back and forth when a
+         * renderable stays close to a threshold. Between 0 and 0.5.
+         */
+        float hysteresis = 0.1f;
+
+        /**
+         * Renderables whose screen size is smaller than this many pixels are not drawn, 0 to
+         * disable. Shadow casters and renderables with culling disabled are not affected.
+         */
+        float smallFeatureCulling = 0.0f;
+    };
+
     /**
      * Structure used to set the precision of the color buffer and related quality settings.
      *
@@ -590,6 +647,43 @@ public:
      */
     VignetteOptions getVignetteOptions() const noexcept;
 
+    /**
+     * Enables or disables occlusion culling on the CPU. Disabled by default.
+     *
+     * @param options options
+     */
+    void setOcclusionCullingOptions(OcclusionCullingOptions options) noexcept;
+
+    /**
+     * Queries the occlusion culling options.
+     *
+     * @return the current occlusion culling options for this view.
+     */
+    OcclusionCullingOptions getOcclusionCullingOptions() const noexcept;
+
+    /**
+     * Returns the statistics of the occlusion culling of the last frame rendered with this
+     * view. All the counters are zero when occlusion culling is disabled.
+     *
+     * @return the occlusion culling statistics of the last frame.
+     */
+    OcclusionCullingStatistics getOcclusionCullingStatistics() const noexcept;
+
+    /**
+     * Sets the options used to select the levels of detail of renderables, and to cull the
+     * smallest ones.
+     *
+     * @param options options
+     */
+    void setLevelOfDetailOptions(LevelOfDetailOptions options) noexcept;
+
+    /**
+     * Queries the level of detail options.
+     *
+     * @return the current level of detail options for this view.
+     */
+    LevelOfDetailOptions getLevelOfDetailOptions() const noexcept;
+
     /**
      * Enables or disables dithering in the post-processing stage. Enabled by default.
      *
@@ -28,9 +28,11 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
+#include <utils/Hash.h>
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
 #include <functional>
 
 namespace filament {
@@ -208,12 +210,8 @@ inline float3 adaptationTransform(float2 whiteBalance) {
     return ILLUMINANT_D65_LMS / lms;
 }
 
-UTILS_ALWAYS_INLINE
-inline float3 chromaticAdaptation(float3 v, float2 whiteBalance) {
-    v = sRGB_to_LMS * v;
-    v = adaptationTransform(whiteBalance) * v;
-    v = LMS_to_sRGB * v;
-    return v;
+inline mat3f chromaticAdaptation(float2 whiteBalance) {
+    return LMS_to_sRGB * mat3f::scaling(adaptationTransform(whiteBalance)) * sRGB_to_LMS;
 }
 
 //------------------------------------------------------------------------------
@@ -336,10 +334,15 @@ inline float3 vibrance(float3 v, float vibrance) {
 
 }
 
+inline float3 curvesDarkScale(float3 shadowGamma, float3 midPoint) {
+    return 1.0f / (pow(midPoint, shadowGamma - 1.0f));
+}
+
 UTILS_ALWAYS_INLINE
-inline float3 curves(float3 v, float3 shadowGamma, float3 midPoint, float3 highlightScale) {
+inline float3 curves(float3 v, float3 shadowGamma, float3 midPoint, float3 highlightScale,
+        float3 d) {
     // "Practical HDR and Wide Color Techniques in Gran Turismo SPORT", Uchimura 2018
-    float3 d = 1.0f / (pow(midPoint, shadowGamma - 1.0f));
+    // d is curvesDarkScale(shadowGamma, midPoint), which doesn't depend on v
     float3 dark = pow(v, shadowGamma) * d;
     float3 light = highlightScale * (v - midPoint) + midPoint;
     return float3{
@@ -377,32 +380,55 @@ ColorTransform selectToneMapping(ColorGrading::ToneMapping toneMapping) {
 //------------------------------------------------------------------------------
 
 struct Config {
-    mat3f colorGradingTransformIn;
+    mat3f colorGradingTransformIn;      // includes the white balance
     mat3f colorGradingTransformOut;
     float3 lumaTransform;
+    float3 curvesDarkScale;
     ColorTransform linearToLogTransform;
     ColorTransform logToLinearTransform;
     ColorTransform toneMapper;
+    float linear[LUT_DIMENSION];        // LogC decoding of the coordinates of the LUT
 };
 
 FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
     SYSTRACE_CALL();
 
+    // identical color gradings share their LUT
+    LutCache& lutCache = engine.getColorGradingLutCache();
+    mLutHandle = lutCache.acquire(builder);
+    if (mLutHandle) {
+        return;
+    }
+
     DriverApi& driver = engine.getDriverApi();
 
     constexpr size_t lutElementCount = LUT_DIMENSION * LUT_DIMENSION * LUT_DIMENSION;
     constexpr size_t elementSize = sizeof(half4);
     void* const data = malloc(lutElementCount * elementSize);
 
+    // everything that doesn't depend on the texel is computed once here
     Config config{
         .colorGradingTransformIn  = selectColorGradingTransformIn(builder->toneMapping),
         .colorGradingTransformOut = selectColorGradingTransformOut(builder->toneMapping),
         .lumaTransform            = selectLumaTransform(builder->toneMapping),
+        .curvesDarkScale          = curvesDarkScale(builder->shadowGamma, builder->midPoint),
         .linearToLogTransform     = selectLinearToLogTransform(builder->toneMapping),
         .logToLinearTransform     = selectLogToLinearTransform(builder->toneMapping),
         .toneMapper               = selectToneMapping(builder->toneMapping)
     };
 
+    // TODO: Peformed in sRGB, should be in Rec.2020 or AP1
+    if (builder->hasAdjustments) {
+        // White balance
+        config.colorGradingTransformIn =
+                config.colorGradingTransformIn * chromaticAdaptation(builder->whiteBalance);
+    }
+
+    // LogC encoding, which applies to each channel independently
+    for (size_t i = 0; i < LUT_DIMENSION; i++) {
+        config.linear[i] = LogC_to_linear(float3{ i * (1.0f / (LUT_DIMENSION - 1u)) }).x;
+    }
+
     //auto now = std::chrono::steady_clock::now();
 
     // Multithreadedly generate the tone mapping 3D look-up table using 32 jobs
@@ -415,18 +441,10 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
             half4* UTILS_RESTRICT p = (half4*) data + b * LUT_DIMENSION * LUT_DIMENSION;
             for (size_t g = 0; g < LUT_DIMENSION; g++) {
                 for (size_t r = 0; r < LUT_DIMENSION; r++) {
-                    float3 v = float3{r, g, b} * (1.0f / (LUT_DIMENSION - 1u));
-
                     // LogC encoding
-                    v = LogC_to_linear(v);
+                    float3 v{ config.linear[r], config.linear[g], config.linear[b] };
 
-                    // TODO: Peformed in sRGB, should be in Rec.2020 or AP1
-                    if (builder->hasAdjustments) {
-                        // White balance
-                        v = chromaticAdaptation(v, builder->whiteBalance);
-                    }
-
-                    // Convert to color grading color space
+                    // White balance, and convert to color grading color space
                     v = config.colorGradingTransformIn * v;
 
                     if (builder->hasAdjustments) {
@@ -465,7 +483,8 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
 
                         // RGB curves
                         v = curves(v,
-                                builder->shadowGamma, builder->midPoint, builder->highlightScale);
+                                builder->shadowGamma, builder->midPoint, builder->highlightScale,
+                                config.curvesDarkScale);
                     }
 
                     // Tone mapping
@@ -505,13 +524,108 @@ FColorGrading::FColorGrading(FEngine& engine, const Builder& builder) {
                     [](void* buffer, size_t, void*) { free(buffer); }
             }
     );
+
+    lutCache.insert(builder, mLutHandle);
 }
 
 FColorGrading::~FColorGrading() noexcept = default;
 
 void FColorGrading::terminate(FEngine& engine) {
     DriverApi& driver = engine.getDriverApi();
-    driver.destroyTexture(mLutHandle);
+    engine.getColorGradingLutCache().release(driver, mLutHandle);
+}
+
+//------------------------------------------------------------------------------
+// LUT cache
+//------------------------------------------------------------------------------
+
+static void hashCombine(size_t& seed, float v) noexcept {
+    utils::hash::combine(seed, v);
+}
+
+template<typename VECTOR>
+static void hashCombine(size_t& seed, VECTOR const& v) noexcept {
+    for (size_t i = 0; i < v.size(); i++) {
+        hashCombine(seed, v[i]);
+    }
+}
+
+uint32_t FColorGrading::hashSettings(const Builder& builder) noexcept {
+    // hasAdjustments is not hashed, it's derived from the other settings
+    size_t seed = 0;
+    utils::hash::combine(seed, uint32_t(builder->toneMapping));
+    hashCombine(seed, builder->whiteBalance);
+    hashCombine(seed, builder->outRed);
+    hashCombine(seed, builder->outGreen);
+    hashCombine(seed, builder->outBlue);
+    hashCombine(seed, builder->shadows);
+    hashCombine(seed, builder->midtones);
+    hashCombine(seed, builder->highlights);
+    hashCombine(seed, builder->tonalRanges);
+    hashCombine(seed, builder->slope);
+    hashCombine(seed, builder->offset);
+    hashCombine(seed, builder->power);
+    hashCombine(seed, builder->contrast);
+    hashCombine(seed, builder->vibrance);
+    hashCombine(seed, builder->saturation);
+    hashCombine(seed, builder->shadowGamma);
+    hashCombine(seed, builder->midPoint);
+    hashCombine(seed, builder->highlightScale);
+    return uint32_t(seed);
+}
+
+bool FColorGrading::isSameSettings(const Builder& lhs, const Builder& rhs) noexcept {
+    return *lhs.mImpl == *rhs.mImpl;
+}
+
+TextureHandle FColorGrading::LutCache::acquire(const Builder& builder) noexcept {
+    const uint32_t h = hashSettings(builder);
+    auto pos = std::find_if(mEntries.begin(), mEntries.end(), [h, &builder](Entry const& entry) {
+        return entry.hash == h && isSameSettings(entry.settings, builder);
+    });
+    if (pos == mEntries.end()) {
+        return {};
+    }
+    pos->refs++;
+    pos->lastUse = ++mTime;
+    return pos->handle;
+}
+
+void FColorGrading::LutCache::insert(const Builder& builder, TextureHandle handle) {
+    mEntries.push_back({ hashSettings(builder), 1, ++mTime, builder, handle });
+}
+
+size_t FColorGrading::LutCache::getUnusedLutCount() const noexcept {
+    return std::count_if(mEntries.begin(), mEntries.end(),
+            [](Entry const& entry) { return !entry.refs; });
+}
+
+void FColorGrading::LutCache::release(DriverApi& driver, TextureHandle handle) noexcept {
+    auto pos = std::find_if(mEntries.begin(), mEntries.end(),
+            [handle](Entry const& entry) { return entry.handle == handle; });
+    assert(pos != mEntries.end() && pos->refs);
+    pos->refs--;
+    pos->lastUse = ++mTime;
+
+    // only keep the most recently used of the unused LUTs
+    if (getUnusedLutCount() > MAX_UNUSED_COUNT) {
+        auto lru = mEntries.end();
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it) {
+            if (!it->refs && (lru == mEntries.end() || it->lastUse < lru->lastUse)) {
+                lru = it;
+            }
+        }
+        driver.destroyTexture(lru->handle);
+        mEntries.erase(lru);
+    }
+}
+
+void FColorGrading::LutCache::terminate(DriverApi& driver) noexcept {
+    for (Entry const& entry : mEntries) {
+        assert(!entry.refs);
+        driver.destroyTexture(entry.handle);
+    }
+    mEntries.clear();
 }
 
 } //namespace filament
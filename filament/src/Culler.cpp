@@ -20,22 +20,39 @@
 
 #include <math/fast.h>
 
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__clang__) || defined(__GNUC__))
+#   define CULLER_HAS_X86_KERNELS 1
+#   include <immintrin.h>
+#else
+#   define CULLER_HAS_X86_KERNELS 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#   define CULLER_HAS_NEON_KERNELS 1
+#   include <arm_neon.h>
+#else
+#   define CULLER_HAS_NEON_KERNELS 0
+#endif
+
 using namespace filament::math;
 
 namespace filament {
 
-void Culler::intersects(
+using result_type = Culler::result_type;
+
+// ------------------------------------------------------------------------------------------------
+// Portable kernels, these rely on auto-vectorization
+// ------------------------------------------------------------------------------------------------
+
+static void intersectsPortable(
         result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT planes,
         float4 const* UTILS_RESTRICT b,
         size_t count) noexcept {
 
-    float4 const * const UTILS_RESTRICT planes = frustum.mPlanes;
-
     // we use a vectorize width of 8 because, on ARMv8 it allow the compiler to write 8
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
@@ -55,19 +72,16 @@ void Culler::intersects(
     }
 }
 
-void Culler::intersects(
+static void intersectsPortable(
         result_type* UTILS_RESTRICT results,
-        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT planes,
         float3 const* UTILS_RESTRICT center,
         float3 const* UTILS_RESTRICT extent,
         size_t count, size_t bit) noexcept {
 
-    float4 const * UTILS_RESTRICT const planes = frustum.mPlanes;
-
     // we use a vectorize width of 8 because, on ARMv8 it allows the compiler to write eight
     // 8-bits results in one go. Without this it has to do 4 separate byte writes, which
     // ends-up being slower.
-    count = round(count); // capacity guaranteed to be multiple of 8
     #pragma clang loop vectorize_width(8)
     for (size_t i = 0; i < count; i++) {
         int visible = ~0;
@@ -89,6 +103,363 @@ void Culler::intersects(
     }
 }
 
+// ------------------------------------------------------------------------------------------------
+// x86 kernels, compiled for AVX2 and AVX-512 regardless of the baseline ISA and selected at
+// runtime. The AVX-512 kernels process 16 items per iteration and use the AVX2 kernels for the
+// remaining 8 items, if any.
+// ------------------------------------------------------------------------------------------------
+
+#if CULLER_HAS_X86_KERNELS
+
+// transposes 8 float3 into 3 vectors of 8 x, y and z
+__attribute__((target("avx2,fma")))
+static inline void loadFloat3x8(float const* UTILS_RESTRICT p,
+        __m256& x, __m256& y, __m256& z) noexcept {
+    __m256 m03 = _mm256_castps128_ps256(_mm_loadu_ps(p +  0));
+    __m256 m14 = _mm256_castps128_ps256(_mm_loadu_ps(p +  4));
+    __m256 m25 = _mm256_castps128_ps256(_mm_loadu_ps(p +  8));
+    m03 = _mm256_insertf128_ps(m03, _mm_loadu_ps(p + 12), 1);
+    m14 = _mm256_insertf128_ps(m14, _mm_loadu_ps(p + 16), 1);
+    m25 = _mm256_insertf128_ps(m25, _mm_loadu_ps(p + 20), 1);
+    __m256 const xy = _mm256_shuffle_ps(m14, m25, _MM_SHUFFLE(2, 1, 3, 2));
+    __m256 const yz = _mm256_shuffle_ps(m03, m14, _MM_SHUFFLE(1, 0, 2, 1));
+    x = _mm256_shuffle_ps(m03, xy, _MM_SHUFFLE(2, 0, 3, 0));
+    y = _mm256_shuffle_ps(yz,  xy, _MM_SHUFFLE(3, 1, 2, 0));
+    z = _mm256_shuffle_ps(yz, m25, _MM_SHUFFLE(3, 0, 3, 1));
+}
+
+// transposes 8 float4 into 4 vectors of 8 x, y, z and w
+__attribute__((target("avx2,fma")))
+static inline void loadFloat4x8(float const* UTILS_RESTRICT p,
+        __m256& x, __m256& y, __m256& z, __m256& w) noexcept {
+    __m256 const r0 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p +  0)), _mm_loadu_ps(p + 16), 1);
+    __m256 const r1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p +  4)), _mm_loadu_ps(p + 20), 1);
+    __m256 const r2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p +  8)), _mm_loadu_ps(p + 24), 1);
+    __m256 const r3 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(p + 12)), _mm_loadu_ps(p + 28), 1);
+    __m256 const t0 = _mm256_unpacklo_ps(r0, r1);
+    __m256 const t1 = _mm256_unpackhi_ps(r0, r1);
+    __m256 const t2 = _mm256_unpacklo_ps(r2, r3);
+    __m256 const t3 = _mm256_unpackhi_ps(r2, r3);
+    x = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    y = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    z = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    w = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// converts the sign bits of 8 floats to 8 bytes set to 0 or 1
+__attribute__((target("avx2,fma")))
+static inline __m128i signToBytes(__m256 visible) noexcept {
+    __m256i const v = _mm256_srli_epi32(_mm256_castps_si256(visible), 31);
+    __m128i const w = _mm_packus_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    return _mm_packus_epi16(w, w);
+}
+
+__attribute__((target("avx2,fma")))
+static void intersectsAvx2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 x, y, z, w;
+        loadFloat4x8(&b[i].x, x, y, z, w);
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++) {
+            __m256 dot = _mm256_sub_ps(_mm256_set1_ps(planes[j].w), w);
+            dot = _mm256_fmadd_ps(_mm256_set1_ps(planes[j].z), z, dot);
+            dot = _mm256_fmadd_ps(_mm256_set1_ps(planes[j].y), y, dot);
+            dot = _mm256_fmadd_ps(_mm256_set1_ps(planes[j].x), x, dot);
+            visible = _mm256_and_ps(visible, dot);
+        }
+        _mm_storel_epi64((__m128i*)(results + i), signToBytes(visible));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void intersectsAvx2(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    __m256 const absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    __m128i const shift = _mm_cvtsi32_si128(int(bit));
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 cx, cy, cz, ex, ey, ez;
+        loadFloat3x8(&center[i].x, cx, cy, cz);
+        loadFloat3x8(&extent[i].x, ex, ey, ez);
+        __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++) {
+            __m256 const px = _mm256_set1_ps(planes[j].x);
+            __m256 const py = _mm256_set1_ps(planes[j].y);
+            __m256 const pz = _mm256_set1_ps(planes[j].z);
+            __m256 d = _mm256_fmadd_ps(pz, cz, _mm256_set1_ps(planes[j].w));
+            d = _mm256_fmadd_ps(py, cy, d);
+            d = _mm256_fmadd_ps(px, cx, d);
+            __m256 r = _mm256_mul_ps(_mm256_and_ps(pz, absMask), ez);
+            r = _mm256_fmadd_ps(_mm256_and_ps(py, absMask), ey, r);
+            r = _mm256_fmadd_ps(_mm256_and_ps(px, absMask), ex, r);
+            visible = _mm256_and_ps(visible, _mm256_sub_ps(d, r));
+        }
+        // this is where the visibility bit is merged into the existing results
+        __m128i const bytes = _mm_sll_epi16(signToBytes(visible), shift);
+        __m128i const prev = _mm_loadl_epi64((__m128i const*)(results + i));
+        _mm_storel_epi64((__m128i*)(results + i), _mm_or_si128(prev, bytes));
+    }
+}
+
+// transposes 16 float3 into 3 vectors of 16 x, y and z
+__attribute__((target("avx512f")))
+static inline void loadFloat3x16(float const* UTILS_RESTRICT p,
+        __m512& x, __m512& y, __m512& z) noexcept {
+    // the first permute gathers the components found in the first 32 floats, the second one
+    // the components found in the last 16 floats.
+    alignas(64) static constexpr int32_t indices[3][2][16] = {
+            {{ 0, 3, 6,  9, 12, 15, 18, 21, 24, 27, 30, 0, 0, 0, 0, 0 },
+             { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 17, 20, 23, 26, 29 }},
+            {{ 1, 4, 7, 10, 13, 16, 19, 22, 25, 28, 31, 0, 0, 0, 0, 0 },
+             { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 18, 21, 24, 27, 30 }},
+            {{ 2, 5, 8, 11, 14, 17, 20, 23, 26, 29,  0, 0, 0, 0, 0, 0 },
+             { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 16, 19, 22, 25, 28, 31 }},
+    };
+    __m512 const a = _mm512_loadu_ps(p +  0);
+    __m512 const b = _mm512_loadu_ps(p + 16);
+    __m512 const c = _mm512_loadu_ps(p + 32);
+    __m512* const out[3] = { &x, &y, &z };
+    for (size_t k = 0; k < 3; k++) {
+        __m512 const ab = _mm512_permutex2var_ps(a, _mm512_load_si512(indices[k][0]), b);
+        *out[k] = _mm512_permutex2var_ps(ab, _mm512_load_si512(indices[k][1]), c);
+    }
+}
+
+// transposes 16 float4 into 4 vectors of 16 x, y, z and w
+__attribute__((target("avx512f")))
+static inline void loadFloat4x16(float const* UTILS_RESTRICT p,
+        __m512& x, __m512& y, __m512& z, __m512& w) noexcept {
+    // gathers [x0..x7, y0..y7] and [z0..z7, w0..w7] out of 8 float4
+    alignas(64) static constexpr int32_t xy[16] = {
+            0, 4, 8, 12, 16, 20, 24, 28, 1, 5, 9, 13, 17, 21, 25, 29 };
+    alignas(64) static constexpr int32_t zw[16] = {
+            2, 6, 10, 14, 18, 22, 26, 30, 3, 7, 11, 15, 19, 23, 27, 31 };
+    __m512i const ixy = _mm512_load_si512(xy);
+    __m512i const izw = _mm512_load_si512(zw);
+    __m512 const r0 = _mm512_loadu_ps(p +  0);
+    __m512 const r1 = _mm512_loadu_ps(p + 16);
+    __m512 const r2 = _mm512_loadu_ps(p + 32);
+    __m512 const r3 = _mm512_loadu_ps(p + 48);
+    __m512 const xy0 = _mm512_permutex2var_ps(r0, ixy, r1);
+    __m512 const zw0 = _mm512_permutex2var_ps(r0, izw, r1);
+    __m512 const xy1 = _mm512_permutex2var_ps(r2, ixy, r3);
+    __m512 const zw1 = _mm512_permutex2var_ps(r2, izw, r3);
+    x = _mm512_shuffle_f32x4(xy0, xy1, _MM_SHUFFLE(1, 0, 1, 0));
+    y = _mm512_shuffle_f32x4(xy0, xy1, _MM_SHUFFLE(3, 2, 3, 2));
+    z = _mm512_shuffle_f32x4(zw0, zw1, _MM_SHUFFLE(1, 0, 1, 0));
+    w = _mm512_shuffle_f32x4(zw0, zw1, _MM_SHUFFLE(3, 2, 3, 2));
+}
+
+// converts the sign bits of 16 floats to 16 bytes set to 0 or 1
+__attribute__((target("avx512f")))
+static inline __m128i signToBytes(__m512 visible) noexcept {
+    return _mm512_cvtepi32_epi8(_mm512_srli_epi32(_mm512_castps_si512(visible), 31));
+}
+
+__attribute__((target("avx512f")))
+static void intersectsAvx512(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 x, y, z, w;
+        loadFloat4x16(&b[i].x, x, y, z, w);
+        __m512 visible = _mm512_castsi512_ps(_mm512_set1_epi32(-1));
+        for (size_t j = 0; j < 6; j++) {
+            __m512 dot = _mm512_sub_ps(_mm512_set1_ps(planes[j].w), w);
+            dot = _mm512_fmadd_ps(_mm512_set1_ps(planes[j].z), z, dot);
+            dot = _mm512_fmadd_ps(_mm512_set1_ps(planes[j].y), y, dot);
+            dot = _mm512_fmadd_ps(_mm512_set1_ps(planes[j].x), x, dot);
+            visible = _mm512_castsi512_ps(_mm512_and_si512(
+                    _mm512_castps_si512(visible), _mm512_castps_si512(dot)));
+        }
+        _mm_storeu_si128((__m128i*)(results + i), signToBytes(visible));
+    }
+    if (i < count) {
+        intersectsAvx2(results + i, planes, b + i, count - i);
+    }
+}
+
+__attribute__((target("avx512f")))
+static void intersectsAvx512(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    __m512i const absMask = _mm512_set1_epi32(0x7fffffff);
+    __m128i const shift = _mm_cvtsi32_si128(int(bit));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m512 cx, cy, cz, ex, ey, ez;
+        loadFloat3x16(&center[i].x, cx, cy, cz);
+        loadFloat3x16(&extent[i].x, ex, ey, ez);
+        __m512i visible = _mm512_set1_epi32(-1);
+        for (size_t j = 0; j < 6; j++) {
+            __m512 const px = _mm512_set1_ps(planes[j].x);
+            __m512 const py = _mm512_set1_ps(planes[j].y);
+            __m512 const pz = _mm512_set1_ps(planes[j].z);
+            __m512 const ax = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(px), absMask));
+            __m512 const ay = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(py), absMask));
+            __m512 const az = _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(pz), absMask));
+            __m512 d = _mm512_fmadd_ps(pz, cz, _mm512_set1_ps(planes[j].w));
+            d = _mm512_fmadd_ps(py, cy, d);
+            d = _mm512_fmadd_ps(px, cx, d);
+            __m512 r = _mm512_mul_ps(az, ez);
+            r = _mm512_fmadd_ps(ay, ey, r);
+            r = _mm512_fmadd_ps(ax, ex, r);
+            visible = _mm512_and_si512(visible, _mm512_castps_si512(_mm512_sub_ps(d, r)));
+        }
+        // this is where the visibility bit is merged into the existing results
+        __m128i const bytes = _mm_sll_epi16(signToBytes(_mm512_castsi512_ps(visible)), shift);
+        __m128i const prev = _mm_loadu_si128((__m128i const*)(results + i));
+        _mm_storeu_si128((__m128i*)(results + i), _mm_or_si128(prev, bytes));
+    }
+    if (i < count) {
+        intersectsAvx2(results + i, planes, center + i, extent + i, count - i, bit);
+    }
+}
+
+#endif // CULLER_HAS_X86_KERNELS
+
+// ------------------------------------------------------------------------------------------------
+// ARMv8 kernels, NEON is always available so these don't need a runtime check
+// ------------------------------------------------------------------------------------------------
+
+#if CULLER_HAS_NEON_KERNELS
+
+// converts the sign bits of 2 x 4 floats to 8 bytes set to 0 or 1
+static inline uint8x8_t signToBytes(uint32x4_t lo, uint32x4_t hi) noexcept {
+    uint16x8_t const w = vcombine_u16(vmovn_u32(vshrq_n_u32(lo, 31)), vmovn_u32(vshrq_n_u32(hi, 31)));
+    return vmovn_u16(w);
+}
+
+static inline uint32x4_t intersectsNeon(float4 const* UTILS_RESTRICT planes,
+        float32x4x4_t const& s) noexcept {
+    uint32x4_t visible = vdupq_n_u32(~0u);
+    for (size_t j = 0; j < 6; j++) {
+        float32x4_t dot = vsubq_f32(vdupq_n_f32(planes[j].w), s.val[3]);
+        dot = vfmaq_n_f32(dot, s.val[2], planes[j].z);
+        dot = vfmaq_n_f32(dot, s.val[1], planes[j].y);
+        dot = vfmaq_n_f32(dot, s.val[0], planes[j].x);
+        visible = vandq_u32(visible, vreinterpretq_u32_f32(dot));
+    }
+    return visible;
+}
+
+static inline uint32x4_t intersectsNeon(float4 const* UTILS_RESTRICT planes,
+        float32x4x3_t const& c, float32x4x3_t const& e) noexcept {
+    uint32x4_t visible = vdupq_n_u32(~0u);
+    for (size_t j = 0; j < 6; j++) {
+        float32x4_t d = vfmaq_n_f32(vdupq_n_f32(planes[j].w), c.val[2], planes[j].z);
+        d = vfmaq_n_f32(d, c.val[1], planes[j].y);
+        d = vfmaq_n_f32(d, c.val[0], planes[j].x);
+        float32x4_t r = vmulq_n_f32(e.val[2], std::abs(planes[j].z));
+        r = vfmaq_n_f32(r, e.val[1], std::abs(planes[j].y));
+        r = vfmaq_n_f32(r, e.val[0], std::abs(planes[j].x));
+        visible = vandq_u32(visible, vreinterpretq_u32_f32(vsubq_f32(d, r)));
+    }
+    return visible;
+}
+
+static void intersectsNeon(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    for (size_t i = 0; i < count; i += 8) {
+        uint32x4_t const lo = intersectsNeon(planes, vld4q_f32(&b[i + 0].x));
+        uint32x4_t const hi = intersectsNeon(planes, vld4q_f32(&b[i + 4].x));
+        vst1_u8(results + i, signToBytes(lo, hi));
+    }
+}
+
+static void intersectsNeon(
+        result_type* UTILS_RESTRICT results,
+        float4 const* UTILS_RESTRICT planes,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    int8x8_t const shift = vdup_n_s8(int8_t(bit));
+    for (size_t i = 0; i < count; i += 8) {
+        uint32x4_t const lo = intersectsNeon(planes,
+                vld3q_f32(&center[i + 0].x), vld3q_f32(&extent[i + 0].x));
+        uint32x4_t const hi = intersectsNeon(planes,
+                vld3q_f32(&center[i + 4].x), vld3q_f32(&extent[i + 4].x));
+        // this is where the visibility bit is merged into the existing results
+        uint8x8_t const bytes = vshl_u8(signToBytes(lo, hi), shift);
+        vst1_u8(results + i, vorr_u8(vld1_u8(results + i), bytes));
+    }
+}
+
+#endif // CULLER_HAS_NEON_KERNELS
+
+// ------------------------------------------------------------------------------------------------
+// Kernel selection
+// ------------------------------------------------------------------------------------------------
+
+namespace {
+
+struct Kernels {
+    void (*spheres)(result_type*, float4 const*, float4 const*, size_t) noexcept;
+    void (*boxes)(result_type*, float4 const*, float3 const*, float3 const*, size_t, size_t) noexcept;
+    const char* name;
+};
+
+Kernels selectKernels() noexcept {
+#if CULLER_HAS_X86_KERNELS
+    // this can run before main() (e.g. for a static Frustum), when the cpu model isn't
+    // initialized yet.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        return { intersectsAvx512, intersectsAvx512, "avx512" };
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return { intersectsAvx2, intersectsAvx2, "avx2" };
+    }
+    return { intersectsPortable, intersectsPortable, "portable" };
+#elif CULLER_HAS_NEON_KERNELS
+    return { intersectsNeon, intersectsNeon, "neon" };
+#else
+    return { intersectsPortable, intersectsPortable, "portable" };
+#endif
+}
+
+Kernels const& getKernels() noexcept {
+    static const Kernels kernels = selectKernels();
+    return kernels;
+}
+
+} // anonymous namespace
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT b,
+        size_t count) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+    getKernels().spheres(results, frustum.mPlanes, b, count);
+}
+
+void Culler::intersects(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+    count = round(count); // capacity guaranteed to be multiple of 8
+    getKernels().boxes(results, frustum.mPlanes, center, extent, count, bit);
+}
+
 /*
  * returns whether a box intersects with the frustum
  */
@@ -136,4 +507,24 @@ void Culler::Test::intersects(
     Culler::intersects(results, frustum, b, count);
 }
 
+void Culler::Test::intersectsPortable(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float3 const* UTILS_RESTRICT c,
+        float3 const* UTILS_RESTRICT e,
+        size_t count) noexcept {
+    filament::intersectsPortable(results, frustum.getNormalizedPlanes(), c, e, round(count), 0);
+}
+
+void Culler::Test::intersectsPortable(
+        result_type* UTILS_RESTRICT results,
+        Frustum const& UTILS_RESTRICT frustum,
+        float4 const* UTILS_RESTRICT b, size_t count) noexcept {
+    filament::intersectsPortable(results, frustum.getNormalizedPlanes(), b, round(count));
+}
+
+const char* Culler::Test::getKernelName() noexcept {
+    return getKernels().name;
+}
+
 } // namespace filament
@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/CullingBvh.h"
+
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
+#include <math/vec4.h>
+
+#include <assert.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+using namespace filament::math;
+using namespace utils;
+
+namespace filament {
+
+// math::min() and math::max() can be compiled to branches, which mispredict a lot here
+static inline float3 lowest(float3 const& a, float3 const& b) noexcept {
+    return { std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) };
+}
+
+static inline float3 highest(float3 const& a, float3 const& b) noexcept {
+    return { std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) };
+}
+
+void CullingBvh::build(float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent, size_t count) {
+    SYSTRACE_CALL();
+
+    clear();
+    if (count == 0) {
+        return;
+    }
+
+    // the boxes are partitioned along with their centers, which is more cache friendly
+    struct Ref {
+        float3 center;
+        uint32_t item;
+    };
+    std::vector<Ref> refs(count);
+    for (uint32_t i = 0; i < count; i++) {
+        refs[i] = { center[i], i };
+    }
+
+    mItems.resize(count);
+    mLeaves.resize(count);
+    mPositions.resize(count);
+
+    // nodes are created in breadth-first order, so children always come after their parent
+    mNodes.reserve(2 * (count + LEAF_SIZE - 1) / LEAF_SIZE);
+    mNodes.push_back({ {}, {}, 0, uint32_t(count), 0, 0 });
+    for (uint32_t i = 0; i < mNodes.size(); i++) {
+        uint32_t const first = mNodes[i].first;
+        uint32_t const size = mNodes[i].count;
+        Ref* const UTILS_RESTRICT r = refs.data() + first;
+
+        if (size <= LEAF_SIZE) {
+            for (uint32_t j = 0; j < size; j++) {
+                mItems[first + j] = r[j].item;
+                mLeaves[r[j].item] = i;
+                mPositions[r[j].item] = first + j;
+            }
+            continue;
+        }
+
+        // split at the median along the largest axis of the centers' bounds
+        float3 lo(std::numeric_limits<float>::max());
+        float3 hi(std::numeric_limits<float>::lowest());
+        for (uint32_t j = 0; j < size; j++) {
+            lo = lowest(lo, r[j].center);
+            hi = highest(hi, r[j].center);
+        }
+        float3 const d = hi - lo;
+        size_t const axis = (d.x >= d.y && d.x >= d.z) ? 0 : (d.y >= d.z ? 1 : 2);
+
+        // round the split up to a multiple of LEAF_SIZE, so that leaves are full
+        uint32_t const half = ((size / 2 + LEAF_SIZE - 1) / LEAF_SIZE) * LEAF_SIZE;
+        std::nth_element(r, r + half, r + size, [axis](Ref const& lhs, Ref const& rhs) {
+            return lhs.center[axis] < rhs.center[axis];
+        });
+
+        mNodes[i].child = uint32_t(mNodes.size());
+        mNodes.push_back({ {}, {}, first, half, 0, i });
+        mNodes.push_back({ {}, {}, first + half, size - half, 0, i });
+    }
+
+    // keep a copy of the boxes in the order of the leaves, with some padding for the Culler
+    mCenters.resize(count + LEAF_SIZE);
+    mExtents.resize(count + LEAF_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        mCenters[i] = center[mItems[i]];
+        mExtents[i] = extent[mItems[i]];
+    }
+
+    for (size_t i = mNodes.size(); i-- > 0;) {
+        updateBounds(mNodes[i]);
+    }
+    mDirty.assign(mNodes.size(), false);
+}
+
+void CullingBvh::refit(float3 const* UTILS_RESTRICT center,
+        float3 const* UTILS_RESTRICT extent, uint32_t const* items, size_t count) {
+    if (empty() || count == 0) {
+        return;
+    }
+
+    mRefitCount += count;
+    if (mRefitCount > size() / REBUILD_RATIO) {
+        build(center, extent, size());
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    // mark the leaves of the boxes that moved and all their ancestors
+    auto& dirtyNodes = mDirtyNodes;
+    dirtyNodes.clear();
+    for (size_t i = 0; i < count; i++) {
+        assert(items[i] < size());
+        mCenters[mPositions[items[i]]] = center[items[i]];
+        mExtents[mPositions[items[i]]] = extent[items[i]];
+        uint32_t index = mLeaves[items[i]];
+        while (!mDirty[index]) {
+            mDirty[index] = true;
+            dirtyNodes.push_back(index);
+            if (index == 0) {
+                break;
+            }
+            index = mNodes[index].parent;
+        }
+    }
+
+    // update the children before their parent
+    if (dirtyNodes.size() < mNodes.size() / 16) {
+        std::sort(dirtyNodes.begin(), dirtyNodes.end(), std::greater<>());
+        for (uint32_t index : dirtyNodes) {
+            updateBounds(mNodes[index]);
+            mDirty[index] = false;
+        }
+    } else {
+        // it's cheaper to go through all the nodes than to sort that many
+        for (size_t index = mNodes.size(); index-- > 0;) {
+            if (mDirty[index]) {
+                updateBounds(mNodes[index]);
+                mDirty[index] = false;
+            }
+        }
+    }
+}
+
+void CullingBvh::clear() noexcept {
+    mNodes.clear();
+    mItems.clear();
+    mLeaves.clear();
+    mPositions.clear();
+    mCenters.clear();
+    mExtents.clear();
+    mDirty.clear();
+    mRefitCount = 0;
+}
+
+void CullingBvh::updateBounds(Node& node) noexcept {
+    float3 lo(std::numeric_limits<float>::max());
+    float3 hi(std::numeric_limits<float>::lowest());
+    if (node.child == 0) {
+        for (uint32_t i = node.first, e = node.first + node.count; i < e; i++) {
+            lo = lowest(lo, mCenters[i] - mExtents[i]);
+            hi = highest(hi, mCenters[i] + mExtents[i]);
+        }
+    } else {
+        for (Node const& child : { mNodes[node.child], mNodes[node.child + 1] }) {
+            lo = lowest(lo, child.center - child.extent);
+            hi = highest(hi, child.center + child.extent);
+        }
+    }
+    node.center = (hi + lo) * 0.5f;
+    node.extent = (hi - lo) * 0.5f;
+}
+
+void CullingBvh::cull(JobSystem& js, Culler::result_type* results, Frustum const& frustum,
+        size_t bit) const noexcept {
+    SYSTRACE_CALL();
+
+    constexpr uint8_t ALL_PLANES = 0x3F;
+    if (empty()) {
+        return;
+    }
+
+    if (size() < PARALLEL_CULLING_MIN_ITEMS) {
+        cullSubtree(0, ALL_PLANES, results, frustum, bit);
+        return;
+    }
+
+    // with this many boxes all the nodes above PARALLEL_CULLING_DEPTH are internal nodes, so
+    // the nodes at that depth are contiguous (breadth-first order). Each job culls some of
+    // these subtrees; they contain disjoint sets of boxes.
+    uint32_t const first = (1u << PARALLEL_CULLING_DEPTH) - 1u;
+    uint32_t const count = 1u << PARALLEL_CULLING_DEPTH;
+    auto work = [this, results, &frustum, bit](uint32_t start, uint32_t n) {
+        for (uint32_t i = start, e = start + n; i < e; i++) {
+            cullSubtree(i, ALL_PLANES, results, frustum, bit);
+        }
+    };
+    auto job = jobs::parallel_for(js, nullptr, first, count, std::cref(work),
+            jobs::CountSplitter<1, PARALLEL_CULLING_DEPTH>());
+    js.runAndWait(job);
+}
+
+void CullingBvh::cullSubtree(uint32_t index, uint8_t planeMask,
+        Culler::result_type* UTILS_RESTRICT results, Frustum const& frustum,
+        size_t bit) const noexcept {
+    Node const& node = mNodes[index];
+    float4 const* const planes = frustum.getNormalizedPlanes();
+    float3 const c = node.center + mTranslation;
+
+    // same test as the Culler, planes the node is entirely inside of are skipped by its children
+    for (size_t j = 0; j < 6; j++) {
+        if (planeMask & (1u << j)) {
+            float const d = dot(planes[j].xyz, c) + planes[j].w;
+            float const r = dot(abs(planes[j].xyz), node.extent);
+            if (!(d - r < 0)) {
+                return;
+            }
+            if (d + r < 0) {
+                planeMask &= ~(1u << j);
+            }
+        }
+    }
+
+    uint32_t const* const items = mItems.data() + node.first;
+    Culler::result_type const visible = Culler::result_type(1u << bit);
+
+    if (planeMask == 0) {
+        // the whole subtree is visible
+        for (uint32_t i = 0; i < node.count; i++) {
+            results[items[i]] |= visible;
+        }
+        return;
+    }
+
+    if (node.child) {
+        cullSubtree(node.child,     planeMask, results, frustum, bit);
+        cullSubtree(node.child + 1, planeMask, results, frustum, bit);
+        return;
+    }
+
+    // the leaf intersects the frustum, test its boxes individually. The translation is applied
+    // the same way as for the culled boxes, so that the results are identical.
+    float3 leafCenters[LEAF_SIZE];
+    Culler::result_type leafResults[LEAF_SIZE] = {};
+    for (uint32_t i = 0; i < LEAF_SIZE; i++) {
+        leafCenters[i] = mCenters[node.first + i] + mTranslation;
+    }
+    Culler::intersects(leafResults, frustum, leafCenters, mExtents.data() + node.first,
+            LEAF_SIZE, bit);
+    for (uint32_t i = 0; i < node.count; i++) {
+        results[items[i]] |= leafResults[i];
+    }
+}
+
+} // namespace filament
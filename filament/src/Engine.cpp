@@ -126,7 +126,7 @@ FEngine::FEngine(Backend backend, Platform* platform, void* sharedGLContext) :
         mPostProcessManager(*this),
         mEntityManager(EntityManager::get()),
         mRenderableManager(*this),
-        mTransformManager(),
+        mTransformManager(&mJobSystem),
         mLightManager(*this),
         mCameraManager(*this),
         mCommandBufferQueue(CONFIG_MIN_COMMAND_BUFFERS_SIZE, CONFIG_COMMAND_BUFFERS_SIZE),
@@ -153,6 +153,17 @@ void FEngine::init() {
 
     mResourceAllocator = new fg::ResourceAllocator(driverApi);
 
+    // the budget and counters of the frame graph's texture cache
+    fg::ResourceAllocator::DebugCounters& counters = mResourceAllocator->getDebugCounters();
+    mDebugRegistry.registerProperty("d.framegraph.cache.budget_mib",
+            &mResourceAllocator->getCacheBudget());
+    mDebugRegistry.registerProperty("d.framegraph.cache.size_kib", &counters.cacheSize);
+    mDebugRegistry.registerProperty("d.framegraph.cache.entries", &counters.cacheEntries);
+    mDebugRegistry.registerProperty("d.framegraph.cache.hits", &counters.hits);
+    mDebugRegistry.registerProperty("d.framegraph.cache.fuzzy_hits", &counters.fuzzyHits);
+    mDebugRegistry.registerProperty("d.framegraph.cache.misses", &counters.misses);
+    mDebugRegistry.registerProperty("d.framegraph.cache.evictions", &counters.evictions);
+
     mFullScreenTriangleVb = upcast(VertexBuffer::Builder()
             .vertexCount(3)
             .bufferCount(1)
@@ -246,6 +257,7 @@ void FEngine::shutdown() {
     mResourceAllocator->terminate();
     mDFG->terminate();                      // free-up the DFG
     mRenderableManager.terminate();         // free-up all renderables
+    mHwRenderPrimitiveFactory.terminate(driver);
     mLightManager.terminate();              // free-up all lights
     mCameraManager.terminate();             // free-up all cameras
 
@@ -272,6 +284,7 @@ void FEngine::shutdown() {
     cleanupResourceList(mScenes);
     cleanupResourceList(mSkyboxes);
     cleanupResourceList(mColorGradings);
+    mColorGradingLutCache.terminate(driver);
 
     // this must be done after Skyboxes and before materials
     destroy(mSkyboxMaterial);
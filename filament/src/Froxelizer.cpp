@@ -23,6 +23,8 @@
 
 #include <filament/Viewport.h>
 
+#include <private/filament/EngineEnums.h>
+
 #include <utils/Allocator.h>
 #include <utils/BinaryTreeArray.h>
 #include <utils/Systrace.h>
@@ -32,6 +34,8 @@
 #include <math/scalar.h>
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 
 #include <stddef.h>
 
@@ -49,15 +53,18 @@ using namespace backend;
  */
 static constexpr bool USE_NON_SQUARE_FROXELS = false;
 
-// The Froxel buffer is set to FROXEL_BUFFER_WIDTH x n
+// The Froxel buffer is set to FROXEL_BUFFER_WIDTH x n, each RGBA_U32 texel holds 4 froxels.
 // With n limited by the supported texture dimension, which is guaranteed to be at least 2048
 // in all version of GLES.
+// The point and spot lights data is stored in the same texture, after the froxels
+// (see commitLights()).
 
-// Make sure this matches the same constants in shading_lit.fs
-constexpr size_t FROXEL_BUFFER_WIDTH_SHIFT  = 6u;
+// The shaders get the width and height from EngineEnums.h
+constexpr size_t FROXEL_BUFFER_WIDTH_SHIFT  = CONFIG_FROXEL_BUFFER_WIDTH_SHIFT;
 constexpr size_t FROXEL_BUFFER_WIDTH        = 1u << FROXEL_BUFFER_WIDTH_SHIFT;
 constexpr size_t FROXEL_BUFFER_WIDTH_MASK   = FROXEL_BUFFER_WIDTH - 1u;
-constexpr size_t FROXEL_BUFFER_HEIGHT       = (FROXEL_BUFFER_ENTRY_COUNT_MAX + FROXEL_BUFFER_WIDTH_MASK) / FROXEL_BUFFER_WIDTH;
+constexpr size_t FROXELS_PER_TEXEL          = 4u;
+constexpr size_t FROXEL_BUFFER_HEIGHT       = CONFIG_FROXEL_BUFFER_HEIGHT;
 
 constexpr size_t RECORD_BUFFER_WIDTH_SHIFT  = 5u;
 constexpr size_t RECORD_BUFFER_WIDTH        = 1u << RECORD_BUFFER_WIDTH_SHIFT;
@@ -71,13 +78,14 @@ constexpr size_t PER_FROXELDATA_ARENA_SIZE = sizeof(float4) *
                                                   FROXEL_BUFFER_ENTRY_COUNT_MAX + 3 +
                                                   FEngine::CONFIG_FROXEL_SLICE_COUNT / 4 + 1);
 
+// minimum number of lights froxelized by a job
+static constexpr size_t LIGHT_PER_JOB = 16;
 
-// number of lights processed by one group (e.g. 32)
-static constexpr size_t LIGHT_PER_GROUP = sizeof(Froxelizer::LightGroupType) * 8;
+// number of froxel ranges whose records are computed in parallel
+static constexpr size_t FROXEL_CHUNK_COUNT = 16;
 
-// number of groups (i.e. jobs) to use for froxelization (e.g. 8)
-static constexpr size_t GROUP_COUNT =
-        (CONFIG_MAX_LIGHT_COUNT + LIGHT_PER_GROUP - 1) / LIGHT_PER_GROUP;
+// maximum number of lights per froxel, limited by FroxelEntry::count
+static constexpr size_t FROXEL_LIGHT_COUNT_MAX = 255;
 
 
 // record buffer cannot be larger than 65K entries because we're using uint16_t to store indices
@@ -85,6 +93,14 @@ static constexpr size_t GROUP_COUNT =
 static_assert(RECORD_BUFFER_ENTRY_COUNT <= 65536,
         "RecordBuffer cannot be larger than 65536 entries");
 
+// froxels and lights share the froxel buffer, and are updated by whole rows
+static_assert(sizeof(Froxelizer::FroxelEntry) == sizeof(uint32_t),
+        "a FroxelEntry must be a component of the froxel buffer");
+static_assert(FROXEL_BUFFER_ENTRY_COUNT_MAX == FROXELS_PER_TEXEL * FROXEL_BUFFER_WIDTH * FROXEL_BUFFER_HEIGHT,
+        "the froxels must fill CONFIG_FROXEL_BUFFER_HEIGHT rows");
+static_assert(FROXEL_BUFFER_WIDTH == FScene::LIGHT_BUFFER_WIDTH,
+        "the froxels and the lights must have the same row size");
+
 Froxelizer::Froxelizer(FEngine& engine)
         : mArena("froxel", PER_FROXELDATA_ARENA_SIZE) {
 
@@ -94,8 +110,8 @@ Froxelizer::Froxelizer(FEngine& engine)
     GPUBuffer::ElementType type = std::is_same<RecordBufferType, uint8_t>::value
                                   ? GPUBuffer::ElementType::UINT8 : GPUBuffer::ElementType::UINT16;
     mRecordsBuffer = GPUBuffer(driverApi, { type, 1 }, RECORD_BUFFER_WIDTH, RECORD_BUFFER_HEIGHT);
-    mFroxelBuffer  = GPUBuffer(driverApi, { GPUBuffer::ElementType::UINT16, 2 },
-            FROXEL_BUFFER_WIDTH, FROXEL_BUFFER_HEIGHT);
+    mFroxelBuffer  = GPUBuffer(driverApi, { GPUBuffer::ElementType::UINT32, 4 },
+            FROXEL_BUFFER_WIDTH, FROXEL_BUFFER_HEIGHT + FScene::LIGHT_BUFFER_HEIGHT);
 }
 
 Froxelizer::~Froxelizer() {
@@ -165,28 +181,11 @@ bool Froxelizer::prepare(
             driverApi.allocatePod<RecordBufferType>(RECORD_BUFFER_ENTRY_COUNT),
             RECORD_BUFFER_ENTRY_COUNT };
 
-    /*
-     * Temporary allocations for processing all froxel data
-     */
-
-    // light records per froxel (~256 KiB)
-    mLightRecords = {
-            arena.allocate<LightRecord>(FROXEL_BUFFER_ENTRY_COUNT_MAX, CACHELINE_SIZE),
-            FROXEL_BUFFER_ENTRY_COUNT_MAX };
-
-    // froxel thread data (~256 KiB)
-    mFroxelShardedData = {
-            arena.allocate<FroxelThreadData>(GROUP_COUNT, CACHELINE_SIZE),
-            uint32_t(GROUP_COUNT)
-    };
+    // per-chunk data, kept across frames
+    mFroxelChunks.resize(FROXEL_CHUNK_COUNT);
 
     assert(mFroxelBufferUser.begin());
     assert(mRecordBufferUser.begin());
-    assert(mLightRecords.begin());
-    assert(mFroxelShardedData.begin());
-
-    // initialize buffers that need to be
-    memset(mLightRecords.data(), 0, mLightRecords.sizeInBytes());
 
     return uniformsNeedUpdating;
 }
@@ -464,6 +463,8 @@ bool Froxelizer::update() noexcept {
     }
     assert(mZLightNear >= mNear);
     mDirtyFlags = 0;
+    // the froxels changed, all lights must be froxelized again
+    mFroxelDataValid = false;
     return uniformsNeedUpdating;
 }
 
@@ -512,22 +513,43 @@ std::pair<size_t, size_t> Froxelizer::clipToIndices(float2 const& clip) const no
 
 
 void Froxelizer::commit(backend::DriverApi& driverApi) {
-    // send data to GPU
-    mFroxelBuffer.commit(driverApi, mFroxelBufferUser);
-    mRecordsBuffer.commit(driverApi, mRecordBufferUser);
+    // the GPU buffers already have the data if nothing changed
+    if (mCommitNeeded) {
+        // send data to GPU
+        mFroxelBuffer.commit(driverApi, mFroxelBufferUser);
+        mRecordsBuffer.commit(driverApi, mRecordBufferUser);
+    }
 #ifndef NDEBUG
     mFroxelBufferUser.clear();
     mRecordBufferUser.clear();
-    mFroxelShardedData.clear();
 #endif
 }
 
+void Froxelizer::commitLights(backend::DriverApi& driverApi,
+        LightsUib const* begin, LightsUib const* end) noexcept {
+    mFroxelBuffer.commit(driverApi, begin, end, FROXEL_BUFFER_HEIGHT);
+}
+
 void Froxelizer::froxelizeLights(FEngine& engine,
         CameraInfo const& UTILS_RESTRICT camera,
         const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
     // note: this is called asynchronously
-    froxelizeLoop(engine, camera, lightData);
-    froxelizeAssignRecordsCompress();
+
+    // when the froxels or the number of lights changed, the froxel data is computed again
+    // from scratch, otherwise only the lights that changed are froxelized.
+    const size_t lightCount = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+    const bool all = !mFroxelDataValid || mLightParams.size() != lightCount;
+    mLightParams.resize(lightCount);
+    mLightFroxels.resize(lightCount);
+    mFroxelizedLightCount = froxelizeLoop(engine, camera, lightData, all);
+    mFroxelDataValid = true;
+
+    mCommitNeeded = all || mFroxelizedLightCount;
+    if (!mCommitNeeded) {
+        return;
+    }
+
+    froxelizeAssignRecordsCompress(engine.getJobSystem());
 
 #ifndef NDEBUG
     if (lightData.size()) {
@@ -553,27 +575,30 @@ void Froxelizer::froxelizeLights(FEngine& engine,
 #endif
 }
 
-void Froxelizer::froxelizeLoop(FEngine& engine,
+size_t Froxelizer::froxelizeLoop(FEngine& engine,
         const CameraInfo& UTILS_RESTRICT camera,
-        const FScene::LightSoa& UTILS_RESTRICT lightData) noexcept {
+        const FScene::LightSoa& UTILS_RESTRICT lightData, bool all) noexcept {
     SYSTRACE_CALL();
 
-    Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
-    memset(froxelThreadData.data(), 0, froxelThreadData.sizeInBytes());
-
     auto& lcm = engine.getLightManager();
     auto const* UTILS_RESTRICT spheres      = lightData.data<FScene::POSITION_RADIUS>();
     auto const* UTILS_RESTRICT directions   = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances    = lightData.data<FScene::LIGHT_INSTANCE>();
+    LightParams* const UTILS_RESTRICT lightParams = mLightParams.data();
+    std::vector<uint16_t>* const lightFroxels = mLightFroxels.data();
+
+    // number of lights froxelized by all the jobs
+    std::atomic<size_t> froxelizedCount{ 0 };
 
-    auto process = [ this, &froxelThreadData,
+    auto process = [ this, lightParams, lightFroxels, &froxelizedCount, all,
                      spheres, directions, instances, &camera, &lcm ]
-            (size_t count, size_t offset, size_t stride) {
+            (uint32_t first, uint32_t count) {
 
         const mat4f& projection = mProjection;
         const mat3f& vn = camera.view.upperLeft();
 
-        for (size_t i = offset; i < count; i += stride) {
+        size_t n = 0;
+        for (size_t i = first, e = first + count; i < e; i++) {
             const size_t j = i + FScene::DIRECTIONAL_LIGHTS_COUNT;
             FLightManager::Instance li = instances[j];
             LightParams light = {
@@ -584,129 +609,173 @@ void Froxelizer::froxelizeLoop(FEngine& engine,
                     .radius = spheres[j].w,
             };
 
-            const size_t group = i % GROUP_COUNT;
-            const size_t bit   = i / GROUP_COUNT;
-            assert(bit < LIGHT_PER_GROUP);
-
-            FroxelThreadData& threadData = froxelThreadData[group];
-            froxelizePointAndSpotLight(threadData, bit, projection, light);
+            // the light parameters are in view space, so this also catches camera moves
+            if (!all && isSameLight(light, lightParams[i])) {
+                continue;
+            }
+            lightParams[i] = light;
+            froxelizePointAndSpotLight(lightFroxels[i], projection, light);
+            n++;
         }
+        froxelizedCount.fetch_add(n, std::memory_order_relaxed);
     };
 
-    // we do 64 lights per job
+    // each light has its own list of froxels, so lights can be froxelized in any order
     JobSystem& js = engine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(mLightParams.size()),
+            std::cref(process), jobs::CountSplitter<LIGHT_PER_JOB, 8>());
+    js.runAndWait(job);
 
-    constexpr bool SINGLE_THREADED = false;
-    if (!SINGLE_THREADED) {
-        auto parent = js.createJob();
-        for (size_t i = 0; i < GROUP_COUNT; i++) {
-            js.run(jobs::createJob(js, parent, std::cref(process),
-                    lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, i, GROUP_COUNT));
-        }
-        js.runAndWait(parent);
-    } else {
-        js.runAndWait(jobs::createJob(js, nullptr, std::cref(process),
-                lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT, 0, 1)
-        );
-    }
+    return froxelizedCount.load(std::memory_order_relaxed);
 }
 
-void Froxelizer::froxelizeAssignRecordsCompress() noexcept {
+void Froxelizer::froxelizeChunk(FroxelChunk& chunk, size_t first, size_t last) const noexcept {
+    // build the list of lights of each froxel of the chunk, with a counting sort. The lights
+    // are visited in order, so each list is sorted, and identical lists are equal arrays.
+    const size_t size = last - first;
+    auto& starts = chunk.starts;
+    starts.assign(size + 2, 0);
+
+    // the froxels of each light are sorted, find the ones in this chunk with a binary search
+    auto range = [first, last](std::vector<uint16_t> const& froxels) {
+        auto b = std::lower_bound(froxels.begin(), froxels.end(), first);
+        auto e = std::lower_bound(b, froxels.end(), last);
+        return std::make_pair(b, e);
+    };
 
-    SYSTRACE_CALL();
+    // count the lights of froxel i in starts[i + 2], so that after the prefix sum starts[i + 1]
+    // is the first light of froxel i. It is used as a cursor while filling the lists, after
+    // which it's the first light of froxel i + 1.
+    for (auto const& froxels : mLightFroxels) {
+        auto r = range(froxels);
+        for (auto it = r.first; it != r.second; ++it) {
+            starts[*it - first + 2]++;
+        }
+    }
+    for (size_t i = 2; i < size + 2; i++) {
+        starts[i] += starts[i - 1];
+    }
 
-    Slice<FroxelThreadData> froxelThreadData = mFroxelShardedData;
-
-    // convert froxel data from N groups of M bits to LightRecord::bitset, so we can
-    // easily compare adjacent froxels, for compaction. The conversion loops below get
-    // inlined and vectorized in release builds.
-
-    // this gets very well vectorized...
-    utils::Slice<LightRecord> records(mLightRecords);
-    for (size_t j = 0, jc = FROXEL_BUFFER_ENTRY_COUNT_MAX; j < jc; j++) {
-        for (size_t i = 0; i < LightRecord::bitset::WORLD_COUNT; i++) {
-            using container_type = LightRecord::bitset::container_type;
-            constexpr size_t r = sizeof(container_type) / sizeof(LightGroupType);
-            container_type b = froxelThreadData[i * r][j];
-            for (size_t k = 0; k < r; k++) {
-                b |= (container_type(froxelThreadData[i * r + k][j]) << (LIGHT_PER_GROUP * k));
-            }
-            records[j].lights.getBitsAt(i) = b;
+    auto& lights = chunk.lights;
+    lights.resize(starts[size + 1]);
+    for (size_t l = 0, c = mLightFroxels.size(); l < c; l++) {
+        auto r = range(mLightFroxels[l]);
+        for (auto it = r.first; it != r.second; ++it) {
+            lights[starts[*it - first + 1]++] = RecordBufferType(l);
         }
     }
 
-    uint16_t offset = 0;
-    FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
+    // compress: a froxel reuses the records of the froxel on its left or above it, if they
+    // have the same lights, which saves many froxel records (north of 10% in practice).
+    auto& records = chunk.records;
+    auto& entries = chunk.froxels;
+    records.clear();
+    entries.resize(size);
 
     const size_t froxelCountX = mFroxelCountX;
-    RecordBufferType* const UTILS_RESTRICT froxelRecords = mRecordBufferUser.data();
-
-    // how many froxel record entries were reused (for debugging)
-    UTILS_UNUSED size_t reused = 0;
+    auto same = [&starts, &lights](size_t a, size_t b) {
+        const size_t count = starts[a + 1] - starts[a];
+        return count == starts[b + 1] - starts[b] &&
+               std::equal(lights.begin() + starts[a], lights.begin() + starts[a + 1],
+                       lights.begin() + starts[b]);
+    };
 
-    for (size_t i = 0, c = getFroxelCount(); i < c;) {
-        LightRecord b = records[i];
-        if (b.lights.none()) {
-            froxels[i++].u32 = 0;
+    for (size_t i = 0; i < size; i++) {
+        const size_t count = starts[i + 1] - starts[i];
+        if (!count) {
+            entries[i].u32 = 0;
             continue;
         }
-
-        // We have a limitation of 255 spot + 255 point lights per froxel.
+        if (i >= 1 && same(i, i - 1)) {
+            entries[i] = entries[i - 1];
+            continue;
+        }
+        if (i >= froxelCountX && same(i, i - froxelCountX)) {
+            entries[i] = entries[i - froxelCountX];
+            continue;
+        }
+        // We have a limitation of 255 lights per froxel, the closest ones are kept.
         // note: initializer list for union cannot have more than one element
-        FroxelEntry entry; 
-        entry.offset = offset;
-        entry.count = (uint8_t)std::min(size_t(255), b.lights.count());
+        FroxelEntry entry;
+        entry.count = uint8_t(std::min(count, FROXEL_LIGHT_COUNT_MAX));
+        if (UTILS_UNLIKELY(records.size() + entry.count > RECORD_BUFFER_ENTRY_COUNT)) {
+            // out of space, this froxel's lights are dropped
+            entries[i].u32 = 0;
+            continue;
+        }
+        entry.offset = uint16_t(records.size());
+        records.insert(records.end(),
+                lights.begin() + starts[i], lights.begin() + starts[i] + entry.count);
+        entries[i] = entry;
+    }
+}
 
-        const size_t lightCount = entry.count;
+void Froxelizer::froxelizeAssignRecordsCompress(JobSystem& js) noexcept {
 
-        if (UTILS_UNLIKELY(offset + lightCount >= RECORD_BUFFER_ENTRY_COUNT)) {
-#ifndef NDEBUG
-            slog.d << "out of space: " << i << ", at " << offset << io::endl;
-#endif
-            // note: instead of dropping froxels we could look for similar records we've already
-            // filed up.
-            do { // this compiles to memset()
-                froxels[i++].u32 = 0;
-            } while(i < c);
-            goto out_of_memory;
+    SYSTRACE_CALL();
+
+    const size_t froxelCount = getFroxelCount();
+    const size_t chunkSize = (froxelCount + FROXEL_CHUNK_COUNT - 1) / FROXEL_CHUNK_COUNT;
+    FroxelChunk* const chunks = mFroxelChunks.data();
+
+    // the light lists and records of each range of froxels are independent
+    auto work = [this, chunks, chunkSize, froxelCount](uint32_t first, uint32_t count) {
+        for (size_t c = first, e = first + count; c < e; c++) {
+            const size_t begin = std::min(c * chunkSize, froxelCount);
+            const size_t end = std::min(begin + chunkSize, froxelCount);
+            froxelizeChunk(chunks[c], begin, end);
         }
+    };
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(FROXEL_CHUNK_COUNT),
+            std::cref(work), jobs::CountSplitter<1, 4>());
+    js.runAndWait(job);
+
+    // the records of the chunks are concatenated
+    std::array<size_t, FROXEL_CHUNK_COUNT> offsets;
+    size_t offset = 0;
+    for (size_t c = 0; c < FROXEL_CHUNK_COUNT; c++) {
+        offsets[c] = offset;
+        offset += chunks[c].records.size();
+    }
 
-        // iterate the bitfield
-        auto * const beginPoint = froxelRecords + offset;
-        b.lights.forEachSetBit([point = beginPoint, beginPoint](size_t l) mutable {
-            // make sure to keep this code branch-less
-            const size_t word = l / LIGHT_PER_GROUP;
-            const size_t bit  = l % LIGHT_PER_GROUP;
-            l = (bit * GROUP_COUNT) | (word % GROUP_COUNT);
-            *point = (RecordBufferType)l;
-            // we need to "cancel" the write if we have more than 255 spot or point lights
-            // (this is a limitation of the data type used to store the light counts per froxel)
-            point += (point - beginPoint < 255) ? 1 : 0;
-        });
-
-        offset += lightCount;
+    FroxelEntry* const UTILS_RESTRICT froxels = mFroxelBufferUser.data();
+    RecordBufferType* const UTILS_RESTRICT froxelRecords = mRecordBufferUser.data();
+    auto copy = [chunks, chunkSize, froxelCount, &offsets, froxels, froxelRecords]
+            (uint32_t first, uint32_t count) {
+        for (size_t c = first, e = first + count; c < e; c++) {
+            FroxelChunk const& chunk = chunks[c];
+            const size_t begin = std::min(c * chunkSize, froxelCount);
+            const size_t base = offsets[c];
+
+            // records that don't fit in the record buffer are dropped, along with the froxels
+            // that use them
+            const size_t available = RECORD_BUFFER_ENTRY_COUNT - std::min(base,
+                    RECORD_BUFFER_ENTRY_COUNT);
+            const size_t size = std::min(chunk.records.size(), available);
+            std::copy_n(chunk.records.data(), size, froxelRecords + base);
+
+            for (size_t i = 0, n = chunk.froxels.size(); i < n; i++) {
+                FroxelEntry entry = chunk.froxels[i];
+                if (entry.count) {
+                    if (UTILS_UNLIKELY(entry.offset + entry.count > size)) {
+                        entry.u32 = 0;
+                    } else {
+                        entry.offset = uint16_t(entry.offset + base);
+                    }
+                }
+                froxels[begin + i] = entry;
+            }
+        }
+    };
+    job = jobs::parallel_for(js, nullptr, 0, uint32_t(FROXEL_CHUNK_COUNT),
+            std::cref(copy), jobs::CountSplitter<1, 4>());
+    js.runAndWait(job);
 
 #ifndef NDEBUG
-        if (lightCount) { reused--; }
-#endif
-        do {
-#ifndef NDEBUG
-            if (lightCount) { reused++; }
-#endif
-            froxels[i++].u32 = entry.u32;
-            if (i >= c) break;
-
-            if (records[i].lights != b.lights && i >= froxelCountX) {
-                // if this froxel record doesn't match the previous one on its left,
-                // we re-try with the record above it, which saves many froxel records
-                // (north of 10% in practice).
-                b = records[i - froxelCountX];
-                entry.u32 = froxels[i - froxelCountX].u32;
-            }
-        } while(records[i].lights == b.lights);
+    if (offset > RECORD_BUFFER_ENTRY_COUNT) {
+        slog.d << "out of space: " << offset << " records" << io::endl;
     }
-out_of_memory:
-    ;
+#endif
 }
 
 static inline float2 project(mat4f const& p, float3 const& v) noexcept {
@@ -732,10 +801,12 @@ static inline float2 project(mat4f const& p, float3 const& v) noexcept {
 }
 
 void Froxelizer::froxelizePointAndSpotLight(
-        FroxelThreadData& froxelThread, size_t bit,
+        std::vector<uint16_t>& froxels,
         mat4f const& UTILS_RESTRICT p,
         const Froxelizer::LightParams& UTILS_RESTRICT light) const noexcept {
 
+    froxels.clear();
+
     if (UTILS_UNLIKELY(light.position.z + light.radius < -mZLightFar)) { // z values are negative
         // This light is fully behind LightFar, it doesn't light anything
         // (we could avoid this check if we culled lights using LightFar instead of the
@@ -850,22 +921,28 @@ void Froxelizer::froxelizePointAndSpotLight(
 
                     assert(bx < mFroxelCountX && ex <= mFroxelCountX);
 
+                    // froxels are visited in increasing order
                     size_t fi = getFroxelIndex(bx, iy, iz);
+                    size_t n = froxels.size();
+                    froxels.resize(n + ex - bx);
+                    uint16_t* const UTILS_RESTRICT out = froxels.data();
                     if (light.invSin != std::numeric_limits<float>::infinity()) {
                         // This is a spotlight (common case)
-                        // this loops gets vectorized (on arm64) w/ clang
+                        // this loop is branch-less
                         while (bx++ != ex) {
                             // see if this froxel intersects the cone
                             bool intersect = sphereConeIntersectionFast(boundingSpheres[fi],
                                     light.position, light.axis, light.invSin, light.cosSqr);
-                            froxelThread[fi++] |= LightGroupType(intersect) << bit;
+                            out[n] = uint16_t(fi++);
+                            n += intersect ? 1 : 0;
                         }
                     } else {
                         // this loops gets vectorized (on arm64) w/ clang
                         while (bx++ != ex) {
-                            froxelThread[fi++] |= LightGroupType(1) << bit;
+                            out[n++] = uint16_t(fi++);
                         }
                     }
+                    froxels.resize(n);
                 }
             }
         }
@@ -117,11 +117,17 @@ void GPUBuffer::terminate(backend::DriverApi& driverApi) noexcept {
     driverApi.destroyTexture(mTexture);
 }
 
-void GPUBuffer::commitSlow(backend::DriverApi& driverApi, void const* begin, void const* end) noexcept {
+void GPUBuffer::commitSlow(backend::DriverApi& driverApi, void const* begin, void const* end,
+        size_t firstRow) noexcept {
     const uintptr_t sizeInBytes = uintptr_t(end) - uintptr_t(begin);
-    assert(sizeInBytes <= mRowSizeInBytes * mHeight);
-    driverApi.update2DImage(mTexture, 0, 0, 0, mWidth, mHeight,
-            { begin, sizeInBytes, mFormat, mType });
+    assert(firstRow <= mHeight);
+    assert(sizeInBytes <= mRowSizeInBytes * (mHeight - firstRow));
+    assert(sizeInBytes % mRowSizeInBytes == 0);
+    const uint32_t height = uint32_t(sizeInBytes / mRowSizeInBytes);
+    if (height) {
+        driverApi.update2DImage(mTexture, 0, 0, uint32_t(firstRow), mWidth, height,
+                { begin, sizeInBytes, mFormat, mType });
+    }
 }
 
 } // namespace filament
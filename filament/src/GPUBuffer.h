@@ -61,9 +61,12 @@ public:
 
     size_t getSize() const noexcept { return mSize; }
 
-    // source data isn't copied and must stay valid until the command-buffer is executed
-    void commit(backend::DriverApi& driverApi, void const* begin, void const* end) noexcept {
-        commitSlow(driverApi, begin, end);
+    // source data isn't copied and must stay valid until the command-buffer is executed.
+    // Only the rows covered by the data are updated, starting at firstRow, so it must be a
+    // whole number of rows.
+    void commit(backend::DriverApi& driverApi, void const* begin, void const* end,
+            size_t firstRow = 0) noexcept {
+        commitSlow(driverApi, begin, end, firstRow);
     }
 
     template<typename T>
@@ -85,7 +88,8 @@ private:
     backend::SamplerParams getSamplerParams() const noexcept { return backend::SamplerParams{}; }
 
 private:
-    void commitSlow(backend::DriverApi& driverApi, void const* begin, void const* end) noexcept;
+    void commitSlow(backend::DriverApi& driverApi, void const* begin, void const* end,
+            size_t firstRow) noexcept;
 
     backend::Handle<backend::HwTexture> mTexture;
     uint32_t mSize = 0;
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "HwRenderPrimitiveFactory.h"
+
+#include "private/backend/DriverApi.h"
+
+namespace filament {
+
+using namespace backend;
+
+static_assert(sizeof(HandleBase) == sizeof(uint32_t), "Key must not have padding");
+
+bool HwRenderPrimitiveFactory::Key::operator==(Key const& rhs) const noexcept {
+    return vbh == rhs.vbh && ibh == rhs.ibh && type == rhs.type &&
+           offset == rhs.offset && minIndex == rhs.minIndex && maxIndex == rhs.maxIndex &&
+           count == rhs.count && enabledAttributes == rhs.enabledAttributes;
+}
+
+HwRenderPrimitiveFactory::HwRenderPrimitiveFactory() = default;
+
+HwRenderPrimitiveFactory::~HwRenderPrimitiveFactory() noexcept = default;
+
+void HwRenderPrimitiveFactory::terminate(DriverApi& driver) noexcept {
+    // the primitives of leaked renderables are released by FRenderableManager::terminate(),
+    // whatever is left here is destroyed regardless of its reference count.
+    for (auto const& item : mPrimitives) {
+        driver.destroyRenderPrimitive(item.second.handle);
+    }
+    mPrimitives.clear();
+    mKeys.clear();
+}
+
+RenderPrimitiveHandle HwRenderPrimitiveFactory::create(DriverApi& driver,
+        VertexBufferHandle vbh, IndexBufferHandle ibh,
+        PrimitiveType type, uint32_t offset, uint32_t minIndex, uint32_t maxIndex,
+        uint32_t count, uint32_t enabledAttributes) noexcept {
+    const Key key{ vbh, ibh, uint32_t(type), offset, minIndex, maxIndex, count, enabledAttributes };
+    auto pos = mPrimitives.find(key);
+    if (pos != mPrimitives.end()) {
+        pos.value().refs++;
+        return pos->second.handle;
+    }
+
+    RenderPrimitiveHandle handle = driver.createRenderPrimitive();
+    if (vbh && ibh) {
+        driver.setRenderPrimitiveBuffer(handle, vbh, ibh, enabledAttributes);
+        driver.setRenderPrimitiveRange(handle, type, offset, minIndex, maxIndex, count);
+    }
+    mPrimitives.insert({ key, { handle, 1 }});
+    mKeys.insert({ handle.getId(), key });
+    return handle;
+}
+
+void HwRenderPrimitiveFactory::destroy(DriverApi& driver, RenderPrimitiveHandle rph) noexcept {
+    auto key = mKeys.find(rph.getId());
+    assert(key != mKeys.end());
+    if (key == mKeys.end()) {
+        return;
+    }
+    auto pos = mPrimitives.find(key->second);
+    assert(pos != mPrimitives.end() && pos->second.handle == rph);
+    if (--pos.value().refs == 0) {
+        driver.destroyRenderPrimitive(rph);
+        mPrimitives.erase(pos);
+        mKeys.erase(key);
+    }
+}
+
+} // namespace filament
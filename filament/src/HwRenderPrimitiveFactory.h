@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_HWRENDERPRIMITIVEFACTORY_H
+#define TNT_FILAMENT_HWRENDERPRIMITIVEFACTORY_H
+
+#include "private/backend/DriverApiForward.h"
+
+#include <backend/DriverEnums.h>
+#include <backend/Handle.h>
+
+#include <utils/Hash.h>
+
+#include <tsl/robin_map.h>
+
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Creates the HwRenderPrimitives of the renderables, and shares them between the primitives that
+ * draw the same geometry (same buffers, range, type and attributes). This saves driver objects,
+ * but more importantly, the commands of renderables drawing the same geometry have the same
+ * primitive handle, which allows RenderPass to batch their draws.
+ *
+ * HwRenderPrimitives must not be modified after creation, since they can be shared.
+ */
+class HwRenderPrimitiveFactory {
+public:
+    HwRenderPrimitiveFactory();
+    ~HwRenderPrimitiveFactory() noexcept;
+
+    HwRenderPrimitiveFactory(HwRenderPrimitiveFactory const& rhs) = delete;
+    HwRenderPrimitiveFactory& operator=(HwRenderPrimitiveFactory const& rhs) = delete;
+
+    // destroys all the HwRenderPrimitives that are left
+    void terminate(backend::DriverApi& driver) noexcept;
+
+    // returns a HwRenderPrimitive for this geometry, which is shared if it exists already
+    backend::RenderPrimitiveHandle create(backend::DriverApi& driver,
+            backend::VertexBufferHandle vbh, backend::IndexBufferHandle ibh,
+            backend::PrimitiveType type, uint32_t offset, uint32_t minIndex, uint32_t maxIndex,
+            uint32_t count, uint32_t enabledAttributes) noexcept;
+
+    // releases a HwRenderPrimitive returned by create(), it's destroyed with its last user
+    void destroy(backend::DriverApi& driver, backend::RenderPrimitiveHandle rph) noexcept;
+
+    // for debugging and testing
+    size_t getPrimitiveCount() const noexcept { return mPrimitives.size(); }
+
+private:
+    struct Key { // 32 bytes, no padding, hashed bitwise
+        backend::VertexBufferHandle vbh;
+        backend::IndexBufferHandle ibh;
+        uint32_t type;
+        uint32_t offset;
+        uint32_t minIndex;
+        uint32_t maxIndex;
+        uint32_t count;
+        uint32_t enabledAttributes;
+        bool operator==(Key const& rhs) const noexcept;
+    };
+
+    struct Value {
+        backend::RenderPrimitiveHandle handle;
+        uint32_t refs;
+    };
+
+    using HandleId = backend::HandleBase::HandleId;
+
+    tsl::robin_map<Key, Value, utils::hash::MurmurHashFn<Key>> mPrimitives;
+    tsl::robin_map<HandleId, Key> mKeys;    // to find the primitive in destroy()
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_HWRENDERPRIMITIVEFACTORY_H
@@ -79,10 +79,13 @@ void FMaterialInstance::terminate(FEngine& engine) {
     FEngine::DriverApi& driver = engine.getDriverApi();
     driver.destroyUniformBuffer(mUbHandle);
     driver.destroySamplerGroup(mSbHandle);
+    // the cached commands refer to this instance, which memory can be reused by another one
+    engine.invalidateMaterialInstanceState();
 }
 
 void FMaterialInstance::initialize(FMaterial const* material) {
     mMaterial = material;
+    material->getEngine().invalidateMaterialInstanceState();
 
     const RasterState& rasterState = mMaterial->getRasterState();
 
@@ -163,20 +166,28 @@ void FMaterialInstance::setDoubleSided(bool doubleSided) noexcept {
     }
 }
 
+template<typename T>
+void FMaterialInstance::setCommandState(T& state, T value) noexcept {
+    if (state != value) {
+        state = value;
+        mMaterial->getEngine().invalidateMaterialInstanceState();
+    }
+}
+
 void FMaterialInstance::setCullingMode(CullingMode culling) noexcept {
-    mCulling = culling;
+    setCommandState(mCulling, culling);
 }
 
 void FMaterialInstance::setColorWrite(bool enable) noexcept {
-    mColorWrite = enable;
+    setCommandState(mColorWrite, enable);
 }
 
 void FMaterialInstance::setDepthWrite(bool enable) noexcept {
-    mDepthWrite = enable;
+    setCommandState(mDepthWrite, enable);
 }
 
 void FMaterialInstance::setDepthCulling(bool enable) noexcept {
-    mDepthFunc = enable ? RasterState::DepthFunc::LE : RasterState::DepthFunc::A;
+    setCommandState(mDepthFunc, enable ? RasterState::DepthFunc::LE : RasterState::DepthFunc::A);
 }
 
 const char* FMaterialInstance::getName() const noexcept {
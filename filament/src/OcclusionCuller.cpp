@@ -0,0 +1,279 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/OcclusionCuller.h"
+
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
+#include <math/vec4.h>
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include <math.h>
+
+using namespace filament::math;
+using namespace utils;
+
+namespace filament {
+
+// clips a triangle against the near plane (z + w >= 0), returns the number of vertices of the
+// resulting polygon: 0, 3 or 4.
+static size_t clipNear(float4 const* UTILS_RESTRICT in, float4* UTILS_RESTRICT out) noexcept {
+    size_t n = 0;
+    for (size_t i = 0; i < 3; i++) {
+        float4 const& p = in[i];
+        float4 const& q = in[i == 2 ? 0 : i + 1];
+        float const dp = p.z + p.w;
+        float const dq = q.z + q.w;
+        if (dp >= 0) {
+            out[n++] = p;
+        }
+        if ((dp >= 0) != (dq >= 0)) {
+            out[n++] = p + (q - p) * (dp / (dp - dq));
+        }
+    }
+    return n;
+}
+
+void OcclusionCuller::begin(mat4f const& viewProjection,
+        uint32_t width, uint32_t height) noexcept {
+    mViewProjection = viewProjection;
+    mWidth = width;
+    mHeight = height;
+    mOccluders.clear();
+}
+
+void OcclusionCuller::addOccluder(mat4f const& transform, float3 const* vertices,
+        uint16_t const* indices, size_t indexCount) noexcept {
+    if (indexCount >= 3) {
+        mOccluders.push_back({ mViewProjection * transform, vertices, indices,
+                uint32_t(indexCount / 3), 0, 0 });
+    }
+}
+
+void OcclusionCuller::setup(Occluder& occluder) noexcept {
+    float const w = float(mWidth);
+    float const h = float(mHeight);
+    Triangle* const UTILS_RESTRICT triangles = mTriangles.data() + occluder.first;
+    uint32_t count = 0;
+
+    for (uint32_t i = 0; i < occluder.triangleCount; i++) {
+        uint16_t const* const index = occluder.indices + i * 3;
+        float4 const clip[3] = {
+                occluder.transform * float4{ occluder.vertices[index[0]], 1 },
+                occluder.transform * float4{ occluder.vertices[index[1]], 1 },
+                occluder.transform * float4{ occluder.vertices[index[2]], 1 }
+        };
+
+        float4 polygon[4];
+        size_t const n = clipNear(clip, polygon);
+
+        // to screen space, in pixels
+        float3 v[4];
+        for (size_t j = 0; j < n; j++) {
+            float const iw = 1.0f / polygon[j].w;
+            v[j] = { (polygon[j].x * iw * 0.5f + 0.5f) * w,
+                     (polygon[j].y * iw * 0.5f + 0.5f) * h,
+                      polygon[j].z * iw };
+        }
+
+        // the clipped polygon is convex, triangulate it as a fan
+        for (size_t j = 2; j < n; j++) {
+            float3 const& v0 = v[0];
+            float3 const& v1 = v[j - 1];
+            float3 const& v2 = v[j];
+
+            float const area = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+            if (!(std::abs(area) > std::numeric_limits<float>::min())) {
+                continue;
+            }
+
+            // pixels whose center is inside the triangle's bounds
+            float const xmin = std::max(std::ceil(std::min({ v0.x, v1.x, v2.x }) - 0.5f), 0.0f);
+            float const ymin = std::max(std::ceil(std::min({ v0.y, v1.y, v2.y }) - 0.5f), 0.0f);
+            float const xmax = std::min(std::floor(std::max({ v0.x, v1.x, v2.x }) - 0.5f) + 1.0f, w);
+            float const ymax = std::min(std::floor(std::max({ v0.y, v1.y, v2.y }) - 0.5f) + 1.0f, h);
+            if (!(xmin < xmax && ymin < ymax)) {
+                continue;
+            }
+
+            Triangle& t = triangles[count++];
+            t.x0 = int32_t(xmin);
+            t.y0 = int32_t(ymin);
+            t.x1 = int32_t(xmax);
+            t.y1 = int32_t(ymax);
+
+            // both windings are accepted, occluders don't need to be closed meshes
+            float const s = area < 0 ? -1.0f : 1.0f;
+            float3 const* const e[3][2] = { { &v0, &v1 }, { &v1, &v2 }, { &v2, &v0 } };
+            for (size_t k = 0; k < 3; k++) {
+                float3 const& p = *e[k][0];
+                float3 const& q = *e[k][1];
+                float const a = s * (p.y - q.y);
+                float const b = s * (q.x - p.x);
+                float const c = s * (p.x * q.y - p.y * q.x);
+                // edge function at the pixel's center. A shared edge has exactly opposite
+                // edge functions in both triangles, so meshes are rasterized without cracks.
+                t.a[k] = a;
+                t.b[k] = b;
+                t.c[k] = c + 0.5f * (a + b);
+            }
+
+            // depth plane, evaluated at the farthest point of the pixel
+            float const ia = 1.0f / area;
+            float const zx = ((v1.z - v0.z) * (v2.y - v0.y) - (v2.z - v0.z) * (v1.y - v0.y)) * ia;
+            float const zy = ((v2.z - v0.z) * (v1.x - v0.x) - (v1.z - v0.z) * (v2.x - v0.x)) * ia;
+            t.zx = zx;
+            t.zy = zy;
+            t.z = v0.z - zx * v0.x - zy * v0.y
+                    + 0.5f * (zx + zy) + 0.5f * (std::abs(zx) + std::abs(zy));
+            t.zmax = std::max({ v0.z, v1.z, v2.z });
+        }
+    }
+    occluder.count = count;
+}
+
+void OcclusionCuller::rasterize(Triangle const& t, uint32_t y0, uint32_t y1) noexcept {
+    int32_t const ys = std::max(t.y0, int32_t(y0));
+    int32_t const ye = std::min(t.y1, int32_t(y1));
+    int32_t const xs = t.x0;
+    int32_t const xe = t.x1;
+    float const a0 = t.a[0], a1 = t.a[1], a2 = t.a[2];
+    float const zx = t.zx;
+    float const zmax = t.zmax;
+
+    for (int32_t y = ys; y < ye; y++) {
+        float const fy = float(y);
+        float const c0 = t.b[0] * fy + t.c[0];
+        float const c1 = t.b[1] * fy + t.c[1];
+        float const c2 = t.b[2] * fy + t.c[2];
+        float const cz = t.zy * fy + t.z;
+        float* const UTILS_RESTRICT row = mDepth.data() + size_t(y) * mWidth;
+
+        // this loop is branchless, so that it gets vectorized
+        for (int32_t x = xs; x < xe; x++) {
+            float const fx = float(x);
+            float const e = std::min(std::min(a0 * fx + c0, a1 * fx + c1), a2 * fx + c2);
+            float const z = std::min(zx * fx + cz, zmax);
+            float const d = row[x];
+            row[x] = (e >= 0.0f) ? std::min(d, z) : d;
+        }
+    }
+}
+
+void OcclusionCuller::rasterize(JobSystem& js) noexcept {
+    SYSTRACE_CALL();
+
+    mDepth.assign(size_t(mWidth) * mHeight, std::numeric_limits<float>::infinity());
+    if (mOccluders.empty() || !mWidth || !mHeight) {
+        return;
+    }
+
+    // each source triangle produces at most two triangles once clipped
+    uint32_t triangleCount = 0;
+    for (Occluder& occluder : mOccluders) {
+        occluder.first = triangleCount;
+        triangleCount += occluder.triangleCount * 2;
+    }
+    mTriangles.resize(triangleCount);
+
+    auto setupWork = [this](Occluder* occluders, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            setup(occluders[i]);
+        }
+    };
+    auto* job = jobs::parallel_for(js, nullptr, mOccluders.data(), mOccluders.size(),
+            std::cref(setupWork), jobs::CountSplitter<1, 4>());
+    js.runAndWait(job);
+
+    // the bands are disjoint, so they can be rasterized concurrently
+    uint32_t const bandHeight = (mHeight + BAND_COUNT - 1) / BAND_COUNT;
+    auto rasterWork = [this, bandHeight](uint32_t start, uint32_t count) {
+        for (uint32_t band = start; band < start + count; band++) {
+            uint32_t const y0 = band * bandHeight;
+            uint32_t const y1 = std::min(y0 + bandHeight, mHeight);
+            for (Occluder const& occluder : mOccluders) {
+                Triangle const* triangles = mTriangles.data() + occluder.first;
+                for (uint32_t i = 0; i < occluder.count; i++) {
+                    if (triangles[i].y0 < int32_t(y1) && triangles[i].y1 > int32_t(y0)) {
+                        rasterize(triangles[i], y0, y1);
+                    }
+                }
+            }
+        }
+    };
+    job = jobs::parallel_for(js, nullptr, 0, BAND_COUNT,
+            std::cref(rasterWork), jobs::CountSplitter<1, 3>());
+    js.runAndWait(job);
+}
+
+bool OcclusionCuller::isOccluded(float3 const& center, float3 const& extent) const noexcept {
+    if (mOccluders.empty() || !mWidth || !mHeight) {
+        return false;
+    }
+
+    // the corners of the box are c +/- x +/- y +/- z in clip space
+    mat4f const& m = mViewProjection;
+    float4 const c = m * float4{ center, 1 };
+    float4 const x = m[0] * extent.x;
+    float4 const y = m[1] * extent.y;
+    float4 const z = m[2] * extent.z;
+
+    float const w = float(mWidth);
+    float const h = float(mHeight);
+    float2 lo(std::numeric_limits<float>::max());
+    float2 hi(std::numeric_limits<float>::lowest());
+    float zmin = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < 8; i++) {
+        float4 const p = c + ((i & 1) ? x : -x) + ((i & 2) ? y : -y) + ((i & 4) ? z : -z);
+        if (!(p.z + p.w > 0 && p.w > 0)) {
+            // the box crosses the near plane
+            return false;
+        }
+        float const iw = 1.0f / p.w;
+        float const sx = (p.x * iw * 0.5f + 0.5f) * w;
+        float const sy = (p.y * iw * 0.5f + 0.5f) * h;
+        lo = { std::min(lo.x, sx), std::min(lo.y, sy) };
+        hi = { std::max(hi.x, sx), std::max(hi.y, sy) };
+        zmin = std::min(zmin, p.z * iw);
+    }
+
+    // all the pixels the box touches
+    if (!(hi.x >= 0 && hi.y >= 0 && lo.x < w && lo.y < h)) {
+        return false;
+    }
+    uint32_t const xs = uint32_t(std::max(lo.x, 0.0f));
+    uint32_t const ys = uint32_t(std::max(lo.y, 0.0f));
+    uint32_t const xe = uint32_t(std::min(hi.x, w - 1.0f)) + 1;
+    uint32_t const ye = uint32_t(std::min(hi.y, h - 1.0f)) + 1;
+
+    for (uint32_t py = ys; py < ye; py++) {
+        float const* const UTILS_RESTRICT row = mDepth.data() + size_t(py) * mWidth;
+        bool hidden = true;
+        for (uint32_t px = xs; px < xe; px++) {
+            hidden &= row[px] < zmin;
+        }
+        if (!hidden) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace filament
@@ -30,6 +30,8 @@
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
+#include <array>
 #include <utility>
 
 using namespace utils;
@@ -103,15 +105,20 @@ RenderPass::Command* RenderPass::appendCommands(CommandTypeFlags const commandTy
     growBy *= uint32_t(colorPass * 2 + depthPass);
     Command* const curr = commands.grow(growBy);
 
+    CommandCache* const cache = mCommandCache;
+    if (cache) {
+        cache->prepare(engine, commandTypeFlags, renderFlags, visibilityMask, growBy);
+    }
+
     // we extract camera position/forward outside of the loop, because these are not cheap.
     const float3 cameraPosition(camera.getPosition());
     const float3 cameraForwardVector(camera.getForwardVector());
     auto work = [commandTypeFlags, curr, &soa, renderFlags, visibilityMask, cameraPosition,
-                 cameraForwardVector]
+                 cameraForwardVector, cache]
             (uint32_t startIndex, uint32_t indexCount) {
         RenderPass::generateCommands(commandTypeFlags, curr,
                 soa, { startIndex, startIndex + indexCount }, renderFlags, visibilityMask,
-                cameraPosition, cameraForwardVector);
+                cameraPosition, cameraForwardVector, cache);
     };
 
     auto jobCommandsParallel = jobs::parallel_for(js, nullptr, vr.first, (uint32_t)vr.size(),
@@ -122,6 +129,11 @@ RenderPass::Command* RenderPass::appendCommands(CommandTypeFlags const commandTy
         js.runAndWait(jobCommandsParallel);
     }
 
+    if (cache) {
+        // trace the number of renderables whose commands were reused
+        SYSTRACE_VALUE32("cachedRenderables", cache->getReusedCount());
+    }
+
     // always add an "eof" command
     // "eof" command. these commands are guaranteed to be sorted last in the
     // command buffer.
@@ -155,7 +167,8 @@ RenderPass::Command* RenderPass::sortCommands() noexcept {
 
     GrowingSlice<Command>& commands = mCommands;
 
-    std::sort(commands.begin(), commands.end());
+    sortCommands(mEngine.getJobSystem(), mEngine.getRenderPassScratchBuffer(),
+            commands.begin(), commands.end());
 
     // find the last command
     Command const* const last = std::partition_point(commands.begin(), commands.end(),
@@ -168,6 +181,149 @@ RenderPass::Command* RenderPass::sortCommands() noexcept {
     return commands.end();
 }
 
+void RenderPass::sortCommands(JobSystem& js, ScratchBuffer& scratch,
+        Command* const begin, Command* const end) noexcept {
+    const size_t count = size_t(end - begin);
+    if (count < RADIX_SORT_MIN_COMMANDS) {
+        std::sort(begin, end);
+        return;
+    }
+
+    /*
+     * LSD radix sort of (key, index) pairs, 8 bits at a time, followed by a permutation of the
+     * commands. The pairs are half the size of the commands, so each pass moves less memory.
+     * The passes on the bytes that are the same in all keys are skipped, which is common because
+     * the pass and priority bits don't vary much.
+     *
+     * For large command counts, each pass is split in chunks processed in parallel, each chunk
+     * scatters its keys to its own range of each bucket, which keeps the sort stable.
+     */
+
+    SYSTRACE_CALL();
+
+    struct SortKey {
+        CommandKey key;
+        uint32_t index;
+    };
+
+    constexpr size_t DIGIT_COUNT = sizeof(CommandKey);
+    using Histogram = std::array<uint32_t, 256>;
+
+    const size_t chunkCount = count < RADIX_SORT_PARALLEL_MIN_COMMANDS ?
+            1 : RADIX_SORT_PARALLEL_CHUNK_COUNT;
+    const size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    // The scratch memory is too large for the per-render-pass arena. We need one histogram per
+    // digit and chunk, two buffers of keys, and a buffer for the permuted commands.
+    const size_t histogramsSize = chunkCount * DIGIT_COUNT * sizeof(Histogram);
+    const size_t keysSize = 2 * count * sizeof(SortKey);
+    char* const memory = static_cast<char*>(
+            scratch.get(histogramsSize + keysSize + count * sizeof(Command)));
+    Histogram* const histograms = reinterpret_cast<Histogram*>(memory);
+    SortKey* const keys = reinterpret_cast<SortKey*>(memory + histogramsSize);
+    Command* const sorted = reinterpret_cast<Command*>(memory + histogramsSize + keysSize);
+
+    auto forEachChunk = [&js, chunkCount](auto const& functor) {
+        if (chunkCount == 1) {
+            functor(0, 1);
+        } else {
+            auto* job = jobs::parallel_for(js, nullptr, 0, uint32_t(chunkCount),
+                    std::cref(functor), jobs::CountSplitter<1, RADIX_SORT_PARALLEL_CHUNK_COUNT>());
+            js.runAndWait(job);
+        }
+    };
+
+    // initialize the keys, and compute each chunk's histograms of all digits at once
+    forEachChunk([=](uint32_t firstChunk, uint32_t chunks) {
+        for (size_t c = firstChunk; c < firstChunk + chunks; c++) {
+            Histogram* const UTILS_RESTRICT h = histograms + c * DIGIT_COUNT;
+            std::fill_n(h, DIGIT_COUNT, Histogram{});
+            for (size_t i = c * chunkSize, e = std::min(count, i + chunkSize); i < e; i++) {
+                const CommandKey key = begin[i].key;
+                keys[i] = { key, uint32_t(i) };
+                for (size_t d = 0; d < DIGIT_COUNT; d++) {
+                    h[d][(key >> (d * 8u)) & 0xFFu]++;
+                }
+            }
+        }
+    });
+
+    SortKey* src = keys;
+    SortKey* dst = keys + count;
+    bool chunkHistogramsValid = true;
+    for (size_t d = 0; d < DIGIT_COUNT; d++) {
+        const unsigned shift = unsigned(d * 8u);
+
+        // skip this pass if all keys have the same digit (the chunks' histograms are still
+        // valid in that case, because the keys don't move)
+        Histogram total{};
+        for (size_t c = 0; c < chunkCount; c++) {
+            Histogram const& h = histograms[c * DIGIT_COUNT + d];
+            for (size_t v = 0; v < 256; v++) {
+                total[v] += h[v];
+            }
+        }
+        if (std::find(total.begin(), total.end(), count) != total.end()) {
+            continue;
+        }
+
+        // after the first pass, the chunks' histograms need to be recomputed because keys
+        // moved across chunks (but the total doesn't change).
+        if (!chunkHistogramsValid) {
+            forEachChunk([=](uint32_t firstChunk, uint32_t chunks) {
+                for (size_t c = firstChunk; c < firstChunk + chunks; c++) {
+                    Histogram& UTILS_RESTRICT h = histograms[c * DIGIT_COUNT + d];
+                    h = {};
+                    for (size_t i = c * chunkSize, e = std::min(count, i + chunkSize); i < e; i++) {
+                        h[(src[i].key >> shift) & 0xFFu]++;
+                    }
+                }
+            });
+        }
+
+        // compute where each chunk starts writing each digit value, we reuse the histograms
+        // for that, since we don't need them anymore.
+        uint32_t offset = 0;
+        for (size_t v = 0; v < 256; v++) {
+            for (size_t c = 0; c < chunkCount; c++) {
+                uint32_t& h = histograms[c * DIGIT_COUNT + d][v];
+                const uint32_t n = h;
+                h = offset;
+                offset += n;
+            }
+        }
+
+        forEachChunk([=](uint32_t firstChunk, uint32_t chunks) {
+            for (size_t c = firstChunk; c < firstChunk + chunks; c++) {
+                Histogram& UTILS_RESTRICT offsets = histograms[c * DIGIT_COUNT + d];
+                SortKey const* const UTILS_RESTRICT in = src;
+                SortKey* const UTILS_RESTRICT out = dst;
+                for (size_t i = c * chunkSize, e = std::min(count, i + chunkSize); i < e; i++) {
+                    out[offsets[(in[i].key >> shift) & 0xFFu]++] = in[i];
+                }
+            }
+        });
+
+        std::swap(src, dst);
+        // a single chunk's histograms are always valid, since the chunk covers all keys
+        chunkHistogramsValid = chunkCount == 1;
+    }
+
+    // finally, permute the commands in the order of the sorted keys
+    forEachChunk([=](uint32_t firstChunk, uint32_t chunks) {
+        const size_t first = firstChunk * chunkSize;
+        const size_t last = std::min(count, (firstChunk + chunks) * chunkSize);
+        for (size_t i = first; i < last; i++) {
+            new(sorted + i) Command(begin[src[i].index]);
+        }
+    });
+    forEachChunk([=](uint32_t firstChunk, uint32_t chunks) {
+        const size_t first = firstChunk * chunkSize;
+        const size_t last = std::min(count, (firstChunk + chunks) * chunkSize);
+        std::copy(sorted + first, sorted + last, begin + first);
+    });
+}
+
 void RenderPass::execute(const char* name,
         backend::Handle<backend::HwRenderTarget> renderTarget,
         backend::RenderPassParams params) const noexcept {
@@ -188,55 +344,233 @@ void RenderPass::recordDriverCommands(FEngine::DriverApi& driver, const Command*
         const Command* last) const noexcept {
     SYSTRACE_CALL();
 
+    mMergedDrawCount = 0;
     if (first != last) {
         SYSTRACE_VALUE32("commandCount", last - first);
 
-        PolygonOffset dummyPolyOffset;
-        PipelineState pipeline{ .polygonOffset = mPolygonOffset };
-        PolygonOffset* const pPipelinePolygonOffset =
-                mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
-
-        Handle<HwUniformBuffer> uboHandle = mUboHandle;
-        FMaterialInstance const* UTILS_RESTRICT mi = nullptr;
-        FMaterial const* UTILS_RESTRICT ma = nullptr;
-        auto const& customCommands = mCustomCommands;
-
-        first--;
-        while (++first != last) {
-            /*
-             * Be careful when changing code below, this is the hot inner-loop
-             */
-
-            if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
-                uint32_t index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
-                customCommands[index]();
-                continue;
+        const bool batching = mEngine.debug.renderer.draw_batching;
+        uint32_t mergedDrawCount = 0;
+        if (size_t(last - first) < PARALLEL_RECORDING_MIN_COMMANDS) {
+            mergedDrawCount = recordDriverCommandsRange(driver, first, last, batching);
+        } else {
+            // custom commands can do anything, they're always executed in order on this thread,
+            // the draw commands in-between are recorded in parallel.
+            while (first != last) {
+                Command const* const custom = std::find_if(first, last, [](Command const& c) {
+                    return (c.key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS);
+                });
+                mergedDrawCount += recordDriverCommandsParallel(driver, first, custom, batching);
+                if (custom != last) {
+                    recordDriverCommandsRange(driver, custom, custom + 1, batching);
+                    first = custom + 1;
+                } else {
+                    first = last;
+                }
             }
+        }
+        mCustomCommands.clear();
 
-            // per-renderable uniform
-            const PrimitiveInfo info = first->primitive;
-            pipeline.rasterState = info.rasterState;
-            if (UTILS_UNLIKELY(mi != info.mi)) {
-                // this is always taken the first time
-                mi = info.mi;
-                ma = mi->getMaterial();
-                pipeline.scissor = mi->getScissor();
-                *pPipelinePolygonOffset = mi->getPolygonOffset();
-                mi->use(driver);
-            }
+        SYSTRACE_VALUE32("mergedDrawCount", mergedDrawCount);
+        mMergedDrawCount = mergedDrawCount;
+    }
+}
+
+// upper bound of the size used in the CommandStream by a single draw command,
+// this must match recordDriverCommandsRange(). Note that a batched draw is always smaller than
+// the draws it replaces.
+static constexpr size_t MAX_DRIVER_COMMANDS_SIZE_PER_DRAW =
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +       // mi->use()
+        CommandBase::align(sizeof(COMMAND_TYPE(bindSamplers))) +            // mi->use()
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBufferRange))) +
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +       // bones
+        std::max(CommandBase::align(sizeof(COMMAND_TYPE(draw))),
+                 CommandBase::align(sizeof(COMMAND_TYPE(drawInstanced))));
+
+// the largest draw is a skinned, instanced draw with a new material instance
+static_assert(MAX_DRIVER_COMMANDS_SIZE_PER_DRAW >=
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +
+        CommandBase::align(sizeof(COMMAND_TYPE(bindSamplers))) +
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBufferRange))) +
+        CommandBase::align(sizeof(COMMAND_TYPE(bindUniformBuffer))) +
+        CommandBase::align(sizeof(COMMAND_TYPE(drawInstanced))),
+        "MAX_DRIVER_COMMANDS_SIZE_PER_DRAW doesn't cover the largest draw");
+
+uint32_t RenderPass::recordDriverCommandsParallel(FEngine::DriverApi& driver, const Command* first,
+        const Command* last, bool batching) const noexcept {
+    const size_t count = size_t(last - first);
+    if (count < PARALLEL_RECORDING_MIN_COMMANDS) {
+        return recordDriverCommandsRange(driver, first, last, batching);
+    }
+
+    SYSTRACE_NAME("recordDriverCommandsParallel");
+
+    // Programs are created lazily on the engine's CommandStream, so we make sure they all
+    // exist before recording in parallel.
+    FMaterialInstance const* mi = nullptr;
+    uint8_t variant = 0;
+    for (Command const* c = first; c != last; ++c) {
+        if (UTILS_UNLIKELY(mi != c->primitive.mi || variant != c->primitive.materialVariant)) {
+            mi = c->primitive.mi;
+            variant = c->primitive.materialVariant;
+            mi->getMaterial()->getProgram(variant);
+        }
+    }
 
-            pipeline.program = ma->getProgram(info.materialVariant.key);
-            size_t offset = info.index * sizeof(PerRenderableUib);
-            driver.bindUniformBufferRange(BindingPoints::PER_RENDERABLE,
-                    uboHandle, offset, sizeof(PerRenderableUib));
-            if (UTILS_UNLIKELY(info.perRenderableBones)) {
-                driver.bindUniformBuffer(BindingPoints::PER_RENDERABLE_BONES,
-                        info.perRenderableBones);
+    // Each job records a chunk of commands in its own part of the scratch buffer, using a
+    // sub-stream. The chunks never split a batch, and each chunk starts with the material
+    // instance of the previous command bound, so that the recorded commands are the same as
+    // if they were recorded serially.
+    const size_t jobCount = std::min(count / PARALLEL_RECORDING_COMMANDS_PER_JOB,
+            PARALLEL_RECORDING_MAX_JOB_COUNT);
+    const size_t commandsPerJob = (count + jobCount - 1) / jobCount;
+    std::array<size_t, PARALLEL_RECORDING_MAX_JOB_COUNT + 1> bounds{};
+    for (size_t i = 1; i < jobCount; i++) {
+        size_t b = std::max(i * commandsPerJob, bounds[i - 1]);
+        while (batching && b < count && canBatch(first[b - 1], first[b])) {
+            b++;
+        }
+        bounds[i] = std::min(b, count);
+    }
+    bounds[jobCount] = count;
+
+    char* const scratch = (char*)mEngine.getRenderPassScratchBuffer().get(
+            count * MAX_DRIVER_COMMANDS_SIZE_PER_DRAW);
+
+    struct Chunk {
+        void const* begin;
+        void const* end;
+        uint32_t mergedDrawCount;
+        uint32_t commandCount;
+    };
+    std::array<Chunk, PARALLEL_RECORDING_MAX_JOB_COUNT> chunks{};
+    Chunk* const pChunks = chunks.data();
+    size_t const* const pBounds = bounds.data();
+
+    auto work = [this, &driver, first, scratch, pChunks, pBounds, batching]
+            (uint32_t startIndex, uint32_t indexCount) {
+        for (uint32_t i = startIndex; i < startIndex + indexCount; i++) {
+            const size_t begin = pBounds[i];
+            const size_t end = pBounds[i + 1];
+            char* const buffer = scratch + begin * MAX_DRIVER_COMMANDS_SIZE_PER_DRAW;
+            CircularBuffer circularBuffer(buffer, (end - begin) * MAX_DRIVER_COMMANDS_SIZE_PER_DRAW);
+            FEngine::DriverApi stream = driver.createSubStream(circularBuffer);
+            FMaterialInstance const* const boundMaterialInstance =
+                    (begin && begin != end) ? first[begin - 1].primitive.mi : nullptr;
+            uint32_t const mergedDrawCount = recordDriverCommandsRange(stream,
+                    first + begin, first + end, batching, boundMaterialInstance);
+            assert(circularBuffer.getHead() <= buffer + (end - begin) * MAX_DRIVER_COMMANDS_SIZE_PER_DRAW);
+            pChunks[i] = { buffer, circularBuffer.getHead(), mergedDrawCount,
+                           stream.getCommandCount() - driver.getCommandCount() };
+        }
+    };
+
+    JobSystem& js = mEngine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, 0, uint32_t(jobCount),
+            std::cref(work), jobs::CountSplitter<1, PARALLEL_RECORDING_MAX_JOB_COUNT>());
+    js.runAndWait(job);
+
+    // append the chunks in order into the engine's CommandStream
+    uint32_t mergedDrawCount = 0;
+    for (size_t i = 0; i < jobCount; i++) {
+        driver.splice(chunks[i].begin, chunks[i].end, chunks[i].commandCount);
+        mergedDrawCount += chunks[i].mergedDrawCount;
+    }
+    return mergedDrawCount;
+}
+
+uint32_t RenderPass::recordDriverCommandsRange(FEngine::DriverApi& driver, const Command* first,
+        const Command* last, bool batching, FMaterialInstance const* boundMaterialInstance)
+        const noexcept {
+    PolygonOffset dummyPolyOffset;
+    PipelineState pipeline{ .polygonOffset = mPolygonOffset };
+    PolygonOffset* const pPipelinePolygonOffset =
+            mPolygonOffsetOverride ? &dummyPolyOffset : &pipeline.polygonOffset;
+
+    Handle<HwUniformBuffer> uboHandle = mUboHandle;
+    FMaterialInstance const* UTILS_RESTRICT mi = boundMaterialInstance;
+    FMaterial const* UTILS_RESTRICT ma = nullptr;
+    if (mi) {
+        ma = mi->getMaterial();
+        pipeline.scissor = mi->getScissor();
+        *pPipelinePolygonOffset = mi->getPolygonOffset();
+    }
+    auto const& customCommands = mCustomCommands;
+    uint32_t mergedDrawCount = 0;
+
+    first--;
+    while (++first != last) {
+        /*
+         * Be careful when changing code below, this is the hot inner-loop
+         */
+
+        if (UTILS_UNLIKELY((first->key & CUSTOM_MASK) != uint64_t(CustomCommand::PASS))) {
+            uint32_t index = (first->key & CUSTOM_INDEX_MASK) >> CUSTOM_INDEX_SHIFT;
+            customCommands[index]();
+            continue;
+        }
+
+        // per-renderable uniform
+        const PrimitiveInfo info = first->primitive;
+        pipeline.rasterState = info.rasterState;
+        if (UTILS_UNLIKELY(mi != info.mi)) {
+            // this is always taken the first time
+            mi = info.mi;
+            ma = mi->getMaterial();
+            pipeline.scissor = mi->getScissor();
+            *pPipelinePolygonOffset = mi->getPolygonOffset();
+            mi->use(driver);
+        }
+
+        pipeline.program = ma->getProgram(info.materialVariant);
+        size_t offset = info.index * sizeof(PerRenderableUib);
+
+        // The shaders see the uniforms of CONFIG_MAX_BATCH_COUNT renderables, starting with this
+        // one. The UBO is large enough for this range (see FScene::RENDERABLE_UBO_PADDING).
+        driver.bindUniformBufferRange(BindingPoints::PER_RENDERABLE,
+                uboHandle, offset, PER_RENDERABLE_UBO_RANGE);
+
+        if (batching && !info.perRenderableBones && !info.instanceCount) {
+            // Look for the following commands that draw the same primitive with the same state
+            // and whose renderables are in the next UBO slots (e.g. a forest), they're drawn
+            // with a single instanced draw. Each instance gets the uniforms of its renderable.
+            Command const* curr = first;
+            Command const* const end =
+                    first + std::min(size_t(last - first), CONFIG_MAX_BATCH_COUNT);
+            while (curr + 1 != end && canBatch(curr[0], curr[1])) {
+                ++curr;
             }
+            const uint32_t count = uint32_t(curr - first) + 1;
+            if (count > 1) {
+                driver.drawInstanced(pipeline, info.primitiveHandle, count);
+                mergedDrawCount += count - 1;
+                first = curr;
+                continue;
+            }
+        }
+
+        if (UTILS_UNLIKELY(info.perRenderableBones)) {
+            driver.bindUniformBuffer(BindingPoints::PER_RENDERABLE_BONES,
+                    info.perRenderableBones);
+        }
+        if (UTILS_UNLIKELY(info.instanceCount)) {
+            driver.drawInstanced(pipeline, info.primitiveHandle, info.instanceCount);
+        } else {
             driver.draw(pipeline, info.primitiveHandle);
         }
-        mCustomCommands.clear();
     }
+    return mergedDrawCount;
+}
+
+bool RenderPass::canBatch(Command const& lhs, Command const& rhs) noexcept {
+    PrimitiveInfo const& a = lhs.primitive;
+    PrimitiveInfo const& b = rhs.primitive;
+    return (rhs.key & CUSTOM_MASK) == uint64_t(CustomCommand::PASS) &&
+            a.mi == b.mi &&
+            a.primitiveHandle == b.primitiveHandle &&
+            a.materialVariant == b.materialVariant &&
+            a.rasterState.u == b.rasterState.u &&
+            !b.perRenderableBones && !b.instanceCount &&
+            a.index + 1 == b.index;
 }
 
 /* static */
@@ -247,7 +581,7 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
 
     FMaterial const * const UTILS_RESTRICT ma = mi->getMaterial();
     uint8_t variant =
-            Variant::filterVariant(cmdDraw.primitive.materialVariant.key, ma->isVariantLit());
+            Variant::filterVariant(cmdDraw.primitive.materialVariant, ma->isVariantLit());
 
     // Below, we evaluate both commands to avoid a branch
 
@@ -275,7 +609,7 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
     cmdDraw.primitive.rasterState.depthWrite = mi->getDepthWrite();
     cmdDraw.primitive.rasterState.depthFunc = mi->getDepthFunc();
     cmdDraw.primitive.mi = mi;
-    cmdDraw.primitive.materialVariant.key = variant;
+    cmdDraw.primitive.materialVariant = variant;
 
     // Code below is branch-less with clang.
 
@@ -299,7 +633,8 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
 UTILS_NOINLINE
 void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const commands,
         FScene::RenderableSoa const& soa, Range<uint32_t> range, RenderFlags renderFlags,
-        FScene::VisibleMaskType visibilityMask, float3 cameraPosition, float3 cameraForward) noexcept {
+        FScene::VisibleMaskType visibilityMask, float3 cameraPosition, float3 cameraForward,
+        CommandCache* cache) noexcept {
 
     // generateCommands() writes both the draw and depth commands simultaneously such that
     // we go throw the list of renderables just once.
@@ -325,12 +660,12 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
 
     switch (commandTypeFlags & (CommandTypeFlags::COLOR | CommandTypeFlags::DEPTH)) {
         case CommandTypeFlags::COLOR:
-            generateCommandsImpl<CommandTypeFlags::COLOR>(commandTypeFlags, curr,
-                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward);
+            generateCommandsImpl<CommandTypeFlags::COLOR>(commandTypeFlags, curr, offset,
+                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward, cache);
             break;
         case CommandTypeFlags::DEPTH:
-            generateCommandsImpl<CommandTypeFlags::DEPTH>(commandTypeFlags, curr,
-                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward);
+            generateCommandsImpl<CommandTypeFlags::DEPTH>(commandTypeFlags, curr, offset,
+                    soa, range, renderFlags, visibilityMask, cameraPosition, cameraForward, cache);
             break;
         default:
             // we should never end-up here
@@ -342,10 +677,11 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
 template<uint32_t commandTypeFlags>
 UTILS_NOINLINE
 void RenderPass::generateCommandsImpl(uint32_t extraFlags,
-        Command* UTILS_RESTRICT curr,
+        Command* UTILS_RESTRICT curr, uint32_t offset,
         FScene::RenderableSoa const& UTILS_RESTRICT soa, Range<uint32_t> range,
         RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
-        float3 cameraPosition, float3 cameraForward) noexcept {
+        float3 cameraPosition, float3 cameraForward,
+        CommandCache* cache) noexcept {
 
     // generateCommands() writes both the draw and depth commands simultaneously such that
     // we go throw the list of renderables just once.
@@ -364,6 +700,18 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
     auto const* const UTILS_RESTRICT soaPrimitives      = soa.data<FScene::PRIMITIVES>();
     auto const* const UTILS_RESTRICT soaBonesUbh        = soa.data<FScene::BONES_UBH>();
     auto const* const UTILS_RESTRICT soaVisibilityMask  = soa.data<FScene::VISIBLE_MASK>();
+    auto const* const UTILS_RESTRICT soaUboSlot         = soa.data<FScene::UBO_SLOT>();
+    auto const* const UTILS_RESTRICT soaInstance        = soa.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* const UTILS_RESTRICT soaInstances       = soa.data<FScene::INSTANCES>();
+
+    // commands in the cache have the same layout as the ones we generate
+    Command const* const first = curr;
+    CommandCache::Entry* const UTILS_RESTRICT cacheEntries = cache ? cache->mEntries.data() : nullptr;
+    const size_t cacheEntryCount = cache ? cache->mEntries.size() : 0;
+    Command const* const UTILS_RESTRICT cachePrevious = cache ? cache->mPrevious.data() : nullptr;
+    Command* const UTILS_RESTRICT cacheCurrent = cache ? cache->mCurrent.data() : nullptr;
+    const uint32_t cacheFrame = cache ? cache->mFrame : 0;
+    uint32_t reusedCount = 0;
 
     const bool hasShadowing = renderFlags & HAS_SHADOWING;
     const bool viewInverseFrontFaces = renderFlags & HAS_INVERSE_FRONT_FACES;
@@ -377,7 +725,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
     Command cmdColor;
 
     Command cmdDepth;
-    cmdDepth.primitive.materialVariant = Variant{ Variant::DEPTH_VARIANT };
+    Variant depthVariant{ Variant::DEPTH_VARIANT };
     cmdDepth.primitive.rasterState = {};
     cmdDepth.primitive.rasterState.colorWrite = false;
     cmdDepth.primitive.rasterState.depthWrite = true;
@@ -432,11 +780,66 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
         // calculate the per-primitive face winding order inversion
         const bool inverseFrontFaces = viewInverseFrontFaces ^ soaReversedWinding[i];
 
+        const Slice<FRenderPrimitive>& primitives = soaPrimitives[i];
+        const uint32_t commandCount = (colorPass * 2 + depthPass) * primitives.size();
+        const uint32_t cacheOffset = uint32_t(offset + (curr - first));
+
+        // shadow maps draw all the instances, the other passes only the ones visible from
+        // the camera (see FView::cullInstances())
+        Handle<HwUniformBuffer> bones = soaBonesUbh[i];
+        uint32_t instanceCount = 0;
+        if (UTILS_UNLIKELY(soaInstances[i])) {
+            FRenderableManager::Instances const& instances = *soaInstances[i];
+            bones = depthContainsShadowCasters ? instances.handle : instances.visibleHandle;
+            instanceCount = depthContainsShadowCasters ? instances.count : instances.visibleCount;
+        }
+
+        CommandCache::Entry* entry = nullptr;
+        const size_t instance = soaInstance[i].asValue();
+        if (cacheEntries && instance < cacheEntryCount) {
+            entry = &cacheEntries[instance];
+            const FRenderableManager::Visibility visibility = soaVisibility[i];
+            const bool reuse = entry->frame + 1 == cacheFrame &&
+                    entry->primitives == primitives.data() &&
+                    entry->primitiveCount == primitives.size() &&
+                    entry->bones == bones &&
+                    entry->instanceCount == instanceCount &&
+                    entry->reversedWinding == soaReversedWinding[i] &&
+                    entry->visibility.priority == visibility.priority &&
+                    entry->visibility.castShadows == visibility.castShadows &&
+                    entry->visibility.receiveShadows == visibility.receiveShadows &&
+                    entry->visibility.skinning == visibility.skinning &&
+                    entry->visibility.morphing == visibility.morphing &&
+                    entry->visibility.instanced == visibility.instanced;
+            if (reuse) {
+                // this renderable didn't change, only the distance to the camera and the UBO
+                // index need to be updated
+                Command const* UTILS_RESTRICT src = cachePrevious + entry->offset;
+                Command* UTILS_RESTRICT dst = cacheCurrent + cacheOffset;
+                for (uint32_t j = 0; j < commandCount; j++) {
+                    Command cmd = src[j];
+                    patchCachedCommand(cmd, distanceBits, soaUboSlot[i]);
+                    curr[j] = cmd;
+                    dst[j] = cmd;
+                }
+                curr += commandCount;
+                entry->offset = cacheOffset;
+                entry->frame = cacheFrame;
+                reusedCount++;
+                continue;
+            }
+        }
+
         cmdColor.key = makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
-        cmdColor.primitive.index = (uint16_t)i;
-        cmdColor.primitive.perRenderableBones = soaBonesUbh[i];
+        assert(soaUboSlot[i] <= MAX_PRIMITIVE_INDEX);
+        cmdColor.primitive.index = soaUboSlot[i];
+        cmdColor.primitive.perRenderableBones = bones;
+        cmdColor.primitive.instanceCount = uint8_t(instanceCount);
         materialVariant.setShadowReceiver(soaVisibility[i].receiveShadows & hasShadowing);
-        materialVariant.setSkinning(soaVisibility[i].skinning || soaVisibility[i].morphing);
+        // instances are stored in the bones UBO, so they need the skinning variant
+        const bool skinning = soaVisibility[i].skinning || soaVisibility[i].morphing ||
+                soaVisibility[i].instanced;
+        materialVariant.setSkinning(skinning);
 
         // we're assuming we're always doing the depth (either way, it's correct)
         // this will generate front to back rendering
@@ -444,16 +847,16 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
         cmdDepth.key |= uint64_t(CustomCommand::PASS);
         cmdDepth.key |= makeField(soaVisibility[i].priority, PRIORITY_MASK, PRIORITY_SHIFT);
         cmdDepth.key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
-        cmdDepth.primitive.index = (uint16_t)i;
-        cmdDepth.primitive.perRenderableBones = soaBonesUbh[i];
-        cmdDepth.primitive.materialVariant.setSkinning(soaVisibility[i].skinning || soaVisibility[i].morphing);
+        cmdDepth.primitive.index = soaUboSlot[i];
+        cmdDepth.primitive.perRenderableBones = bones;
+        cmdDepth.primitive.instanceCount = uint8_t(instanceCount);
+        depthVariant.setSkinning(skinning);
+        cmdDepth.primitive.materialVariant = depthVariant.key;
         cmdDepth.primitive.rasterState.inverseFrontFaces = inverseFrontFaces;
 
         const bool shadowCaster = soaVisibility[i].castShadows & hasShadowing;
         const bool writeDepthForShadowCasters = depthContainsShadowCasters & shadowCaster;
 
-        const Slice<FRenderPrimitive>& primitives = soaPrimitives[i];
-
         /*
          * This is our hot loop. It's written to avoid branches.
          * When modifying this code, always ensure it stays efficient.
@@ -462,7 +865,7 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
             FMaterialInstance const* const mi = primitive.getMaterialInstance();
             if (colorPass) {
                 cmdColor.primitive.primitiveHandle = primitive.getHwHandle();
-                cmdColor.primitive.materialVariant = materialVariant;
+                cmdColor.primitive.materialVariant = materialVariant.key;
                 RenderPass::setupColorCommand(cmdColor, depthPass, mi, inverseFrontFaces);
 
                 const bool blendPass = Pass(cmdColor.key & PASS_MASK) == Pass::BLENDED;
@@ -562,9 +965,109 @@ void RenderPass::generateCommandsImpl(uint32_t extraFlags,
                 ++curr;
             }
         }
+
+        if (entry) {
+            std::copy(curr - commandCount, curr, cacheCurrent + cacheOffset);
+            entry->primitives = primitives.data();
+            entry->primitiveCount = uint32_t(primitives.size());
+            entry->bones = bones;
+            entry->instanceCount = instanceCount;
+            entry->offset = cacheOffset;
+            entry->frame = cacheFrame;
+            entry->visibility = soaVisibility[i];
+            entry->reversedWinding = soaReversedWinding[i];
+        }
+    }
+
+    if (reusedCount) {
+        cache->mReusedCount.fetch_add(reusedCount, std::memory_order_relaxed);
+    }
+}
+
+void RenderPass::patchCachedCommand(Command& cmd,
+        uint32_t distanceBits, uint32_t index) noexcept {
+    // this must match the way the keys are computed in generateCommandsImpl()
+    cmd.primitive.index = index;
+    uint64_t key = cmd.key;
+    if (key == uint64_t(Pass::SENTINEL)) {
+        return;
+    }
+    switch (Pass(key & PASS_MASK)) {
+        case Pass::DEPTH:
+            key &= ~DISTANCE_BITS_MASK;
+            key |= makeField(distanceBits, DISTANCE_BITS_MASK, DISTANCE_BITS_SHIFT);
+            break;
+        case Pass::COLOR:
+        case Pass::REFRACT:
+            key &= ~Z_BUCKET_MASK;
+            key |= makeField(distanceBits >> 22u, Z_BUCKET_MASK, Z_BUCKET_SHIFT);
+            break;
+        case Pass::BLENDED:
+            key &= ~BLEND_DISTANCE_MASK;
+            key |= makeField(~distanceBits, BLEND_DISTANCE_MASK, BLEND_DISTANCE_SHIFT);
+            break;
+        default:
+            break;
+    }
+    cmd.key = key;
+}
+
+// ------------------------------------------------------------------------------------------------
+
+RenderPass::CommandCache::CommandCache() noexcept = default;
+
+RenderPass::CommandCache::~CommandCache() noexcept = default;
+
+void RenderPass::CommandCache::clear() noexcept {
+    mEntries.clear();
+    mPrevious.clear();
+    mCurrent.clear();
+}
+
+void RenderPass::CommandCache::prepare(FEngine& engine, uint32_t commandTypeFlags,
+        RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
+        size_t commandCount) noexcept {
+    FRenderableManager const& rcm = engine.getRenderableManager();
+    ChangeJournal const& journal = rcm.getChangeJournal();
+
+    Slice<const Entity> changes;
+    const bool valid = journal.getChangesSince(mSequence, changes) &&
+            mCommandTypeFlags == commandTypeFlags &&
+            mRenderFlags == renderFlags &&
+            mVisibilityMask == visibilityMask &&
+            mMaterialInstanceStateVersion == engine.getMaterialInstanceStateVersion();
+
+    mSequence = journal.getSequence();
+    mCommandTypeFlags = commandTypeFlags;
+    mRenderFlags = renderFlags;
+    mVisibilityMask = visibilityMask;
+    mMaterialInstanceStateVersion = engine.getMaterialInstanceStateVersion();
+    mReusedCount.store(0, std::memory_order_relaxed);
+
+    // component instances start at 1
+    mEntries.resize(rcm.getComponentCount() + 1);
+
+    if (valid) {
+        for (Entity e : changes) {
+            auto ci = rcm.getInstance(e);
+            if (ci) {
+                mEntries[ci.asValue()].frame = 0;
+            }
+        }
+        mFrame++;
+    } else {
+        // skip a frame, so that none of the entries match the previous frame
+        mFrame += 2;
+    }
+
+    std::swap(mPrevious, mCurrent);
+    if (mCurrent.size() < commandCount) {
+        mCurrent.resize(commandCount);
     }
 }
 
+// ------------------------------------------------------------------------------------------------
+
 void RenderPass::updateSummedPrimitiveCounts(
         FScene::RenderableSoa& renderableData, Range<uint32_t> vr) noexcept {
     auto const* const UTILS_RESTRICT primitives = renderableData.data<FScene::PRIMITIVES>();
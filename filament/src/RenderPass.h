@@ -25,12 +25,15 @@
 
 #include "private/backend/DriverApiForward.h"
 
+#include <private/filament/EngineEnums.h>
 #include <private/filament/Variant.h>
 
 #include <utils/compiler.h>
 #include <utils/Slice.h>
 
+#include <atomic>
 #include <limits>
+#include <vector>
 
 namespace utils {
 class JobSystem;
@@ -214,11 +217,25 @@ public:
         backend::Handle<backend::HwRenderPrimitive> primitiveHandle;    // 4 bytes
         backend::Handle<backend::HwUniformBuffer> perRenderableBones;   // 4 bytes
         backend::RasterState rasterState;                               // 4 bytes
-        uint16_t index = 0;                                             // 2 bytes
-        Variant materialVariant;                                        // 1 byte
-        uint8_t reserved = {};                                          // 1 byte
+        union {                                                         // 4 bytes
+            struct {
+                // UBO slot, the renderables of a scene are limited by the number of entities
+                uint32_t index                  : 18;
+                // 0 if not instanced, up to CONFIG_MAX_INSTANCES
+                uint32_t instanceCount          : 8;
+                // Variant::key
+                uint32_t materialVariant        : 6;
+            };
+            uint32_t packed = 0;
+        };
     };
 
+    static constexpr uint32_t MAX_PRIMITIVE_INDEX = (1u << 18u) - 1u;
+    static_assert(CONFIG_MAX_INSTANCES < (1u << 8u),
+            "PrimitiveInfo::instanceCount can't hold CONFIG_MAX_INSTANCES");
+    static_assert(VARIANT_COUNT <= (1u << 6u),
+            "PrimitiveInfo::materialVariant can't hold all the variants");
+
     struct alignas(8) Command {     // 32 bytes
         CommandKey key = 0;         //  8 bytes
         PrimitiveInfo primitive;    // 24 bytes
@@ -231,6 +248,7 @@ public:
     };
     static_assert(std::is_trivially_destructible<Command>::value,
             "Command isn't trivially destructible");
+    static_assert(sizeof(Command) == 32, "Command must be 32 bytes");
 
     using RenderFlags = uint8_t;
     static constexpr RenderFlags HAS_SHADOWING           = 0x01;
@@ -239,6 +257,61 @@ public:
     static constexpr RenderFlags HAS_INVERSE_FRONT_FACES = 0x08;
     static constexpr RenderFlags HAS_FOG                 = 0x10;
 
+    /*
+     * A CommandCache keeps the commands generated for each renderable by appendCommands(), so
+     * that the next frame can reuse them for the renderables that didn't change. Only the
+     * camera-distance dependent bits of the keys and the UBO index are patched.
+     *
+     * The cache is keyed on the renderable instance, and invalidated entirely when the pass
+     * parameters (command type, render flags, visibility mask) change, or when the state of a
+     * material instance changes (see FMaterialInstance::setCommandState()), or when a material
+     * instance is created or destroyed. A cache must only be used by one RenderPass per frame,
+     * typically there is one cache per View and per type of pass.
+     */
+    class CommandCache {
+    public:
+        CommandCache() noexcept;
+        ~CommandCache() noexcept;
+
+        CommandCache(CommandCache const& rhs) = delete;
+        CommandCache& operator=(CommandCache const& rhs) = delete;
+
+        // discards all cached commands
+        void clear() noexcept;
+
+        // number of renderables whose commands were reused during the last appendCommands()
+        size_t getReusedCount() const noexcept { return mReusedCount.load(std::memory_order_relaxed); }
+
+    private:
+        friend class RenderPass;
+
+        struct Entry {
+            FRenderPrimitive const* primitives = nullptr;
+            backend::Handle<backend::HwUniformBuffer> bones;
+            uint32_t primitiveCount = 0;
+            uint32_t instanceCount = 0;
+            uint32_t offset = 0;        // offset of the commands in mCurrent
+            uint32_t frame = 0;         // frame the commands were cached in, 0 if invalid
+            FRenderableManager::Visibility visibility{};
+            bool reversedWinding = false;
+        };
+
+        // called once per appendCommands(), before generating the commands
+        void prepare(FEngine& engine, uint32_t commandTypeFlags, RenderFlags renderFlags,
+                FScene::VisibleMaskType visibilityMask, size_t commandCount) noexcept;
+
+        std::vector<Entry> mEntries;        // indexed by renderable instance
+        std::vector<Command> mPrevious;     // commands of the previous frame
+        std::vector<Command> mCurrent;      // commands of this frame
+        uint64_t mSequence = 0;             // RenderableManager's change journal sequence
+        uint32_t mFrame = 1;
+        uint32_t mMaterialInstanceStateVersion = 0;
+        uint32_t mCommandTypeFlags = 0;
+        RenderFlags mRenderFlags = 0;
+        FScene::VisibleMaskType mVisibilityMask = 0;
+        std::atomic<uint32_t> mReusedCount{ 0 };
+    };
+
 
     RenderPass(FEngine& engine, utils::GrowingSlice<Command> commands) noexcept;
     void overridePolygonOffset(backend::PolygonOffset* polygonOffset) noexcept;
@@ -247,6 +320,10 @@ public:
     void setCamera(const CameraInfo& camera) noexcept;
     void setRenderFlags(RenderFlags flags) noexcept;
 
+    // Sets the cache used by appendCommands() to reuse the commands of the previous frame,
+    // or nullptr to always generate all commands (default).
+    void setCommandCache(CommandCache* cache) noexcept { mCommandCache = cache; }
+
     // Sets the visibility mask, which is AND-ed against each Renderable's VISIBLE_MASK to determine
     // if the renderable is visible for this pass.
     // Defaults to all 1's, which means all renderables in this render pass will be rendered.
@@ -276,6 +353,26 @@ public:
     // the new mCommands.end()
     Command* sortCommands() noexcept;
 
+    // Sorts commands by key. This uses a radix sort, and falls back to std::sort() for small
+    // command counts. Note that unlike std::sort(), the order of equal keys is preserved.
+    // The radix sort's temporary memory comes from scratch.
+    static void sortCommands(utils::JobSystem& js, ScratchBuffer& scratch,
+            Command* begin, Command* end) noexcept;
+
+    // below this many commands, the driver commands are recorded on the calling thread only
+    static constexpr size_t PARALLEL_RECORDING_MIN_COMMANDS = 4096;
+
+    // Records the driver commands of [first, last). Large ranges are recorded in parallel, which
+    // produces the same driver commands as recordDriverCommandsRange().
+    void recordDriverCommands(FEngine::DriverApi& driver, const Command* first,
+            const Command* last) const noexcept;
+
+    // Records the driver commands of [first, last) on the calling thread, assuming that
+    // boundMaterialInstance is already bound. Returns the number of draws merged by batching.
+    uint32_t recordDriverCommandsRange(FEngine::DriverApi& driver, const Command* first,
+            const Command* last, bool batching,
+            FMaterialInstance const* boundMaterialInstance = nullptr) const noexcept;
+
     void execute(const char* name,
             backend::Handle<backend::HwRenderTarget> renderTarget,
             backend::RenderPassParams params) const noexcept;
@@ -289,11 +386,17 @@ public:
         return mCommandsHighWatermark * sizeof(Command);
     }
 
+    // Number of draws saved by batching during the last execute() or executeCommands().
+    // Consecutive commands that only differ by their (contiguous) UBO slot are recorded as a
+    // single instanced draw of up to CONFIG_MAX_BATCH_COUNT instances, this is controlled by the
+    // "d.renderer.draw_batching" debug property.
+    size_t getMergedDrawCount() const noexcept { return mMergedDrawCount; }
+
 private:
     friend class FRenderer;
 
-    // on 64-bits systems, we process batches of 4 (64 bytes) cache-lines, or 8 (32 bytes) commands
-    // on 32-bits systems, we process batches of 8 (32 bytes) cache-lines, or 8 (32 bytes) commands
+    // on 64-bits systems, we process batches of 10 (64 bytes) cache-lines, or 16 (40 bytes) commands
+    // on 32-bits systems, we process batches of 16 (32 bytes) cache-lines, or 16 (32 bytes) commands
     static constexpr size_t JOBS_PARALLEL_FOR_COMMANDS_COUNT = 16;
     static constexpr size_t JOBS_PARALLEL_FOR_COMMANDS_SIZE  =
             sizeof(Command) * JOBS_PARALLEL_FOR_COMMANDS_COUNT;
@@ -301,21 +404,45 @@ private:
     static_assert(JOBS_PARALLEL_FOR_COMMANDS_SIZE % utils::CACHELINE_SIZE == 0,
             "Size of Commands jobs must be multiple of a cache-line size");
 
+    // below this many commands std::sort() is faster than the radix sort
+    static constexpr size_t RADIX_SORT_MIN_COMMANDS = 512;
+    // below this many commands the radix sort runs on the calling thread only
+    static constexpr size_t RADIX_SORT_PARALLEL_MIN_COMMANDS = 16384;
+    // number of chunks (and jobs) the parallel radix sort is split into
+    static constexpr size_t RADIX_SORT_PARALLEL_CHUNK_COUNT = 8;
+
+    // size of the range of the renderable UBO bound for each draw, see getObjectUniformsIndex()
+    // in getters.vs
+    static constexpr size_t PER_RENDERABLE_UBO_RANGE =
+            CONFIG_MAX_BATCH_COUNT * sizeof(PerRenderableUib);
+
+    // minimum number of commands recorded by a job, and maximum number of jobs
+    static constexpr size_t PARALLEL_RECORDING_COMMANDS_PER_JOB = 1024;
+    static constexpr size_t PARALLEL_RECORDING_MAX_JOB_COUNT = 8;
+
     static inline void generateCommands(uint32_t commandTypeFlags, Command* commands,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
-            FScene::VisibleMaskType visibilityMask, math::float3 cameraPosition, math::float3 cameraForward) noexcept;
+            FScene::VisibleMaskType visibilityMask, math::float3 cameraPosition, math::float3 cameraForward,
+            CommandCache* cache) noexcept;
 
     template<uint32_t commandTypeFlags>
-    static inline void generateCommandsImpl(uint32_t, Command* commands,
+    static inline void generateCommandsImpl(uint32_t, Command* commands, uint32_t offset,
             FScene::RenderableSoa const& soa, utils::Range<uint32_t> range,
             RenderFlags renderFlags, FScene::VisibleMaskType visibilityMask,
-            math::float3 cameraPosition, math::float3 cameraForward) noexcept;
+            math::float3 cameraPosition, math::float3 cameraForward,
+            CommandCache* cache) noexcept;
+
+    static inline void patchCachedCommand(Command& cmd,
+            uint32_t distanceBits, uint32_t index) noexcept;
+
+    // whether two consecutive commands can be drawn with a single instanced draw
+    static inline bool canBatch(Command const& lhs, Command const& rhs) noexcept;
 
     static void setupColorCommand(Command& cmdDraw, bool hasDepthPass,
             FMaterialInstance const* mi, bool inverseFrontFaces) noexcept;
 
-    void recordDriverCommands(FEngine::DriverApi& driver, const Command* first,
-            const Command* last) const noexcept;
+    uint32_t recordDriverCommandsParallel(FEngine::DriverApi& driver, const Command* first,
+            const Command* last, bool batching) const noexcept;
 
     static void updateSummedPrimitiveCounts(
             FScene::RenderableSoa& renderableData, utils::Range<uint32_t> vr) noexcept;
@@ -336,6 +463,9 @@ private:
     // the UBO containing the data for the renderables
     backend::Handle<backend::HwUniformBuffer> mUboHandle;
 
+    // the cache used to reuse the commands of the previous frame, if any
+    CommandCache* mCommandCache = nullptr;
+
     // info about the camera
     CameraInfo mCamera;
     // info about the scene features (e.g.: has shadows, lighting, etc...)
@@ -351,6 +481,9 @@ private:
 
     // high watermark for debugging
     size_t mCommandsHighWatermark = 0;
+
+    // number of draws merged by batching, for debugging
+    mutable uint32_t mMergedDrawCount = 0;
 };
 
 } // namespace filament
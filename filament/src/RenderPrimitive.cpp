@@ -23,62 +23,62 @@
 
 namespace filament {
 
-void FRenderPrimitive::init(backend::DriverApi& driver,
+void FRenderPrimitive::init(FEngine& engine,
         const RenderableManager::Builder::Entry& entry) noexcept {
 
     assert(entry.materialInstance);
 
-    mHandle = driver.createRenderPrimitive();
     mMaterialInstance = upcast(entry.materialInstance);
     mBlendOrder = entry.blendOrder;
 
     if (entry.indices && entry.vertices) {
         FVertexBuffer* vertexBuffer = upcast(entry.vertices);
         FIndexBuffer* indexBuffer = upcast(entry.indices);
-
-        AttributeBitset enabledAttributes = vertexBuffer->getDeclaredAttributes();
-
-        auto const& ebh = vertexBuffer->getHwHandle();
-        auto const& ibh = indexBuffer->getHwHandle();
-
-        driver.setRenderPrimitiveBuffer(mHandle, ebh, ibh, (uint32_t)enabledAttributes.getValue());
-        driver.setRenderPrimitiveRange(mHandle, entry.type,
-                (uint32_t)entry.offset, (uint32_t)entry.minIndex, (uint32_t)entry.maxIndex,
-                (uint32_t)entry.count);
-
+        mVertexBufferHandle = vertexBuffer->getHwHandle();
+        mIndexBufferHandle = indexBuffer->getHwHandle();
         mPrimitiveType = entry.type;
-        mEnabledAttributes = enabledAttributes;
+        mEnabledAttributes = vertexBuffer->getDeclaredAttributes();
     }
+
+    HwRenderPrimitiveFactory& factory = engine.getHwRenderPrimitiveFactory();
+    mHandle = factory.create(engine.getDriverApi(), mVertexBufferHandle, mIndexBufferHandle,
+            mPrimitiveType, (uint32_t)entry.offset, (uint32_t)entry.minIndex,
+            (uint32_t)entry.maxIndex, (uint32_t)entry.count,
+            (uint32_t)mEnabledAttributes.getValue());
 }
 
 void FRenderPrimitive::terminate(FEngine& engine) {
-    FEngine::DriverApi& driver = engine.getDriverApi();
-    driver.destroyRenderPrimitive(mHandle);
+    HwRenderPrimitiveFactory& factory = engine.getHwRenderPrimitiveFactory();
+    factory.destroy(engine.getDriverApi(), mHandle);
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type,
         FVertexBuffer* vertices, FIndexBuffer* indices, size_t offset,
         size_t minIndex, size_t maxIndex, size_t count) noexcept {
-    AttributeBitset enabledAttributes = vertices->getDeclaredAttributes();
-    auto const& ebh = vertices->getHwHandle();
-    auto const& ibh = indices->getHwHandle();
-
-    FEngine::DriverApi& driver = engine.getDriverApi();
-
-    driver.setRenderPrimitiveBuffer(mHandle, ebh, ibh, (uint32_t)enabledAttributes.getValue());
-    driver.setRenderPrimitiveRange(mHandle, type,
-            (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex, (uint32_t)count);
-
+    mVertexBufferHandle = vertices->getHwHandle();
+    mIndexBufferHandle = indices->getHwHandle();
     mPrimitiveType = type;
-    mEnabledAttributes = enabledAttributes;
+    mEnabledAttributes = vertices->getDeclaredAttributes();
+    update(engine, offset, minIndex, maxIndex, count);
 }
 
 void FRenderPrimitive::set(FEngine& engine, RenderableManager::PrimitiveType type, size_t offset,
         size_t minIndex, size_t maxIndex, size_t count) noexcept {
-    FEngine::DriverApi& driver = engine.getDriverApi();
-    driver.setRenderPrimitiveRange(mHandle, type,
-            (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex, (uint32_t)count);
     mPrimitiveType = type;
+    update(engine, offset, minIndex, maxIndex, count);
+}
+
+void FRenderPrimitive::update(FEngine& engine,
+        size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept {
+    // the HwRenderPrimitive may be shared with other primitives, so it can't be modified,
+    // instead we switch to the one for the new geometry
+    HwRenderPrimitiveFactory& factory = engine.getHwRenderPrimitiveFactory();
+    FEngine::DriverApi& driver = engine.getDriverApi();
+    auto handle = factory.create(driver, mVertexBufferHandle, mIndexBufferHandle,
+            mPrimitiveType, (uint32_t)offset, (uint32_t)minIndex, (uint32_t)maxIndex,
+            (uint32_t)count, (uint32_t)mEnabledAttributes.getValue());
+    factory.destroy(driver, mHandle);
+    mHandle = handle;
 }
 
 } // namespace filament
@@ -37,10 +37,14 @@
 
 #include <utils/compiler.h>
 #include <utils/Panic.h>
+#include <utils/sstream.h>
 #include <utils/Systrace.h>
 #include <utils/vector.h>
 
+#include <fstream>
+
 #include <assert.h>
+#include <ctype.h>
 
 // this helps visualize what dynamic-scaling is doing
 #define DEBUG_DYNAMIC_SCALING false
@@ -61,6 +65,11 @@ FRenderer::FRenderer(FEngine& engine) :
 {
     FDebugRegistry& debugRegistry = engine.getDebugRegistry();
     debugRegistry.registerProperty("d.ssao.enabled", &engine.debug.ssao.enabled);
+    debugRegistry.registerProperty("d.renderer.draw_batching", &engine.debug.renderer.draw_batching);
+    debugRegistry.registerProperty("d.renderer.framegraph_compile_cache",
+            &engine.debug.renderer.framegraph_compile_cache);
+    debugRegistry.registerProperty("d.renderer.framegraph_profiling",
+            &engine.debug.renderer.framegraph_profiling);
 }
 
 void FRenderer::init() noexcept {
@@ -265,6 +274,8 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
      */
 
     FrameGraph fg(engine.getResourceAllocator());
+    const bool profiling = engine.debug.renderer.framegraph_profiling;
+    fg.setProfilingEnabled(profiling);
 
     const TargetBufferFlags discardedFlags = mDiscardedFlags;
     const TargetBufferFlags clearFlags = mClearFlags;
@@ -342,6 +353,7 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     // TODO: this should be a FrameGraph pass to participate to automatic culling
     pass.newCommandBuffer();
+    pass.setCommandCache(&view.getStructureCommandCache());
     pass.appendCommands(RenderPass::CommandTypeFlags::SSAO);
     pass.sortCommands();
 
@@ -362,7 +374,9 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     // TODO: ideally this should be a FrameGraph pass to participate to automatic culling
     pass.newCommandBuffer();
+    pass.setCommandCache(&view.getColorCommandCache());
     pass.appendCommands(RenderPass::COLOR);
+    pass.setCommandCache(nullptr);
     pass.sortCommands();
 
     // We use a framegraph pass to wait for froxelization to finish (so it can be done
@@ -454,9 +468,30 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     auto output = input;
     fg.present(output);
     fg.moveResource(fgViewRenderTarget, output);
-    fg.compile();
+    if (engine.debug.renderer.framegraph_compile_cache) {
+        // the graph is usually the same as in the previous frame
+        fg.compile(view.getFrameGraphCompileCache());
+    } else {
+        fg.compile();
+    }
     //fg.export_graphviz(slog.d, view.getName());
     fg.execute(engine, driver);
+    if (UTILS_UNLIKELY(profiling)) {
+        // each view writes the trace of each frame in its own file, in the current directory
+        io::sstream trace;
+        fg.export_chrome_trace(trace, view.getName());
+        char path[128];
+        snprintf(path, sizeof(path), "framegraph_trace_%u_%s.json",
+                mFrameId, view.getName() ? view.getName() : "view");
+        for (char* c = path; *c; c++) {
+            *c = (isalnum(*c) || *c == '.') ? *c : '_';
+        }
+        std::ofstream file(path);
+        file << trace.c_str();
+        if (!file) {
+            slog.w << "could not write the frame graph trace to " << path << io::endl;
+        }
+    }
 
     recordHighWatermark(pass.getCommandsHighWatermark());
 }
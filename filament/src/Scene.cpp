@@ -23,15 +23,21 @@
 
 #include "details/Culler.h"
 #include "details/Engine.h"
+#include "details/Froxelizer.h"
 #include "details/IndirectLight.h"
 #include "details/Skybox.h"
 
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
 #include <utils/Range.h>
+#include <utils/Systrace.h>
 #include <utils/Zip2Iterator.h>
 
 #include <algorithm>
+#include <atomic>
+
+#include <string.h>
 
 using namespace filament::math;
 using namespace utils;
@@ -47,9 +53,8 @@ FScene::FScene(FEngine& engine) :
 FScene::~FScene() noexcept = default;
 
 
-void FScene::prepare(const mat4f& worldOriginTransform) {
-    // TODO: can we skip this in most cases? Since we rely on indices staying the same,
-    //       we could only skip, if nothing changed in the RCM.
+void FScene::prepare(utils::JobSystem& js, const mat4f& worldOriginTransform) {
+    SYSTRACE_CALL();
 
     FEngine& engine = mEngine;
     EntityManager& em = engine.getEntityManager();
@@ -60,194 +65,676 @@ void FScene::prepare(const mat4f& worldOriginTransform) {
     auto& sceneData = mRenderableData;
     auto& lightData = mLightData;
     auto const& entities = mEntities;
+    auto& entityInfo = mEntityInfo;
+
+    /*
+     * In incremental mode, we only need to resolve the entities' components again if entities
+     * were added or removed from the scene, or if components were created or destroyed (which
+     * invalidates the journals). Otherwise, the journals tell us which renderables changed.
+     */
+    const bool incremental = mIncrementalPreparation;
+    Slice<const Entity> transformChanges;
+    Slice<const Entity> renderableChanges;
+    Slice<const Entity> lightChanges;
+    bool resolve = !incremental || mEntitiesChanged ||
+            !tcm.getChangeJournal().getChangesSince(mTransformSequence, transformChanges) ||
+            !rcm.getChangeJournal().getChangesSince(mRenderableSequence, renderableChanges) ||
+            !lcm.getChangeJournal().getChangesSince(mLightSequence, lightChanges);
+    if (!resolve) {
+        // entities could have been destroyed without their components being gc'ed yet
+        for (EntityInfo const& info : entityInfo) {
+            if (UTILS_UNLIKELY((info.ri || info.li) && !em.isAlive(info.entity))) {
+                resolve = true;
+                break;
+            }
+        }
+    }
+    mTransformSequence = tcm.getChangeJournal().getSequence();
+    mRenderableSequence = rcm.getChangeJournal().getSequence();
+    mLightSequence = lcm.getChangeJournal().getSequence();
+    mEntitiesChanged = false;
 
+    /*
+     * Gathering the scene happens in three steps:
+     * 1. (parallel) resolve the components of each entity
+     * 2. (serial)   prefix-sum the renderables and lights to find their row in their SoA
+     * 3. (parallel) compute the world transforms and bounds and write the SoA rows
+     *
+     * The result is identical to processing all entities serially in the order of mEntities.
+     * In incremental mode, the first two steps are skipped when possible.
+     */
 
-    // NOTE: we can't know in advance how many entities are renderable or lights because the corresponding
-    // component can be added after the entity is added to the scene.
+    if (resolve) {
+        // NOTE: we can't know in advance how many entities are renderable or lights because the corresponding
+        // component can be added after the entity is added to the scene.
 
-    size_t renderableDataCapacity = entities.size();
-    // we need the capacity to be multiple of 16 for SIMD loops
-    renderableDataCapacity = (renderableDataCapacity + 0xFu) & ~0xFu;
-    // we need 1 extra entry at the end for the summed primitive count
-    renderableDataCapacity = renderableDataCapacity + 1;
+        size_t renderableDataCapacity = entities.size();
+        // we need the capacity to be multiple of 16 for SIMD loops
+        renderableDataCapacity = (renderableDataCapacity + 0xFu) & ~0xFu;
+        // we need 1 extra entry at the end for the summed primitive count
+        renderableDataCapacity = renderableDataCapacity + 1;
 
-    sceneData.clear();
-    if (sceneData.capacity() < renderableDataCapacity) {
-        sceneData.setCapacity(renderableDataCapacity);
-    }
+        sceneData.clear();
+        if (sceneData.capacity() < renderableDataCapacity) {
+            sceneData.setCapacity(renderableDataCapacity);
+        }
 
-    // The light data list will always contain at least one entry for the
-    // dominating directional light, even if there are no entities.
-    size_t lightDataCapacity = std::max<size_t>(1, entities.size());
-    // we need the capacity to be multiple of 16 for SIMD loops
-    lightDataCapacity = (lightDataCapacity + 0xFu) & ~0xFu;
+        // The light data list will always contain at least one entry for the
+        // dominating directional light, even if there are no entities.
+        size_t lightDataCapacity = std::max<size_t>(1, entities.size());
+        // we need the capacity to be multiple of 16 for SIMD loops
+        lightDataCapacity = (lightDataCapacity + 0xFu) & ~0xFu;
 
-    lightData.clear();
-    if (lightData.capacity() < lightDataCapacity) {
-        lightData.setCapacity(lightDataCapacity);
-    }
-    // the first entries are reserved for the directional lights (currently only one)
-    lightData.resize(DIRECTIONAL_LIGHTS_COUNT);
+        lightData.clear();
+        if (lightData.capacity() < lightDataCapacity) {
+            lightData.setCapacity(lightDataCapacity);
+        }
 
+        // we need a linear array of entities to be able to split the work
+        entityInfo.resize(entities.size());
+        { // scope for systrace
+            SYSTRACE_NAME("copy entities");
+            EntityInfo* UTILS_RESTRICT p = entityInfo.data();
+            for (Entity e : entities) {
+                (p++)->entity = e;
+            }
+        }
 
-    // find the max intensity directional light index in our local array
-    float maxIntensity = 0.0f;
+        auto resolveInstances = [&em, &rcm, &lcm, &tcm, info = entityInfo.data()]
+                (uint32_t first, uint32_t count) {
+            for (EntityInfo* p = info + first, * const last = p + count; p != last; ++p) {
+                p->ri = {};
+                p->li = {};
+                p->ti = {};
+                p->directionalLight = false;
+
+                // getInstance() always returns null if the entity is the Null entity
+                // so we don't need to check for that, but we need to check it's alive
+                if (!em.isAlive(p->entity)) {
+                    continue;
+                }
 
-    for (Entity e : entities) {
-        if (!em.isAlive(e)) {
-            continue;
+                auto ri = rcm.getInstance(p->entity);
+                auto li = lcm.getInstance(p->entity);
+                if (!ri & !li) {
+                    continue;
+                }
+
+                auto ti = tcm.getInstance(p->entity);
+
+                // don't even draw this object if it doesn't have a transform (which shouldn't happen
+                // because one is always created when creating a Renderable component).
+                p->ri = ti ? ri : FRenderableManager::Instance{};
+                p->li = li;
+                p->ti = ti;
+                p->directionalLight = li && lcm.isDirectionalLight(li);
+            }
+        };
+
+        auto jobResolve = jobs::parallel_for(js, nullptr, 0, (uint32_t)entityInfo.size(),
+                std::cref(resolveInstances),
+                jobs::CountSplitter<JOBS_PARALLEL_FOR_ENTITIES_COUNT, 8>());
+        js.runAndWait(jobResolve);
+
+        // the first entries are reserved for the directional lights (currently only one)
+        uint32_t renderableCount = 0;
+        uint32_t lightCount = DIRECTIONAL_LIGHTS_COUNT;
+        mLightEntityInfo.clear();
+        for (EntityInfo& info : entityInfo) {
+            info.renderableIndex = renderableCount;
+            info.lightIndex = lightCount;
+            renderableCount += info.ri ? 1u : 0u;
+            if (info.li) {
+                mLightEntityInfo.push_back(uint32_t(&info - entityInfo.data()));
+                // we don't store the directional lights, because we only have a single one.
+                lightCount += info.directionalLight ? 0u : 1u;
+            }
         }
+        mRenderableCount = renderableCount;
+        mLightCount = lightCount;
+    }
+
+    // In incremental mode, the rows of the renderable data are kept from one frame to the next
+    // (the views only reorder them), so that only the rows that changed are copied from the cache.
+    const bool keepRenderableRows = incremental && !resolve &&
+            sceneData.size() == mRenderableCount;
 
-        // getInstance() always returns null if the entity is the Null entity
-        // so we don't need to check for that, but we need to check it's alive
-        auto ri = rcm.getInstance(e);
-        auto li = lcm.getInstance(e);
-        if (!ri & !li) {
-            continue;
+    // we know there is enough space in the arrays
+    if (!keepRenderableRows) {
+        sceneData.clear();
+        sceneData.resize(mRenderableCount);
+    }
+    lightData.clear();
+    lightData.resize(mLightCount);
+
+    // find the max intensity directional light, this must be done in entity order so that the
+    // selection is deterministic.
+    float maxIntensity = 0.0f;
+    EntityInfo const* dominantDirectionalLight = nullptr;
+    for (uint32_t index : mLightEntityInfo) {
+        EntityInfo const& info = entityInfo[index];
+        if (UTILS_UNLIKELY(info.directionalLight)) {
+            const float intensity = lcm.getIntensity(info.li);
+            if (intensity >= maxIntensity) {
+                maxIntensity = intensity;
+                dominantDirectionalLight = &info;
+            }
         }
+    }
+
+    if (dominantDirectionalLight) {
+        FLightManager::Instance const li = dominantDirectionalLight->li;
+        const mat4f worldTransform =
+                worldOriginTransform * tcm.getWorldTransform(dominantDirectionalLight->ti);
+        float3 d = lcm.getLocalDirection(li);
+        // using mat3f::getTransformForNormals handles non-uniform scaling
+        d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
+        lightData.elementAt<FScene::POSITION_RADIUS>(0) =
+                float4{ 0, 0, 0, std::numeric_limits<float>::infinity() };
+        lightData.elementAt<FScene::DIRECTION>(0)       = d;
+        lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = li;
+    }
 
-        // get the world transform
-        auto ti = tcm.getInstance(e);
-        const mat4f worldTransform = worldOriginTransform * tcm.getWorldTransform(ti);
-        const bool reversedWindingOrder = det(worldTransform.upperLeft()) < 0;
-
-        // don't even draw this object if it doesn't have a transform (which shouldn't happen
-        // because one is always created when creating a Renderable component).
-        if (ri && ti) {
-            // compute the world AABB so we can perform culling
-            const Box worldAABB = rigidTransform(rcm.getAABB(ri), worldTransform);
-
-            // we know there is enough space in the array
-            sceneData.push_back_unsafe(
-                    ri,                       // RENDERABLE_INSTANCE
-                    worldTransform,           // WORLD_TRANSFORM
-                    reversedWindingOrder,     // REVERSED_WINDING_ORDER
-                    rcm.getVisibility(ri),    // VISIBILITY_STATE
-                    rcm.getBonesUbh(ri),      // BONES_UBH
-                    worldAABB.center,         // WORLD_AABB_CENTER
-                    0,                        // VISIBLE_MASK
-                    rcm.getMorphWeights(ri),  // MORPH_WEIGHTS
-                    rcm.getLayerMask(ri),     // LAYERS
-                    worldAABB.halfExtent,     // WORLD_AABB_EXTENT
-                    {},                       // PRIMITIVES
-                    0                         // SUMMED_PRIMITIVE_COUNT
-            );
+    if (!incremental) {
+        auto gatherRenderables = [this, &sceneData, &worldOriginTransform,
+                info = entityInfo.data()](uint32_t first, uint32_t count) {
+            for (EntityInfo const* p = info + first, * const last = p + count; p != last; ++p) {
+                if (p->ri) {
+                    gatherRenderable(*p, sceneData, worldOriginTransform);
+                }
+            }
+        };
+
+        auto jobGather = jobs::parallel_for(js, nullptr, 0, (uint32_t)entityInfo.size(),
+                std::cref(gatherRenderables),
+                jobs::CountSplitter<JOBS_PARALLEL_FOR_ENTITIES_COUNT, 8>());
+        js.runAndWait(jobGather);
+        mRenderableRowCopies = mRenderableCount;
+    } else {
+        // The cache doesn't include the translation of the world origin, which changes every
+        // time the camera moves when the world is rendered relative to the camera.
+        mat4f origin = worldOriginTransform;
+        origin[3] = float4{ 0, 0, 0, 1 };
+        const float3 translation = worldOriginTransform[3].xyz;
+
+        auto& cache = mRenderableCache;
+        mat4f const& cacheOrigin = mRenderableCacheOrigin;
+        const bool updateAll = resolve ||
+                origin[0] != cacheOrigin[0] || origin[1] != cacheOrigin[1] ||
+                origin[2] != cacheOrigin[2] || origin[3] != cacheOrigin[3];
+
+        // the rows of the cache that changed this frame, unless they all need to be copied
+        bool copyAll = updateAll || !keepRenderableRows ||
+                translation != mRenderableCacheTranslation;
+        uint32_t const* changedRows = nullptr;
+        size_t changedRowCount = 0;
+
+        if (resolve) {
+            SYSTRACE_NAME("resolve cache");
+            cache.clear();
+            if (cache.capacity() < mRenderableCount) {
+                cache.setCapacity(mRenderableCount);
+            }
+            cache.resize(mRenderableCount);
+            mRenderableEntityInfo.clear();
+            mRenderableEntityInfo.reserve(mRenderableCount);
+            for (EntityInfo const& info : entityInfo) {
+                if (info.ri) {
+                    mRenderableEntityInfo[info.entity] = uint32_t(&info - entityInfo.data());
+                }
+            }
         }
 
-        if (li) {
-            // find the dominant directional light
-            if (UTILS_UNLIKELY(lcm.isDirectionalLight(li))) {
-                // we don't store the directional lights, because we only have a single one
-                if (lcm.getIntensity(li) >= maxIntensity) {
-                    maxIntensity = lcm.getIntensity(li);
-                    float3 d = lcm.getLocalDirection(li);
-                    // using mat3f::getTransformForNormals handles non-uniform scaling
-                    d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
-                    lightData.elementAt<FScene::POSITION_RADIUS>(0) =
-                            float4{ 0, 0, 0, std::numeric_limits<float>::infinity() };
-                    lightData.elementAt<FScene::DIRECTION>(0)       = d;
-                    lightData.elementAt<FScene::LIGHT_INSTANCE>(0)  = li;
+        if (updateAll) {
+            mRenderableCacheOrigin = origin;
+            mRenderableUBOInvalid = true;
+            auto gatherRenderables = [this, &cache, &origin,
+                    info = entityInfo.data()](uint32_t first, uint32_t count) {
+                for (EntityInfo const* p = info + first, * const last = p + count; p != last; ++p) {
+                    if (p->ri) {
+                        gatherRenderable(*p, cache, origin);
+                    }
                 }
+            };
+            auto jobGather = jobs::parallel_for(js, nullptr, 0, (uint32_t)entityInfo.size(),
+                    std::cref(gatherRenderables),
+                    jobs::CountSplitter<JOBS_PARALLEL_FOR_ENTITIES_COUNT, 8>());
+            js.runAndWait(jobGather);
+
+            if (mCullingHierarchy && mRenderableCount >= CULLING_BVH_MIN_RENDERABLES) {
+                mCullingBvh.build(cache.data<WORLD_AABB_CENTER>(),
+                        cache.data<WORLD_AABB_EXTENT>(), mRenderableCount);
             } else {
-                const float4 p = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
-                float3 d = 0;
-                if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
-                    d = lcm.getLocalDirection(li);
-                    // using mat3f::getTransformForNormals handles non-uniform scaling
-                    d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
+                mCullingBvh.clear();
+            }
+        } else {
+            SYSTRACE_NAME("update changed renderables");
+            // entities can appear several times in the journals, it's cheaper to update them
+            // again than to remove the duplicates.
+            auto const& map = mRenderableEntityInfo;
+            auto& dirtySlots = mDirtyRenderableUBOSlots;
+            size_t const firstDirtySlot = dirtySlots.size();
+            for (Slice<const Entity> changes : { transformChanges, renderableChanges }) {
+                for (Entity e : changes) {
+                    auto pos = map.find(e);
+                    if (pos != map.end()) {
+                        EntityInfo const& info = entityInfo[pos->second];
+                        gatherRenderable(info, cache, origin);
+                        dirtySlots.push_back(info.renderableIndex);
+                    }
                 }
-                lightData.push_back_unsafe(
-                        float4{ p.xyz, lcm.getRadius(li) }, d, li, {}, {}, {});
+            }
+            // the slots are also the rows of the cache
+            mCullingBvh.refit(cache.data<WORLD_AABB_CENTER>(), cache.data<WORLD_AABB_EXTENT>(),
+                    dirtySlots.data() + firstDirtySlot, dirtySlots.size() - firstDirtySlot);
+            if (UTILS_UNLIKELY(dirtySlots.size() > mRenderableCount)) {
+                // updateUBOs() wasn't called for a while
+                mRenderableUBOInvalid = true;
+                dirtySlots.clear();
+                copyAll = true;
+            } else {
+                changedRows = dirtySlots.data() + firstDirtySlot;
+                changedRowCount = dirtySlots.size() - firstDirtySlot;
             }
         }
+        mRenderableCacheTranslation = translation;
+        mCullingBvh.setTranslation(translation);
+
+        // finally copy the cache into the renderable data, which the views are free to reorder
+        auto copyRenderables = [&cache, &sceneData, translation]
+                (uint32_t first, uint32_t count) {
+            std::copy_n(cache.data<RENDERABLE_INSTANCE>() + first, count,
+                    sceneData.data<RENDERABLE_INSTANCE>() + first);
+            std::copy_n(cache.data<WORLD_TRANSFORM>() + first, count,
+                    sceneData.data<WORLD_TRANSFORM>() + first);
+            std::copy_n(cache.data<REVERSED_WINDING_ORDER>() + first, count,
+                    sceneData.data<REVERSED_WINDING_ORDER>() + first);
+            std::copy_n(cache.data<VISIBILITY_STATE>() + first, count,
+                    sceneData.data<VISIBILITY_STATE>() + first);
+            std::copy_n(cache.data<BONES_UBH>() + first, count,
+                    sceneData.data<BONES_UBH>() + first);
+            std::copy_n(cache.data<WORLD_AABB_CENTER>() + first, count,
+                    sceneData.data<WORLD_AABB_CENTER>() + first);
+            std::copy_n(cache.data<MORPH_WEIGHTS>() + first, count,
+                    sceneData.data<MORPH_WEIGHTS>() + first);
+            std::copy_n(cache.data<UBO_SLOT>() + first, count,
+                    sceneData.data<UBO_SLOT>() + first);
+            std::copy_n(cache.data<INSTANCES>() + first, count,
+                    sceneData.data<INSTANCES>() + first);
+            std::copy_n(cache.data<LAYERS>() + first, count,
+                    sceneData.data<LAYERS>() + first);
+            std::copy_n(cache.data<WORLD_AABB_EXTENT>() + first, count,
+                    sceneData.data<WORLD_AABB_EXTENT>() + first);
+            mat4f* const UTILS_RESTRICT worldTransforms = sceneData.data<WORLD_TRANSFORM>();
+            float3* const UTILS_RESTRICT centers = sceneData.data<WORLD_AABB_CENTER>();
+            for (size_t i = first, e = first + count; i < e; i++) {
+                worldTransforms[i][3].xyz += translation;
+                centers[i] += translation;
+            }
+        };
+
+        if (copyAll) {
+            auto jobCopy = jobs::parallel_for(js, nullptr, 0, mRenderableCount,
+                    std::cref(copyRenderables),
+                    jobs::CountSplitter<JOBS_PARALLEL_FOR_ENTITIES_COUNT * 8, 8>());
+            js.runAndWait(jobCopy);
+            mRenderableRowCopies = mRenderableCount;
+        } else {
+            SYSTRACE_NAME("copy changed renderables");
+            // The UBO_SLOT of a renderable is also its row in the cache, so the rows that a view
+            // reordered are the ones whose UBO_SLOT doesn't match. They're restored first, so
+            // that the rows that changed this frame are back in place.
+            std::atomic<uint32_t> movedRowCount{ 0 };
+            auto copyMovedRows = [&sceneData, &copyRenderables, &movedRowCount]
+                    (uint32_t first, uint32_t count) {
+                uint32_t const* const slots = sceneData.data<UBO_SLOT>();
+                uint32_t moved = 0;
+                for (uint32_t i = first, e = first + count; i < e; i++) {
+                    if (slots[i] != i) {
+                        copyRenderables(i, 1);
+                        moved++;
+                    }
+                }
+                movedRowCount.fetch_add(moved, std::memory_order_relaxed);
+            };
+            auto jobCopy = jobs::parallel_for(js, nullptr, 0, mRenderableCount,
+                    std::cref(copyMovedRows),
+                    jobs::CountSplitter<JOBS_PARALLEL_FOR_ENTITIES_COUNT * 8, 8>());
+            js.runAndWait(jobCopy);
+
+            for (size_t i = 0; i < changedRowCount; i++) {
+                copyRenderables(changedRows[i], 1);
+            }
+            mRenderableRowCopies = movedRowCount.load(std::memory_order_relaxed) +
+                    uint32_t(changedRowCount);
+        }
     }
 
+    // lights are not cached, there are usually few of them
+    auto gatherLights = [this, &lightData, &worldOriginTransform,
+            info = entityInfo.data(), indices = mLightEntityInfo.data()]
+            (uint32_t first, uint32_t count) {
+        for (uint32_t const* p = indices + first, * const last = p + count; p != last; ++p) {
+            if (!info[*p].directionalLight) {
+                gatherLight(info[*p], lightData, worldOriginTransform);
+            }
+        }
+    };
+
+    auto jobLights = jobs::parallel_for(js, nullptr, 0, (uint32_t)mLightEntityInfo.size(),
+            std::cref(gatherLights),
+            jobs::CountSplitter<JOBS_PARALLEL_FOR_ENTITIES_COUNT, 8>());
+    js.runAndWait(jobLights);
+
     // some elements past the end of the array will be accessed by SIMD code, we need to make
     // sure the data is valid enough as not to produce errors such as divide-by-zero
     // (e.g. in computeLightRanges())
     for (size_t i = lightData.size(), e = (lightData.size() + 3u) & ~3u; i < e; i++) {
         new(lightData.data<POSITION_RADIUS>() + i) float4{ 0, 0, 0, 1 };
     }
+
+    if (mCullingHierarchy && mLightCount - DIRECTIONAL_LIGHTS_COUNT >= CULLING_BVH_MIN_LIGHTS) {
+        updateLightCullingBvh(worldOriginTransform[3].xyz);
+    } else {
+        mLightCullingBvh.clear();
+    }
+}
+
+void FScene::updateLightCullingBvh(float3 const& translation) noexcept {
+    SYSTRACE_CALL();
+
+    size_t const count = mLightCount - DIRECTIONAL_LIGHTS_COUNT;
+    float4 const* const UTILS_RESTRICT spheres =
+            mLightData.data<POSITION_RADIUS>() + DIRECTIONAL_LIGHTS_COUNT;
+    auto& centers = mLightCenters;
+    auto& extents = mLightExtents;
+
+    if (mLightCullingBvh.size() != count) {
+        centers.resize(count);
+        extents.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            centers[i] = spheres[i].xyz - translation;
+            extents[i] = float3(spheres[i].w);
+        }
+        mLightCullingBvh.build(centers.data(), extents.data(), count);
+    } else {
+        // The rows of the lights follow the iteration order of mEntities, which only changes
+        // when entities are added or removed. The rows are compared by value, so a light that
+        // changed row is handled like a light that moved: this is slower, but never wrong.
+        // Static lights are skipped, refit() rebuilds the hierarchy if too many lights moved.
+        auto& moved = mMovedLights;
+        moved.clear();
+        for (size_t i = 0; i < count; i++) {
+            float3 const center = spheres[i].xyz - translation;
+            float3 const extent = float3(spheres[i].w);
+            if (center != centers[i] || extent != extents[i]) {
+                centers[i] = center;
+                extents[i] = extent;
+                moved.push_back(uint32_t(i));
+            }
+        }
+        mLightCullingBvh.refit(centers.data(), extents.data(), moved.data(), moved.size());
+    }
+    mLightCullingBvh.setTranslation(translation);
+}
+
+void FScene::gatherRenderable(EntityInfo const& info, RenderableSoa& soa,
+        mat4f const& worldOriginTransform) const noexcept {
+    FRenderableManager& rcm = mEngine.getRenderableManager();
+    FTransformManager const& tcm = mEngine.getTransformManager();
+    auto const ri = info.ri;
+
+    // get the world transform
+    const mat4f worldTransform = worldOriginTransform * tcm.getWorldTransform(info.ti);
+    const bool reversedWindingOrder = det(worldTransform.upperLeft()) < 0;
+
+    // compute the world AABB so we can perform culling, instanced renderables are culled as
+    // a whole first, and then per instance by the view.
+    FRenderableManager::Instances* const instances = rcm.getInstances(ri);
+    const Box worldAABB = rigidTransform(instances ? instances->bounds : rcm.getAABB(ri),
+            worldTransform);
+
+    // each entity owns its own row, so this is safe to do from multiple threads
+    const size_t i = info.renderableIndex;
+    soa.elementAt<RENDERABLE_INSTANCE>(i)       = ri;
+    soa.elementAt<WORLD_TRANSFORM>(i)           = worldTransform;
+    soa.elementAt<REVERSED_WINDING_ORDER>(i)    = reversedWindingOrder;
+    soa.elementAt<VISIBILITY_STATE>(i)          = rcm.getVisibility(ri);
+    soa.elementAt<BONES_UBH>(i)                 = rcm.getBonesUbh(ri);
+    soa.elementAt<WORLD_AABB_CENTER>(i)         = worldAABB.center;
+    soa.elementAt<VISIBLE_MASK>(i)              = 0;
+    soa.elementAt<MORPH_WEIGHTS>(i)             = rcm.getMorphWeights(ri);
+    soa.elementAt<UBO_SLOT>(i)                  = i;
+    soa.elementAt<INSTANCES>(i)                 = instances;
+    soa.elementAt<LAYERS>(i)                    = rcm.getLayerMask(ri);
+    soa.elementAt<WORLD_AABB_EXTENT>(i)         = worldAABB.halfExtent;
+    soa.elementAt<PRIMITIVES>(i)                = {};
+    soa.elementAt<SUMMED_PRIMITIVE_COUNT>(i)    = 0;
+}
+
+void FScene::gatherLight(EntityInfo const& info, LightSoa& soa,
+        mat4f const& worldOriginTransform) const noexcept {
+    FLightManager const& lcm = mEngine.getLightManager();
+    FTransformManager const& tcm = mEngine.getTransformManager();
+    auto const li = info.li;
+
+    // get the world transform
+    const mat4f worldTransform = worldOriginTransform * tcm.getWorldTransform(info.ti);
+
+    const float4 position = worldTransform * float4{ lcm.getLocalPosition(li), 1 };
+    float3 d = 0;
+    if (!lcm.isPointLight(li) || lcm.isIESLight(li)) {
+        d = lcm.getLocalDirection(li);
+        // using mat3f::getTransformForNormals handles non-uniform scaling
+        d = normalize(mat3f::getTransformForNormals(worldTransform.upperLeft()) * d);
+    }
+
+    // each entity owns its own row, so this is safe to do from multiple threads
+    const size_t i = info.lightIndex;
+    soa.elementAt<POSITION_RADIUS>(i)       = float4{ position.xyz, lcm.getRadius(li) };
+    soa.elementAt<DIRECTION>(i)             = d;
+    soa.elementAt<LIGHT_INSTANCE>(i)        = li;
+    soa.elementAt<VISIBILITY>(i)            = {};
+    soa.elementAt<SCREEN_SPACE_Z_RANGE>(i)  = {};
+    soa.elementAt<SHADOW_INFO>(i)           = {};
 }
 
 void FScene::updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept {
     FEngine::DriverApi& driver = mEngine.getDriverApi();
-    const size_t size = visibleRenderables.size() * sizeof(PerRenderableUib);
-
-    // allocate space into the command stream directly
-    void* const buffer = driver.allocate(size);
 
     bool hasContactShadows = false;
     auto& sceneData = mRenderableData;
-    for (uint32_t i : visibleRenderables) {
-        mat4f const& model = sceneData.elementAt<WORLD_TRANSFORM>(i);
-        const size_t offset = i * sizeof(PerRenderableUib);
-
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, worldFromModelMatrix), model);
-
-        // Using mat3f::getTransformForNormals handles non-uniform scaling, but DOESN'T guarantee that
-        // the transformed normals will have unit-length, therefore they need to be normalized
-        // in the shader (that's already the case anyways, since normalization is needed after
-        // interpolation).
-        //
-        // We pre-scale normals by the inverse of the largest scale factor to avoid
-        // large post-transform magnitudes in the shader, especially in the fragment shader, where
-        // we use medium precision.
-        //
-        // Note: if the model matrix is known to be a rigid-transform, we could just use it directly.
-
-        mat3f m = mat3f::getTransformForNormals(model.upperLeft());
-        m *= mat3f(1.0f / std::sqrt(max(float3{length2(m[0]), length2(m[1]), length2(m[2])})));
-
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, worldFromModelNormalMatrix), m);
-
-        // Note that we cast bools to uint32. Booleans are byte-sized in C++, but we need to
-        // initialize all 32 bits in the UBO field.
-
-        FRenderableManager::Visibility visibility = sceneData.elementAt<VISIBILITY_STATE>(i);
-        hasContactShadows = hasContactShadows || visibility.screenSpaceContactShadows;
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, skinningEnabled),
-                uint32_t(visibility.skinning));
-
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, morphingEnabled),
-                uint32_t(visibility.morphing));
-
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, screenSpaceContactShadows),
-                uint32_t(visibility.screenSpaceContactShadows));
-
-        UniformBuffer::setUniform(buffer,
-                offset + offsetof(PerRenderableUib, morphWeights),
-                sceneData.elementAt<MORPH_WEIGHTS>(i));
+
+    if (mIncrementalPreparation) {
+        // the renderables use their slot in our persistent UBO, renderableUbh is not used.
+        updatePersistentUBO(driver);
+        renderableUbh = mRenderableUbh;
+        for (uint32_t i : visibleRenderables) {
+            FRenderableManager::Visibility visibility = sceneData.elementAt<VISIBILITY_STATE>(i);
+            hasContactShadows = hasContactShadows || visibility.screenSpaceContactShadows;
+        }
+    } else {
+        const size_t size = (visibleRenderables.size() + RENDERABLE_UBO_PADDING) *
+                sizeof(PerRenderableUib);
+
+        // allocate space into the command stream directly
+        void* const buffer = driver.allocate(size);
+
+        // the padding is bound, but never read by the shaders
+        memset(static_cast<char*>(buffer) + visibleRenderables.size() * sizeof(PerRenderableUib),
+                0, RENDERABLE_UBO_PADDING * sizeof(PerRenderableUib));
+
+        for (uint32_t i : visibleRenderables) {
+            FRenderableManager::Visibility visibility = sceneData.elementAt<VISIBILITY_STATE>(i);
+            hasContactShadows = hasContactShadows || visibility.screenSpaceContactShadows;
+            sceneData.elementAt<UBO_SLOT>(i) = i;
+            setRenderableUniforms(buffer, i * sizeof(PerRenderableUib),
+                    sceneData.elementAt<WORLD_TRANSFORM>(i), visibility,
+                    sceneData.elementAt<MORPH_WEIGHTS>(i));
+        }
+
+        driver.loadUniformBuffer(renderableUbh, { buffer, size });
     }
 
     // TODO: handle static objects separately
     mHasContactShadows = hasContactShadows;
     mRenderableViewUbh = renderableUbh;
-    driver.loadUniformBuffer(renderableUbh, { buffer, size });
 
     if (mSkybox) {
         mSkybox->commit(driver);
     }
 }
 
+void FScene::updatePersistentUBO(backend::DriverApi& driver) noexcept {
+    SYSTRACE_CALL();
+
+    auto const& cache = mRenderableCache;
+    const uint32_t count = mRenderableCount;
+    const float3 translation = mRenderableCacheTranslation;
+
+    if (mRenderableUBOCount < count) {
+        // allocate 1/3 extra, with a minimum of 16 objects
+        mRenderableUBOCount = std::max(16u, (4u * count + 2u) / 3u);
+        if (mRenderableUbh) {
+            driver.destroyUniformBuffer(mRenderableUbh);
+        }
+        mRenderableUbh = driver.createUniformBuffer(
+                (mRenderableUBOCount + RENDERABLE_UBO_PADDING) * sizeof(PerRenderableUib),
+                backend::BufferUsage::DYNAMIC);
+        mRenderableUBOInvalid = true;
+
+        // the padding is bound, but never read by the shaders. We initialize it only once.
+        const size_t size = RENDERABLE_UBO_PADDING * sizeof(PerRenderableUib);
+        void* const buffer = driver.allocate(size);
+        memset(buffer, 0, size);
+        driver.updateUniformBuffer(mRenderableUbh, { buffer, size },
+                uint32_t(mRenderableUBOCount * sizeof(PerRenderableUib)));
+    }
+
+    // when the world origin moves, all the world transforms change
+    if (translation != mRenderableUBOTranslation) {
+        mRenderableUBOInvalid = true;
+    }
+
+    // uploads the slots [first, last) from the cache
+    RenderableUBOUpdates& updates = mRenderableUBOUpdates;
+    updates = {};
+    auto upload = [&driver, &cache, &updates, translation, ubh = mRenderableUbh](
+            uint32_t first, uint32_t last) {
+        updates.rangeCount++;
+        updates.renderableCount += last - first;
+        const size_t size = (last - first) * sizeof(PerRenderableUib);
+        // allocate space into the command stream directly
+        void* const buffer = driver.allocate(size);
+        for (uint32_t i = first; i < last; i++) {
+            mat4f model = cache.elementAt<WORLD_TRANSFORM>(i);
+            model[3].xyz += translation;
+            setRenderableUniforms(buffer, (i - first) * sizeof(PerRenderableUib),
+                    model, cache.elementAt<VISIBILITY_STATE>(i), cache.elementAt<MORPH_WEIGHTS>(i));
+        }
+        driver.updateUniformBuffer(ubh, { buffer, size }, uint32_t(first * sizeof(PerRenderableUib)));
+    };
+
+    auto& dirtySlots = mDirtyRenderableUBOSlots;
+    if (!mRenderableUBOInvalid && !dirtySlots.empty()) {
+        std::sort(dirtySlots.begin(), dirtySlots.end());
+        dirtySlots.erase(std::unique(dirtySlots.begin(), dirtySlots.end()), dirtySlots.end());
+
+        // each range of contiguous slots is a separate upload, past a point it's cheaper to
+        // upload everything at once.
+        size_t rangeCount = 1;
+        for (size_t i = 1, c = dirtySlots.size(); i < c; i++) {
+            rangeCount += (dirtySlots[i] != dirtySlots[i - 1] + 1) ? 1 : 0;
+        }
+        if (rangeCount > MAX_RENDERABLE_UBO_UPDATE_RANGES) {
+            mRenderableUBOInvalid = true;
+        } else {
+            auto first = dirtySlots.begin();
+            while (first != dirtySlots.end()) {
+                auto last = first + 1;
+                while (last != dirtySlots.end() && *last == *(last - 1) + 1) {
+                    ++last;
+                }
+                upload(*first, *(last - 1) + 1);
+                first = last;
+            }
+        }
+    }
+
+    if (mRenderableUBOInvalid && count) {
+        upload(0, count);
+        mRenderableUBOTranslation = translation;
+        mRenderableUBOInvalid = false;
+    }
+
+    dirtySlots.clear();
+}
+
+UTILS_ALWAYS_INLINE
+inline void FScene::setRenderableUniforms(void* buffer, size_t offset,
+        mat4f const& model, FRenderableManager::Visibility visibility,
+        float4 const& morphWeights) noexcept {
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, worldFromModelMatrix), model);
+
+    // Using mat3f::getTransformForNormals handles non-uniform scaling, but DOESN'T guarantee that
+    // the transformed normals will have unit-length, therefore they need to be normalized
+    // in the shader (that's already the case anyways, since normalization is needed after
+    // interpolation).
+    //
+    // We pre-scale normals by the inverse of the largest scale factor to avoid
+    // large post-transform magnitudes in the shader, especially in the fragment shader, where
+    // we use medium precision.
+    //
+    // Note: if the model matrix is known to be a rigid-transform, we could just use it directly.
+
+    mat3f m = mat3f::getTransformForNormals(model.upperLeft());
+    m *= mat3f(1.0f / std::sqrt(max(float3{length2(m[0]), length2(m[1]), length2(m[2])})));
+
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, worldFromModelNormalMatrix), m);
+
+    // Note that we cast bools to uint32. Booleans are byte-sized in C++, but we need to
+    // initialize all 32 bits in the UBO field.
+
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, skinningEnabled),
+            uint32_t(visibility.skinning));
+
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, morphingEnabled),
+            uint32_t(visibility.morphing));
+
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, screenSpaceContactShadows),
+            uint32_t(visibility.screenSpaceContactShadows));
+
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, instancingEnabled),
+            int32_t(visibility.instanced));
+
+    UniformBuffer::setUniform(buffer,
+            offset + offsetof(PerRenderableUib, morphWeights), morphWeights);
+}
+
 void FScene::terminate(FEngine& engine) {
     // DO NOT destroy this UBO, it's owned by the View
     mRenderableViewUbh.clear();
+    // but this one is ours
+    if (mRenderableUbh) {
+        engine.getDriverApi().destroyUniformBuffer(mRenderableUbh);
+        mRenderableUbh.clear();
+    }
 }
 
-void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootArena, backend::Handle<backend::HwUniformBuffer> lightUbh) noexcept {
+void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootArena, Froxelizer& froxelizer) noexcept {
     FEngine::DriverApi& driver = mEngine.getDriverApi();
     FLightManager& lcm = mEngine.getLightManager();
     FScene::LightSoa& lightData = getLightData();
 
     /*
      * Here we copy our lights data into the GPU buffer, some lights might be left out if there
-     * are more than the GPU buffer allows (i.e. 256).
+     * are more than the GPU buffer allows (i.e. 4096).
      *
      * We always sort lights by distance to the camera plane so that:
      * - we can build light trees
@@ -275,18 +762,21 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
     lightData.resize(std::min(size, CONFIG_MAX_LIGHT_COUNT + DIRECTIONAL_LIGHTS_COUNT));
 
     // number of point/spot lights
-    size_t positionalLightCount = size - DIRECTIONAL_LIGHTS_COUNT;
+    size_t positionalLightCount = lightData.size() - DIRECTIONAL_LIGHTS_COUNT;
 
     // compute the light ranges (needed when building light trees)
     float2* const zrange = lightData.data<FScene::SCREEN_SPACE_Z_RANGE>();
     computeLightRanges(zrange, camera, spheres + DIRECTIONAL_LIGHTS_COUNT, positionalLightCount);
 
-    LightsUib* const lp = driver.allocatePod<LightsUib>(positionalLightCount);
+    // the light buffer is updated by whole rows
+    const size_t gpuLightCount =
+            (positionalLightCount + LIGHTS_PER_ROW - 1) / LIGHTS_PER_ROW * LIGHTS_PER_ROW;
+    LightsUib* const lp = driver.allocatePod<LightsUib>(gpuLightCount);
 
     auto const* UTILS_RESTRICT directions       = lightData.data<FScene::DIRECTION>();
     auto const* UTILS_RESTRICT instances        = lightData.data<FScene::LIGHT_INSTANCE>();
     auto const* UTILS_RESTRICT shadowInfo       = lightData.data<FScene::SHADOW_INFO>();
-    for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = size; i < c; ++i) {
+    for (size_t i = DIRECTIONAL_LIGHTS_COUNT, c = lightData.size(); i < c; ++i) {
         const size_t gpuIndex = i - DIRECTIONAL_LIGHTS_COUNT;
         auto li = instances[i];
         lp[gpuIndex].positionFalloff      = { spheres[i].xyz, lcm.getSquaredFalloffInv(li) };
@@ -297,7 +787,7 @@ void FScene::prepareDynamicLights(const CameraInfo& camera, ArenaScope& rootAren
         lp[gpuIndex].type                 = lcm.isPointLight(li) ? 0u : 1u;
     }
 
-    driver.loadUniformBuffer(lightUbh, { lp, positionalLightCount * sizeof(LightsUib) });
+    froxelizer.commitLights(driver, lp, lp + gpuLightCount);
 }
 
 // These methods need to exist so clang honors the __restrict__ keyword, which in turn
@@ -354,14 +844,17 @@ inline void FScene::computeLightRanges(
 
 void FScene::addEntity(Entity entity) {
     mEntities.insert(entity);
+    mEntitiesChanged = true;
 }
 
 void FScene::addEntities(const Entity* entities, size_t count) {
     mEntities.insert(entities, entities + count);
+    mEntitiesChanged = true;
 }
 
 void FScene::remove(Entity entity) {
     mEntities.erase(entity);
+    mEntitiesChanged = true;
 }
 
 size_t FScene::getRenderableCount() const noexcept {
@@ -392,6 +885,36 @@ bool FScene::hasEntity(Entity entity) const noexcept {
     return mEntities.find(entity) != mEntities.end();
 }
 
+void FScene::setIncrementalPreparationEnabled(bool enabled) noexcept {
+    if (mIncrementalPreparation != enabled) {
+        mIncrementalPreparation = enabled;
+        mEntitiesChanged = true;
+        if (!enabled) {
+            mRenderableCache.clear();
+            mRenderableEntityInfo.clear();
+            mDirtyRenderableUBOSlots.clear();
+            mCullingBvh.clear();
+            if (mRenderableUbh) {
+                mEngine.getDriverApi().destroyUniformBuffer(mRenderableUbh);
+                mRenderableUbh.clear();
+                mRenderableUBOCount = 0;
+            }
+        }
+    }
+}
+
+void FScene::setCullingHierarchyEnabled(bool enabled) noexcept {
+    if (mCullingHierarchy != enabled) {
+        mCullingHierarchy = enabled;
+        // the hierarchy is built when all renderables are updated
+        mEntitiesChanged = true;
+        if (!enabled) {
+            mCullingBvh.clear();
+            mLightCullingBvh.clear();
+        }
+    }
+}
+
 void FScene::setSkybox(FSkybox* skybox) noexcept {
     std::swap(mSkybox, skybox);
     if (skybox) {
@@ -458,4 +981,20 @@ bool Scene::hasEntity(Entity entity) const noexcept {
     return upcast(this)->hasEntity(entity);
 }
 
+void Scene::setIncrementalPreparationEnabled(bool enabled) noexcept {
+    upcast(this)->setIncrementalPreparationEnabled(enabled);
+}
+
+bool Scene::isIncrementalPreparationEnabled() const noexcept {
+    return upcast(this)->isIncrementalPreparationEnabled();
+}
+
+void Scene::setCullingHierarchyEnabled(bool enabled) noexcept {
+    upcast(this)->setCullingHierarchyEnabled(enabled);
+}
+
+bool Scene::isCullingHierarchyEnabled() const noexcept {
+    return upcast(this)->isCullingHierarchyEnabled();
+}
+
 } // namespace filament
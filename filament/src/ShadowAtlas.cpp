@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/ShadowAtlas.h"
+
+#include <assert.h>
+
+namespace filament {
+
+uint32_t ShadowAtlas::getLayerDimension(uint32_t dimension) noexcept {
+    constexpr uint32_t mask = (1u << MAX_LEVEL) - 1u;
+    return (dimension + mask) & ~mask;
+}
+
+uint8_t ShadowAtlas::getLevel(uint32_t layerDimension, uint32_t size) noexcept {
+    uint8_t level = 0;
+    while (level < MAX_LEVEL && (layerDimension >> (level + 1u)) >= size) {
+        level++;
+    }
+    return level;
+}
+
+void ShadowAtlas::reset(uint32_t layerDimension, uint8_t firstLayer) noexcept {
+    assert(layerDimension == getLayerDimension(layerDimension));
+    mDimension = layerDimension;
+    mCursor = 0;
+    mLayer = firstLayer;
+    mLevel = 0;
+}
+
+ShadowAtlas::Tile ShadowAtlas::allocate(uint8_t level) noexcept {
+    assert(level >= mLevel && level <= MAX_LEVEL);
+    mLevel = level;
+
+    // the cursor is always aligned to the size of the tile, since the tiles before were larger
+    uint32_t const count = 1u << (2u * (MAX_LEVEL - level));
+    if (mCursor + count > TILES_PER_LAYER) {
+        mCursor = 0;
+        mLayer++;
+    }
+
+    uint32_t x = 0;
+    uint32_t y = 0;
+    for (uint32_t i = 0; i < MAX_LEVEL; i++) {
+        x |= ((mCursor >> (2u * i)) & 1u) << i;
+        y |= ((mCursor >> (2u * i + 1u)) & 1u) << i;
+    }
+    mCursor += count;
+
+    uint32_t const unit = mDimension >> MAX_LEVEL;
+    return { mLayer, x * unit, y * unit, mDimension >> level };
+}
+
+} // namespace filament
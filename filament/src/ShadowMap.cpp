@@ -28,6 +28,9 @@
 
 #include <backend/DriverEnums.h>
 
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
 #include <limits>
 
 using namespace filament::math;
@@ -70,15 +73,16 @@ ShadowMap::~ShadowMap() {
 }
 
 void ShadowMap::render(DriverApi& driver, Handle<HwRenderTarget> rt,
-        filament::Viewport const& viewport, FView::Range const& range, RenderPass& pass, FView& view) noexcept {
+        filament::Viewport const& viewport, FView::Range const& range, RenderPass& pass, FView& view,
+        bool clear) noexcept {
     FEngine& engine = mEngine;
 
     FScene& scene = *view.getScene();
 
     // FIXME: in the future this will come from the framegraph
     RenderPassParams params = {};
-    params.flags.clear = TargetBufferFlags::DEPTH;
-    params.flags.discardStart = TargetBufferFlags::DEPTH;
+    params.flags.clear = clear ? TargetBufferFlags::DEPTH : TargetBufferFlags::NONE;
+    params.flags.discardStart = clear ? TargetBufferFlags::DEPTH : TargetBufferFlags::NONE;
     params.flags.discardEnd = TargetBufferFlags::COLOR0 | TargetBufferFlags::STENCIL;
     params.clearDepth = 1.0;
     params.viewport = viewport;
@@ -101,7 +105,8 @@ void ShadowMap::render(DriverApi& driver, Handle<HwRenderTarget> rt,
     pass.execute("Shadow map Pass", rt, params);
 }
 
-void ShadowMap::computeSceneCascadeParams(const FScene::LightSoa& lightData, size_t index,
+void ShadowMap::computeSceneCascadeParams(JobSystem& js,
+        const FScene::LightSoa& lightData, size_t index,
         FScene const* scene, filament::CameraInfo const& camera, uint8_t visibleLayers,
         CascadeParameters& cascadeParams) {
     // Compute the light's model matrix.
@@ -112,30 +117,7 @@ void ShadowMap::computeSceneCascadeParams(const FScene::LightSoa& lightData, siz
     const mat4f V = camera.view;
 
     // Compute scene bounds in world space, as well as the light-space and view-space near/far planes
-    cascadeParams.lsNearFar = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
-    cascadeParams.vsNearFar = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
-    cascadeParams.wsShadowCastersVolume = {};
-    cascadeParams.wsShadowReceiversVolume = {};
-    visitScene(*scene, visibleLayers,
-            [&](Aabb caster) {
-                cascadeParams.wsShadowCastersVolume.min =
-                        min(cascadeParams.wsShadowCastersVolume.min, caster.min);
-                cascadeParams.wsShadowCastersVolume.max =
-                        max(cascadeParams.wsShadowCastersVolume.max, caster.max);
-                float2 nf = computeNearFar(Mv, caster);
-                cascadeParams.lsNearFar.x = std::max(cascadeParams.lsNearFar.x, nf.x);  // near
-                cascadeParams.lsNearFar.y = std::min(cascadeParams.lsNearFar.y, nf.y);  // far
-            },
-            [&](Aabb receiver) {
-                cascadeParams.wsShadowReceiversVolume.min =
-                        min(cascadeParams.wsShadowReceiversVolume.min, receiver.min);
-                cascadeParams.wsShadowReceiversVolume.max =
-                        max(cascadeParams.wsShadowReceiversVolume.max, receiver.max);
-                float2 nf = computeNearFar(V, receiver);
-                cascadeParams.vsNearFar.x = std::max(cascadeParams.vsNearFar.x, nf.x);
-                cascadeParams.vsNearFar.y = std::min(cascadeParams.vsNearFar.y, nf.y);
-            }
-    );
+    visitScene(js, *scene, visibleLayers, Mv, V, cascadeParams);
 }
 
 void ShadowMap::update(const FScene::LightSoa& lightData, size_t index, FScene const* scene,
@@ -587,12 +569,13 @@ mat4f ShadowMap::getTextureCoordsMapping() const noexcept {
             0, 0, 0, 1
     });
 
-    // apply the 1-texel border viewport transform
-    const float o = 1.0f / mShadowMapLayout.atlasDimension;
+    // apply the 1-texel border viewport transform, and move the texture to its place in the atlas
+    const float2 o = float2(mShadowMapLayout.offset + 1u) /
+            float(mShadowMapLayout.atlasDimension);
     const float s = 1.0f - 2.0f * (1.0f / mShadowMapLayout.textureDimension);
     const mat4f Mb(mat4f::row_major_init{
-             s, 0, 0, o,
-             0, s, 0, o,
+             s, 0, 0, o.x,
+             0, s, 0, o.y,
              0, 0, 1, 0,
              0, 0, 0, 1
     });
@@ -631,12 +614,6 @@ math::mat4f ShadowMap::directionalLightFrustum(float near, float far) noexcept {
     return m;
 }
 
-float2 ShadowMap::computeNearFar(const mat4f& view,
-        Aabb const& wsShadowCastersVolume) noexcept {
-    const Aabb::Corners wsSceneCastersCorners = wsShadowCastersVolume.getCorners();
-    return computeNearFar(view, wsSceneCastersCorners.data(), wsSceneCastersCorners.size());
-}
-
 float2 ShadowMap::computeNearFar(const mat4f& view,
         float3 const* wsVertices, size_t count) noexcept {
     float2 nearFar = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
@@ -1027,28 +1004,117 @@ float ShadowMap::texelSizeWorldSpace(const mat4f& Wp, const mat4f& MbMtF) const
 }
 
 
-template<typename Casters, typename Receivers>
-void ShadowMap::visitScene(const FScene& scene, uint32_t visibleLayers,
-        Casters casters, Receivers receivers) noexcept {
+void ShadowMap::visitScene(JobSystem& js, FScene const& scene, uint32_t visibleLayers,
+        mat4f const& Mv, mat4f const& V, CascadeParameters& cascadeParams) noexcept {
+    SYSTRACE_CALL();
+
+    // the renderables are split in a fixed number of chunks, each one is reduced separately
+    constexpr size_t CHUNK_COUNT = 16;
+    constexpr size_t PARALLEL_VISIT_MIN_RENDERABLES = 1024;
+
+    const size_t count = scene.getRenderableData().size();
+    if (count < PARALLEL_VISIT_MIN_RENDERABLES) {
+        visitScene(scene, visibleLayers, Mv, V, cascadeParams, 0, count);
+        return;
+    }
+
+    CascadeParameters chunks[CHUNK_COUNT];
+    const size_t chunkSize = (count + CHUNK_COUNT - 1) / CHUNK_COUNT;
+    auto work = [&](uint32_t start, uint32_t n) {
+        for (size_t i = start, e = start + n; i < e; i++) {
+            const size_t first = std::min(i * chunkSize, count);
+            visitScene(scene, visibleLayers, Mv, V, chunks[i],
+                    first, std::min(first + chunkSize, count));
+        }
+    };
+    auto job = jobs::parallel_for(js, nullptr, 0, CHUNK_COUNT,
+            std::cref(work), jobs::CountSplitter<1, 4>());
+    js.runAndWait(job);
+
+    CascadeParameters& out = cascadeParams;
+    out.wsShadowCastersVolume = {};
+    out.wsShadowReceiversVolume = {};
+    out.lsNearFar = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
+    out.vsNearFar = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::max() };
+    for (CascadeParameters const& chunk : chunks) {
+        out.wsShadowCastersVolume.min = min(out.wsShadowCastersVolume.min,
+                chunk.wsShadowCastersVolume.min);
+        out.wsShadowCastersVolume.max = max(out.wsShadowCastersVolume.max,
+                chunk.wsShadowCastersVolume.max);
+        out.wsShadowReceiversVolume.min = min(out.wsShadowReceiversVolume.min,
+                chunk.wsShadowReceiversVolume.min);
+        out.wsShadowReceiversVolume.max = max(out.wsShadowReceiversVolume.max,
+                chunk.wsShadowReceiversVolume.max);
+        out.lsNearFar = { std::max(out.lsNearFar.x, chunk.lsNearFar.x),
+                          std::min(out.lsNearFar.y, chunk.lsNearFar.y) };
+        out.vsNearFar = { std::max(out.vsNearFar.x, chunk.vsNearFar.x),
+                          std::min(out.vsNearFar.y, chunk.vsNearFar.y) };
+    }
+}
+
+void ShadowMap::visitScene(FScene const& scene, uint32_t visibleLayers,
+        mat4f const& Mv, mat4f const& V, CascadeParameters& cascadeParams,
+        size_t first, size_t last) noexcept {
     using State = FRenderableManager::Visibility;
     FScene::RenderableSoa const& UTILS_RESTRICT soa = scene.getRenderableData();
     float3 const* const UTILS_RESTRICT worldAABBCenter = soa.data<FScene::WORLD_AABB_CENTER>();
     float3 const* const UTILS_RESTRICT worldAABBExtent = soa.data<FScene::WORLD_AABB_EXTENT>();
     uint8_t const* const UTILS_RESTRICT layers = soa.data<FScene::LAYERS>();
     State const* const UTILS_RESTRICT visibility = soa.data<FScene::VISIBILITY_STATE>();
-    size_t c = soa.size();
-    for (size_t i = 0; i < c; i++) {
-        if (layers[i] & visibleLayers) {
-            const Aabb aabb{ worldAABBCenter[i] - worldAABBExtent[i],
-                             worldAABBCenter[i] + worldAABBExtent[i] };
-            if (visibility[i].castShadows) {
-                casters(aabb);
-            }
-            if (visibility[i].receiveShadows) {
-                receivers(aabb);
-            }
-        }
+
+    // Mv and V are affine transforms, so the z range of a box's corners is its center's z plus or
+    // minus the projection of its extent; there is no need to transform the corners.
+    const float3 lz = { Mv[0].z, Mv[1].z, Mv[2].z };
+    const float3 vz = { V[0].z, V[1].z, V[2].z };
+    const float3 lzAbs = abs(lz);
+    const float3 vzAbs = abs(vz);
+
+    constexpr float lowest = std::numeric_limits<float>::lowest();
+    constexpr float highest = std::numeric_limits<float>::max();
+    float3 castersMin(highest), castersMax(lowest);
+    float3 receiversMin(highest), receiversMax(lowest);
+    float2 lsNearFar = { lowest, highest };
+    float2 vsNearFar = { lowest, highest };
+
+    // This loop is written without branches, renderables that aren't casters or receivers
+    // contribute empty bounds instead.
+    for (size_t i = first; i < last; i++) {
+        const float3 c = worldAABBCenter[i];
+        const float3 e = worldAABBExtent[i];
+        const bool visible = (layers[i] & visibleLayers) != 0;
+        const bool caster = visible && visibility[i].castShadows;
+        const bool receiver = visible && visibility[i].receiveShadows;
+
+        const float3 lo = c - e;
+        const float3 hi = c + e;
+        const float3 cmin = caster ? lo : float3(highest);
+        const float3 cmax = caster ? hi : float3(lowest);
+        const float3 rmin = receiver ? lo : float3(highest);
+        const float3 rmax = receiver ? hi : float3(lowest);
+        castersMin = { std::min(castersMin.x, cmin.x), std::min(castersMin.y, cmin.y),
+                       std::min(castersMin.z, cmin.z) };
+        castersMax = { std::max(castersMax.x, cmax.x), std::max(castersMax.y, cmax.y),
+                       std::max(castersMax.z, cmax.z) };
+        receiversMin = { std::min(receiversMin.x, rmin.x), std::min(receiversMin.y, rmin.y),
+                         std::min(receiversMin.z, rmin.z) };
+        receiversMax = { std::max(receiversMax.x, rmax.x), std::max(receiversMax.y, rmax.y),
+                         std::max(receiversMax.z, rmax.z) };
+
+        // we're on the z axis in light space (looking down to -z), near is the largest z
+        const float lc = dot(lz, c) + Mv[3].z;
+        const float lr = dot(lzAbs, e);
+        const float vc = dot(vz, c) + V[3].z;
+        const float vr = dot(vzAbs, e);
+        lsNearFar.x = std::max(lsNearFar.x, caster ? lc + lr : lowest);
+        lsNearFar.y = std::min(lsNearFar.y, caster ? lc - lr : highest);
+        vsNearFar.x = std::max(vsNearFar.x, receiver ? vc + vr : lowest);
+        vsNearFar.y = std::min(vsNearFar.y, receiver ? vc - vr : highest);
     }
+
+    cascadeParams.wsShadowCastersVolume = { castersMin, castersMax };
+    cascadeParams.wsShadowReceiversVolume = { receiversMin, receiversMax };
+    cascadeParams.lsNearFar = lsNearFar;
+    cascadeParams.vsNearFar = vsNearFar;
 }
 
 } // namespace filament
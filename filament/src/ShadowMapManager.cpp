@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 
+#include "details/RenderPrimitive.h"
+#include "details/ShadowAtlas.h"
 #include "details/ShadowMap.h"
 #include "details/ShadowMapManager.h"
 #include "details/View.h"
@@ -22,12 +24,20 @@
 
 #include <private/filament/SibGenerator.h>
 
+#include <utils/Hash.h>
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+
 namespace filament {
 
 using namespace backend;
 using namespace math;
+using namespace utils;
 
 ShadowMapManager::ShadowMapManager(FEngine& engine) : mTextureState(0, 0) {
+    mCullingShadowMap = std::make_unique<ShadowMap>(engine);
     for (size_t i = 0; i < mCascadeShadowMapCache.size(); i++) {
         mCascadeShadowMapCache[i] = std::make_unique<ShadowMap>(engine);
     }
@@ -39,6 +49,8 @@ ShadowMapManager::ShadowMapManager(FEngine& engine) : mTextureState(0, 0) {
             &engine.debug.shadowmap.visualize_cascades);
     debugRegistry.registerProperty("d.shadowmap.tightly_bound_scene",
             &engine.debug.shadowmap.tightly_bound_scene);
+    debugRegistry.registerProperty("d.shadowmap.parallel_update",
+            &engine.debug.shadowmap.parallel_update);
 }
 
 ShadowMapManager::~ShadowMapManager() {
@@ -59,36 +71,65 @@ void ShadowMapManager::prepare(FEngine& engine, DriverApi& driver, SamplerGroup&
         return std::max(3u, lcm.getShadowMapSize(light));
     };
 
-    // Lay out the shadow maps. For now, we take the largest requested dimension and allocate a
-    // texture of that size. Each cascade / shadow map gets its own layer in the array texture.
-    // The directional shadow cascades start on layer 0, followed by spot lights.
-    uint8_t layer = 0;
+    if (mCascadeShadowMaps.empty() && mSpotShadowMaps.empty()) {
+        return;
+    }
+
+    // Lay out the shadow maps. We take the largest requested dimension and allocate a texture
+    // of that size. Each cascade gets its own layer in the array texture, starting on layer 0.
+    // The spot light shadow maps are packed in the following layers, see ShadowAtlas.
     uint32_t maxDimension = 0;
+    for (auto const& cascade : mCascadeShadowMaps) {
+        maxDimension = std::max(maxDimension, getShadowMapSize(cascade.getLightIndex()));
+    }
+    for (auto const& spotShadowMap : mSpotShadowMaps) {
+        maxDimension = std::max(maxDimension, getShadowMapSize(spotShadowMap.getLightIndex()));
+    }
+    const uint32_t dim = ShadowAtlas::getLayerDimension(maxDimension);
+
+    uint8_t layer = 0;
     for (auto& cascade : mCascadeShadowMaps) {
         // Shadow map size should be the same for all cascades.
-        const uint32_t dim = getShadowMapSize(cascade.getLightIndex());
-        maxDimension = std::max(maxDimension, dim);
         cascade.setLayout({
             .layer = layer++,
-            .size = dim
-        });
-    }
-    for (auto& spotShadowMap : mSpotShadowMaps) {
-        uint32_t dim = getShadowMapSize(spotShadowMap.getLightIndex());
-        maxDimension = std::max(maxDimension, dim);
-        spotShadowMap.setLayout({
-            .layer = layer++,
-            .size = dim
+            .size = getShadowMapSize(cascade.getLightIndex())
         });
     }
 
-    const uint16_t layersNeeded = layer;
-    const uint32_t dim = maxDimension;
+    // Spot lights get the resolution they asked for, which is halved each time their screen size
+    // is halved below half the viewport's height. The largest shadow maps are laid out first.
+    const size_t spotCount = mSpotShadowMaps.size();
+    uint8_t levels[CONFIG_MAX_SHADOW_CASTING_SPOTS];
+    uint8_t order[CONFIG_MAX_SHADOW_CASTING_SPOTS];
+    for (size_t i = 0; i < spotCount; i++) {
+        auto const& entry = mSpotShadowMaps[i];
+        uint8_t level = ShadowAtlas::getLevel(dim, getShadowMapSize(entry.getLightIndex()));
+        const float screenSize = entry.getScreenSize();
+        for (float s = 0.5f; level < ShadowAtlas::MAX_LEVEL && screenSize < s; s *= 0.5f) {
+            level++;
+        }
+        // The minimum size is 3 texels, as we require a 1 texel border.
+        levels[i] = std::min(level, ShadowAtlas::getLevel(dim, 3u));
+        order[i] = uint8_t(i);
+    }
+    std::stable_sort(order, order + spotCount, [&levels](uint8_t lhs, uint8_t rhs) {
+        return levels[lhs] < levels[rhs];
+    });
 
-    if (layersNeeded == 0) {
-        return;
+    ShadowAtlas atlas;
+    atlas.reset(dim, layer);
+    for (size_t i = 0; i < spotCount; i++) {
+        const ShadowAtlas::Tile tile = atlas.allocate(levels[order[i]]);
+        mSpotShadowMaps[order[i]].setLayout({
+            .layer = tile.layer,
+            .x = tile.x,
+            .y = tile.y,
+            .size = tile.size
+        });
     }
 
+    const uint16_t layersNeeded = atlas.getLayerCount();
+
     // If we already have a texture with the same dimensions and layer count, there's no need to
     // create a new one.
     const TextureState newState(dim, layersNeeded);
@@ -127,7 +168,13 @@ bool ShadowMapManager::update(FEngine& engine, FView& view, UniformBuffer& perVi
         UniformBuffer& shadowUb, FScene::RenderableSoa& renderableData,
         FScene::LightSoa& lightData) noexcept {
     bool hasShadowing = false;
-    hasShadowing |= updateCascadeShadowMaps(engine, view, perViewUb, renderableData, lightData);
+    prepareCascadeShadowMaps(engine, view, perViewUb, renderableData, lightData);
+
+    // The cameras of the shadow maps are independent from each other, so they're computed
+    // concurrently. Culling and uniforms are done afterwards, since they write to shared data.
+    updateShadowMapCameras(engine, view, lightData);
+
+    hasShadowing |= updateCascadeShadowMaps(engine, perViewUb, lightData);
     hasShadowing |= updateSpotShadowMaps(engine, view, shadowUb, renderableData, lightData);
     return hasShadowing;
 }
@@ -144,10 +191,10 @@ void ShadowMapManager::setShadowCascades(size_t lightIndex, size_t cascades) noe
     }
 }
 
-void ShadowMapManager::addSpotShadowMap(size_t lightIndex) noexcept {
+void ShadowMapManager::addSpotShadowMap(size_t lightIndex, float screenSize) noexcept {
     const size_t maps = mSpotShadowMaps.size();
     assert(maps < CONFIG_MAX_SHADOW_CASTING_SPOTS);
-    mSpotShadowMaps.emplace_back(mSpotShadowMapCache[maps].get(), lightIndex);
+    mSpotShadowMaps.emplace_back(mSpotShadowMapCache[maps].get(), lightIndex, screenSize);
 }
 
 void ShadowMapManager::render(FEngine& engine, FView& view, backend::DriverApi& driver,
@@ -155,11 +202,11 @@ void ShadowMapManager::render(FEngine& engine, FView& view, backend::DriverApi&
     if (UTILS_UNLIKELY(engine.debug.shadowmap.checkerboard)) {
         // TODO: eventually this will be handled as a optional pass in the framegraph
         fillWithDebugPattern(driver, mShadowMapTexture);
+        mSpotShadowCache.clear();
         return;
     }
 
-    size_t currentRt = 0;
-    for (size_t i = 0; i < mCascadeShadowMaps.size(); i++, currentRt++) {
+    for (size_t i = 0; i < mCascadeShadowMaps.size(); i++) {
         const auto& map = mCascadeShadowMaps[i];
         if (!map.hasVisibleShadows()) {
             continue;
@@ -167,16 +214,52 @@ void ShadowMapManager::render(FEngine& engine, FView& view, backend::DriverApi&
 
         const uint32_t dim = map.getLayout().size;
         filament::Viewport viewport{1, 1, dim - 2, dim - 2};
-        map.getShadowMap()->render(driver, mRenderTargets[currentRt],
+        map.getShadowMap()->render(driver, mRenderTargets[map.getLayout().layer],
                 viewport, view.getVisibleDirectionalShadowCasters(), pass, view);
     }
     assert(mShadowMapTexture);
-    for (size_t i = 0; i < mSpotShadowMaps.size(); i++, currentRt++) {
+
+    // Spot shadow maps share the layers of the texture. A layer is rendered only if one of its
+    // shadow maps changed since it was last rendered; then all of them are rendered again, since
+    // the whole layer is cleared.
+    const size_t spotCount = mSpotShadowMaps.size();
+    SpotShadowState states[CONFIG_MAX_SHADOW_CASTING_SPOTS];
+    bool cacheable[CONFIG_MAX_SHADOW_CASTING_SPOTS];
+    uint32_t dirtyLayers = 0;
+    for (size_t i = 0; i < spotCount; i++) {
         const auto& map = mSpotShadowMaps[i];
         if (!map.hasVisibleShadows()) {
             continue;
         }
-        const uint32_t dim = map.getLayout().size;
+        const ShadowMap& shadowMap = *map.getShadowMap();
+        states[i] = {
+                .projection = shadowMap.getCamera().getProjectionMatrix(),
+                .layout = map.getLayout(),
+                .polygonOffset = shadowMap.getPolygonOffset()
+        };
+        cacheable[i] = getSpotShadowCasters(view, i, states[i].casters);
+        if (!cacheable[i] || std::find(mSpotShadowCache.begin(), mSpotShadowCache.end(),
+                states[i]) == mSpotShadowCache.end()) {
+            dirtyLayers |= 1u << map.getLayout().layer;
+        }
+    }
+
+    // forget about the shadow maps of the layers that are about to be cleared
+    mSpotShadowCache.erase(std::remove_if(mSpotShadowCache.begin(), mSpotShadowCache.end(),
+            [dirtyLayers](SpotShadowState const& state) {
+                return dirtyLayers & (1u << state.layout.layer);
+            }), mSpotShadowCache.end());
+
+    uint32_t clearedLayers = 0;
+    for (size_t i = 0; i < spotCount; i++) {
+        const auto& map = mSpotShadowMaps[i];
+        const ShadowLayout& layout = map.getLayout();
+        if (!map.hasVisibleShadows() || !(dirtyLayers & (1u << layout.layer))) {
+            continue;
+        }
+        const bool clear = !(clearedLayers & (1u << layout.layer));
+        clearedLayers |= 1u << layout.layer;
+
         // we set a viewport with a 1-texel border for when we index outside of the texture
         // DON'T CHANGE this unless ShadowMap::getTextureCoordsMapping() is updated too.
         // see: ShadowMap::getTextureCoordsMapping()
@@ -184,47 +267,107 @@ void ShadowMapManager::render(FEngine& engine, FView& view, backend::DriverApi&
         // clamping in the shadow shader (see sampleDepth inside shadowing.fs). Unfortunately, the APIs
         // don't seem let us clear depth attachments to anything greater than 1.0, so we'd need a way to
         // do this other than clearing.
-        filament::Viewport viewport {1, 1, dim - 2, dim - 2};
+        filament::Viewport viewport {
+                int32_t(layout.x + 1), int32_t(layout.y + 1), layout.size - 2, layout.size - 2 };
         pass.setVisibilityMask(VISIBLE_SPOT_SHADOW_CASTER_N(i));
-        map.getShadowMap()->render(driver, mRenderTargets[currentRt], viewport,
-                view.getVisibleSpotShadowCasters(), pass, view);
+        map.getShadowMap()->render(driver, mRenderTargets[layout.layer], viewport,
+                view.getVisibleSpotShadowCasters(), pass, view, clear);
         pass.clearVisibilityMask();
+
+        if (cacheable[i]) {
+            mSpotShadowCache.push_back(states[i]);
+        }
+    }
+}
+
+bool ShadowMapManager::getSpotShadowCasters(FView const& view, size_t i,
+        uint64_t& signature) noexcept {
+    FScene::RenderableSoa const& soa = view.getScene()->getRenderableData();
+    FView::Range const& range = view.getVisibleSpotShadowCasters();
+    auto const* const UTILS_RESTRICT instances = soa.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* const UTILS_RESTRICT transforms = soa.data<FScene::WORLD_TRANSFORM>();
+    auto const* const UTILS_RESTRICT bones = soa.data<FScene::BONES_UBH>();
+    auto const* const UTILS_RESTRICT inst = soa.data<FScene::INSTANCES>();
+    auto const* const UTILS_RESTRICT morphWeights = soa.data<FScene::MORPH_WEIGHTS>();
+    auto const* const UTILS_RESTRICT visibleMasks = soa.data<FScene::VISIBLE_MASK>();
+    auto const* const UTILS_RESTRICT primitives = soa.data<FScene::PRIMITIVES>();
+    const uint8_t mask = VISIBLE_SPOT_SHADOW_CASTER_N(i);
+
+    // the hashes of the casters are summed, so that their order doesn't matter
+    uint64_t sum = 0;
+    for (uint32_t j = range.first; j < range.last; j++) {
+        if (!(visibleMasks[j] & mask)) {
+            continue;
+        }
+        if (bones[j] || inst[j]) {
+            return false;
+        }
+        const struct {
+            uint32_t instance;
+            mat4f transform;
+            float4 morphWeights;
+        } caster = { instances[j].asValue(), transforms[j], morphWeights[j] };
+        const uint32_t* const words = reinterpret_cast<const uint32_t*>(&caster);
+        const size_t count = sizeof(caster) / sizeof(uint32_t);
+        uint32_t h0 = hash::murmur3(words, count, 0);
+        uint32_t h1 = hash::murmur3(words, count, 1);
+
+        // the geometry and material instances of the current level-of-detail
+        for (FRenderPrimitive const& primitive : primitives[j]) {
+            const struct {
+                uint32_t handle;
+                uint32_t reserved;
+                uint64_t materialInstance;
+            } p = { primitive.getHwHandle().getId(), 0,
+                    uint64_t(uintptr_t(primitive.getMaterialInstance())) };
+            const uint32_t* const pwords = reinterpret_cast<const uint32_t*>(&p);
+            const size_t pcount = sizeof(p) / sizeof(uint32_t);
+            h0 = hash::murmur3(pwords, pcount, h0);
+            h1 = hash::murmur3(pwords, pcount, h1);
+        }
+        sum += (uint64_t(h0) << 32u) | h1;
     }
+    signature = sum;
+    return true;
+}
+
+ShadowMap::ShadowMapLayout ShadowMapManager::getShadowMapLayout(
+        ShadowMapEntry const& entry) const noexcept {
+    const ShadowLayout& layout = entry.getLayout();
+    return {
+            .zResolution = mTextureZResolution,
+            .atlasDimension = mTextureState.size,
+            .textureDimension = layout.size,
+            .shadowDimension = layout.size - 2,
+            .offset = { layout.x, layout.y }
+    };
 }
 
-bool ShadowMapManager::updateCascadeShadowMaps(FEngine& engine, FView& view,
+void ShadowMapManager::prepareCascadeShadowMaps(FEngine& engine, FView& view,
             UniformBuffer& perViewUb, FScene::RenderableSoa& renderableData,
             FScene::LightSoa& lightData) noexcept {
-    bool hasShadowing = false;
-
     FScene* scene = view.getScene();
     const CameraInfo& viewingCameraInfo = view.getCameraInfo();
     uint8_t visibleLayers = view.getVisibleLayers();
-    const uint16_t textureSize = mTextureState.size;
     auto& lcm = engine.getLightManager();
 
-    ShadowMap::CascadeParameters cascadeParams;
+    ShadowMap::CascadeParameters& cascadeParams = mCascadeParams;
+    cascadeParams = {};
 
     if (mCascadeShadowMaps.size() > 0) {
         // Compute scene-dependent values shared across all cascades.
-        ShadowMap::computeSceneCascadeParams(lightData, 0, scene, viewingCameraInfo, visibleLayers,
-                cascadeParams);
+        ShadowMap::computeSceneCascadeParams(engine.getJobSystem(), lightData, 0, scene,
+                viewingCameraInfo, visibleLayers, cascadeParams);
 
         // Even if we have more than one cascade, we cull directional shadow casters against the
-        // entire camera frustum, as if we only had a single cascade.
-        ShadowMap& map = *mCascadeShadowMaps[0].getShadowMap();
-        const size_t textureDimension = mCascadeShadowMaps[0].getLayout().size;
-        const ShadowMap::ShadowMapLayout layout {
-                .zResolution = mTextureZResolution,
-                .atlasDimension = textureSize,
-                .textureDimension = textureDimension,
-                .shadowDimension = textureDimension - 2
-        };
+        // entire camera frustum, as if we only had a single cascade. This uses its own shadow
+        // map, the cascades are updated afterwards by updateShadowMapCameras().
+        ShadowMap& map = *mCullingShadowMap;
         map.update(lightData, 0, scene, viewingCameraInfo, visibleLayers,
-                layout, cascadeParams);
+                getShadowMapLayout(mCascadeShadowMaps[0]), cascadeParams);
         Frustum const& frustum = map.getCamera().getFrustum();
         FView::cullRenderables(engine.getJobSystem(), renderableData, frustum,
-                VISIBLE_DIR_SHADOW_CASTER_BIT);
+                VISIBLE_DIR_SHADOW_CASTER_BIT, scene->getCullingBvh());
 
         // Set shadowBias, using the first directional cascade.
         const float texelSizeWorldSpace = map.getTexelSizeWorldSpace();
@@ -264,32 +407,72 @@ bool ShadowMapManager::updateCascadeShadowMaps(FEngine& engine, FView& view,
     std::fill_n(&wsSplitPositionUniform[0], 4, -std::numeric_limits<float>::infinity());
     std::copy(splits.beginWs() + 1, splits.endWs(), &wsSplitPositionUniform[0]);
 
-    float csSplitPosition[CONFIG_MAX_SHADOW_CASCADES + 1];
-    std::copy(splits.beginCs(), splits.endCs(), csSplitPosition);
-
     // Update cascade split uniform.
     perViewUb.setUniform(offsetof(PerViewUib, cascadeSplits), wsSplitPositionUniform);
+}
+
+void ShadowMapManager::updateShadowMapCameras(FEngine& engine, FView& view,
+        FScene::LightSoa& lightData) noexcept {
+    SYSTRACE_CALL();
+
+    FScene const* scene = view.getScene();
+    const CameraInfo& viewingCameraInfo = view.getCameraInfo();
+    const uint8_t visibleLayers = view.getVisibleLayers();
+    const size_t cascadeCount = mCascadeShadowMaps.size();
+    const size_t count = cascadeCount + mSpotShadowMaps.size();
+
+    float csSplitPosition[CONFIG_MAX_SHADOW_CASCADES + 1];
+    std::copy(mCascadeSplits.beginCs(), mCascadeSplits.endCs(), csSplitPosition);
+
+    // the cascades come first, followed by the spot lights
+    auto work = [&](uint32_t start, uint32_t n) {
+        for (size_t i = start, e = start + n; i < e; i++) {
+            if (i < cascadeCount) {
+                auto& entry = mCascadeShadowMaps[i];
+                assert(entry.getLightIndex() == 0);
+                ShadowMap::CascadeParameters cascadeParams = mCascadeParams;
+                cascadeParams.csNearFar = { csSplitPosition[i], csSplitPosition[i + 1] };
+                entry.getShadowMap()->update(lightData, 0, scene, viewingCameraInfo,
+                        visibleLayers, getShadowMapLayout(entry), cascadeParams);
+            } else {
+                auto& entry = mSpotShadowMaps[i - cascadeCount];
+                entry.getShadowMap()->update(lightData, entry.getLightIndex(), scene,
+                        viewingCameraInfo, visibleLayers, getShadowMapLayout(entry), {});
+            }
+        }
+    };
+
+    // The first call to ShadowMap::update() initializes the engine's debug near/far hints, the
+    // following ones only read them. With cascades, this call was made for culling already,
+    // otherwise the first shadow map is updated here, and only once.
+    uint32_t first = 0;
+    if (cascadeCount == 0 && count > 0) {
+        work(0, 1);
+        first = 1;
+    }
+
+    if (UTILS_UNLIKELY(!engine.debug.shadowmap.parallel_update)) {
+        work(first, uint32_t(count - first));
+        return;
+    }
+
+    JobSystem& js = engine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, first, uint32_t(count - first),
+            std::cref(work), jobs::CountSplitter<1, 4>());
+    js.runAndWait(job);
+}
+
+bool ShadowMapManager::updateCascadeShadowMaps(FEngine& engine,
+            UniformBuffer& perViewUb, FScene::LightSoa& lightData) noexcept {
+    bool hasShadowing = false;
+    auto& lcm = engine.getLightManager();
 
     uint32_t directionalShadows = 0;
     uint32_t cascadeHasVisibleShadows = 0;
     float screenSpaceShadowDistance = 0.0;
     for (size_t i = 0; i < mCascadeShadowMaps.size(); i++) {
         auto& entry = mCascadeShadowMaps[i];
-
-        // Compute the frustum for the directional light.
         ShadowMap& shadowMap = *entry.getShadowMap();
-        UTILS_UNUSED_IN_RELEASE size_t l = entry.getLightIndex();
-        assert(l == 0);
-
-        const size_t textureDimension = entry.getLayout().size;
-        const ShadowMap::ShadowMapLayout layout{
-                .zResolution = mTextureZResolution,
-                .atlasDimension = textureSize,
-                .textureDimension = textureDimension,
-                .shadowDimension = textureDimension - 2
-        };
-        cascadeParams.csNearFar = { csSplitPosition[i], csSplitPosition[i + 1] };
-        shadowMap.update(lightData, 0, scene, viewingCameraInfo, visibleLayers, layout, cascadeParams);
         if (shadowMap.hasVisibleShadows()) {
             entry.setHasVisibleShadows(true);
 
@@ -332,29 +515,15 @@ bool ShadowMapManager::updateSpotShadowMaps(FEngine& engine, FView& view, Unifor
     bool hasShadowing = false;
 
     FScene* scene = view.getScene();
-    const CameraInfo& viewingCameraInfo = view.getCameraInfo();
-    uint8_t visibleLayers = view.getVisibleLayers();
-    const uint16_t textureSize = mTextureState.size;
 
     // shadow-map shadows for point/spot lights
     auto& lcm = engine.getLightManager();
     FScene::ShadowInfo* const shadowInfo = lightData.data<FScene::SHADOW_INFO>();
     for (size_t i = 0, c = mSpotShadowMaps.size(); i < c; i++) {
         auto& entry = mSpotShadowMaps[i];
-
-        // compute the frustum for this light
         ShadowMap& shadowMap = *entry.getShadowMap();
         size_t l = entry.getLightIndex();
 
-        const size_t textureDimension = entry.getLayout().size;
-        const ShadowMap::ShadowMapLayout layout{
-                .zResolution = mTextureZResolution,
-                .atlasDimension = textureSize,
-                .textureDimension = textureDimension,
-                .shadowDimension = textureDimension - 2
-        };
-        shadowMap.update(lightData, l, scene, viewingCameraInfo, visibleLayers, layout, {});
-
         FLightManager::Instance light = lightData.elementAt<FScene::LIGHT_INSTANCE>(l);
         if (shadowMap.hasVisibleShadows()) {
             entry.setHasVisibleShadows(true);
@@ -363,7 +532,7 @@ bool ShadowMapManager::updateSpotShadowMaps(FEngine& engine, FView& view, Unifor
             UniformBuffer& u = shadowUb;
             Frustum const& frustum = shadowMap.getCamera().getFrustum();
             FView::cullRenderables(engine.getJobSystem(), renderableData, frustum,
-                    VISIBLE_SPOT_SHADOW_CASTER_N_BIT(i));
+                    VISIBLE_SPOT_SHADOW_CASTER_N_BIT(i), scene->getCullingBvh());
 
             mat4f const& lightFromWorldMatrix = shadowMap.getLightSpaceMatrix();
             u.setUniform(offsetof(ShadowUib, spotLightFromWorldMatrix) +
@@ -424,6 +593,7 @@ void ShadowMapManager::destroyResources(DriverApi& driver) noexcept {
     if (mShadowMapTexture) {
         driver.destroyTexture(mShadowMapTexture);
     }
+    mSpotShadowCache.clear();
 }
 
 ShadowMapManager::CascadeSplits::CascadeSplits(Params p) : mSplitCount(p.cascadeCount + 1) {
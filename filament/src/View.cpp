@@ -39,6 +39,9 @@
 #include <math/scalar.h>
 #include <math/fast.h>
 
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <memory>
 #include <filament/View.h>
 
@@ -73,7 +76,6 @@ FView::FView(FEngine& engine)
 
     // allocate ubos
     mPerViewUbh = driver.createUniformBuffer(mPerViewUb.getSize(), backend::BufferUsage::DYNAMIC);
-    mLightUbh = driver.createUniformBuffer(CONFIG_MAX_LIGHT_COUNT * sizeof(LightsUib), backend::BufferUsage::DYNAMIC);
     mShadowUbh = driver.createUniformBuffer(mShadowUb.getSize(), backend::BufferUsage::DYNAMIC);
 
     mIsDynamicResolutionSupported = driver.isFrameTimeSupported();
@@ -87,7 +89,6 @@ void FView::terminate(FEngine& engine) {
     // Here we would cleanly free resources we've allocated or we own (currently none).
     DriverApi& driver = engine.getDriverApi();
     driver.destroyUniformBuffer(mPerViewUbh);
-    driver.destroyUniformBuffer(mLightUbh);
     driver.destroyUniformBuffer(mShadowUbh);
     driver.destroySamplerGroup(mPerViewSbh);
     driver.destroyUniformBuffer(mRenderableUbh);
@@ -242,7 +243,8 @@ void FView::prepareShadowing(FEngine& engine, backend::DriverApi& driver,
             continue;
         }
 
-        mShadowMapManager.addSpotShadowMap(l);
+        float4 const& sphere = lightData.elementAt<FScene::POSITION_RADIUS>(l);
+        mShadowMapManager.addSpotShadowMap(l, getScreenSize(sphere.xyz, { sphere.w, 0, 0 }));
 
         shadowCastingSpotCount++;
         if (shadowCastingSpotCount > CONFIG_MAX_SHADOW_CASTING_SPOTS - 1) {
@@ -265,7 +267,7 @@ void FView::prepareLighting(FEngine& engine, FEngine::DriverApi& driver, ArenaSc
     const CameraInfo& camera = mViewingCameraInfo;
     FScene* const scene = mScene;
 
-    scene->prepareDynamicLights(camera, arena, mLightUbh);
+    scene->prepareDynamicLights(camera, arena, mFroxelizer);
 
     // here the array of visible lights has been shrunk to CONFIG_MAX_LIGHT_COUNT
     auto const& lightData = scene->getLightData();
@@ -390,24 +392,39 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
     // is set
     mViewingCameraInfo = CameraInfo(*camera, worldOriginScene);
 
-    mCullingFrustum = FCamera::getFrustum(
-            mCullingCamera->getCullingProjectionMatrix(),
-            FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix()));
+    mat4 const cullingProjection = mCullingCamera->getCullingProjectionMatrix();
+    mat4f const cullingView =
+            FCamera::getViewMatrix(worldOriginScene * mCullingCamera->getModelMatrix());
+    mat4f const cullingViewProjection = mat4f(cullingProjection) * cullingView;
+    mCullingFrustum = FCamera::getFrustum(cullingProjection, cullingView);
+
+    // used to compute the screen size of renderables, see getScreenSize()
+    mScreenSizeDepth = { cullingViewProjection[0].w, cullingViewProjection[1].w,
+                         cullingViewProjection[2].w, cullingViewProjection[3].w };
+    mScreenSizeScale = float(cullingProjection[1][1]);
 
     /*
      * Gather all information needed to render this scene. Apply the world origin to all
      * objects in the scene.
      */
-    scene->prepare(worldOriginScene);
+    scene->prepare(js, worldOriginScene);
+
+    // forget the levels of detail of the renderables that have been destroyed
+    if (UTILS_UNLIKELY(!mLevelsOfDetail.empty())) {
+        FRenderableManager const& rcm = engine.getRenderableManager();
+        for (auto it = mLevelsOfDetail.begin(); it != mLevelsOfDetail.end();) {
+            it = rcm.hasComponent(it->first) ? std::next(it) : mLevelsOfDetail.erase(it);
+        }
+    }
 
     /*
      * Light culling: runs in parallel with Renderable culling (below)
      */
 
     auto *prepareVisibleLightsJob = js.runAndRetain(js.createJob(nullptr,
-            [&frustum = mCullingFrustum, &engine, scene](JobSystem& js, JobSystem::Job*) {
-                FView::prepareVisibleLights(
-                        engine.getLightManager(), js, frustum, scene->getLightData());
+            [this, &frustum = mCullingFrustum, &engine, scene](JobSystem& js, JobSystem::Job*) {
+                prepareVisibleLights(engine.getLightManager(), js, frustum,
+                        scene->getLightData(), scene->getLightCullingBvh());
             }));
 
     Range merged;
@@ -423,8 +440,29 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
          * (this will set the VISIBLE_RENDERABLE bit)
          */
 
-        prepareVisibleRenderables(js, mCullingFrustum, renderableData);
+        prepareVisibleRenderables(js, mCullingFrustum, renderableData, scene->getCullingBvh());
+
+        /*
+         * Occlusion culling: clears the VISIBLE_RENDERABLE bit of renderables hidden by the
+         * occluders, it must run after frustum culling which selects the occluders
+         */
+
+        cullOccludedRenderables(js, engine.getRenderableManager(),
+                cullingViewProjection, viewport, renderableData);
+
+        /*
+         * Small feature culling: clears the VISIBLE_RENDERABLE bit of renderables smaller
+         * than a few pixels
+         */
 
+        cullSmallRenderables(viewport, renderableData);
+
+        /*
+         * Instance culling: instanced renderables are culled per instance, it must run last
+         * because only the instances of the visible renderables are culled
+         */
+
+        cullInstances(driver, engine.getRenderableManager(), renderableData);
 
         /*
          * Shadowing: compute the shadow camera and cull shadow casters
@@ -480,20 +518,27 @@ void FView::prepare(FEngine& engine, backend::DriverApi& driver, ArenaScope& are
         merged = Range{ 0, iSpotLightCastersEnd };
 
         // update those UBOs
-        const size_t size = merged.size() * sizeof(PerRenderableUib);
-        if (size) {
-            if (mRenderableUBOSize < size) {
-                // allocate 1/3 extra, with a minimum of 16 objects
-                const size_t count = std::max(size_t(16u), (4u * merged.size() + 2u) / 3u);
-                mRenderableUBOSize = uint32_t(count * sizeof(PerRenderableUib));
-                driver.destroyUniformBuffer(mRenderableUbh);
-                mRenderableUbh = driver.createUniformBuffer(mRenderableUBOSize,
-                        backend::BufferUsage::STREAM);
+        const size_t size =
+                (merged.size() + FScene::RENDERABLE_UBO_PADDING) * sizeof(PerRenderableUib);
+        if (!merged.empty()) {
+            if (scene->isIncrementalPreparationEnabled()) {
+                // the scene uses its own persistent UBO in that case
+                scene->updateUBOs(merged, {});
             } else {
-                // TODO: should we shrink the underlying UBO at some point?
+                if (mRenderableUBOSize < size) {
+                    // allocate 1/3 extra, with a minimum of 16 objects
+                    const size_t count = std::max(size_t(16u), (4u * merged.size() + 2u) / 3u) +
+                            FScene::RENDERABLE_UBO_PADDING;
+                    mRenderableUBOSize = uint32_t(count * sizeof(PerRenderableUib));
+                    driver.destroyUniformBuffer(mRenderableUbh);
+                    mRenderableUbh = driver.createUniformBuffer(mRenderableUBOSize,
+                            backend::BufferUsage::STREAM);
+                } else {
+                    // TODO: should we shrink the underlying UBO at some point?
+                }
+                assert(mRenderableUbh);
+                scene->updateUBOs(merged, mRenderableUbh);
             }
-            assert(mRenderableUbh);
-            scene->updateUBOs(merged, mRenderableUbh);
         }
     }
 
@@ -696,18 +741,196 @@ void FView::commitFroxels(backend::DriverApi& driverApi) const noexcept {
 
 UTILS_NOINLINE
 void FView::prepareVisibleRenderables(JobSystem& js,
-        Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept {
+        Frustum const& frustum, FScene::RenderableSoa& renderableData,
+        CullingBvh const* bvh) const noexcept {
     SYSTRACE_CALL();
     if (UTILS_LIKELY(isFrustumCullingEnabled())) {
-        FView::cullRenderables(js, renderableData, frustum, VISIBLE_RENDERABLE_BIT);
+        FView::cullRenderables(js, renderableData, frustum, VISIBLE_RENDERABLE_BIT, bvh);
     } else {
         std::uninitialized_fill(renderableData.begin<FScene::VISIBLE_MASK>(),
                   renderableData.end<FScene::VISIBLE_MASK>(), VISIBLE_RENDERABLE);
     }
 }
 
+void FView::cullOccludedRenderables(JobSystem& js, FRenderableManager const& rcm,
+        mat4f const& viewProjection, filament::Viewport const& viewport,
+        FScene::RenderableSoa& renderableData) noexcept {
+    OcclusionCullingStatistics stats{};
+    if (!mOcclusionCullingOptions.enabled || !viewport.width || !viewport.height) {
+        mOcclusionCullingStatistics = stats;
+        return;
+    }
+
+    SYSTRACE_CALL();
+    auto const start = std::chrono::steady_clock::now();
+
+    // the depth buffer has the aspect ratio of the viewport
+    uint32_t const width = mOcclusionCullingOptions.resolution;
+    uint32_t const height = std::min(std::max(1u,
+            uint32_t(float(width) * float(viewport.height) / float(viewport.width) + 0.5f)),
+            uint32_t(1024));
+
+    auto const* UTILS_RESTRICT instances      = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* UTILS_RESTRICT worldTransform = renderableData.data<FScene::WORLD_TRANSFORM>();
+    auto const* UTILS_RESTRICT centers        = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    auto const* UTILS_RESTRICT extents        = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    auto const* UTILS_RESTRICT visibility     = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto const* UTILS_RESTRICT layers         = renderableData.data<FScene::LAYERS>();
+    auto      * UTILS_RESTRICT visibleMask    = renderableData.data<FScene::VISIBLE_MASK>();
+    uint8_t const visibleLayers = getVisibleLayers();
+
+    // the occluders of the renderables visible from the camera are rasterized
+    OcclusionCuller& culler = mOcclusionCuller;
+    culler.begin(viewProjection, width, height);
+    for (size_t i = 0, c = renderableData.size(); i < c; i++) {
+        bool const visible = (!visibility[i].culling || (visibleMask[i] & VISIBLE_RENDERABLE))
+                && (layers[i] & visibleLayers);
+        if (visible) {
+            FRenderableManager::Occluder const* const occluder = rcm.getOccluder(instances[i]);
+            if (occluder) {
+                culler.addOccluder(worldTransform[i], occluder->vertices.data(),
+                        occluder->indices.data(), occluder->indices.size());
+            }
+        }
+    }
+    stats.occluderCount = uint32_t(culler.getOccluderCount());
+
+    if (stats.occluderCount) {
+        culler.rasterize(js);
+
+        // renderables are tested in parallel, each job handles its own rows
+        std::atomic<uint32_t> testedCount{ 0 };
+        std::atomic<uint32_t> culledCount{ 0 };
+        auto work = [&](uint32_t first, uint32_t count) {
+            uint32_t tested = 0;
+            uint32_t culled = 0;
+            for (uint32_t i = first, e = first + count; i < e; i++) {
+                if ((visibleMask[i] & VISIBLE_RENDERABLE) && visibility[i].culling
+                        && (layers[i] & visibleLayers)) {
+                    tested++;
+                    if (culler.isOccluded(centers[i], extents[i])) {
+                        visibleMask[i] &= ~VISIBLE_RENDERABLE;
+                        culled++;
+                    }
+                }
+            }
+            testedCount.fetch_add(tested, std::memory_order_relaxed);
+            culledCount.fetch_add(culled, std::memory_order_relaxed);
+        };
+        auto job = jobs::parallel_for(js, nullptr, 0, (uint32_t)renderableData.size(),
+                std::cref(work), jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>());
+        js.runAndWait(job);
+
+        stats.testedCount = testedCount.load(std::memory_order_relaxed);
+        stats.culledCount = culledCount.load(std::memory_order_relaxed);
+    }
+
+    stats.cpuTime = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - start).count();
+    mOcclusionCullingStatistics = stats;
+}
+
+void FView::cullSmallRenderables(filament::Viewport const& viewport,
+        FScene::RenderableSoa& renderableData) const noexcept {
+    if (mLevelOfDetailOptions.smallFeatureCulling <= 0.0f || !viewport.height) {
+        return;
+    }
+
+    SYSTRACE_CALL();
+
+    float const minScreenSize = mLevelOfDetailOptions.smallFeatureCulling / float(viewport.height);
+    auto const* UTILS_RESTRICT centers    = renderableData.data<FScene::WORLD_AABB_CENTER>();
+    auto const* UTILS_RESTRICT extents    = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+    auto const* UTILS_RESTRICT visibility = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto      * UTILS_RESTRICT visibleMask = renderableData.data<FScene::VISIBLE_MASK>();
+    for (size_t i = 0, c = renderableData.size(); i < c; i++) {
+        if ((visibleMask[i] & VISIBLE_RENDERABLE) && visibility[i].culling &&
+                getScreenSize(centers[i], extents[i]) < minScreenSize) {
+            visibleMask[i] &= ~VISIBLE_RENDERABLE;
+        }
+    }
+}
+
+void FView::cullInstances(DriverApi& driver, FRenderableManager const& rcm,
+        FScene::RenderableSoa& renderableData) noexcept {
+    auto const* UTILS_RESTRICT instances      = renderableData.data<FScene::INSTANCES>();
+    auto const* UTILS_RESTRICT ri             = renderableData.data<FScene::RENDERABLE_INSTANCE>();
+    auto const* UTILS_RESTRICT worldTransform = renderableData.data<FScene::WORLD_TRANSFORM>();
+    auto const* UTILS_RESTRICT visibility     = renderableData.data<FScene::VISIBILITY_STATE>();
+    auto const* UTILS_RESTRICT layers         = renderableData.data<FScene::LAYERS>();
+    auto      * UTILS_RESTRICT visibleMask    = renderableData.data<FScene::VISIBLE_MASK>();
+    bool const frustumCulling = isFrustumCullingEnabled();
+    uint8_t const visibleLayers = getVisibleLayers();
+
+    for (size_t i = 0, c = renderableData.size(); i < c; i++) {
+        if (UTILS_LIKELY(!instances[i])) {
+            continue;
+        }
+        // this runs before computeVisibilityMasks(), so the layers and the renderables that
+        // aren't frustum culled are handled here as well
+        bool const visible = (layers[i] & visibleLayers) &&
+                (!visibility[i].culling || (visibleMask[i] & VISIBLE_RENDERABLE));
+        if (!visible) {
+            continue;
+        }
+
+        FRenderableManager::Instances& inst = *instances[i];
+        size_t const count = inst.count;
+        auto& results = mInstanceVisibility;
+        results.assign(Culler::round(count), 0);
+        if (frustumCulling && visibility[i].culling) {
+            // the bounding box of the renderable is the one of a single instance
+            Box const aabb = rcm.getAABB(ri[i]);
+            mInstanceCenters.resize(Culler::round(count));
+            mInstanceExtents.resize(Culler::round(count));
+            for (size_t k = 0; k < count; k++) {
+                Box const box = rigidTransform(aabb, worldTransform[i] * inst.transforms[k]);
+                mInstanceCenters[k] = box.center;
+                mInstanceExtents[k] = box.halfExtent;
+            }
+            Culler::intersects(results.data(), mCullingFrustum,
+                    mInstanceCenters.data(), mInstanceExtents.data(), count, 0);
+        } else {
+            std::fill_n(results.begin(), count, 1);
+        }
+
+        // the visible instances keep their index, so getInstanceIndex() is stable
+        auto const* UTILS_RESTRICT src =
+                static_cast<PerRenderableUibInstance const*>(inst.uniforms.getBuffer());
+        auto* UTILS_RESTRICT dst =
+                static_cast<PerRenderableUibInstance*>(inst.visibleUniforms.invalidate());
+        uint32_t visibleCount = 0;
+        for (size_t k = 0; k < count; k++) {
+            if (results[k]) {
+                dst[visibleCount++] = src[k];
+            }
+        }
+        inst.visibleCount = visibleCount;
+
+        if (visibleCount) {
+            driver.loadUniformBuffer(inst.visibleHandle, inst.visibleUniforms.toBufferDescriptor(
+                    driver, 0, visibleCount * sizeof(PerRenderableUibInstance)));
+        } else {
+            visibleMask[i] &= ~VISIBLE_RENDERABLE;
+        }
+    }
+}
+
+float FView::getScreenSize(float3 const& center, float3 const& extent) const noexcept {
+    // w is the distance along the view direction, or 1 with orthographic projections
+    float const w = dot(mScreenSizeDepth.xyz, center) + mScreenSizeDepth.w;
+    return w > 0.0f ? length(extent) * mScreenSizeScale / w : std::numeric_limits<float>::infinity();
+}
+
 void FView::cullRenderables(JobSystem& js,
-        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit) noexcept {
+        FScene::RenderableSoa& renderableData, Frustum const& frustum, size_t bit,
+        CullingBvh const* bvh) noexcept {
+
+    if (bvh) {
+        assert(bvh->size() == renderableData.size());
+        bvh->cull(js, renderableData.data<FScene::VISIBLE_MASK>(), frustum, bit);
+        return;
+    }
 
     float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
     float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
@@ -729,8 +952,8 @@ void FView::cullRenderables(JobSystem& js,
     js.runAndWait(job);
 }
 
-void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
-        Frustum const& frustum, FScene::LightSoa& lightData) noexcept {
+void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem& js,
+        Frustum const& frustum, FScene::LightSoa& lightData, CullingBvh const* bvh) noexcept {
     SYSTRACE_CALL();
 
     auto const* UTILS_RESTRICT sphereArray     = lightData.data<FScene::POSITION_RADIUS>();
@@ -738,7 +961,20 @@ void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
     auto const* UTILS_RESTRICT instanceArray   = lightData.data<FScene::LIGHT_INSTANCE>();
     auto      * UTILS_RESTRICT visibleArray    = lightData.data<FScene::VISIBILITY>();
 
-    Culler::intersects(visibleArray, frustum, sphereArray, lightData.size());
+    if (bvh) {
+        // the hierarchy tests the bounding boxes of the lights, the spheres of the lights that
+        // pass are tested below, so that the result is the same as with a linear sweep
+        assert(bvh->size() == lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT);
+        std::fill_n(visibleArray, lightData.size(), 0);
+        bvh->cull(js, visibleArray + FScene::DIRECTIONAL_LIGHTS_COUNT, frustum, 0);
+        for (size_t i = FScene::DIRECTIONAL_LIGHTS_COUNT; i < lightData.size(); i++) {
+            if (visibleArray[i]) {
+                visibleArray[i] = Culler::intersects(frustum, sphereArray[i]);
+            }
+        }
+    } else {
+        Culler::intersects(visibleArray, frustum, sphereArray, lightData.size());
+    }
 
     const float4* const UTILS_RESTRICT planes = frustum.getNormalizedPlanes();
     // the directional light is considered visible
@@ -775,6 +1011,24 @@ void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
         }
     }
 
+    if (visibleLightCount - FScene::DIRECTIONAL_LIGHTS_COUNT > CONFIG_MAX_LIGHT_COUNT) {
+        // too many lights, keep the ones that cover the most of the screen. The lights that
+        // aren't visible are never selected, since more than enough of them are visible.
+        SYSTRACE_NAME("selectVisibleLights");
+        size_t const count = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+        mLightScreenSizes.resize(count);
+        float* const UTILS_RESTRICT screenSizes = mLightScreenSizes.data();
+        for (size_t i = 0; i < count; i++) {
+            float4 const sphere = sphereArray[i + FScene::DIRECTIONAL_LIGHTS_COUNT];
+            screenSizes[i] = visibleArray[i + FScene::DIRECTIONAL_LIGHTS_COUNT] ?
+                    getScreenSize(sphere.xyz, { sphere.w, 0, 0 }) :
+                    -std::numeric_limits<float>::infinity();
+        }
+        selectLargest(screenSizes, count, CONFIG_MAX_LIGHT_COUNT,
+                visibleArray + FScene::DIRECTIONAL_LIGHTS_COUNT, mSortedLightScreenSizes);
+        visibleLightCount = FScene::DIRECTIONAL_LIGHTS_COUNT + CONFIG_MAX_LIGHT_COUNT;
+    }
+
     // Partition array such that all visible lights appear first
     UTILS_UNUSED_IN_RELEASE auto last =
             std::partition(lightData.begin() + FScene::DIRECTIONAL_LIGHTS_COUNT, lightData.end(),
@@ -786,12 +1040,65 @@ void FView::prepareVisibleLights(FLightManager const& lcm, utils::JobSystem&,
     lightData.resize(visibleLightCount);
 }
 
+void FView::selectLargest(float const* sizes, size_t count, size_t maxCount,
+        uint8_t* selected, std::vector<float>& scratch) noexcept {
+    if (count <= maxCount) {
+        std::fill_n(selected, count, 1);
+        return;
+    }
+
+    // This is a partial sort of the sizes, which is cheaper than sorting them.
+    scratch.assign(sizes, sizes + count);
+    auto const nth = scratch.begin() + maxCount - 1;
+    std::nth_element(scratch.begin(), nth, scratch.end(), std::greater<float>());
+    float const threshold = *nth;
+
+    // sizes equal to the threshold are selected in order until there is no more room
+    size_t equalCount = maxCount - size_t(std::count_if(scratch.begin(), nth,
+            [threshold](float size) { return size > threshold; }));
+    for (size_t i = 0; i < count; i++) {
+        float const size = sizes[i];
+        bool const keep = size > threshold || (size == threshold && equalCount);
+        equalCount -= (size == threshold && keep) ? 1 : 0;
+        selected[i] = keep;
+    }
+}
+
+uint8_t FView::selectLevelOfDetail(FRenderableManager::LevelOfDetail const& lod,
+        uint8_t level, float screenSize, float hysteresis) noexcept {
+    level = std::min(level, uint8_t(lod.count - 1));
+    while (level + 1 < lod.count && screenSize < lod.screenSizes[level + 1] * (1.0f - hysteresis)) {
+        level++;
+    }
+    while (level > 0 && screenSize > lod.screenSizes[level] * (1.0f + hysteresis)) {
+        level--;
+    }
+    return level;
+}
+
 void FView::updatePrimitivesLod(FEngine& engine, const CameraInfo&,
         FScene::RenderableSoa& renderableData, Range visible) noexcept {
+    SYSTRACE_CALL();
+
+    // Levels are always selected from the culling camera's point of view, rather than from the
+    // camera of the pass, so that shadow casters use the same geometry as in the color pass.
     FRenderableManager const& rcm = engine.getRenderableManager();
+    int const bias = mLevelOfDetailOptions.bias;
+    float const hysteresis = mLevelOfDetailOptions.hysteresis;
     for (uint32_t index : visible) {
-        uint8_t level = 0; // TODO: pick the proper level of detail
+        uint8_t level = 0;
         auto ri = renderableData.elementAt<FScene::RENDERABLE_INSTANCE>(index);
+        FRenderableManager::LevelOfDetail const* const lod = rcm.getLevelOfDetail(ri);
+        if (UTILS_UNLIKELY(lod)) {
+            // the levels are keyed by entity, instances are not stable across destroy()
+            uint8_t& current = mLevelsOfDetail[rcm.getEntity(ri)];
+            float const screenSize = getScreenSize(
+                    renderableData.elementAt<FScene::WORLD_AABB_CENTER>(index),
+                    renderableData.elementAt<FScene::WORLD_AABB_EXTENT>(index));
+            level = selectLevelOfDetail(*lod, current, screenSize, hysteresis);
+            current = level;
+            level = uint8_t(math::clamp(int(level) + bias, 0, int(lod->count) - 1));
+        }
         renderableData.elementAt<FScene::PRIMITIVES>(index) = rcm.getRenderPrimitives(ri, level);
     }
 }
@@ -993,6 +1300,26 @@ View::VignetteOptions View::getVignetteOptions() const noexcept {
     return upcast(this)->getVignetteOptions();
 }
 
+void View::setOcclusionCullingOptions(View::OcclusionCullingOptions options) noexcept {
+    upcast(this)->setOcclusionCullingOptions(options);
+}
+
+View::OcclusionCullingOptions View::getOcclusionCullingOptions() const noexcept {
+    return upcast(this)->getOcclusionCullingOptions();
+}
+
+View::OcclusionCullingStatistics View::getOcclusionCullingStatistics() const noexcept {
+    return upcast(this)->getOcclusionCullingStatistics();
+}
+
+void View::setLevelOfDetailOptions(View::LevelOfDetailOptions options) noexcept {
+    upcast(this)->setLevelOfDetailOptions(options);
+}
+
+View::LevelOfDetailOptions View::getLevelOfDetailOptions() const noexcept {
+    return upcast(this)->getLevelOfDetailOptions();
+}
+
 void View::setBlendMode(BlendMode blendMode) noexcept {
     upcast(this)->setBlendMode(blendMode);
 }
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_COMPONENTS_CHANGEJOURNAL_H
+#define TNT_FILAMENT_COMPONENTS_CHANGEJOURNAL_H
+
+#include <utils/compiler.h>
+#include <utils/Entity.h>
+#include <utils/Slice.h>
+
+#include <array>
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * A ChangeJournal records which entities had their component data modified, so that consumers
+ * (e.g. FScene) can update the data they derive from it incrementally.
+ *
+ * Each recorded change has a monotonically increasing sequence number. A consumer remembers
+ * the sequence it has caught up to, and later asks for the changes that happened since.
+ * If these changes are not available anymore -- because they were trimmed, or because the
+ * journal was invalidated (e.g. components were created, destroyed or moved) -- the consumer
+ * must recompute everything.
+ *
+ * The journal keeps the changes of the last few frames only, see gc().
+ */
+class ChangeJournal {
+public:
+    using Sequence = uint64_t;
+
+    // records that the component data of entity e changed
+    void record(utils::Entity e) noexcept {
+        mEntries.push_back(e);
+    }
+
+    // records a change that can't be tracked per entity, all consumers must start over
+    void invalidate() noexcept {
+        // skip one sequence number, so that even consumers who were up-to-date are invalidated
+        mFirst = getSequence() + 1;
+        mEntries.clear();
+    }
+
+    // returns the sequence number a consumer is at once it has consumed all the changes
+    Sequence getSequence() const noexcept {
+        return mFirst + mEntries.size();
+    }
+
+    // returns the changes recorded since 'since', or false if they're not available anymore.
+    // the returned entities are not unique.
+    bool getChangesSince(Sequence since, utils::Slice<const utils::Entity>& changes) const noexcept {
+        if (since < mFirst || since > getSequence()) {
+            return false;
+        }
+        changes.set(mEntries.data() + (since - mFirst), mEntries.data() + mEntries.size());
+        return true;
+    }
+
+    // Called once per frame. Discards the changes older than FRAME_HISTORY_COUNT frames. If the
+    // journal holds more than maxEntries changes, it is invalidated instead, as a full update
+    // would be cheaper anyways.
+    void gc(size_t maxEntries) noexcept {
+        if (UTILS_UNLIKELY(mEntries.size() > maxEntries)) {
+            invalidate();
+        }
+        Sequence const oldest = mFrameHistory[mFrameIndex];
+        mFrameHistory[mFrameIndex] = getSequence();
+        mFrameIndex = (mFrameIndex + 1) % FRAME_HISTORY_COUNT;
+        if (oldest > mFirst) {
+            mEntries.erase(mEntries.begin(), mEntries.begin() + (oldest - mFirst));
+            mFirst = oldest;
+        }
+    }
+
+private:
+    static constexpr size_t FRAME_HISTORY_COUNT = 4;
+    std::vector<utils::Entity> mEntries;
+    std::array<Sequence, FRAME_HISTORY_COUNT> mFrameHistory{};
+    Sequence mFirst = 0;
+    uint32_t mFrameIndex = 0;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_COMPONENTS_CHANGEJOURNAL_H
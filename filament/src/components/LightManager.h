@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "components/ChangeJournal.h"
+
 #include "private/backend/DriverApiForward.h"
 
 #include <filament/LightManager.h>
@@ -67,7 +69,19 @@ public:
     void prepare(backend::DriverApi& driver) const noexcept;
 
     void gc(utils::EntityManager& em) noexcept {
+        size_t const count = mManager.getComponentCount();
         mManager.gc(em);
+        if (UTILS_UNLIKELY(count != mManager.getComponentCount())) {
+            // components were removed, which moves instances around
+            mChangeJournal.invalidate();
+        }
+        mChangeJournal.gc(mManager.getComponentCount());
+    }
+
+    // Light data is cheap to recompute, so changes to individual lights are not recorded. The
+    // journal is only invalidated when lights are created or destroyed.
+    ChangeJournal const& getChangeJournal() const noexcept {
+        return mChangeJournal;
     }
 
     struct LightType {
@@ -285,6 +299,7 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
     FEngine& mEngine;
 };
 
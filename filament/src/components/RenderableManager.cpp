@@ -29,6 +29,9 @@
 #include <utils/Log.h>
 #include <utils/Panic.h>
 
+#include <algorithm>
+#include <cmath>
+
 using namespace filament::math;
 using namespace utils;
 
@@ -48,6 +51,15 @@ struct RenderableManager::BuilderDetails {
     size_t mSkinningBoneCount = 0;
     Bone const* mUserBones = nullptr;
     mat4f const* mUserBoneMatrices = nullptr;
+    size_t mInstanceCount = 1;
+    mat4f const* mInstanceTransforms = nullptr;
+    float3 const* mOccluderVertices = nullptr;
+    size_t mOccluderVertexCount = 0;
+    uint16_t const* mOccluderIndices = nullptr;
+    size_t mOccluderIndexCount = 0;
+    std::vector<Entry> mLodEntries;     // geometry of the levels of detail 1 and up
+    float mLodScreenSizes[MAX_LEVEL_OF_DETAIL_COUNT] = {};
+    uint8_t mLevelCount = 1;
 
     explicit BuilderDetails(size_t count)
             : mEntries(count), mCulling(true), mCastShadows(false), mReceiveShadows(true),
@@ -55,6 +67,17 @@ struct RenderableManager::BuilderDetails {
     }
     // this is only needed for the explicit instantiation below
     BuilderDetails() = default;
+
+    Entry& getLodEntry(uint8_t level, size_t index) noexcept {
+        assert(level > 0 && level < mLevelCount);
+        mLodEntries.resize(std::max(mLodEntries.size(), (mLevelCount - 1) * mEntries.size()));
+        return mLodEntries[(level - 1) * mEntries.size() + index];
+    }
+
+    // screen size below which the given level is used
+    float getLodScreenSize(uint8_t level) const noexcept {
+        return mLodScreenSizes[level] > 0 ? mLodScreenSizes[level] : std::pow(0.5f, float(level));
+    }
 };
 
 using BuilderType = RenderableManager;
@@ -96,6 +119,40 @@ RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index,
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index, uint8_t level,
+        PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices) noexcept {
+    return geometry(index, level, type, vertices, indices, 0, indices->getIndexCount());
+}
+
+RenderableManager::Builder& RenderableManager::Builder::geometry(size_t index, uint8_t level,
+        PrimitiveType type, VertexBuffer* vertices, IndexBuffer* indices,
+        size_t offset, size_t count) noexcept {
+    if (level == 0) {
+        return geometry(index, type, vertices, indices, offset, count);
+    }
+    if (index < mImpl->mEntries.size() && level < MAX_LEVEL_OF_DETAIL_COUNT) {
+        mImpl->mLevelCount = std::max(mImpl->mLevelCount, uint8_t(level + 1));
+        Entry& entry = mImpl->getLodEntry(level, index);
+        entry.vertices = vertices;
+        entry.indices = indices;
+        entry.offset = offset;
+        entry.minIndex = 0;
+        entry.maxIndex = vertices->getVertexCount() - 1;
+        entry.count = count;
+        entry.type = type;
+    }
+    return *this;
+}
+
+RenderableManager::Builder& RenderableManager::Builder::levelOfDetail(
+        uint8_t level, float screenSize) noexcept {
+    if (level > 0 && level < MAX_LEVEL_OF_DETAIL_COUNT) {
+        mImpl->mLevelCount = std::max(mImpl->mLevelCount, uint8_t(level + 1));
+        mImpl->mLodScreenSizes[level] = screenSize;
+    }
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::material(size_t index,
         MaterialInstance const* materialInstance) noexcept {
     if (index < mImpl->mEntries.size()) {
@@ -163,6 +220,13 @@ RenderableManager::Builder& RenderableManager::Builder::morphing(bool enable) no
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::instances(
+        size_t instanceCount, mat4f const* transforms) noexcept {
+    mImpl->mInstanceCount = instanceCount;
+    mImpl->mInstanceTransforms = transforms;
+    return *this;
+}
+
 RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index, uint16_t blendOrder) noexcept {
     if (index < mImpl->mEntries.size()) {
         mImpl->mEntries[index].blendOrder = blendOrder;
@@ -170,6 +234,15 @@ RenderableManager::Builder& RenderableManager::Builder::blendOrder(size_t index,
     return *this;
 }
 
+RenderableManager::Builder& RenderableManager::Builder::occluder(float3 const* vertices,
+        size_t vertexCount, uint16_t const* indices, size_t indexCount) noexcept {
+    mImpl->mOccluderVertices = vertices;
+    mImpl->mOccluderVertexCount = vertexCount;
+    mImpl->mOccluderIndices = indices;
+    mImpl->mOccluderIndexCount = indexCount;
+    return *this;
+}
+
 RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& engine, Entity entity) {
     bool isEmpty = true;
 
@@ -178,6 +251,20 @@ RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& eng
         return Error;
     }
 
+    if (!ASSERT_PRECONDITION_NON_FATAL(
+            mImpl->mInstanceCount > 0 && mImpl->mInstanceCount <= CONFIG_MAX_INSTANCES,
+            "[entity=%u] instance count (%u) must be between 1 and %u",
+            entity.getId(), mImpl->mInstanceCount, CONFIG_MAX_INSTANCES)) {
+        return Error;
+    }
+
+    // instances are stored in the bones UBO
+    if (!ASSERT_PRECONDITION_NON_FATAL(mImpl->mInstanceCount == 1 ||
+            (mImpl->mSkinningBoneCount == 0 && !mImpl->mMorphingEnabled),
+            "[entity=%u] instanced renderables can't be skinned or morphed", entity.getId())) {
+        return Error;
+    }
+
     for (size_t i = 0, c = mImpl->mEntries.size(); i < c; i++) {
         auto& entry = mImpl->mEntries[i];
 
@@ -227,6 +314,33 @@ RenderableManager::Builder::Result RenderableManager::Builder::build(Engine& eng
         isEmpty = false;
     }
 
+    for (size_t i = 0, c = mImpl->mLodEntries.size(); i < c; i++) {
+        auto& entry = mImpl->mLodEntries[i];
+
+        // missing geometry is inherited from the previous level
+        if (!entry.indices || !entry.vertices) {
+            continue;
+        }
+
+        if (!ASSERT_PRECONDITION_NON_FATAL(entry.offset + entry.count <= entry.indices->getIndexCount(),
+                "[entity=%u, level %u, primitive @ %u] offset (%u) + count (%u) > indexCount (%u)",
+                entity.getId(), 1 + i / mImpl->mEntries.size(), i % mImpl->mEntries.size(),
+                entry.offset, entry.count, entry.indices->getIndexCount())) {
+            entry.vertices = nullptr;
+            return Error;
+        }
+    }
+
+    for (uint8_t level = 1; level < mImpl->mLevelCount; level++) {
+        float const screenSize = mImpl->getLodScreenSize(level);
+        if (!ASSERT_PRECONDITION_NON_FATAL(screenSize > 0 &&
+                (level == 1 || screenSize < mImpl->getLodScreenSize(level - 1)),
+                "[entity=%u] the screen size of level %u (%g) must be positive and smaller "
+                "than the previous level's", entity.getId(), level, screenSize)) {
+            return Error;
+        }
+    }
+
     if (!ASSERT_POSTCONDITION_NON_FATAL(
             !mImpl->mAABB.isEmpty() ||
             (!mImpl->mCulling && (!(mImpl->mReceiveShadows || mImpl->mCastShadows)) ||
@@ -266,14 +380,42 @@ void FRenderableManager::create(
     assert(ci);
 
     if (ci) {
-        // create and initialize all needed RenderPrimitives
+        // create and initialize all needed RenderPrimitives, level after level
         using size_type = Slice<FRenderPrimitive>::size_type;
-        Builder::Entry const * const entries = builder->mEntries.data();
-        FRenderPrimitive* rp = new FRenderPrimitive[builder->mEntries.size()];
-        for (size_t i = 0, c = builder->mEntries.size(); i < c; ++i) {
-            rp[i].init(driver, entries[i]);
+        size_t const primitiveCount = builder->mEntries.size();
+        size_t const levelCount = builder->mLevelCount;
+        std::vector<Builder::Entry> entries(builder->mEntries);
+        FRenderPrimitive* rp = new FRenderPrimitive[primitiveCount * levelCount];
+        for (size_t level = 0; level < levelCount; level++) {
+            for (size_t i = 0; i < primitiveCount; ++i) {
+                size_t const lodIndex = (level - 1) * primitiveCount + i;
+                if (level > 0 && lodIndex < builder->mLodEntries.size()) {
+                    // the material and blend order are shared by all levels, the geometry
+                    // is inherited from the previous level unless specified
+                    Builder::Entry const& lod = builder->mLodEntries[lodIndex];
+                    if (lod.vertices && lod.indices) {
+                        entries[i].vertices = lod.vertices;
+                        entries[i].indices = lod.indices;
+                        entries[i].offset = lod.offset;
+                        entries[i].minIndex = lod.minIndex;
+                        entries[i].maxIndex = lod.maxIndex;
+                        entries[i].count = lod.count;
+                        entries[i].type = lod.type;
+                    }
+                }
+                rp[level * primitiveCount + i].init(engine, entries[i]);
+            }
+        }
+        setPrimitives(ci, { rp, size_type(primitiveCount * levelCount) });
+
+        std::unique_ptr<LevelOfDetail>& lod = manager[ci].lod;
+        lod.reset();
+        if (levelCount > 1) {
+            lod = std::unique_ptr<LevelOfDetail>(new LevelOfDetail{ uint8_t(levelCount), {} });
+            for (uint8_t level = 1; level < levelCount; level++) {
+                lod->screenSizes[level] = builder->getLodScreenSize(level);
+            }
         }
-        setPrimitives(ci, { rp, size_type(builder->mEntries.size()) });
 
         setAxisAlignedBoundingBox(ci, builder->mAABB);
         setLayerMask(ci, builder->mLayerMask);
@@ -285,6 +427,8 @@ void FRenderableManager::create(
         setSkinning(ci, false);
         setMorphing(ci, builder->mMorphingEnabled);
         setMorphWeights(ci, {0, 0, 0, 0});
+        setOccluder(ci, builder->mOccluderVertices, builder->mOccluderVertexCount,
+                builder->mOccluderIndices, builder->mOccluderIndexCount);
 
         const size_t count = builder->mSkinningBoneCount;
         if (UTILS_UNLIKELY(count > 0 || builder->mMorphingEnabled)) {
@@ -321,6 +465,37 @@ void FRenderableManager::create(
                 }
             }
         }
+
+        const size_t instanceCount = builder->mInstanceCount;
+        std::unique_ptr<Instances>& instances = manager[ci].instances;
+        instances.reset();
+        setInstanced(ci, false);
+        if (UTILS_UNLIKELY(instanceCount > 1 || builder->mInstanceTransforms)) {
+            // the instances use the bones binding, so this is sized like the bones UBO above
+            instances = std::unique_ptr<Instances>(new Instances{
+                    driver.createUniformBuffer(CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone),
+                            backend::BufferUsage::DYNAMIC),
+                    driver.createUniformBuffer(CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone),
+                            backend::BufferUsage::DYNAMIC),
+                    UniformBuffer{ instanceCount * sizeof(PerRenderableUibInstance) },
+                    UniformBuffer{ instanceCount * sizeof(PerRenderableUibInstance) },
+                    std::vector<mat4f>(instanceCount),
+                    {},
+                    uint32_t(instanceCount),
+                    uint32_t(instanceCount)
+            });
+            setInstanced(ci, true);
+            if (builder->mInstanceTransforms) {
+                setInstanceTransforms(ci, builder->mInstanceTransforms, instanceCount);
+            } else {
+                // initialize the instances to identity
+                std::vector<mat4f> const identity(instanceCount);
+                setInstanceTransforms(ci, identity.data(), instanceCount);
+            }
+        }
+
+        // instances might have moved, and the setters above recorded this entity already
+        mChangeJournal.invalidate();
     }
 }
 
@@ -330,6 +505,7 @@ void FRenderableManager::destroy(utils::Entity e) noexcept {
     if (ci) {
         destroyComponent(ci);
         mManager.removeComponent(e);
+        mChangeJournal.invalidate();
     }
 }
 
@@ -364,6 +540,13 @@ void FRenderableManager::destroyComponent(Instance ci) noexcept {
     if (bones) {
         driver.destroyUniformBuffer(bones->handle);
     }
+
+    // destroy the instances structures if any
+    std::unique_ptr<Instances> const& instances = manager[ci].instances;
+    if (instances) {
+        driver.destroyUniformBuffer(instances->handle);
+        driver.destroyUniformBuffer(instances->visibleHandle);
+    }
 }
 
 void FRenderableManager::destroyComponentPrimitives(
@@ -382,6 +565,7 @@ void FRenderableManager::prepare(
     auto& manager = mManager;
 
     std::unique_ptr<Bones>  const * const UTILS_RESTRICT bones = manager.raw_array<BONES>();
+    std::unique_ptr<Instances> const * const UTILS_RESTRICT inst = manager.raw_array<INSTANCES>();
     for (uint32_t index : list) {
         size_t i = instances[index].asValue();
         assert(i);  // we should never get the null instance here
@@ -390,15 +574,32 @@ void FRenderableManager::prepare(
                 driver.loadUniformBuffer(bones[i]->handle, bones[i]->bones.toBufferDescriptor(driver));
             }
         }
+        if (UTILS_UNLIKELY(inst[i])) {
+            if (inst[i]->uniforms.isDirty()) {
+                driver.loadUniformBuffer(inst[i]->handle, inst[i]->uniforms.toBufferDescriptor(driver));
+            }
+        }
     }
 }
 
+Slice<FRenderPrimitive> FRenderableManager::getRenderPrimitives(
+        Instance instance, uint8_t level) const noexcept {
+    // the primitives of all the levels are stored contiguously, level after level
+    Slice<FRenderPrimitive> primitives = mManager[instance].primitives;
+    size_t const levelCount = getLevelCount(instance);
+    assert(level < levelCount);
+    using size_type = Slice<FRenderPrimitive>::size_type;
+    size_type const count = size_type(primitives.size() / levelCount);
+    return { primitives.data() + level * count, count };
+}
+
 void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
         size_t primitiveIndex, FMaterialInstance const* mi) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setMaterialInstance(upcast(mi));
+            mChangeJournal.record(mManager.getEntity(instance));
             AttributeBitset required = mi->getMaterial()->getRequiredAttributes();
             AttributeBitset declared = primitives[primitiveIndex].getEnabledAttributes();
             if (UTILS_UNLIKELY((declared & required) != required)) {
@@ -413,7 +614,7 @@ void FRenderableManager::setMaterialInstanceAt(Instance instance, uint8_t level,
 MaterialInstance* FRenderableManager::getMaterialInstanceAt(
         Instance instance, uint8_t level, size_t primitiveIndex) const noexcept {
     if (instance) {
-        const Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        const Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             // We store the material instance as const because we don't want to change it internally
             // but when the user queries it, we want to allow them to call setParameter()
@@ -426,9 +627,10 @@ MaterialInstance* FRenderableManager::getMaterialInstanceAt(
 void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
         size_t primitiveIndex, uint16_t order) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].setBlendOrder(order);
+            mChangeJournal.record(mManager.getEntity(instance));
         }
     }
 }
@@ -436,7 +638,7 @@ void FRenderableManager::setBlendOrderAt(Instance instance, uint8_t level,
 AttributeBitset FRenderableManager::getEnabledAttributesAt(
         Instance instance, uint8_t level, size_t primitiveIndex) const noexcept {
     if (instance) {
-        Slice<FRenderPrimitive> const& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             return primitives[primitiveIndex].getEnabledAttributes();
         }
@@ -448,20 +650,47 @@ void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t
         PrimitiveType type, FVertexBuffer* vertices, FIndexBuffer* indices,
         size_t offset, size_t count) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mEngine, type, vertices, indices, offset,
                     0, vertices->getVertexCount() - 1, count);
+            mChangeJournal.record(mManager.getEntity(instance));
         }
     }
 }
 
+void FRenderableManager::setOccluder(Instance instance, float3 const* vertices,
+        size_t vertexCount, uint16_t const* indices, size_t indexCount) noexcept {
+    if (instance) {
+        std::unique_ptr<Occluder>& occluder = mManager[instance].occluder;
+        // ignore the incomplete triangle, if any
+        indexCount -= indexCount % 3;
+        if (!vertices || !indices || !indexCount) {
+            occluder.reset();
+            return;
+        }
+        for (size_t i = 0; i < indexCount; i++) {
+            if (!ASSERT_PRECONDITION_NON_FATAL(indices[i] < vertexCount,
+                    "occluder index %u out of range (%u vertices)",
+                    unsigned(indices[i]), unsigned(vertexCount))) {
+                occluder.reset();
+                return;
+            }
+        }
+        occluder = std::unique_ptr<Occluder>(new Occluder{
+                { vertices, vertices + vertexCount },
+                { indices, indices + indexCount }
+        });
+    }
+}
+
 void FRenderableManager::setGeometryAt(Instance instance, uint8_t level, size_t primitiveIndex,
         PrimitiveType type, size_t offset, size_t count) noexcept {
     if (instance) {
-        Slice<FRenderPrimitive>& primitives = getRenderPrimitives(instance, level);
+        Slice<FRenderPrimitive> primitives = getRenderPrimitives(instance, level);
         if (primitiveIndex < primitives.size()) {
             primitives[primitiveIndex].set(mEngine, type, offset, 0, 0, count);
+            mChangeJournal.record(mManager.getEntity(instance));
         }
     }
 }
@@ -502,9 +731,30 @@ void FRenderableManager::setBones(Instance ci,
     }
 }
 
+void FRenderableManager::setInstanceTransforms(Instance ci,
+        mat4f const* UTILS_RESTRICT transforms, size_t count, size_t offset) noexcept {
+    if (ci) {
+        std::unique_ptr<Instances> const& instances = mManager[ci].instances;
+        if (instances && offset < instances->count) {
+            count = std::min(count, instances->count - offset);
+            PerRenderableUibInstance* UTILS_RESTRICT out =
+                    (PerRenderableUibInstance*)instances->uniforms.invalidateUniforms(
+                            offset * sizeof(PerRenderableUibInstance),
+                            count * sizeof(PerRenderableUibInstance));
+            for (size_t i = 0; i < count; ++i) {
+                makeInstance(&out[i], transforms[i], uint32_t(offset + i));
+                instances->transforms[offset + i] = transforms[i];
+            }
+            updateInstanceBounds(*instances, mManager[ci].aabb);
+            mChangeJournal.record(mManager.getEntity(ci));
+        }
+    }
+}
+
 void FRenderableManager::setMorphWeights(Instance ci, const float4& weights) noexcept {
     if (ci) {
         mManager[ci].morphWeights = weights;
+        mChangeJournal.record(mManager.getEntity(ci));
     }
 }
 
@@ -531,6 +781,27 @@ void FRenderableManager::makeBone(PerRenderableUibBone* UTILS_RESTRICT out, mat4
     out->ns = is / max(abs(is));
 }
 
+void FRenderableManager::makeInstance(PerRenderableUibInstance* UTILS_RESTRICT out,
+        mat4f const& t, uint32_t index) noexcept {
+    // same as the normal matrix of the renderable, see FScene::setRenderableUniforms()
+    mat3f m = mat3f::getTransformForNormals(t.upperLeft());
+    m *= mat3f(1.0f / std::sqrt(max(float3{ length2(m[0]), length2(m[1]), length2(m[2]) })));
+
+    out->transform = t;
+    out->normalTransform[0] = { m[0], 0.0f };
+    out->normalTransform[1] = { m[1], 0.0f };
+    out->normalTransform[2] = { m[2], 0.0f };
+    out->index = { float(index), 0.0f, 0.0f, 0.0f };
+}
+
+void FRenderableManager::updateInstanceBounds(Instances& instances, Box const& aabb) noexcept {
+    Box bounds = rigidTransform(aabb, instances.transforms[0]);
+    for (size_t i = 1, c = instances.count; i < c; ++i) {
+        bounds.unionSelf(rigidTransform(aabb, instances.transforms[i]));
+    }
+    instances.bounds = bounds;
+}
+
 // ------------------------------------------------------------------------------------------------
 // Trampoline calling into private implementation
 // ------------------------------------------------------------------------------------------------
@@ -596,9 +867,17 @@ size_t RenderableManager::getPrimitiveCount(Instance instance) const noexcept {
     return upcast(this)->getPrimitiveCount(instance, 0);
 }
 
+size_t RenderableManager::getLevelOfDetailCount(Instance instance) const noexcept {
+    return upcast(this)->getLevelCount(instance);
+}
+
 void RenderableManager::setMaterialInstanceAt(Instance instance,
         size_t primitiveIndex, MaterialInstance const* materialInstance) noexcept {
-    upcast(this)->setMaterialInstanceAt(instance, 0, primitiveIndex, upcast(materialInstance));
+    // materials are shared by all the levels of detail
+    for (size_t level = 0, c = upcast(this)->getLevelCount(instance); level < c; level++) {
+        upcast(this)->setMaterialInstanceAt(instance, uint8_t(level), primitiveIndex,
+                upcast(materialInstance));
+    }
 }
 
 MaterialInstance* RenderableManager::getMaterialInstanceAt(
@@ -607,7 +886,10 @@ MaterialInstance* RenderableManager::getMaterialInstanceAt(
 }
 
 void RenderableManager::setBlendOrderAt(Instance instance, size_t primitiveIndex, uint16_t order) noexcept {
-    upcast(this)->setBlendOrderAt(instance, 0, primitiveIndex, order);
+    // blend orders are shared by all the levels of detail
+    for (size_t level = 0, c = upcast(this)->getLevelCount(instance); level < c; level++) {
+        upcast(this)->setBlendOrderAt(instance, uint8_t(level), primitiveIndex, order);
+    }
 }
 
 AttributeBitset RenderableManager::getEnabledAttributesAt(Instance instance, size_t primitiveIndex) const noexcept {
@@ -636,8 +918,22 @@ void RenderableManager::setBones(Instance instance,
     upcast(this)->setBones(instance, transforms, boneCount, offset);
 }
 
+void RenderableManager::setInstanceTransforms(Instance instance,
+        mat4f const* transforms, size_t count, size_t offset) noexcept {
+    upcast(this)->setInstanceTransforms(instance, transforms, count, offset);
+}
+
+size_t RenderableManager::getInstanceCount(Instance instance) const noexcept {
+    return upcast(this)->getInstanceCount(instance);
+}
+
 void RenderableManager::setMorphWeights(Instance instance, float4 const& weights) noexcept {
     upcast(this)->setMorphWeights(instance, weights);
 }
 
+void RenderableManager::setOccluder(Instance instance, float3 const* vertices,
+        size_t vertexCount, uint16_t const* indices, size_t indexCount) noexcept {
+    upcast(this)->setOccluder(instance, vertices, vertexCount, indices, indexCount);
+}
+
 } // namespace filament
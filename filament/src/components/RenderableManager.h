@@ -21,6 +21,8 @@
 
 #include "UniformBuffer.h"
 
+#include "components/ChangeJournal.h"
+
 #include "private/backend/DriverApiForward.h"
 
 #include <backend/Handle.h>
@@ -35,6 +37,9 @@
 #include <utils/Slice.h>
 #include <utils/Range.h>
 
+#include <memory>
+#include <vector>
+
 // for gtest
 class FilamentTest_Bones_Test;
 
@@ -58,10 +63,40 @@ public:
         bool skinning                   : 1;
         bool morphing                   : 1;
         bool screenSpaceContactShadows  : 1;
+        bool instanced                  : 1;
     };
 
     static_assert(sizeof(Visibility) == sizeof(uint16_t), "Visibility should be 16 bits");
 
+    // simplified mesh used for occlusion culling, in the local space of the renderable
+    struct Occluder {
+        std::vector<math::float3> vertices;
+        std::vector<uint16_t> indices;
+    };
+
+    /*
+     * Instances of an instanced renderable. The transforms of all the instances are used by the
+     * shadow maps, and the view being prepared compacts the ones visible from its camera in a
+     * second buffer (see FView::cullInstances()). The instances are stored in the bones UBO
+     * of the shaders, see PerRenderableUibInstance.
+     */
+    struct Instances {
+        backend::Handle<backend::HwUniformBuffer> handle;          // all the instances
+        backend::Handle<backend::HwUniformBuffer> visibleHandle;   // the visible instances
+        UniformBuffer uniforms;
+        UniformBuffer visibleUniforms;
+        std::vector<math::mat4f> transforms;    // relative to the renderable's transform
+        Box bounds;                             // of all the instances, in the renderable's space
+        uint32_t count;
+        uint32_t visibleCount;                  // instances in visibleUniforms
+    };
+
+    // screen sizes below which each level of detail is used, screenSizes[0] is unused
+    struct LevelOfDetail {
+        uint8_t count;
+        float screenSizes[MAX_LEVEL_OF_DETAIL_COUNT];
+    };
+
     explicit FRenderableManager(FEngine& engine) noexcept;
     ~FRenderableManager();
 
@@ -80,6 +115,14 @@ public:
         return mManager.getInstance(e);
     }
 
+    utils::Entity getEntity(Instance i) const noexcept {
+        return mManager.getEntity(i);
+    }
+
+    size_t getComponentCount() const noexcept {
+        return mManager.getComponentCount();
+    }
+
     void create(const RenderableManager::Builder& builder, utils::Entity entity);
 
     void destroy(utils::Entity e) noexcept;
@@ -91,7 +134,19 @@ public:
             utils::Range<uint32_t> list) const noexcept;
 
     void gc(utils::EntityManager& em) noexcept {
+        size_t const count = mManager.getComponentCount();
         mManager.gc(em);
+        if (UTILS_UNLIKELY(count != mManager.getComponentCount())) {
+            // components were removed, which moves instances around
+            mChangeJournal.invalidate();
+        }
+        // past this many changes, it's cheaper for consumers to start over
+        mChangeJournal.gc(mManager.getComponentCount());
+    }
+
+    // records the entities whose AABB, layers, visibility or morph weights changed
+    ChangeJournal const& getChangeJournal() const noexcept {
+        return mChangeJournal;
     }
 
     inline void setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept;
@@ -109,10 +164,15 @@ public:
     inline void setCulling(Instance instance, bool enable) noexcept;
     inline void setSkinning(Instance instance, bool enable) noexcept;
     inline void setMorphing(Instance instance, bool enable) noexcept;
+    inline void setInstanced(Instance instance, bool enable) noexcept;
     inline void setPrimitives(Instance instance, utils::Slice<FRenderPrimitive> const& primitives) noexcept;
     inline void setBones(Instance instance, Bone const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setBones(Instance instance, math::mat4f const* transforms, size_t boneCount, size_t offset = 0) noexcept;
     inline void setMorphWeights(Instance instance, const math::float4& weights) noexcept;
+    void setInstanceTransforms(Instance instance, math::mat4f const* transforms,
+            size_t count, size_t offset = 0) noexcept;
+    void setOccluder(Instance instance, math::float3 const* vertices, size_t vertexCount,
+            uint16_t const* indices, size_t indexCount) noexcept;
 
 
     inline bool isShadowCaster(Instance instance) const noexcept;
@@ -129,9 +189,14 @@ public:
 
     inline backend::Handle<backend::HwUniformBuffer> getBonesUbh(Instance instance) const noexcept;
     inline uint32_t getBoneCount(Instance instance) const noexcept;
+    inline Instances* getInstances(Instance instance) noexcept;
+    inline Instances const* getInstances(Instance instance) const noexcept;
+    inline size_t getInstanceCount(Instance instance) const noexcept;
+    inline Occluder const* getOccluder(Instance instance) const noexcept;
+    inline LevelOfDetail const* getLevelOfDetail(Instance instance) const noexcept;
 
 
-    inline size_t getLevelCount(Instance instance) const noexcept { return 1; }
+    inline size_t getLevelCount(Instance instance) const noexcept;
     inline size_t getPrimitiveCount(Instance instance, uint8_t level) const noexcept;
     void setMaterialInstanceAt(Instance instance, uint8_t level,
             size_t primitiveIndex, FMaterialInstance const* materialInstance) noexcept;
@@ -143,8 +208,7 @@ public:
             PrimitiveType type, size_t offset, size_t count) noexcept;
     void setBlendOrderAt(Instance instance, uint8_t level, size_t primitiveIndex, uint16_t blendOrder) noexcept;
     AttributeBitset getEnabledAttributesAt(Instance instance, uint8_t level, size_t primitiveIndex) const noexcept;
-    inline utils::Slice<FRenderPrimitive> const& getRenderPrimitives(Instance instance, uint8_t level) const noexcept;
-    inline utils::Slice<FRenderPrimitive>& getRenderPrimitives(Instance instance, uint8_t level) noexcept;
+    utils::Slice<FRenderPrimitive> getRenderPrimitives(Instance instance, uint8_t level) const noexcept;
 
 private:
     void destroyComponent(Instance ci) noexcept;
@@ -161,6 +225,10 @@ private:
 
     static void makeBone(PerRenderableUibBone* out, math::mat4f const& transforms) noexcept;
 
+    static void makeInstance(PerRenderableUibInstance* out, math::mat4f const& transform,
+            uint32_t index) noexcept;
+    static void updateInstanceBounds(Instances& instances, Box const& aabb) noexcept;
+
     enum {
         AABB,               // user data
         LAYERS,             // user data
@@ -168,6 +236,9 @@ private:
         VISIBILITY,         // user data
         PRIMITIVES,         // user data
         BONES,              // filament data, UBO storing a pointer to the bones information
+        OCCLUDER,           // user data
+        LOD,                // user data, null when there is a single level of detail
+        INSTANCES,          // user data, null when the renderable isn't instanced
     };
 
     using Base = utils::SingleInstanceComponentManager<
@@ -176,7 +247,10 @@ private:
             filament::math::float4,          // MORPH_WEIGHTS
             Visibility,                      // VISIBILITY
             utils::Slice<FRenderPrimitive>,  // PRIMITIVES
-            std::unique_ptr<Bones>           // BONES
+            std::unique_ptr<Bones>,          // BONES
+            std::unique_ptr<Occluder>,       // OCCLUDER
+            std::unique_ptr<LevelOfDetail>,  // LOD
+            std::unique_ptr<Instances>       // INSTANCES
     >;
 
     struct Sim : public Base {
@@ -197,6 +271,9 @@ private:
                 Field<VISIBILITY>   visibility;
                 Field<PRIMITIVES>   primitives;
                 Field<BONES>        bones;
+                Field<OCCLUDER>     occluder;
+                Field<LOD>          lod;
+                Field<INSTANCES>    instances;
             };
         };
 
@@ -209,6 +286,7 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
     FEngine& mEngine;
 };
 
@@ -217,6 +295,11 @@ FILAMENT_UPCAST(RenderableManager)
 void FRenderableManager::setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept {
     if (instance) {
         mManager[instance].aabb = aabb;
+        std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+        if (UTILS_UNLIKELY(instances)) {
+            updateInstanceBounds(*instances, aabb);
+        }
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -225,12 +308,14 @@ void FRenderableManager::setLayerMask(Instance instance,
     if (instance) {
         uint8_t& layers = mManager[instance].layers;
         layers = (layers & ~select) | (values & select);
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
 void FRenderableManager::setLayerMask(Instance instance, uint8_t layerMask) noexcept {
     if (instance) {
         mManager[instance].layers = layerMask;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -238,6 +323,7 @@ void FRenderableManager::setPriority(Instance instance, uint8_t priority) noexce
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.priority = priority;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -245,6 +331,7 @@ void FRenderableManager::setCastShadows(Instance instance, bool enable) noexcept
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.castShadows = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -252,6 +339,7 @@ void FRenderableManager::setReceiveShadows(Instance instance, bool enable) noexc
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.receiveShadows = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -259,6 +347,7 @@ void FRenderableManager::setScreenSpaceContactShadows(Instance instance, bool en
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.screenSpaceContactShadows = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -266,6 +355,7 @@ void FRenderableManager::setCulling(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.culling = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -273,6 +363,15 @@ void FRenderableManager::setSkinning(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.skinning = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
+    }
+}
+
+void FRenderableManager::setInstanced(Instance instance, bool enable) noexcept {
+    if (instance) {
+        Visibility& visibility = mManager[instance].visibility;
+        visibility.instanced = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -280,6 +379,7 @@ void FRenderableManager::setMorphing(Instance instance, bool enable) noexcept {
     if (instance) {
         Visibility& visibility = mManager[instance].visibility;
         visibility.morphing = enable;
+        mChangeJournal.record(mManager.getEntity(instance));
     }
 }
 
@@ -307,6 +407,11 @@ bool FRenderableManager::isCullingEnabled(Instance instance) const noexcept {
     return getVisibility(instance).culling;
 }
 
+FRenderableManager::Occluder const* FRenderableManager::getOccluder(Instance instance) const noexcept {
+    std::unique_ptr<Occluder> const& occluder = mManager[instance].occluder;
+    return occluder.get();
+}
+
 uint8_t FRenderableManager::getLayerMask(Instance instance) const noexcept {
     return mManager[instance].layers;
 }
@@ -333,14 +438,31 @@ inline uint32_t FRenderableManager::getBoneCount(Instance instance) const noexce
     return bones ? bones->count : 0;
 }
 
-utils::Slice<FRenderPrimitive> const& FRenderableManager::getRenderPrimitives(
-        Instance instance, uint8_t level) const noexcept {
-    return mManager[instance].primitives;
+FRenderableManager::Instances* FRenderableManager::getInstances(Instance instance) noexcept {
+    std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+    return instances.get();
+}
+
+FRenderableManager::Instances const* FRenderableManager::getInstances(
+        Instance instance) const noexcept {
+    std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+    return instances.get();
+}
+
+size_t FRenderableManager::getInstanceCount(Instance instance) const noexcept {
+    std::unique_ptr<Instances> const& instances = mManager[instance].instances;
+    return instances ? instances->count : 1;
+}
+
+FRenderableManager::LevelOfDetail const* FRenderableManager::getLevelOfDetail(
+        Instance instance) const noexcept {
+    std::unique_ptr<LevelOfDetail> const& lod = mManager[instance].lod;
+    return lod.get();
 }
 
-utils::Slice<FRenderPrimitive>& FRenderableManager::getRenderPrimitives(
-        Instance instance, uint8_t level) noexcept {
-    return mManager[instance].primitives;
+size_t FRenderableManager::getLevelCount(Instance instance) const noexcept {
+    std::unique_ptr<LevelOfDetail> const& lod = mManager[instance].lod;
+    return lod ? lod->count : 1;
 }
 
 size_t FRenderableManager::getPrimitiveCount(Instance instance, uint8_t level) const noexcept {
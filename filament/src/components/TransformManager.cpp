@@ -16,14 +16,72 @@
 
 #include "components/TransformManager.h"
 
+#include <utils/JobSystem.h>
+#include <utils/Systrace.h>
+
+#include <math/mat3.h>
 #include <math/mat4.h>
+#include <math/quat.h>
+
+#if defined(__SSE__)
+#   include <xmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#   include <arm_neon.h>
+#endif
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+
+#include <math.h>
 
 using namespace utils;
 using namespace filament::math;
 
 namespace filament {
 
-FTransformManager::FTransformManager() noexcept = default;
+// out = lhs * rhs, with SSE or NEON when available. The products and sums are done in the same
+// order as mat4f's operator*, so the results are the same.
+static inline void multiply(mat4f& UTILS_RESTRICT out,
+        mat4f const& UTILS_RESTRICT lhs, mat4f const& UTILS_RESTRICT rhs) noexcept {
+#if defined(__SSE__)
+    __m128 const l0 = _mm_loadu_ps(&lhs[0][0]);
+    __m128 const l1 = _mm_loadu_ps(&lhs[1][0]);
+    __m128 const l2 = _mm_loadu_ps(&lhs[2][0]);
+    __m128 const l3 = _mm_loadu_ps(&lhs[3][0]);
+    for (size_t i = 0; i < 4; i++) {
+        __m128 r = _mm_mul_ps(l0, _mm_set1_ps(rhs[i][0]));
+        r = _mm_add_ps(r, _mm_mul_ps(l1, _mm_set1_ps(rhs[i][1])));
+        r = _mm_add_ps(r, _mm_mul_ps(l2, _mm_set1_ps(rhs[i][2])));
+        r = _mm_add_ps(r, _mm_mul_ps(l3, _mm_set1_ps(rhs[i][3])));
+        _mm_storeu_ps(&out[i][0], r);
+    }
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+    float32x4_t const l0 = vld1q_f32(&lhs[0][0]);
+    float32x4_t const l1 = vld1q_f32(&lhs[1][0]);
+    float32x4_t const l2 = vld1q_f32(&lhs[2][0]);
+    float32x4_t const l3 = vld1q_f32(&lhs[3][0]);
+    for (size_t i = 0; i < 4; i++) {
+        float32x4_t const c = vld1q_f32(&rhs[i][0]);
+        float32x4_t r = vmulq_laneq_f32(l0, c, 0);
+        r = vaddq_f32(r, vmulq_laneq_f32(l1, c, 1));
+        r = vaddq_f32(r, vmulq_laneq_f32(l2, c, 2));
+        r = vaddq_f32(r, vmulq_laneq_f32(l3, c, 3));
+        vst1q_f32(&out[i][0], r);
+    }
+#else
+    out = lhs * rhs;
+#endif
+}
+
+// translation * rotation * scale
+static inline mat4f compose(float3 const& t, quatf const& r, float3 const& s) noexcept {
+    mat3f const m(r);
+    return mat4f{ mat3f{ m[0] * s.x, m[1] * s.y, m[2] * s.z }, t };
+}
+
+FTransformManager::FTransformManager(JobSystem* js) noexcept : mJobSystem(js) {
+}
 
 FTransformManager::~FTransformManager() noexcept = default;
 
@@ -51,6 +109,8 @@ void FTransformManager::create(Entity entity, Instance parent, const mat4f& loca
         manager[i].next = 0;
         manager[i].prev = 0;
         manager[i].firstChild = 0;
+        manager[i].hasTrs = false;
+        mChangeJournal.invalidate();
         insertNode(i, parent);
         setTransform(i, localTransform);
     }
@@ -123,6 +183,7 @@ void FTransformManager::destroy(Entity e) noexcept {
 
         // 2) remove the component
         Instance moved = manager.removeComponent(e);
+        mChangeJournal.invalidate();
 
         // 3) update the references to the entry now with Instance i
         if (moved != i) {
@@ -137,10 +198,126 @@ void FTransformManager::setTransform(Instance ci, const mat4f& model) noexcept {
         auto& manager = mManager;
         // store our local transform
         manager[ci].local = model;
+        manager[ci].hasTrs = false;
         updateNodeTransform(ci);
     }
 }
 
+void FTransformManager::setTransform(Instance ci, float3 const& translation,
+        quatf const& rotation, float3 const& scale) noexcept {
+    setTrs(ci, { translation, rotation, scale });
+}
+
+void FTransformManager::setTranslation(Instance ci, float3 const& translation) noexcept {
+    Trs trs = getTrs(ci);
+    trs.translation = translation;
+    setTrs(ci, trs);
+}
+
+void FTransformManager::setRotation(Instance ci, quatf const& rotation) noexcept {
+    Trs trs = getTrs(ci);
+    trs.rotation = rotation;
+    setTrs(ci, trs);
+}
+
+void FTransformManager::setScale(Instance ci, float3 const& scale) noexcept {
+    Trs trs = getTrs(ci);
+    trs.scale = scale;
+    setTrs(ci, trs);
+}
+
+void FTransformManager::setTrs(Instance ci, Trs const& trs) noexcept {
+    validateNode(ci);
+    if (ci) {
+        auto& manager = mManager;
+        // the local transform is derived from the TRS, which is never decomposed again
+        manager[ci].trs = trs;
+        manager[ci].hasTrs = true;
+        manager[ci].local = compose(trs.translation, trs.rotation, trs.scale);
+        updateNodeTransform(ci);
+    }
+}
+
+FTransformManager::Trs FTransformManager::getTrs(Instance ci) const noexcept {
+    auto const& manager = mManager;
+    if (manager[ci].hasTrs) {
+        return manager[ci].trs;
+    }
+
+    // the local transform was set as a matrix, decompose it
+    mat4f const& m = manager[ci].local;
+    Trs trs;
+    trs.translation = m[3].xyz;
+    float3 const x = m[0].xyz;
+    float3 const y = m[1].xyz;
+    float3 const z = m[2].xyz;
+    float const det = dot(x, cross(y, z));
+    trs.scale = float3{ length(x), length(y), length(z) } * (det < 0 ? -1.0f : 1.0f);
+    if (std::abs(det) > std::numeric_limits<float>::epsilon()) {
+        trs.rotation = mat3f{ x / trs.scale.x, y / trs.scale.y, z / trs.scale.z }.toQuaternion();
+    }
+    return trs;
+}
+
+void FTransformManager::setTransforms(Instance const* instances,
+        mat4f const* localTransforms, size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        Instance const ci = instances[k];
+        validateNode(ci);
+        if (ci) {
+            manager[ci].local = localTransforms[k];
+            manager[ci].hasTrs = false;
+        }
+    }
+    updateNodeTransforms(instances, count);
+}
+
+void FTransformManager::setTransforms(Instance const* instances, float3 const* translations,
+        quatf const* rotations, float3 const* scales, size_t count) noexcept {
+    auto& manager = mManager;
+    for (size_t k = 0; k < count; k++) {
+        Instance const ci = instances[k];
+        validateNode(ci);
+        if (ci) {
+            Trs const trs{ translations[k], rotations[k], scales ? scales[k] : float3{ 1 }};
+            manager[ci].trs = trs;
+            manager[ci].hasTrs = true;
+            manager[ci].local = compose(trs.translation, trs.rotation, trs.scale);
+        }
+    }
+    updateNodeTransforms(instances, count);
+}
+
+// updates the world transforms of the given nodes and their descendants, in a single sweep
+void FTransformManager::updateNodeTransforms(Instance const* instances, size_t count) noexcept {
+    if (UTILS_UNLIKELY(mLocalTransformTransactionOpen)) {
+        return;
+    }
+
+    auto& manager = mManager;
+    if (mLevels.empty()) {
+        // the hierarchy changed, it's simpler to update everything after sorting it
+        sortByLevel();
+        transformLevels(manager.begin(), true);
+        return;
+    }
+
+    mFlags.resize(manager.end());
+    Instance const end = manager.end();
+    Instance first = end;
+    for (size_t k = 0; k < count; k++) {
+        Instance const ci = instances[k];
+        if (ci) {
+            mFlags[ci] = DIRTY;
+            first = std::min(first, ci);
+        }
+    }
+    if (first != end) {
+        transformLevels(first, false);
+    }
+}
+
 void FTransformManager::updateNodeTransform(Instance i) noexcept {
     if (UTILS_UNLIKELY(mLocalTransformTransactionOpen)) {
         return;
@@ -157,6 +334,7 @@ void FTransformManager::updateNodeTransform(Instance i) noexcept {
 
     // compute our world transform
     manager[i].world = pt * static_cast<mat4f const&>(manager[i].local);
+    mChangeJournal.record(manager.getEntity(i));
 
     // update our children's world transforms
     Instance child = manager[i].firstChild;
@@ -169,11 +347,24 @@ void FTransformManager::openLocalTransformTransaction() noexcept {
     mLocalTransformTransactionOpen = true;
 }
 
+void FTransformManager::setParallelTransformUpdateEnabled(bool enable) noexcept {
+    mParallelTransformUpdate = enable;
+}
+
 void FTransformManager::commitLocalTransformTransaction() noexcept {
     if (mLocalTransformTransactionOpen) {
         mLocalTransformTransactionOpen = false;
         auto& manager = mManager;
 
+        if (mParallelTransformUpdate) {
+            // the hierarchy is only sorted again if it changed since the last time
+            if (mLevels.empty()) {
+                sortByLevel();
+            }
+            transformLevels(manager.begin(), true);
+            return;
+        }
+
         // swapNode() below needs some temporary storage which we provide here
         auto& soa = manager.getSoA();
         soa.ensureCapacity(soa.size() + 1);
@@ -186,7 +377,13 @@ void FTransformManager::commitLocalTransformTransaction() noexcept {
             }
             Instance parent = manager[i].parent;
             assert(parent < i);
-            manager[i].world = world[parent] * static_cast<mat4f const&>(manager[i].local);
+            const mat4f m = world[parent] * static_cast<mat4f const&>(manager[i].local);
+            mat4f const& w = world[i];
+            // only journal the transforms that actually changed, most of them usually don't
+            if (m[0] != w[0] || m[1] != w[1] || m[2] != w[2] || m[3] != w[3]) {
+                manager[i].world = m;
+                mChangeJournal.record(manager.getEntity(i));
+            }
         }
     }
 }
@@ -197,6 +394,9 @@ void FTransformManager::insertNode(Instance i, Instance parent) noexcept {
 
     assert(manager[i].parent == Instance{});
 
+    // the hierarchy changed
+    mLevels.clear();
+
     manager[i].parent = parent;
     manager[i].prev = 0;
     if (parent) {
@@ -224,8 +424,14 @@ void FTransformManager::swapNode(Instance i, Instance j) noexcept {
     // swap the content of the nodes directly
     std::swap(manager.elementAt<LOCAL>(i), manager.elementAt<LOCAL>(j));
     std::swap(manager.elementAt<WORLD>(i), manager.elementAt<WORLD>(j));
+    std::swap(manager.elementAt<TRS>(i), manager.elementAt<TRS>(j));
+    std::swap(manager.elementAt<HAS_TRS>(i), manager.elementAt<HAS_TRS>(j));
     manager.swap(i, j); // this swaps the data relative to SingleInstanceComponentManager
 
+    // consumers might have cached our instances
+    mChangeJournal.invalidate();
+    mLevels.clear();
+
     // now swap the linked-list references, to do that correctly we must use a temporary
     // node to fix-up the linked-list pointers
     // Here we are guaranteed to have enough capacity for our temporary storage, so we
@@ -260,6 +466,7 @@ void FTransformManager::removeNode(Instance i) noexcept {
     Instance parent = manager[i].parent;
     Instance prev = manager[i].prev;
     Instance next = manager[i].next;
+    mLevels.clear();
     if (prev) {
         manager[prev].next = next;
     } else if (parent) {
@@ -317,6 +524,7 @@ void FTransformManager::transformChildren(Sim& manager, Instance ci) noexcept {
         mat4f const& pt = manager[parent].world;
         mat4f const& local = manager[ci].local;
         manager[ci].world = pt * local;
+        mChangeJournal.record(manager.getEntity(ci));
 
         // assume we don't have a deep hierarchy
         Instance child = manager[ci].firstChild;
@@ -329,6 +537,138 @@ void FTransformManager::transformChildren(Sim& manager, Instance ci) noexcept {
     }
 }
 
+// sorts the nodes by their depth in the hierarchy, i.e. in breadth-first order. Siblings end-up
+// next to each other, and all the parents of a level are in the level before.
+void FTransformManager::sortByLevel() noexcept {
+    SYSTRACE_CALL();
+
+    auto& manager = mManager;
+    size_t const count = manager.end();
+    mLevels.clear();
+
+    std::vector<Instance> order;
+    order.reserve(count);
+    order.push_back(0);
+    Instance const* const parent = manager.raw_array<PARENT>();
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        if (!parent[i]) {
+            order.push_back(i);
+        }
+    }
+    for (size_t first = 1; first < order.size();) {
+        size_t const last = order.size();
+        mLevels.push_back(uint32_t(first));
+        for (size_t k = first; k < last; k++) {
+            for (Instance child = manager[order[k]].firstChild; child;
+                    child = manager[child].next) {
+                order.push_back(child);
+            }
+        }
+        first = last;
+    }
+    mLevels.push_back(uint32_t(order.size()));
+    assert(order.size() == count);
+
+    // remap[i] is the new position of the node at position i
+    std::vector<Instance> remap(count);
+    bool sorted = true;
+    for (size_t k = 0; k < count; k++) {
+        remap[order[k]] = Instance(k);
+        sorted = sorted && order[k] == Instance(k);
+    }
+    if (sorted) {
+        return;
+    }
+
+    // consumers might have cached our instances
+    mChangeJournal.invalidate();
+
+    // fix-up the references first, then move the nodes to their new position
+    auto& soa = manager.getSoA();
+    for (Instance* references : { soa.data<PARENT>(), soa.data<FIRST_CHILD>(),
+            soa.data<NEXT>(), soa.data<PREV>() }) {
+        for (size_t i = 1; i < count; i++) {
+            references[i] = remap[references[i]];
+        }
+    }
+    for (Instance i = manager.begin(), e = manager.end(); i != e; ++i) {
+        while (remap[i] != i) {
+            Instance const j = remap[i];
+            swapElements(i, j);
+            std::swap(remap[i], remap[j]);
+        }
+    }
+}
+
+// swaps two nodes, without updating the references to them
+void FTransformManager::swapElements(Instance i, Instance j) noexcept {
+    auto& manager = mManager;
+    std::swap(manager.elementAt<LOCAL>(i), manager.elementAt<LOCAL>(j));
+    std::swap(manager.elementAt<WORLD>(i), manager.elementAt<WORLD>(j));
+    std::swap(manager.elementAt<PARENT>(i), manager.elementAt<PARENT>(j));
+    std::swap(manager.elementAt<FIRST_CHILD>(i), manager.elementAt<FIRST_CHILD>(j));
+    std::swap(manager.elementAt<NEXT>(i), manager.elementAt<NEXT>(j));
+    std::swap(manager.elementAt<PREV>(i), manager.elementAt<PREV>(j));
+    std::swap(manager.elementAt<TRS>(i), manager.elementAt<TRS>(j));
+    std::swap(manager.elementAt<HAS_TRS>(i), manager.elementAt<HAS_TRS>(j));
+    manager.swap(i, j);
+}
+
+// computes the world transforms of the nodes marked DIRTY in mFlags and of their descendants,
+// or of all the nodes if 'all' is true. The nodes must be sorted by level and none before
+// 'first' can be marked. The nodes of a level only depend on the level before, so they're
+// computed in parallel.
+void FTransformManager::transformLevels(Instance first, bool all) noexcept {
+    SYSTRACE_CALL();
+
+    auto& manager = mManager;
+    auto& soa = manager.getSoA();
+    mat4f* const UTILS_RESTRICT world = soa.data<WORLD>();
+    mat4f const* const UTILS_RESTRICT local = soa.data<LOCAL>();
+    Instance const* const UTILS_RESTRICT parent = soa.data<PARENT>();
+
+    mFlags.resize(manager.end());
+    uint8_t* const UTILS_RESTRICT flags = mFlags.data();
+
+    auto work = [world, local, parent, flags, all](uint32_t start, uint32_t count) {
+        for (uint32_t i = start, e = start + count; i < e; i++) {
+            // the parent of the roots is the identity (see SingleInstanceComponentManager)
+            if (all || ((flags[i] | flags[parent[i]]) & DIRTY)) {
+                mat4f m;
+                multiply(m, world[parent[i]], local[i]);
+                mat4f const& w = world[i];
+                bool const changed = m[0] != w[0] || m[1] != w[1] || m[2] != w[2] || m[3] != w[3];
+                flags[i] = uint8_t(DIRTY | (changed ? CHANGED : 0));
+                world[i] = m;
+            }
+        }
+    };
+
+    JobSystem* const js = mParallelTransformUpdate ? mJobSystem : nullptr;
+    for (size_t l = 0, c = mLevels.size() - 1; l < c; l++) {
+        if (mLevels[l + 1] <= first) {
+            continue;
+        }
+        uint32_t const start = std::max(mLevels[l], uint32_t(first));
+        uint32_t const count = mLevels[l + 1] - start;
+        if (js && count >= PARALLEL_UPDATE_MIN_COUNT) {
+            auto job = jobs::parallel_for(*js, nullptr, start, count, std::cref(work),
+                    jobs::CountSplitter<PARALLEL_UPDATE_MIN_COUNT / 2, 5>());
+            js->runAndWait(job);
+        } else {
+            work(start, count);
+        }
+    }
+
+    // only journal the transforms that actually changed, most of them usually don't
+    for (Instance i = first, e = manager.end(); i != e; ++i) {
+        if (flags[i] & CHANGED) {
+            mChangeJournal.record(manager.getEntity(i));
+        }
+    }
+    std::fill(flags + first, flags + manager.end(), 0);
+}
+
 void FTransformManager::validateNode(Instance i) noexcept {
 #ifndef NDEBUG
     auto& manager = mManager;
@@ -376,6 +716,8 @@ void FTransformManager::gc(utils::EntityManager& em) noexcept {
     manager.gc(em, 4, [this](Entity e) {
                 destroy(e);
             });
+    // past this many changes, it's cheaper for consumers to start over
+    mChangeJournal.gc(manager.getComponentCount());
 }
 
 TransformManager::children_iterator& TransformManager::children_iterator::operator++() {
@@ -445,6 +787,53 @@ void TransformManager::commitLocalTransformTransaction() noexcept {
     upcast(this)->commitLocalTransformTransaction();
 }
 
+void TransformManager::setTransforms(Instance const* instances,
+        const mat4f* localTransforms, size_t count) noexcept {
+    upcast(this)->setTransforms(instances, localTransforms, count);
+}
+
+void TransformManager::setTransforms(Instance const* instances, const float3* translations,
+        const quatf* rotations, const float3* scales, size_t count) noexcept {
+    upcast(this)->setTransforms(instances, translations, rotations, scales, count);
+}
+
+void TransformManager::setTransform(Instance ci, const float3& translation,
+        const quatf& rotation, const float3& scale) noexcept {
+    upcast(this)->setTransform(ci, translation, rotation, scale);
+}
+
+void TransformManager::setTranslation(Instance ci, const float3& translation) noexcept {
+    upcast(this)->setTranslation(ci, translation);
+}
+
+void TransformManager::setRotation(Instance ci, const quatf& rotation) noexcept {
+    upcast(this)->setRotation(ci, rotation);
+}
+
+void TransformManager::setScale(Instance ci, const float3& scale) noexcept {
+    upcast(this)->setScale(ci, scale);
+}
+
+float3 TransformManager::getTranslation(Instance ci) const noexcept {
+    return upcast(this)->getTranslation(ci);
+}
+
+quatf TransformManager::getRotation(Instance ci) const noexcept {
+    return upcast(this)->getRotation(ci);
+}
+
+float3 TransformManager::getScale(Instance ci) const noexcept {
+    return upcast(this)->getScale(ci);
+}
+
+void TransformManager::setParallelTransformUpdateEnabled(bool enable) noexcept {
+    upcast(this)->setParallelTransformUpdateEnabled(enable);
+}
+
+bool TransformManager::isParallelTransformUpdateEnabled() const noexcept {
+    return upcast(this)->isParallelTransformUpdateEnabled();
+}
+
 TransformManager::children_iterator TransformManager::getChildrenBegin(
         TransformManager::Instance parent) const noexcept {
     return upcast(this)->getChildrenBegin(parent);
@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "components/ChangeJournal.h"
+
 #include <filament/TransformManager.h>
 
 #include <utils/compiler.h>
@@ -27,6 +29,16 @@
 #include <utils/Slice.h>
 
 #include <math/mat4.h>
+#include <math/quat.h>
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stdint.h>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
 
 namespace filament {
 
@@ -34,7 +46,8 @@ class UTILS_PRIVATE FTransformManager : public TransformManager {
 public:
     using Instance = TransformManager::Instance;
 
-    FTransformManager() noexcept;
+    // world transforms are computed in parallel with 'js', when it's set
+    explicit FTransformManager(utils::JobSystem* js = nullptr) noexcept;
     ~FTransformManager() noexcept;
 
     // free-up all resources
@@ -75,6 +88,12 @@ public:
 
     void commitLocalTransformTransaction() noexcept;
 
+    void setParallelTransformUpdateEnabled(bool enable) noexcept;
+
+    bool isParallelTransformUpdateEnabled() const noexcept {
+        return mParallelTransformUpdate;
+    }
+
     void gc(utils::EntityManager& em) noexcept;
 
     utils::Slice<const math::mat4f> getWorldTransforms() const noexcept {
@@ -83,24 +102,79 @@ public:
 
     void setTransform(Instance ci, const math::mat4f& model) noexcept;
 
+    void setTransforms(Instance const* instances, math::mat4f const* localTransforms,
+            size_t count) noexcept;
+
+    void setTransforms(Instance const* instances, math::float3 const* translations,
+            math::quatf const* rotations, math::float3 const* scales, size_t count) noexcept;
+
     const math::mat4f& getTransform(Instance ci) const noexcept {
         return mManager[ci].local;
     }
 
+    void setTransform(Instance ci, math::float3 const& translation, math::quatf const& rotation,
+            math::float3 const& scale) noexcept;
+
+    void setTranslation(Instance ci, math::float3 const& translation) noexcept;
+
+    void setRotation(Instance ci, math::quatf const& rotation) noexcept;
+
+    void setScale(Instance ci, math::float3 const& scale) noexcept;
+
+    math::float3 getTranslation(Instance ci) const noexcept {
+        return getTrs(ci).translation;
+    }
+
+    math::quatf getRotation(Instance ci) const noexcept {
+        return getTrs(ci).rotation;
+    }
+
+    math::float3 getScale(Instance ci) const noexcept {
+        return getTrs(ci).scale;
+    }
+
     const math::mat4f& getWorldTransform(Instance ci) const noexcept {
         return mManager[ci].world;
     }
 
+    // records the entities whose world transform changed
+    ChangeJournal const& getChangeJournal() const noexcept {
+        return mChangeJournal;
+    }
+
 private:
     struct Sim;
 
+    // a local transform, as a translation, a rotation and a scale
+    struct Trs {
+        math::float3 translation{};
+        math::quatf rotation{ 1, 0, 0, 0 };
+        math::float3 scale{ 1 };
+    };
+
+    // returns the TRS of a component, decomposes its local transform if it doesn't have one
+    Trs getTrs(Instance ci) const noexcept;
+    void setTrs(Instance ci, Trs const& trs) noexcept;
+
     void validateNode(Instance i) noexcept;
     void removeNode(Instance i) noexcept;
     void updateNode(Instance i) noexcept;
     void updateNodeTransform(Instance i) noexcept;
     void insertNode(Instance i, Instance p) noexcept;
     void swapNode(Instance i, Instance j) noexcept;
-    static void transformChildren(Sim& manager, Instance firstChild) noexcept;
+    void transformChildren(Sim& manager, Instance firstChild) noexcept;
+    void sortByLevel() noexcept;
+    void swapElements(Instance i, Instance j) noexcept;
+    void transformLevels(Instance first, bool all) noexcept;
+    void updateNodeTransforms(Instance const* instances, size_t count) noexcept;
+
+    enum : uint8_t {
+        DIRTY = 0x1,    // the world transform must be computed
+        CHANGED = 0x2   // the world transform changed
+    };
+
+    // levels smaller than this are transformed serially
+    static constexpr size_t PARALLEL_UPDATE_MIN_COUNT = 1024;
 
     friend class TransformManager::children_iterator;
 
@@ -111,6 +185,8 @@ private:
         FIRST_CHILD,    // instance to our first child
         NEXT,           // instance to our next sibling
         PREV,           // instance to our previous sibling
+        TRS,            // local transform as a TRS, if HAS_TRS
+        HAS_TRS,        // whether the local transform was set as a TRS
     };
 
     using Base = utils::SingleInstanceComponentManager<
@@ -119,7 +195,9 @@ private:
             Instance,
             Instance,
             Instance,
-            Instance
+            Instance,
+            Trs,
+            bool
     >;
 
     struct Sim : public Base {
@@ -142,6 +220,8 @@ private:
                 Field<FIRST_CHILD>  firstChild;
                 Field<NEXT>         next;
                 Field<PREV>         prev;
+                Field<TRS>          trs;
+                Field<HAS_TRS>      hasTrs;
             };
         };
 
@@ -154,7 +234,12 @@ private:
     };
 
     Sim mManager;
+    ChangeJournal mChangeJournal;
+    utils::JobSystem* mJobSystem = nullptr;
+    std::vector<uint32_t> mLevels;      // first instance of each level, empty if not sorted
+    std::vector<uint8_t> mFlags;        // DIRTY / CHANGED, used by transformLevels()
     bool mLocalTransformTransactionOpen = false;
+    bool mParallelTransformUpdate = false;
 };
 
 FILAMENT_UPCAST(TransformManager)
@@ -18,6 +18,11 @@
 #define TNT_FILAMENT_DETAILS_ALLOCATORS_H
 
 #include <utils/Allocator.h>
+#include <utils/architecture.h>
+#include <utils/compiler.h>
+#include <utils/memalign.h>
+
+#include <algorithm>
 
 namespace filament {
 
@@ -62,6 +67,34 @@ using LinearAllocatorArena = utils::Arena<
 
 using ArenaScope = utils::ArenaScope<LinearAllocatorArena>;
 
+// A growable block of memory kept from frame to frame, for temporary storage that's too large
+// for the per-render pass arena (e.g. sorting or recording the commands of a render pass).
+// Its content doesn't survive get(), so it can only have one user at a time.
+class ScratchBuffer {
+public:
+    ScratchBuffer() noexcept = default;
+    ScratchBuffer(ScratchBuffer const& rhs) = delete;
+    ScratchBuffer& operator=(ScratchBuffer const& rhs) = delete;
+    ~ScratchBuffer() noexcept { utils::aligned_free(mBuffer); }
+
+    // returns at least size bytes, aligned to a cache line
+    void* get(size_t size) noexcept {
+        if (UTILS_UNLIKELY(size > mSize)) {
+            // grow geometrically, so that slowly growing scenes don't reallocate each frame
+            utils::aligned_free(mBuffer);
+            mSize = std::max(size, 2 * mSize);
+            mBuffer = utils::aligned_alloc(mSize, utils::CACHELINE_SIZE);
+        }
+        return mBuffer;
+    }
+
+    size_t getSize() const noexcept { return mSize; }
+
+private:
+    void* mBuffer = nullptr;
+    size_t mSize = 0;
+};
+
 } // namespace filament
 
 #endif // TNT_FILAMENT_DETAILS_ALLOCATORS_H
@@ -19,6 +19,8 @@
 
 #include "upcast.h"
 
+#include "private/backend/DriverApiForward.h"
+
 #include <backend/DriverEnums.h>
 #include <backend/Handle.h>
 
@@ -26,6 +28,11 @@
 
 #include <math/mathfwd.h>
 
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
 namespace filament {
 
 class FEngine;
@@ -43,7 +50,49 @@ public:
 
     backend::TextureHandle getHwHandle() const noexcept { return mLutHandle; }
 
+    /*
+     * The LUTs of the ColorGradings, shared by the ColorGradings built with the same settings.
+     * The last few LUTs no longer used are kept, so that going back to previous settings
+     * (e.g. when scrubbing a slider) doesn't generate them again.
+     */
+    class LutCache {
+    public:
+        static constexpr size_t MAX_UNUSED_COUNT = 4;
+
+        // returns the LUT for these settings and adds a reference to it, or a null handle
+        backend::TextureHandle acquire(const Builder& builder) noexcept;
+
+        // adds a LUT with a single reference
+        void insert(const Builder& builder, backend::TextureHandle handle);
+
+        // removes a reference to the LUT
+        void release(backend::DriverApi& driver, backend::TextureHandle handle) noexcept;
+
+        // destroys all the LUTs, which must no longer be used
+        void terminate(backend::DriverApi& driver) noexcept;
+
+        // for debugging and testing
+        size_t getLutCount() const noexcept { return mEntries.size(); }
+        size_t getUnusedLutCount() const noexcept;
+
+    private:
+        struct Entry {
+            uint32_t hash;
+            uint32_t refs;
+            uint64_t lastUse;           // for evicting the unused entries
+            Builder settings;           // a copy of the settings the LUT was generated from
+            backend::TextureHandle handle;
+        };
+
+        std::vector<Entry> mEntries;
+        uint64_t mTime = 0;
+    };
+
 private:
+    // consistent with BuilderDetails::operator==
+    static uint32_t hashSettings(const Builder& builder) noexcept;
+    static bool isSameSettings(const Builder& lhs, const Builder& rhs) noexcept;
+
     backend::TextureHandle mLutHandle;
 };
 
@@ -32,6 +32,8 @@ namespace filament {
  *
  * The implementation assumes 'count' below is multiple of 8
  *
+ * Hand-written SIMD kernels (AVX2, AVX-512 or NEON) are used when the CPU supports them, the
+ * selection happens at runtime, the first time any of the methods below is called.
  */
 
 class Culler {
@@ -91,6 +93,21 @@ public:
                 Frustum const& frustum,
                 math::float4 const* b,
                 size_t count) noexcept;
+
+        // same as above, but always uses the portable (auto-vectorized) implementation
+        static void intersectsPortable(result_type* results,
+                Frustum const& frustum,
+                math::float3 const* c,
+                math::float3 const* e,
+                size_t count) noexcept;
+
+        static void intersectsPortable(result_type* results,
+                Frustum const& frustum,
+                math::float4 const* b,
+                size_t count) noexcept;
+
+        // returns the name of the kernels selected for this CPU
+        static const char* getKernelName() noexcept;
     };
 };
 
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_CULLINGBVH_H
+#define TNT_FILAMENT_DETAILS_CULLINGBVH_H
+
+#include "details/Culler.h"
+
+#include <filament/Frustum.h>
+
+#include <utils/compiler.h>
+
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
+
+namespace filament {
+
+/*
+ * A bounding volume hierarchy over a set of AABBs (typically the world AABBs of the renderables
+ * of a scene), used to cull them against a frustum without testing each one of them.
+ *
+ * The hierarchy is built once, and then refit when some boxes move. It can be built in a space
+ * that differs from the one of the culled boxes by a translation (see setTranslation()), so
+ * that moving the world origin doesn't require a refit.
+ *
+ * Leaves contain up to Culler::MODULO boxes, which are tested individually with the Culler,
+ * so that the visibility of the boxes intersecting the frustum planes is exactly the same as
+ * with a linear sweep. For this purpose, the hierarchy keeps a copy of the boxes in the order
+ * of its leaves.
+ */
+class CullingBvh {
+public:
+    // (re)builds the hierarchy over 'count' boxes
+    void build(math::float3 const* center, math::float3 const* extent, size_t count);
+
+    // updates the bounds of the given boxes, which can contain duplicates. This may rebuild the
+    // hierarchy if too many boxes moved since it was built.
+    void refit(math::float3 const* center, math::float3 const* extent,
+            uint32_t const* items, size_t count);
+
+    void clear() noexcept;
+
+    bool empty() const noexcept { return mNodes.empty(); }
+
+    // number of boxes in the hierarchy
+    size_t size() const noexcept { return mItems.size(); }
+
+    // translation from the space the hierarchy is built in, to the space of the culled boxes
+    void setTranslation(math::float3 translation) noexcept { mTranslation = translation; }
+
+    /*
+     * Sets 'bit' in results[i] for each box i that intersects with the frustum (once translated),
+     * the other results are left untouched.
+     */
+    void cull(utils::JobSystem& js, Culler::result_type* results, Frustum const& frustum,
+            size_t bit) const noexcept;
+
+private:
+    static constexpr uint32_t LEAF_SIZE = Culler::MODULO;
+
+    // subtrees below this depth are culled in parallel
+    static constexpr uint32_t PARALLEL_CULLING_DEPTH = 4;
+    static constexpr size_t PARALLEL_CULLING_MIN_ITEMS = 8192;
+
+    // a rebuild happens when more than 1/REBUILD_RATIO of the boxes were refit since the
+    // last build, as the quality of the hierarchy degrades when boxes move.
+    static constexpr size_t REBUILD_RATIO = 4;
+
+    struct Node {
+        math::float3 center;    // bounds of all the boxes of the subtree
+        math::float3 extent;
+        uint32_t first;         // the subtree contains mItems[first, first + count)
+        uint32_t count;
+        uint32_t child;         // index of the first child (the second follows), 0 for leaves
+        uint32_t parent;
+    };
+
+    void updateBounds(Node& node) noexcept;
+
+    void cullSubtree(uint32_t index, uint8_t planeMask, Culler::result_type* results,
+            Frustum const& frustum, size_t bit) const noexcept;
+
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mItems;       // box indices, in the order of the leaves
+    std::vector<uint32_t> mLeaves;      // leaf of each box
+    std::vector<uint32_t> mPositions;   // position of each box in mItems
+    std::vector<math::float3> mCenters; // copy of the boxes, in the order of mItems
+    std::vector<math::float3> mExtents;
+    std::vector<uint32_t> mDirtyNodes;  // scratch buffer used by refit()
+    std::vector<bool> mDirty;
+    size_t mRefitCount = 0;
+    math::float3 mTranslation{};
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_CULLINGBVH_H
@@ -18,6 +18,7 @@
 #define TNT_FILAMENT_DETAILS_ENGINE_H
 
 #include "upcast.h"
+#include "HwRenderPrimitiveFactory.h"
 #include "PostProcessManager.h"
 
 #include "components/CameraManager.h"
@@ -145,15 +146,31 @@ public:
     // we'll simply have to use separate Areas (for instance).
     LinearAllocatorArena& getPerRenderPassAllocator() noexcept { return mPerRenderPassAllocator; }
 
+    // scratch memory shared by the render passes, which run in sequence on the main thread
+    ScratchBuffer& getRenderPassScratchBuffer() noexcept { return mRenderPassScratchBuffer; }
+
     // Material IDs...
     uint32_t getMaterialId() const noexcept { return mMaterialId++; }
 
+    // Version of the material instances' states used by the render passes (culling mode,
+    // depth write, etc...). This changes each time one of these states changes.
+    uint32_t getMaterialInstanceStateVersion() const noexcept {
+        return mMaterialInstanceStateVersion;
+    }
+    void invalidateMaterialInstanceState() const noexcept { mMaterialInstanceStateVersion++; }
+
     const FMaterial* getDefaultMaterial() const noexcept { return mDefaultMaterial; }
     const FMaterial* getSkyboxMaterial() const noexcept;
     const FIndirectLight* getDefaultIndirectLight() const noexcept { return mDefaultIbl; }
     const FTexture* getDummyCubemap() const noexcept { return mDefaultIblTexture; }
     const FColorGrading* getDefaultColorGrading() const noexcept { return mDefaultColorGrading; }
 
+    FColorGrading::LutCache& getColorGradingLutCache() noexcept { return mColorGradingLutCache; }
+
+    HwRenderPrimitiveFactory& getHwRenderPrimitiveFactory() noexcept {
+        return mHwRenderPrimitiveFactory;
+    }
+
     backend::Handle<backend::HwRenderPrimitive> getFullScreenRenderPrimitive() const noexcept {
         return mFullScreenTriangleRph;
     }
@@ -346,6 +363,7 @@ private:
     ResourceList<FRenderTarget> mRenderTargets{ "RenderTarget" };
 
     mutable uint32_t mMaterialId = 0;
+    mutable uint32_t mMaterialInstanceStateVersion = 0;
 
     // FMaterialInstance are handled directly by FMaterial
     std::unordered_map<const FMaterial*, ResourceList<FMaterialInstance>> mMaterialInstances;
@@ -357,6 +375,7 @@ private:
     DriverApi mCommandStream;
 
     LinearAllocatorArena mPerRenderPassAllocator;
+    ScratchBuffer mRenderPassScratchBuffer;
     HeapAllocatorArena mHeapAllocator;
 
     utils::JobSystem mJobSystem;
@@ -370,6 +389,8 @@ private:
     mutable FIndirectLight* mDefaultIbl = nullptr;
 
     mutable FColorGrading* mDefaultColorGrading = nullptr;
+    FColorGrading::LutCache mColorGradingLutCache;
+    HwRenderPrimitiveFactory mHwRenderPrimitiveFactory;
 
     mutable utils::CountDownLatch mDriverBarrier;
 
@@ -391,6 +412,7 @@ public:
             bool tightly_bound_scene = true;
             float dzn = -1.0f;
             float dzf =  1.0f;
+            bool parallel_update = true;
         } shadowmap;
         struct {
             bool enabled = true;
@@ -398,6 +420,11 @@ public:
         struct {
             bool camera_at_origin = true;
         } view;
+        struct {
+            bool draw_batching = true;
+            bool framegraph_compile_cache = true;
+            bool framegraph_profiling = false;
+        } renderer;
          matdbg::DebugServer* server = nullptr;
     } debug;
 };
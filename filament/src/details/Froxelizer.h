@@ -32,7 +32,6 @@
 #include <private/filament/UibGenerator.h>
 
 #include <utils/compiler.h>
-#include <utils/bitset.h>
 #include <utils/Slice.h>
 
 #include <math/mat4.h>
@@ -55,25 +54,28 @@ public:
 };
 
 //
-// Light UBO           Froxel Record Buffer     per-froxel light list texture
-// {4 x float4}         R_U8  {index into        RG_U16 {offset, point-count, spot-sount}
-// (spot/point            light texture}
+// Froxel Record Buffer     per-froxel light list texture, followed by the light texture
+// R_U16 {index into        RGBA_U32 {4 x {offset, point-count, spot-sount}}
+//  light texture}          RGBA_U32 {4 x RGBA_U32 (spot/point)}
 //
-//  +----+                     +-+                     +----+
-// 0|....| <------------+     0| |         +-----------|0230| (e.g. offset=02, 3-lights)
-// 1|....|<--------+     \    1| |        /            |    |
-// 2:    :          \     +---2|0|<------+             |    |
-// 3:    : <-------- \--------3|3|                     :    :
-// 4:    :            +------- :1:                     :    :
-//  :    :                     : :                     :    :
-//  :    :                     | |                     |    |
-//  :    :                     | |                     |    |
-//  :    :                     +-+                     |    |
-//  :    :                  65536 max                  +----+
-//  |....|                                          h = num froxels
-//  |....|
-//  +----+
-// 256 lights max
+//        +-+                     +----+
+//       0| |         +-----------|0230| (e.g. offset=02, 3-lights)
+//       1| |        /            |    |
+//  +----2|0|<------+             |    |
+//  | +--3|3|                     :    :
+//  | |   :1:                     :    :
+//  | |   : :                     |    |
+//  | |   +-+                     +----+ h = num froxels / 4
+//  | | 65536 max                0|....| <---+
+//  | |                          1|....|     |
+//  | |                          2:    :     |
+//  | |                          3:    : <-+ |
+//  | |                           :    :   | |
+//  | |                           |....|   | |
+//  | |                           +----+   | |
+//  | |                      4096 lights max | |
+//  | +------------------------------------+ |
+//  +----------------------------------------+
 //
 
 // Max number of froxels limited by:
@@ -96,7 +98,7 @@ public:
     // gpu buffer containing records. valid after construction.
     GPUBuffer const& getRecordBuffer() const noexcept { return mRecordsBuffer; }
 
-    // gpu buffer containing froxels. valid after construction.
+    // gpu buffer containing froxels, followed by the lights. valid after construction.
     GPUBuffer const& getFroxelBuffer() const noexcept { return mFroxelBuffer; }
 
     void setOptions(float zLightNear, float zLightFar) noexcept;
@@ -123,6 +125,8 @@ public:
     size_t getFroxelCount() const noexcept { return mFroxelCount; }
 
     // update Records and Froxels texture with lights data. this is thread-safe.
+    // Only the lights that changed since the last call are froxelized again, and nothing is
+    // done (including by commit()) if none did.
     void froxelizeLights(FEngine& engine, CameraInfo const& camera,
             const FScene::LightSoa& lightData) noexcept;
 
@@ -134,9 +138,14 @@ public:
         u.setUniform(offsetof(PerViewUib, oneOverFroxelDimensionY), mOneOverDimension.y);
     }
 
-    // send froxel data to GPU
+    // send froxel data to GPU, if it changed
     void commit(backend::DriverApi& driverApi);
 
+    // send the point and spot lights data to GPU, after the froxels in the froxel buffer.
+    // The data must be a whole number of rows and stay valid until the command-buffer is executed.
+    void commitLights(backend::DriverApi& driverApi,
+            LightsUib const* begin, LightsUib const* end) noexcept;
+
 
     /*
      * Only for testing/debugging...
@@ -152,22 +161,19 @@ public:
             };
         };
     };
-    // This depends on the maximum number of lights (currently 255),and can't be more than 16 bits.
+    // This depends on the maximum number of lights (currently 4095),and can't be more than 16 bits.
     static_assert(CONFIG_MAX_LIGHT_INDEX <= std::numeric_limits<uint16_t>::max(), "can't have more than 65536 lights");
     using RecordBufferType = std::conditional_t<CONFIG_MAX_LIGHT_INDEX <= std::numeric_limits<uint8_t>::max(), uint8_t, uint16_t>;
     const utils::Slice<FroxelEntry>& getFroxelBufferUser() const { return mFroxelBufferUser; }
     const utils::Slice<RecordBufferType>& getRecordBufferUser() const { return mRecordBufferUser; }
 
-    // this is chosen so froxelizePointAndSpotLight() vectorizes 4 froxel tests / spotlight
-    // with 256 lights this implies 8 jobs (256 / 32) for froxelization.
-    using LightGroupType = uint32_t;
+    // number of lights froxelized by the last call to froxelizeLights()
+    size_t getFroxelizedLightCount() const noexcept { return mFroxelizedLightCount; }
 
-private:
-    struct LightRecord {
-        using bitset = utils::bitset<uint64_t, (CONFIG_MAX_LIGHT_COUNT + 63) / 64>;
-        bitset lights;
-    };
+    // whether the last call to froxelizeLights() changed the froxel data
+    bool isCommitNeeded() const noexcept { return mCommitNeeded; }
 
+private:
     struct LightParams {
         math::float3 position;
         float cosSqr;
@@ -190,18 +196,34 @@ private:
         uint16_t reserved;
     };
 
-    using FroxelThreadData = std::array<LightGroupType, FROXEL_BUFFER_ENTRY_COUNT_MAX>;
+    // The froxels are split in chunks, whose light lists and records are computed in parallel.
+    // The records of all the chunks are then concatenated in the record buffer.
+    struct FroxelChunk {
+        std::vector<uint32_t> starts;           // first light of each froxel in 'lights'
+        std::vector<RecordBufferType> lights;   // lights of each froxel, in increasing order
+        std::vector<RecordBufferType> records;  // records of this chunk
+        std::vector<FroxelEntry> froxels;       // entries, with offsets relative to 'records'
+    };
 
     void setViewport(Viewport const& viewport) noexcept;
     void setProjection(const math::mat4f& projection, float near, float far) noexcept;
     bool update() noexcept;
 
-    void froxelizeLoop(FEngine& engine,
-            const CameraInfo& camera, const FScene::LightSoa& lightData) noexcept;
+    // returns the number of lights froxelized, only the ones that changed unless 'all' is set
+    size_t froxelizeLoop(FEngine& engine,
+            const CameraInfo& camera, const FScene::LightSoa& lightData, bool all) noexcept;
 
-    void froxelizeAssignRecordsCompress() noexcept;
+    static bool isSameLight(LightParams const& lhs, LightParams const& rhs) noexcept {
+        return lhs.position == rhs.position && lhs.cosSqr == rhs.cosSqr &&
+               lhs.axis == rhs.axis && lhs.invSin == rhs.invSin && lhs.radius == rhs.radius;
+    }
+
+    void froxelizeAssignRecordsCompress(utils::JobSystem& js) noexcept;
 
-    void froxelizePointAndSpotLight(FroxelThreadData& froxelThread, size_t bit,
+    void froxelizeChunk(FroxelChunk& chunk, size_t first, size_t last) const noexcept;
+
+    // replaces 'froxels' with the indices of the froxels the light touches, in increasing order
+    void froxelizePointAndSpotLight(std::vector<uint16_t>& froxels,
             math::mat4f const& projection, const LightParams& light) const noexcept;
 
     static void computeLightTree(LightTreeNode* lightTree,
@@ -228,12 +250,15 @@ private:
     math::float4* mPlanesY = nullptr;
     math::float4* mBoundingSpheres = nullptr;
 
-    utils::Slice<FroxelThreadData> mFroxelShardedData;  // 256 KiB w/  256 lights
+    // The froxels of each light are kept from one frame to the next, along with the parameters
+    // of the lights (in view space), so that only the lights that changed are froxelized again.
+    std::vector<std::vector<uint16_t>> mLightFroxels;   // size depends on the lights' coverage
+    std::vector<LightParams> mLightParams;              // 144 KiB w/ 4096 lights
+    std::vector<FroxelChunk> mFroxelChunks;
     utils::Slice<FroxelEntry> mFroxelBufferUser;        //  32 KiB w/ 8192 froxels
 
     // max 32 KiB  (actual: resolution dependant)
-    utils::Slice<RecordBufferType> mRecordBufferUser;   //  64 KiB
-    utils::Slice<LightRecord> mLightRecords;            // 256 KiB w/ 256 lights
+    utils::Slice<RecordBufferType> mRecordBufferUser;   // 128 KiB
 
     uint16_t mFroxelCountX = 0;
     uint16_t mFroxelCountY = 0;
@@ -258,6 +283,11 @@ private:
     float mZLightFar = FEngine::CONFIG_Z_LIGHT_FAR;
     float mZLightNear = FEngine::CONFIG_Z_LIGHT_NEAR;  // light near (first slice)
 
+    // whether mFroxelShardedData and mLightParams match the current froxels
+    bool mFroxelDataValid = false;
+    bool mCommitNeeded = false;
+    size_t mFroxelizedLightCount = 0;
+
     // track if we need to update our internal state before froxelizing
     uint8_t mDirtyFlags = 0;
     enum {
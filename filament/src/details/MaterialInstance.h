@@ -143,6 +143,12 @@ private:
 
     void commitSlow(FEngine::DriverApi& driver) const;
 
+    // All the states used to generate the commands of the render passes (culling, depth
+    // write, etc...) must be changed through this, which invalidates the render passes'
+    // command caches when the state actually changes.
+    template<typename T>
+    void setCommandState(T& state, T value) noexcept;
+
     // keep these grouped, they're accessed together in the render-loop
     FMaterial const* mMaterial = nullptr;
     backend::Handle<backend::HwUniformBuffer> mUbHandle;
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_OCCLUSIONCULLER_H
+#define TNT_FILAMENT_DETAILS_OCCLUSIONCULLER_H
+
+#include <utils/compiler.h>
+
+#include <math/mat4.h>
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace utils {
+class JobSystem;
+} // namespace utils
+
+namespace filament {
+
+/*
+ * A software occlusion culler.
+ *
+ * A few simplified meshes (the occluders) are rasterized into a low resolution depth buffer,
+ * which is then used to find boxes that are entirely hidden behind them.
+ *
+ * A pixel of the depth buffer is written when an occluder covers its center, and it stores the
+ * farthest depth of the occluder within that pixel; boxes are tested against all the pixels
+ * they touch. So a box can only be reported occluded by mistake if it hides in less than a
+ * pixel along the silhouette of an occluder, which is why occluders must be inside the
+ * geometry they stand for.
+ *
+ * Depths are normalized device coordinates, which are affine in screen space with both
+ * perspective and orthographic projections. Occluders are clipped against the near plane.
+ *
+ * Usage:
+ *   begin(viewProjection, width, height);
+ *   addOccluder(...);  // for each occluder
+ *   rasterize(js);
+ *   isOccluded(...);   // for each box, can be called concurrently
+ */
+class OcclusionCuller {
+public:
+    // sets the projection and the resolution of the depth buffer, and removes all occluders
+    void begin(math::mat4f const& viewProjection, uint32_t width, uint32_t height) noexcept;
+
+    // adds a triangle mesh. 'transform' maps the vertices to the space of viewProjection.
+    // the data is referenced until rasterize() returns.
+    void addOccluder(math::mat4f const& transform, math::float3 const* vertices,
+            uint16_t const* indices, size_t indexCount) noexcept;
+
+    // renders all the occluders into the depth buffer
+    void rasterize(utils::JobSystem& js) noexcept;
+
+    // whether the box is entirely hidden by the occluders
+    bool isOccluded(math::float3 const& center, math::float3 const& extent) const noexcept;
+
+    size_t getOccluderCount() const noexcept { return mOccluders.size(); }
+
+    uint32_t getWidth() const noexcept { return mWidth; }
+    uint32_t getHeight() const noexcept { return mHeight; }
+
+    // the depth buffer, for debugging. Each pixel is the farthest depth of the occluders
+    // covering it, or +inf.
+    float const* getDepthBuffer() const noexcept { return mDepth.data(); }
+
+private:
+    // occluders are rasterized in horizontal bands, in parallel
+    static constexpr uint32_t BAND_COUNT = 8;
+
+    struct Occluder {
+        math::mat4f transform;      // viewProjection * transform
+        math::float3 const* vertices;
+        uint16_t const* indices;
+        uint32_t triangleCount;
+        uint32_t first;             // first triangle in mTriangles
+        uint32_t count;             // number of triangles after setup
+    };
+
+    // a triangle ready to be rasterized. The coverage and depth are evaluated with the
+    // integer coordinates of the pixels.
+    struct Triangle {
+        float a[3], b[3], c[3];     // edge functions, all >= 0 when the pixel is inside
+        float z, zx, zy;            // farthest depth of the pixel
+        float zmax;
+        int32_t x0, y0, x1, y1;     // bounds of the pixels, x1 and y1 excluded
+    };
+
+    void setup(Occluder& occluder) noexcept;
+    void rasterize(Triangle const& triangle, uint32_t y0, uint32_t y1) noexcept;
+
+    math::mat4f mViewProjection;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    std::vector<Occluder> mOccluders;
+    std::vector<Triangle> mTriangles;
+    std::vector<float> mDepth;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_OCCLUSIONCULLER_H
@@ -36,7 +36,7 @@ class FRenderPrimitive {
 public:
     FRenderPrimitive() noexcept = default;
 
-    void init(backend::DriverApi& driver, const RenderableManager::Builder::Entry& entry) noexcept;
+    void init(FEngine& engine, const RenderableManager::Builder::Entry& entry) noexcept;
 
     void set(FEngine& engine, RenderableManager::PrimitiveType type,
             FVertexBuffer* vertices, FIndexBuffer* indices, size_t offset,
@@ -60,8 +60,13 @@ public:
     }
 
 private:
+    void update(FEngine& engine,
+            size_t offset, size_t minIndex, size_t maxIndex, size_t count) noexcept;
+
     FMaterialInstance const* mMaterialInstance = nullptr;
     backend::Handle<backend::HwRenderPrimitive> mHandle;
+    backend::Handle<backend::HwVertexBuffer> mVertexBufferHandle;
+    backend::Handle<backend::HwIndexBuffer> mIndexBufferHandle;
     backend::PrimitiveType mPrimitiveType = backend::PrimitiveType::NONE;
     AttributeBitset mEnabledAttributes;
     uint16_t mBlendOrder = 0;
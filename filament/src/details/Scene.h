@@ -23,12 +23,16 @@
 #include "components/TransformManager.h"
 
 #include "details/Culler.h"
+#include "details/CullingBvh.h"
 
 #include "Allocators.h"
 
 #include <filament/Box.h>
 #include <filament/Scene.h>
 
+#include <private/filament/EngineEnums.h>
+#include <private/filament/UibGenerator.h>
+
 #include <utils/compiler.h>
 #include <utils/Entity.h>
 #include <utils/Slice.h>
@@ -36,12 +40,20 @@
 #include <utils/Range.h>
 
 #include <cstddef>
+#include <vector>
+
+#include <tsl/robin_map.h>
 #include <tsl/robin_set.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 struct CameraInfo;
 class FEngine;
+class Froxelizer;
 class FIndirectLight;
 class FRenderer;
 class FSkybox;
@@ -69,6 +81,12 @@ public:
     size_t getLightCount() const noexcept;
     bool hasEntity(utils::Entity entity) const noexcept;
 
+    void setIncrementalPreparationEnabled(bool enabled) noexcept;
+    bool isIncrementalPreparationEnabled() const noexcept { return mIncrementalPreparation; }
+
+    void setCullingHierarchyEnabled(bool enabled) noexcept;
+    bool isCullingHierarchyEnabled() const noexcept { return mCullingHierarchy; }
+
 public:
     /*
      * Filaments-scope Public API
@@ -78,12 +96,31 @@ public:
     // for that in a few places.
     static constexpr size_t DIRECTIONAL_LIGHTS_COUNT = 1;
 
+    // below this many renderables, a linear sweep is faster than traversing the culling hierarchy
+    static constexpr size_t CULLING_BVH_MIN_RENDERABLES = 4096;
+
+    // below this many lights, a linear sweep is faster than traversing the culling hierarchy
+    static constexpr size_t CULLING_BVH_MIN_LIGHTS = 1024;
+
+    // point and spot lights are stored in LIGHT_BUFFER_WIDTH x LIGHT_BUFFER_HEIGHT texels of
+    // 4 x 32 bits (see LightsUib), after the froxels in the froxel texture (see Froxelizer).
+    // Make sure this matches light_punctual.fs
+    static constexpr size_t LIGHT_BUFFER_WIDTH_SHIFT = 6u;
+    static constexpr size_t LIGHT_BUFFER_WIDTH = 1u << LIGHT_BUFFER_WIDTH_SHIFT;
+    static constexpr size_t LIGHTS_PER_ROW = LIGHT_BUFFER_WIDTH * 16u / sizeof(LightsUib);
+    static constexpr size_t LIGHT_BUFFER_HEIGHT =
+            (CONFIG_MAX_LIGHT_COUNT + LIGHTS_PER_ROW - 1) / LIGHTS_PER_ROW;
+
+    // number of unused renderables slots after the last one in the renderable UBOs. RenderPass
+    // always binds the range of CONFIG_MAX_BATCH_COUNT slots starting at a renderable's slot.
+    static constexpr size_t RENDERABLE_UBO_PADDING = CONFIG_MAX_BATCH_COUNT - 1;
+
     explicit FScene(FEngine& engine);
     ~FScene() noexcept;
     void terminate(FEngine& engine);
 
-    void prepare(const math::mat4f& worldOriginTransform);
-    void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena, backend::Handle<backend::HwUniformBuffer> lightUbh) noexcept;
+    void prepare(utils::JobSystem& js, const math::mat4f& worldOriginTransform);
+    void prepareDynamicLights(const CameraInfo& camera, ArenaScope& arena, Froxelizer& froxelizer) noexcept;
 
 
     filament::backend::Handle<backend::HwUniformBuffer> getRenderableUBO() const noexcept {
@@ -105,6 +142,8 @@ public:
         WORLD_AABB_CENTER,      // 12 | world-space bounding box center of the renderable
         VISIBLE_MASK,           //  1 | each bit represents a visibility in a pass
         MORPH_WEIGHTS,          //  4 | floats for morphing
+        UBO_SLOT,               //  4 | index of the renderable in the per-renderable UBO
+        INSTANCES,              //  8 | instances of the renderable, null if not instanced
 
         // These are not needed anymore after culling
         LAYERS,                 //  1 | layers
@@ -124,6 +163,8 @@ public:
             math::float3,                               // WORLD_AABB_CENTER
             VisibleMaskType,                            // VISIBLE_MASK
             math::float4,                               // MORPH_WEIGHTS
+            uint32_t,                                   // UBO_SLOT
+            FRenderableManager::Instances*,             // INSTANCES
             uint8_t,                                    // LAYERS
             math::float3,                               // WORLD_AABB_EXTENT
             utils::Slice<FRenderPrimitive>,             // PRIMITIVES
@@ -197,9 +238,63 @@ public:
 
     void updateUBOs(utils::Range<uint32_t> visibleRenderables, backend::Handle<backend::HwUniformBuffer> renderableUbh) noexcept;
 
+    // the uploads to the persistent renderable UBO made by the last updateUBOs()
+    struct RenderableUBOUpdates {
+        uint32_t rangeCount = 0;        // number of updateUniformBuffer() calls
+        uint32_t renderableCount = 0;   // number of renderables uploaded
+    };
+    RenderableUBOUpdates const& getRenderableUBOUpdates() const noexcept {
+        return mRenderableUBOUpdates;
+    }
+
+    // the number of rows of the renderable data copied from the cache by the last prepare()
+    uint32_t getRenderableRowCopies() const noexcept { return mRenderableRowCopies; }
+
     bool hasContactShadows() const noexcept;
 
+    // Returns the hierarchy over the rows of the renderable data, or null if it's not available.
+    // It's only valid until the renderable data is reordered.
+    CullingBvh const* getCullingBvh() const noexcept {
+        return mCullingBvh.empty() ? nullptr : &mCullingBvh;
+    }
+
+    // Returns the hierarchy over the bounding spheres of the point and spot lights, or null if
+    // it's not available. Its items are the rows of the light data minus
+    // DIRECTIONAL_LIGHTS_COUNT, so it's only valid until the light data is reordered.
+    CullingBvh const* getLightCullingBvh() const noexcept {
+        return mLightCullingBvh.empty() ? nullptr : &mLightCullingBvh;
+    }
+
 private:
+    // number of entities processed by each job in prepare()
+    static constexpr size_t JOBS_PARALLEL_FOR_ENTITIES_COUNT = 128;
+
+    // maximum number of separate uploads to the persistent renderable UBO in a frame
+    static constexpr size_t MAX_RENDERABLE_UBO_UPDATE_RANGES = 32;
+
+    // per-entity scratch data used by prepare() to gather the scene in parallel
+    struct EntityInfo {
+        utils::Entity entity;
+        FRenderableManager::Instance ri;    // only set if the entity also has a transform
+        FLightManager::Instance li;
+        FTransformManager::Instance ti;
+        uint32_t renderableIndex;           // row in mRenderableData
+        uint32_t lightIndex;                // row in mLightData
+        bool directionalLight;
+    };
+
+    void gatherRenderable(EntityInfo const& info, RenderableSoa& soa,
+            math::mat4f const& worldOriginTransform) const noexcept;
+
+    void gatherLight(EntityInfo const& info, LightSoa& soa,
+            math::mat4f const& worldOriginTransform) const noexcept;
+
+    void updatePersistentUBO(backend::DriverApi& driver) noexcept;
+
+    static inline void setRenderableUniforms(void* buffer, size_t offset,
+            math::mat4f const& model, FRenderableManager::Visibility visibility,
+            math::float4 const& morphWeights) noexcept;
+
     static inline void computeLightRanges(math::float2* zrange,
             CameraInfo const& camera, const math::float4* spheres, size_t count) noexcept;
 
@@ -217,6 +312,68 @@ private:
      */
     tsl::robin_set<utils::Entity> mEntities;
 
+    /*
+     * Linear copy of mEntities, along with their resolved component instances. This is only
+     * used by prepare(), but we keep it around to avoid reallocating it every frame.
+     */
+    std::vector<EntityInfo> mEntityInfo;
+
+    // indices in mEntityInfo of the entities that have a light component
+    std::vector<uint32_t> mLightEntityInfo;
+
+    // number of rows in mRenderableData and mLightData, set when mEntityInfo is resolved
+    uint32_t mRenderableCount = 0;
+    uint32_t mLightCount = DIRECTIONAL_LIGHTS_COUNT;
+
+    /*
+     * Incremental preparation. The rows of mRenderableData are reordered by each View (see
+     * FView::prepare()), so instead we keep a copy of them (minus the translation of the
+     * world origin) indexed by EntityInfo::renderableIndex, in which only the rows of the
+     * renderables that changed are updated. The change journals of the transform, renderable
+     * and light managers tell us which ones changed since the last prepare(). Only those rows,
+     * and the rows the views reordered, are then copied back into mRenderableData.
+     */
+    bool mIncrementalPreparation = false;
+    bool mEntitiesChanged = true;                   // entities were added or removed
+    RenderableSoa mRenderableCache;
+    math::mat4f mRenderableCacheOrigin;             // world origin used for mRenderableCache
+    math::float3 mRenderableCacheTranslation{};     // world origin translation of the last prepare()
+    uint32_t mRenderableRowCopies = 0;              // rows of mRenderableData copied by prepare()
+    tsl::robin_map<utils::Entity, uint32_t> mRenderableEntityInfo;  // entity to mEntityInfo index
+    ChangeJournal::Sequence mTransformSequence = 0;
+    ChangeJournal::Sequence mRenderableSequence = 0;
+    ChangeJournal::Sequence mLightSequence = 0;
+
+    /*
+     * With incremental preparation, the per-renderable UBO is owned by the scene and indexed
+     * by EntityInfo::renderableIndex (the UBO_SLOT), so that only the slots of the renderables
+     * that changed need to be uploaded.
+     */
+    backend::Handle<backend::HwUniformBuffer> mRenderableUbh;
+    uint32_t mRenderableUBOCount = 0;               // capacity of mRenderableUbh in renderables
+    math::float3 mRenderableUBOTranslation{};       // world origin translation of its content
+    bool mRenderableUBOInvalid = true;              // all slots need to be uploaded
+    std::vector<uint32_t> mDirtyRenderableUBOSlots;
+    RenderableUBOUpdates mRenderableUBOUpdates;
+
+    /*
+     * With incremental preparation, a bounding volume hierarchy can be kept over the world AABBs
+     * of mRenderableCache, so that views don't need to test each renderable for culling.
+     */
+    bool mCullingHierarchy = false;
+    CullingBvh mCullingBvh;
+
+    /*
+     * The culling hierarchy of the lights doesn't need incremental preparation, because lights
+     * are gathered in the same rows every frame. It's built without the translation of the world
+     * origin, from these copies of the lights' bounds, so that only the lights that moved are
+     * refit.
+     */
+    void updateLightCullingBvh(math::float3 const& translation) noexcept;
+    CullingBvh mLightCullingBvh;
+    std::vector<math::float3> mLightCenters;
+    std::vector<math::float3> mLightExtents;
+    std::vector<uint32_t> mMovedLights;             // scratch buffer
 
     /*
      * The data below is valid only during a view pass. i.e. if a scene is used in multiple
@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_SHADOWATLAS_H
+#define TNT_FILAMENT_DETAILS_SHADOWATLAS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * Packs square shadow maps into the layers of a texture array.
+ *
+ * A shadow map of level k covers 1/4^k of a layer, like a node of a quadtree. When shadow maps
+ * are allocated from the largest to the smallest, they can be laid out along the Morton order
+ * of the smallest tiles without ever leaving a hole, so a cursor is all the state we need.
+ */
+class ShadowAtlas {
+public:
+    // the smallest shadow maps cover 1/4^MAX_LEVEL of a layer
+    static constexpr uint8_t MAX_LEVEL = 3;
+
+    struct Tile {
+        uint8_t layer;
+        uint32_t x;         // position of the tile in its layer, in texels
+        uint32_t y;
+        uint32_t size;      // dimension of the tile, in texels
+    };
+
+    // rounds a dimension up, so that the tiles of all levels have a whole number of texels
+    static uint32_t getLayerDimension(uint32_t dimension) noexcept;
+
+    // the deepest level whose tiles are at least 'size' texels wide
+    static uint8_t getLevel(uint32_t layerDimension, uint32_t size) noexcept;
+
+    // starts a new layout, in layers of dimension 'layerDimension' (as returned by
+    // getLayerDimension()), the first one being 'firstLayer'.
+    void reset(uint32_t layerDimension, uint8_t firstLayer) noexcept;
+
+    // allocates a tile of the given level. Levels must be allocated in increasing order.
+    Tile allocate(uint8_t level) noexcept;
+
+    // number of layers used so far, including the ones before the first layer
+    uint8_t getLayerCount() const noexcept { return mCursor ? mLayer + 1 : mLayer; }
+
+private:
+    static constexpr uint32_t TILES_PER_LAYER = 1u << (2u * MAX_LEVEL);
+
+    uint32_t mDimension = 0;
+    uint32_t mCursor = 0;   // Morton code of the next free tile of level MAX_LEVEL
+    uint8_t mLayer = 0;
+    uint8_t mLevel = 0;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_SHADOWATLAS_H
@@ -55,6 +55,9 @@ public:
         // the dimension of the actual shadow map, taking into account the 1 texel border
         // e.g., for a texture dimension of 512, shadowDimension would be 510
         size_t shadowDimension = 0;
+
+        // the position of the shadow map texture within the atlas, in texels
+        math::uint2 offset = {};
     };
 
     struct CascadeParameters {
@@ -75,7 +78,8 @@ public:
 
     // Call once per frame to populate the CascadeParameters struct, then pass to update().
     // This computes values constant across all cascades.
-    static void computeSceneCascadeParams(const FScene::LightSoa& lightData, size_t index,
+    static void computeSceneCascadeParams(utils::JobSystem& js,
+            const FScene::LightSoa& lightData, size_t index,
             FScene const* scene, filament::CameraInfo const& camera, uint8_t visibleLayers,
             CascadeParameters& cascadeParams);
 
@@ -85,9 +89,11 @@ public:
             filament::CameraInfo const& camera, uint8_t visibleLayers,
             ShadowMapLayout layout, const CascadeParameters& cascadeParams) noexcept;
 
+    // when clear is false, the render target is loaded instead of cleared, which preserves the
+    // other shadow maps of the atlas.
     void render(backend::DriverApi& driver, backend::Handle<backend::HwRenderTarget> rt,
             filament::Viewport const& viewport, utils::Range<uint32_t> const& range,
-            RenderPass& pass, FView& view) noexcept;
+            RenderPass& pass, FView& view, bool clear = true) noexcept;
 
     // Do we have visible shadows. Valid after calling update().
     bool hasVisibleShadows() const noexcept { return mHasVisibleShadows; }
@@ -96,6 +102,9 @@ public:
     // Valid after calling update().
     math::mat4f const& getLightSpaceMatrix() const noexcept { return mLightSpace; }
 
+    // Polygon offset used to render the shadow map. Valid after calling update().
+    backend::PolygonOffset const& getPolygonOffset() const noexcept { return mPolygonOffset; }
+
     // return the size of a texel in world space (pre-warping)
     float getTexelSizeWorldSpace() const noexcept { return mTexelSizeWs; }
 
@@ -105,6 +114,17 @@ public:
     // use only for debugging
     FCamera const& getDebugCamera() const noexcept { return *mDebugCamera; }
 
+    // Computes the bounds of the shadow casters and receivers of the scene, and their near/far
+    // planes in light space (Mv) and view space (V) respectively. This is a parallel reduction
+    // over the renderables.
+    static void visitScene(utils::JobSystem& js, FScene const& scene, uint32_t visibleLayers,
+            math::mat4f const& Mv, math::mat4f const& V, CascadeParameters& cascadeParams) noexcept;
+
+    // same as above, for the renderables in [first, last)
+    static void visitScene(FScene const& scene, uint32_t visibleLayers,
+            math::mat4f const& Mv, math::mat4f const& V, CascadeParameters& cascadeParams,
+            size_t first, size_t last) noexcept;
+
 private:
     struct CameraInfo {
         math::mat4f projection;
@@ -153,19 +173,12 @@ private:
     static inline void computeFrustumCorners(math::float3* out,
             const math::mat4f& projectionViewInverse, math::float2 csNearFar = { -1.0f, 1.0f }) noexcept;
 
-    static inline math::float2 computeNearFar(math::mat4f const& view,
-            Aabb const& wsShadowCastersVolume) noexcept;
-
     static inline math::float2 computeNearFar(math::mat4f const& view,
             math::float3 const* wsVertices, size_t count) noexcept;
 
     static inline math::float4 computeBoundingSphere(
             math::float3 const* vertices, size_t count) noexcept;
 
-    template<typename Casters, typename Receivers>
-    static void visitScene(FScene const& scene, uint32_t visibleLayers,
-            Casters casters, Receivers receivers) noexcept;
-
     static inline Aabb compute2DBounds(const math::mat4f& lightView,
             math::float3 const* wsVertices, size_t count) noexcept;
 
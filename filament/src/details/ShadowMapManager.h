@@ -17,6 +17,8 @@
 #ifndef TNT_FILAMENT_DETAILS_SHADOWMAPMANAGER_H
 #define TNT_FILAMENT_DETAILS_SHADOWMAPMANAGER_H
 
+#include "details/ShadowMap.h"
+
 #include <filament/Viewport.h>
 
 #include <private/backend/DriverApi.h>
@@ -29,6 +31,7 @@
 #include <backend/DriverEnums.h>
 #include <backend/Handle.h>
 
+#include <math/mat4.h>
 #include <math/vec3.h>
 
 #include <array>
@@ -39,7 +42,6 @@ namespace filament {
 
 class FView;
 
-class ShadowMap;
 class RenderPass;
 
 class ShadowMapManager {
@@ -54,7 +56,9 @@ public:
     void reset() noexcept;
 
     void setShadowCascades(size_t lightIndex, size_t cascades) noexcept;
-    void addSpotShadowMap(size_t lightIndex) noexcept;
+    // screenSize is the projected diameter of the light's sphere, divided by the viewport's
+    // height. Spot lights that cover less of the screen get smaller shadow maps.
+    void addSpotShadowMap(size_t lightIndex, float screenSize) noexcept;
 
     // Allocates shadow texture based on the shadows maps and their requirements.
     void prepare(FEngine& engine, backend::DriverApi& driver, backend::SamplerGroup& samplerGroup,
@@ -72,10 +76,20 @@ public:
         return mCascadeShadowMapCache[c].get();
     }
 
+    const ShadowMap* getSpotShadowMap(size_t i) const noexcept {
+        return mSpotShadowMapCache[i].get();
+    }
+
 private:
 
-    bool updateCascadeShadowMaps(FEngine& engine, FView& view, UniformBuffer& perViewUb,
+    // Computes the scene's bounds and the cascade splits, and culls the directional shadow casters.
+    void prepareCascadeShadowMaps(FEngine& engine, FView& view, UniformBuffer& perViewUb,
             FScene::RenderableSoa& renderableData, FScene::LightSoa& lightData) noexcept;
+    // Computes the cameras of all the shadow maps, in parallel unless disabled for debugging.
+    void updateShadowMapCameras(FEngine& engine, FView& view,
+            FScene::LightSoa& lightData) noexcept;
+    bool updateCascadeShadowMaps(FEngine& engine, UniformBuffer& perViewUb,
+            FScene::LightSoa& lightData) noexcept;
     bool updateSpotShadowMaps(FEngine& engine, FView& view, UniformBuffer& shadowUb,
             FScene::RenderableSoa& renderableData, FScene::LightSoa& lightData) noexcept;
     void fillWithDebugPattern(backend::DriverApi& driverApi,
@@ -84,16 +98,23 @@ private:
 
     struct ShadowLayout {
         uint8_t layer = 0;
+        uint32_t x = 0;         // position of the shadow map in its layer
+        uint32_t y = 0;
         uint32_t size = 0;
+
+        bool operator==(const ShadowLayout& rhs) const {
+            return layer == rhs.layer && x == rhs.x && y == rhs.y && size == rhs.size;
+        }
     };
 
     class ShadowMapEntry {
     public:
         ShadowMapEntry() = default;
-        ShadowMapEntry(ShadowMap* shadowMap, const size_t light) :
+        ShadowMapEntry(ShadowMap* shadowMap, const size_t light, float screenSize = 0.0f) :
                 mShadowMap(shadowMap),
                 mLightIndex(light),
-                mLayout({}) {}
+                mLayout({}),
+                mScreenSize(screenSize) {}
 
         explicit operator bool() const { return mShadowMap != nullptr; }
 
@@ -101,6 +122,7 @@ private:
         size_t getLightIndex() const { return mLightIndex; }
         const ShadowLayout& getLayout() const { return mLayout; }
         bool hasVisibleShadows() const { return mHasVisibleShadows; }
+        float getScreenSize() const { return mScreenSize; }
 
         void setHasVisibleShadows(bool hasVisibleShadows) { mHasVisibleShadows = hasVisibleShadows; }
         void setLayout(const ShadowLayout& layout) { mLayout = layout; }
@@ -109,9 +131,33 @@ private:
         ShadowMap* mShadowMap = nullptr;
         size_t mLightIndex = 0;
         ShadowLayout mLayout = {};
+        float mScreenSize = 0.0f;
         bool mHasVisibleShadows = false;
     };
 
+    // What a spot shadow map was rendered with. The shadow map doesn't need to be rendered again
+    // as long as all of this stays the same.
+    struct SpotShadowState {
+        math::mat4 projection;      // the light's projection, includes the light's transform
+        ShadowLayout layout;
+        backend::PolygonOffset polygonOffset;
+        uint64_t casters;           // see getSpotShadowCasters()
+
+        bool operator==(const SpotShadowState& rhs) const {
+            return projection == rhs.projection && layout == rhs.layout &&
+                   polygonOffset.slope == rhs.polygonOffset.slope &&
+                   polygonOffset.constant == rhs.polygonOffset.constant &&
+                   casters == rhs.casters;
+        }
+    };
+
+    // Computes a signature of the casters of the spot shadow map i, which changes when any of
+    // them moves, appears or disappears. Returns false if the casters can change without moving
+    // (e.g. skinned or instanced renderables), in which case the shadow map can't be cached.
+    static bool getSpotShadowCasters(FView const& view, size_t i, uint64_t& signature) noexcept;
+
+    ShadowMap::ShadowMapLayout getShadowMapLayout(ShadowMapEntry const& entry) const noexcept;
+
     struct TextureState {
         uint16_t size;
         uint8_t layers;
@@ -156,6 +202,9 @@ private:
     } mCascadeSplits;
     CascadeSplits::Params mCascadeSplitParams;
 
+    // scene-dependent values shared across all cascades, computed by prepareCascadeShadowMaps()
+    ShadowMap::CascadeParameters mCascadeParams;
+
     // 16-bits seems enough.
     // TODO: make it an option.
     // TODO: iOS does not support the DEPTH16 texture format.
@@ -167,6 +216,12 @@ private:
     std::vector<ShadowMapEntry> mCascadeShadowMaps;
     std::vector<ShadowMapEntry> mSpotShadowMaps;
 
+    // spot shadow maps currently in the texture, they're rendered again only when they change
+    std::vector<SpotShadowState> mSpotShadowCache;
+
+    // the directional shadow casters are culled against the whole camera frustum, using the
+    // camera of this shadow map
+    std::unique_ptr<ShadowMap> mCullingShadowMap;
     std::array<std::unique_ptr<ShadowMap>, CONFIG_MAX_SHADOW_CASCADES> mCascadeShadowMapCache;
     std::array<std::unique_ptr<ShadowMap>, CONFIG_MAX_SHADOW_CASTING_SPOTS> mSpotShadowMapCache;
 };
@@ -22,17 +22,21 @@
 #include "upcast.h"
 
 #include "FrameInfo.h"
+#include "RenderPass.h"
 #include "UniformBuffer.h"
 
 #include "details/Allocators.h"
 #include "details/Camera.h"
 #include "details/ColorGrading.h"
 #include "details/Froxelizer.h"
+#include "details/OcclusionCuller.h"
 #include "details/RenderTarget.h"
 #include "details/ShadowMap.h"
 #include "details/ShadowMapManager.h"
 #include "details/Scene.h"
 
+#include "fg/FrameGraphCompileCache.h"
+
 #include <private/filament/EngineEnums.h>
 
 #include "private/backend/DriverApi.h"
@@ -47,6 +51,11 @@
 
 #include <math/scalar.h>
 
+#include <tsl/robin_map.h>
+
+#include <algorithm>
+#include <vector>
+
 namespace utils {
 class JobSystem;
 } // namespace utils;
@@ -173,16 +182,33 @@ public:
 
     void renderShadowMaps(FEngine& engine, FEngine::DriverApi& driver, RenderPass& pass) noexcept;
 
+    // caches of the commands of the structure and color passes, reused across frames
+    RenderPass::CommandCache& getStructureCommandCache() noexcept { return mStructureCommandCache; }
+    RenderPass::CommandCache& getColorCommandCache() noexcept { return mColorCommandCache; }
+
+    // the compiled frame graph of the previous frame, see FRenderer::renderJob()
+    FrameGraphCompileCache& getFrameGraphCompileCache() noexcept { return mFrameGraphCompileCache; }
+
     void updatePrimitivesLod(
             FEngine& engine, const CameraInfo& camera,
             FScene::RenderableSoa& renderableData, Range visible) noexcept;
 
+    // Selects the level of detail for the given screen size, starting from the current level so
+    // that a threshold must be crossed by more than the hysteresis margin to switch levels.
+    static uint8_t selectLevelOfDetail(FRenderableManager::LevelOfDetail const& lod,
+            uint8_t level, float screenSize, float hysteresis) noexcept;
+
+    // projected diameter of the bounding sphere of a box, divided by the viewport's height
+    float getScreenSize(math::float3 const& center, math::float3 const& extent) const noexcept;
+
     void setShadowsEnabled(bool enabled) noexcept { mShadowingEnabled = enabled; }
 
     FCamera const* getDirectionalLightCamera() const noexcept {
         return &mShadowMapManager.getCascadeShadowMap(0)->getDebugCamera();
     }
 
+    ShadowMapManager const& getShadowMapManager() const noexcept { return mShadowMapManager; }
+
     void setRenderTarget(FRenderTarget* renderTarget) noexcept {
         mRenderTarget = renderTarget;
     }
@@ -326,6 +352,29 @@ public:
         return mVignetteOptions;
     }
 
+    void setOcclusionCullingOptions(OcclusionCullingOptions options) noexcept {
+        options.resolution = math::clamp(options.resolution, uint16_t(64), uint16_t(1024));
+        mOcclusionCullingOptions = options;
+    }
+
+    OcclusionCullingOptions getOcclusionCullingOptions() const noexcept {
+        return mOcclusionCullingOptions;
+    }
+
+    OcclusionCullingStatistics getOcclusionCullingStatistics() const noexcept {
+        return mOcclusionCullingStatistics;
+    }
+
+    void setLevelOfDetailOptions(LevelOfDetailOptions options) noexcept {
+        options.hysteresis = math::clamp(options.hysteresis, 0.0f, 0.5f);
+        options.smallFeatureCulling = std::max(options.smallFeatureCulling, 0.0f);
+        mLevelOfDetailOptions = options;
+    }
+
+    LevelOfDetailOptions getLevelOfDetailOptions() const noexcept {
+        return mLevelOfDetailOptions;
+    }
+
     void setBlendMode(BlendMode blendMode) noexcept {
         mBlendMode = blendMode;
     }
@@ -355,8 +404,14 @@ public:
         return mRenderTarget == nullptr ? kEmptyHandle : mRenderTarget->getHwHandle();
     }
 
+    // Sets selected[i] for the maxCount largest sizes, and clears it for the others. When there
+    // are ties, the first ones are selected. scratch is used for a partial sort of the sizes.
+    static void selectLargest(float const* sizes, size_t count, size_t maxCount,
+            uint8_t* selected, std::vector<float>& scratch) noexcept;
+
+    // bvh, if not null, must be the hierarchy over renderableData's rows (see FScene)
     static void cullRenderables(utils::JobSystem& js, FScene::RenderableSoa& renderableData,
-            Frustum const& frustum, size_t bit) noexcept;
+            Frustum const& frustum, size_t bit, CullingBvh const* bvh = nullptr) noexcept;
 
     UniformBuffer& getViewUniforms() const { return mPerViewUb; }
     backend::SamplerGroup& getViewSamplers() const { return mPerViewSb; }
@@ -364,11 +419,28 @@ public:
 
 private:
     void prepareVisibleRenderables(utils::JobSystem& js,
-            Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
-
-    static void prepareVisibleLights(
+            Frustum const& frustum, FScene::RenderableSoa& renderableData,
+            CullingBvh const* bvh) const noexcept;
+
+    // clears the VISIBLE_RENDERABLE bit of the renderables hidden by occluders
+    void cullOccludedRenderables(utils::JobSystem& js, FRenderableManager const& rcm,
+            math::mat4f const& viewProjection, filament::Viewport const& viewport,
+            FScene::RenderableSoa& renderableData) noexcept;
+
+    // clears the VISIBLE_RENDERABLE bit of the renderables too small to be seen
+    void cullSmallRenderables(filament::Viewport const& viewport,
+            FScene::RenderableSoa& renderableData) const noexcept;
+
+    // culls the instances of the visible instanced renderables, and uploads the visible ones.
+    // Clears the VISIBLE_RENDERABLE bit of the renderables without visible instances.
+    void cullInstances(backend::DriverApi& driver, FRenderableManager const& rcm,
+            FScene::RenderableSoa& renderableData) noexcept;
+
+    // bvh is the hierarchy over the point and spot lights, if any. When more lights than
+    // CONFIG_MAX_LIGHT_COUNT are visible, the ones with the largest screen size are kept.
+    void prepareVisibleLights(
             FLightManager const& lcm, utils::JobSystem& js, Frustum const& frustum,
-            FScene::LightSoa& lightData) noexcept;
+            FScene::LightSoa& lightData, CullingBvh const* bvh) noexcept;
 
     static void computeVisibilityMasks(
             uint8_t visibleLayers, uint8_t const* layers,
@@ -377,7 +449,6 @@ private:
 
     void bindPerViewUniformsAndSamplers(FEngine::DriverApi& driver) const noexcept {
         driver.bindUniformBuffer(BindingPoints::PER_VIEW, mPerViewUbh);
-        driver.bindUniformBuffer(BindingPoints::LIGHTS, mLightUbh);
         driver.bindUniformBuffer(BindingPoints::SHADOW, mShadowUbh);
         driver.bindSamplers(BindingPoints::PER_VIEW, mPerViewSbh);
     }
@@ -390,7 +461,6 @@ private:
     // these are accessed in the render loop, keep together
     backend::Handle<backend::HwSamplerGroup> mPerViewSbh;
     backend::Handle<backend::HwUniformBuffer> mPerViewUbh;
-    backend::Handle<backend::HwUniformBuffer> mLightUbh;
     backend::Handle<backend::HwUniformBuffer> mShadowUbh;
     backend::Handle<backend::HwUniformBuffer> mRenderableUbh;
 
@@ -422,6 +492,18 @@ private:
     FogOptions mFogOptions;
     DepthOfFieldOptions mDepthOfFieldOptions;
     VignetteOptions mVignetteOptions;
+    OcclusionCullingOptions mOcclusionCullingOptions;
+    OcclusionCullingStatistics mOcclusionCullingStatistics;
+    OcclusionCuller mOcclusionCuller;
+    LevelOfDetailOptions mLevelOfDetailOptions;
+    math::float4 mScreenSizeDepth{};        // w row of the culling camera's view-projection
+    float mScreenSizeScale = 0.0f;          // vertical scale of the culling camera's projection
+    tsl::robin_map<utils::Entity, uint8_t> mLevelsOfDetail; // unbiased level of each renderable
+    std::vector<float> mLightScreenSizes;       // scratch buffers of prepareVisibleLights()
+    std::vector<float> mSortedLightScreenSizes;
+    std::vector<math::float3> mInstanceCenters;             // scratch buffers of cullInstances()
+    std::vector<math::float3> mInstanceExtents;
+    std::vector<Culler::result_type> mInstanceVisibility;
     BlendMode mBlendMode = BlendMode::OPAQUE;
     const FColorGrading* mColorGrading = nullptr;
     const FColorGrading* mDefaultColorGrading = nullptr;
@@ -448,6 +530,10 @@ private:
     mutable bool mHasShadowing = false;
 
     ShadowMapManager mShadowMapManager;
+
+    RenderPass::CommandCache mStructureCommandCache;
+    RenderPass::CommandCache mColorCommandCache;
+    FrameGraphCompileCache mFrameGraphCompileCache;
 };
 
 FILAMENT_UPCAST(View)
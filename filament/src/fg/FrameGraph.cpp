@@ -16,12 +16,14 @@
 
 #include "FrameGraph.h"
 
+#include "FrameGraphCompileCache.h"
 #include "FrameGraphPassResources.h"
 #include "FrameGraphHandle.h"
 
 #include "fg/ResourceNode.h"
 #include "fg/PassNode.h"
 #include "fg/VirtualResource.h"
+#include "fg/ResourceAllocator.h"
 
 #include "details/Engine.h"
 
@@ -30,6 +32,10 @@
 
 #include <utils/Panic.h>
 #include <utils/Log.h>
+#include <utils/Systrace.h>
+
+#include <algorithm>
+#include <chrono>
 
 using namespace utils;
 
@@ -92,7 +98,8 @@ FrameGraph::FrameGraph(fg::ResourceAllocatorInterface& resourceAllocator)
           mPassNodes(mArena),
           mResourceNodes(mArena),
           mResourceNodeEntries(mArena),
-          mResourceEntries(mArena) {
+          mResourceEntries(mArena),
+          mPassProfiles(mArena) {
     mPassNodes.reserve(32);
     mResourceNodes.reserve(64);
     mResourceNodeEntries.reserve(64);
@@ -367,6 +374,9 @@ FrameGraph& FrameGraph::compile() noexcept {
         }
     }
 
+    // this needs the final descriptors of the textures, so it must happen after resolve()
+    aliasTextures();
+
     // add resource to de-virtualize or destroy to the corresponding list for each active pass
     // but add them in priority order (this is so that rendertargets are added after textures)
     for (size_t priority = 0; priority < 2; priority++) {
@@ -386,6 +396,371 @@ FrameGraph& FrameGraph::compile() noexcept {
     return *this;
 }
 
+FrameGraph& FrameGraph::compile(FrameGraphCompileCache& cache) noexcept {
+    SYSTRACE_CALL();
+    using namespace std::chrono;
+    FrameGraphCompileCache::Statistics& stats = cache.mStatistics;
+
+    const steady_clock::time_point start = steady_clock::now();
+    computeSignature(cache.mScratch);
+    if (cache.mScratch == cache.mSignature) {
+        loadCompiledGraph(cache);
+        stats.hits++;
+        stats.cachedTime = duration_cast<nanoseconds>(steady_clock::now() - start);
+        if (stats.compileTime > stats.cachedTime) {
+            stats.savedTime += stats.compileTime - stats.cachedTime;
+        }
+    } else {
+        // only compile() is timed, so that the saved time isn't overestimated
+        const steady_clock::time_point compileStart = steady_clock::now();
+        compile();
+        stats.compileTime = duration_cast<nanoseconds>(steady_clock::now() - compileStart);
+        stats.misses++;
+        saveCompiledGraph(cache);
+        std::swap(cache.mSignature, cache.mScratch);
+    }
+
+    SYSTRACE_CONTEXT();
+    SYSTRACE_VALUE32("fg.compileSavedUs",
+            uint32_t(duration_cast<microseconds>(stats.savedTime).count()));
+    return *this;
+}
+
+void FrameGraph::computeSignature(std::vector<uint32_t>& signature) noexcept {
+    constexpr uint32_t NONE = FrameGraphCompileCache::NONE;
+    auto& resourceNodeEntries = mResourceNodeEntries;
+
+    signature.clear();
+    signature.push_back(uint32_t(mPassNodes.size()));
+    signature.push_back(uint32_t(mResourceNodes.size()));
+    signature.push_back(uint32_t(mResourceEntries.size()));
+
+    auto addHandles = [&signature](auto const& handles) {
+        signature.push_back(uint32_t(handles.size()));
+        for (FrameGraphHandle handle : handles) {
+            signature.push_back(handle.index);
+        }
+    };
+    for (PassNode const& pass : mPassNodes) {
+        signature.push_back(pass.hasSideEffect);
+        addHandles(pass.reads);
+        addHandles(pass.writes);
+        addHandles(pass.samples);
+        addHandles(pass.renderTargets);
+    }
+
+    // moveResource() can make several handles share the same node, so nodes are identified
+    // by their index in mResourceNodeEntries
+    for (size_t i = 0, c = mResourceNodes.size(); i < c; i++) {
+        ResourceNode const* const node = mResourceNodes[i];
+        size_t index = i;
+        if (resourceNodeEntries[i].get() != node) {
+            index = std::find_if(resourceNodeEntries.begin(), resourceNodeEntries.end(),
+                    [node](auto const& entry) { return entry.get() == node; })
+                            - resourceNodeEntries.begin();
+        }
+        signature.push_back(uint32_t(index));
+        signature.push_back(node->resource->id);
+        signature.push_back(node->version);
+        signature.push_back(node->writer ? node->writer->id : NONE);
+    }
+
+    // the other descriptors don't change the result of compile()
+    for (UniquePtr<ResourceEntryBase> const& resource : mResourceEntries) {
+        signature.push_back(uint32_t(resource->imported) | uint32_t(resource->priority) << 8u |
+                            uint32_t(resource->version) << 16u);
+        if (ResourceEntry<FrameGraphTexture> const* texture = resource->asTextureResourceEntry()) {
+            FrameGraphTexture::Descriptor const& desc = texture->descriptor;
+            signature.insert(signature.end(), {
+                    1u, desc.width, desc.height, desc.depth,
+                    uint32_t(desc.levels) | uint32_t(desc.samples) << 8u |
+                    uint32_t(desc.type) << 16u,
+                    uint32_t(desc.format), uint32_t(desc.usage) });
+        } else if (RenderTargetResourceEntry const* rt = resource->asRenderTargetResourceEntry()) {
+            signature.push_back(2u);
+            for (auto const& attachment : rt->descriptor.attachments.textures) {
+                signature.push_back(attachment.isValid() ?
+                        attachment.getHandle().index | uint32_t(attachment.getLevel()) << 16u :
+                        NONE);
+            }
+            signature.push_back(rt->descriptor.samples);
+        } else {
+            signature.push_back(0u);
+        }
+    }
+}
+
+void FrameGraph::saveCompiledGraph(FrameGraphCompileCache& cache) noexcept {
+    constexpr uint16_t NONE = FrameGraphCompileCache::NONE;
+    auto& resourceLists = cache.mResourceLists;
+
+    cache.mPasses.clear();
+    resourceLists.clear();
+    for (PassNode const& pass : mPassNodes) {
+        FrameGraphCompileCache::Pass p{ pass.refCount,
+                uint32_t(resourceLists.size()), uint32_t(pass.devirtualize.size()),
+                uint32_t(resourceLists.size() + pass.devirtualize.size()),
+                uint32_t(pass.destroy.size()) };
+        for (VirtualResource* resource : pass.devirtualize) {
+            resourceLists.push_back(static_cast<ResourceEntryBase*>(resource)->id);
+        }
+        for (VirtualResource* resource : pass.destroy) {
+            resourceLists.push_back(static_cast<ResourceEntryBase*>(resource)->id);
+        }
+        cache.mPasses.push_back(p);
+    }
+
+    cache.mReaderCounts.clear();
+    for (UniquePtr<ResourceNode> const& node : mResourceNodeEntries) {
+        cache.mReaderCounts.push_back(node->readerCount);
+    }
+
+    cache.mResources.clear();
+    cache.mConcreteDescriptors.clear();
+    for (UniquePtr<ResourceEntryBase> const& resource : mResourceEntries) {
+        FrameGraphCompileCache::Resource r{};
+        r.refs = resource->refs;
+        r.first = resource->first ? uint16_t(resource->first->id) : NONE;
+        r.last = resource->last ? uint16_t(resource->last->id) : NONE;
+        r.aliasOf = NONE;
+        r.concreteDescriptor = NONE;
+        if (ResourceEntry<FrameGraphTexture> const* texture = resource->asTextureResourceEntry()) {
+            r.usage = texture->descriptor.usage;
+            r.samples = texture->descriptor.samples;
+            r.aliased = texture->aliased;
+            if (texture->aliasOf) {
+                r.aliasOf = texture->aliasOf->id;
+            }
+            if (texture->concreteDescriptor) {
+                r.concreteDescriptor = uint16_t(cache.mConcreteDescriptors.size());
+                cache.mConcreteDescriptors.push_back(*texture->concreteDescriptor);
+            }
+        }
+        cache.mResources.push_back(r);
+    }
+
+    cache.mTextureMemoryStatistics = mTextureMemoryStatistics;
+}
+
+void FrameGraph::loadCompiledGraph(FrameGraphCompileCache const& cache) noexcept {
+    constexpr uint16_t NONE = FrameGraphCompileCache::NONE;
+    Vector<PassNode>& passNodes = mPassNodes;
+    Vector<UniquePtr<ResourceEntryBase>>& resourceRegistry = mResourceEntries;
+
+    for (size_t i = 0, c = mResourceNodeEntries.size(); i < c; i++) {
+        mResourceNodeEntries[i]->readerCount = cache.mReaderCounts[i];
+    }
+
+    for (size_t i = 0, c = resourceRegistry.size(); i < c; i++) {
+        FrameGraphCompileCache::Resource const& r = cache.mResources[i];
+        ResourceEntryBase* const resource = resourceRegistry[i].get();
+        resource->refs = r.refs;
+        resource->first = r.first != NONE ? &passNodes[r.first] : nullptr;
+        resource->last = r.last != NONE ? &passNodes[r.last] : nullptr;
+        if (ResourceEntry<FrameGraphTexture>* texture = resource->asTextureResourceEntry()) {
+            // the usage and sample count as updated by compile()
+            texture->descriptor.usage = r.usage;
+            texture->descriptor.samples = r.samples;
+            texture->aliased = r.aliased;
+            texture->aliasOf = r.aliasOf != NONE ?
+                    resourceRegistry[r.aliasOf]->asTextureResourceEntry() : nullptr;
+            texture->concreteDescriptor = r.concreteDescriptor != NONE ?
+                    mArena.make<FrameGraphTexture::Descriptor>(
+                            cache.mConcreteDescriptors[r.concreteDescriptor]) : nullptr;
+        }
+    }
+
+    // render targets are still resolved, because they also apply the parameters of their
+    // descriptors (viewport, clear color...), which are not part of the signature
+    for (UniquePtr<ResourceEntryBase> const& resource : resourceRegistry) {
+        if (resource->refs) {
+            resource->resolve(*this);
+        }
+    }
+
+    auto const& resourceLists = cache.mResourceLists;
+    for (size_t i = 0, c = passNodes.size(); i < c; i++) {
+        FrameGraphCompileCache::Pass const& p = cache.mPasses[i];
+        PassNode& pass = passNodes[i];
+        pass.refCount = p.refCount;
+        for (size_t j = p.devirtualize; j < p.devirtualize + p.devirtualizeCount; j++) {
+            pass.devirtualize.push_back(resourceRegistry[resourceLists[j]].get());
+        }
+        for (size_t j = p.destroy; j < p.destroy + p.destroyCount; j++) {
+            pass.destroy.push_back(resourceRegistry[resourceLists[j]].get());
+        }
+    }
+
+    mTextureMemoryStatistics = cache.mTextureMemoryStatistics;
+}
+
+static size_t getTextureSize(FrameGraphTexture::Descriptor const& desc) noexcept {
+    // see FrameGraphTexture::create()
+    bool const sampleable = any(desc.usage & TextureUsage::SAMPLEABLE);
+    return ResourceAllocator::getTextureSize(desc.format,
+            sampleable ? desc.levels : uint8_t(1), sampleable ? uint8_t(1) : desc.samples,
+            desc.width, desc.height, desc.depth);
+}
+
+// Computes the descriptor of a texture that can be used in place of both lhs and rhs, returns
+// false if there isn't one.
+static bool mergeTextureDescriptors(FrameGraphTexture::Descriptor const& lhs,
+        FrameGraphTexture::Descriptor const& rhs, FrameGraphTexture::Descriptor* out) noexcept {
+    // textures that can't be sampled have a single level, see FrameGraphTexture::create()
+    auto getLevels = [](FrameGraphTexture::Descriptor const& desc) {
+        return any(desc.usage & TextureUsage::SAMPLEABLE) ? desc.levels : uint8_t(1);
+    };
+    bool const sampleable = any((lhs.usage | rhs.usage) & TextureUsage::SAMPLEABLE);
+    if (lhs.type != rhs.type || lhs.format != rhs.format || lhs.depth != rhs.depth ||
+            lhs.samples != rhs.samples || getLevels(lhs) != getLevels(rhs) ||
+            (sampleable && lhs.samples > 1)) {
+        return false;
+    }
+
+    bool const sameSize = lhs.width == rhs.width && lhs.height == rhs.height;
+#if defined(__EMSCRIPTEN__)
+    // some WebGL implementations don't support attachments of different sizes, see
+    // ResourceAllocator::createTexture()
+    if (!sameSize) {
+        return false;
+    }
+#else
+    // textures are sampled with normalized coordinates, so they can't be larger than needed
+    if (!sameSize && sampleable) {
+        return false;
+    }
+#endif
+
+    *out = lhs;
+    out->width = std::max(lhs.width, rhs.width);
+    out->height = std::max(lhs.height, rhs.height);
+    out->levels = getLevels(lhs);
+    out->usage = lhs.usage | rhs.usage;
+    return true;
+}
+
+void FrameGraph::aliasTextures() noexcept {
+    using TextureEntry = ResourceEntry<FrameGraphTexture>;
+    Vector<ResourceNode*>& resourceNodes = mResourceNodes;
+
+    struct Lifetime {
+        TextureEntry* entry;
+        uint32_t first;     // id of the first pass using the texture
+        uint32_t last;      // id of the last pass using the texture
+        size_t size;
+    };
+
+    Vector<Lifetime> textures(mArena);
+    for (UniquePtr<ResourceEntryBase> const& resource : mResourceEntries) {
+        TextureEntry* const entry = resource->asTextureResourceEntry();
+        if (entry && !entry->imported && entry->refs && entry->first &&
+                any(entry->descriptor.usage)) {
+            entry->concreteDescriptor = nullptr;
+            entry->aliasOf = nullptr;
+            entry->aliased = false;
+            textures.push_back({ entry, entry->first->id, entry->last->id,
+                                 getTextureSize(entry->descriptor) });
+        }
+    }
+
+    // the attachments of a render target must exist as long as it does
+    for (UniquePtr<ResourceEntryBase> const& resource : mResourceEntries) {
+        RenderTargetResourceEntry* const rt = resource->asRenderTargetResourceEntry();
+        if (!rt || !rt->refs || !rt->first) {
+            continue;
+        }
+        for (auto const& attachment : rt->descriptor.attachments.textures) {
+            if (!attachment.isValid()) {
+                continue;
+            }
+            ResourceEntryBase const* const entry =
+                    resourceNodes[attachment.getHandle().index]->resource;
+            auto pos = std::find_if(textures.begin(), textures.end(),
+                    [entry](Lifetime const& t) { return t.entry == entry; });
+            if (pos != textures.end()) {
+                pos->first = std::min(pos->first, rt->first->id);
+                pos->last = std::max(pos->last, rt->last->id);
+            }
+        }
+    }
+
+    std::sort(textures.begin(), textures.end(), [](Lifetime const& lhs, Lifetime const& rhs) {
+        return lhs.first < rhs.first;
+    });
+
+    // Each texture uses the concrete texture that grows the least among the ones that are no
+    // longer in use when it's first needed, or gets its own.
+    struct Concrete {
+        TextureEntry* head;     // the texture that creates the concrete texture
+        TextureEntry* tail;     // the last texture using it so far
+        uint32_t last;
+        size_t size;
+        FrameGraphTexture::Descriptor descriptor;
+    };
+
+    Vector<Concrete> concretes(mArena);
+    concretes.reserve(textures.size());
+    for (Lifetime const& texture : textures) {
+        Concrete* best = nullptr;
+        size_t bestGrowth = std::numeric_limits<size_t>::max();
+        FrameGraphTexture::Descriptor bestDescriptor;
+        if (mTextureAliasing) {
+            for (Concrete& concrete : concretes) {
+                FrameGraphTexture::Descriptor merged;
+                if (concrete.last < texture.first &&
+                        mergeTextureDescriptors(concrete.descriptor,
+                                texture.entry->descriptor, &merged)) {
+                    size_t const growth = getTextureSize(merged) - concrete.size;
+                    if (growth < bestGrowth) {
+                        best = &concrete;
+                        bestGrowth = growth;
+                        bestDescriptor = merged;
+                    }
+                }
+            }
+        }
+        if (best) {
+            texture.entry->aliasOf = best->tail;
+            best->tail->aliased = true;
+            best->tail = texture.entry;
+            best->last = texture.last;
+            best->size += bestGrowth;
+            best->descriptor = bestDescriptor;
+        } else {
+            concretes.push_back({ texture.entry, texture.entry, texture.last, texture.size,
+                                  texture.entry->descriptor });
+        }
+    }
+
+    TextureMemoryStatistics stats;
+    stats.textureCount = uint32_t(textures.size());
+    stats.concreteTextureCount = uint32_t(concretes.size());
+    for (Concrete const& concrete : concretes) {
+        if (concrete.head != concrete.tail) {
+            concrete.head->concreteDescriptor =
+                    mArena.make<FrameGraphTexture::Descriptor>(concrete.descriptor);
+        }
+        stats.aliasedSize += concrete.size;
+    }
+    for (Lifetime const& texture : textures) {
+        stats.totalSize += texture.size;
+    }
+    for (PassNode const& pass : mPassNodes) {
+        size_t size = 0;
+        for (Lifetime const& texture : textures) {
+            if (texture.first <= pass.id && pass.id <= texture.last) {
+                size += texture.size;
+            }
+        }
+        stats.peakSize = std::max(stats.peakSize, size);
+    }
+    mTextureMemoryStatistics = stats;
+
+    SYSTRACE_CONTEXT();
+    SYSTRACE_VALUE32("fg.texturePeakKiB", uint32_t(stats.peakSize >> 10u));
+    SYSTRACE_VALUE32("fg.textureAliasedKiB", uint32_t(stats.aliasedSize >> 10u));
+}
+
 void FrameGraph::executeInternal(PassNode const& node, DriverApi& driver) noexcept {
     assert(node.base);
     // create concrete resources and rendertargets
@@ -419,6 +794,17 @@ void FrameGraph::executeInternal(PassNode const& node, DriverApi& driver) noexce
     });
 }
 
+void FrameGraph::executeProfiled(PassNode const& node, DriverApi& driver) noexcept {
+    assert(node.id < mPassProfiles.size());
+    PassProfile& profile = mPassProfiles[node.id];
+    const uint32_t commandCount = driver.getCommandCount();
+    profile.executeStart = Clock::now();
+    executeInternal(node, driver);
+    profile.executeTime = Clock::now() - profile.executeStart;
+    profile.commandCount = driver.getCommandCount() - commandCount;
+    profile.executed = true;
+}
+
 void FrameGraph::reset() noexcept {
     // reset the frame graph state
     mPassNodes.clear();
@@ -434,7 +820,11 @@ void FrameGraph::execute(FEngine& engine, DriverApi& driver) noexcept {
     for (PassNode const& node : passNodes) {
         if (node.refCount) {
             driver.pushGroupMarker(node.name);
-            executeInternal(node, driver);
+            if (UTILS_UNLIKELY(mProfiling)) {
+                executeProfiled(node, driver);
+            } else {
+                executeInternal(node, driver);
+            }
             driver.popGroupMarker();
         }
     }
@@ -447,7 +837,11 @@ void FrameGraph::execute(FEngine& engine, DriverApi& driver) noexcept {
 void FrameGraph::execute(DriverApi& driver) noexcept {
     for (PassNode const& node : mPassNodes) {
         if (node.refCount) {
-            executeInternal(node, driver);
+            if (UTILS_UNLIKELY(mProfiling)) {
+                executeProfiled(node, driver);
+            } else {
+                executeInternal(node, driver);
+            }
         }
     }
     // this is a good place to kick the GPU, since we've just done a bunch of work
@@ -534,6 +928,48 @@ void FrameGraph::export_graphviz(utils::io::ostream& out, const char* viewName)
 #endif
 }
 
+static void writeJsonString(utils::io::ostream& out, const char* s) {
+    out << '"';
+    for (; s && *s; s++) {
+        if (*s == '"' || *s == '\\') {
+            out << '\\';
+        }
+        out << *s;
+    }
+    out << '"';
+}
+
+void FrameGraph::export_chrome_trace(utils::io::ostream& out, const char* viewName) const {
+    // see the "Trace Event Format" for chrome://tracing. Times are in microseconds, from the
+    // setup of the first pass.
+    using us = std::chrono::duration<double, std::micro>;
+    auto const& passProfiles = mPassProfiles;
+    const Clock::time_point epoch =
+            passProfiles.empty() ? Clock::time_point{} : passProfiles.front().setupStart;
+
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":0,\"args\":{\"name\":";
+    writeJsonString(out, viewName ? viewName : "FrameGraph");
+    out << "}}";
+    for (PassProfile const& profile : passProfiles) {
+        out << ",\n{\"name\":";
+        writeJsonString(out, profile.name);
+        out << ",\"cat\":\"setup\",\"ph\":\"X\",\"pid\":0,\"tid\":0"
+            << ",\"ts\":" << us(profile.setupStart - epoch).count()
+            << ",\"dur\":" << us(profile.setupTime).count()
+            << ",\"args\":{\"culled\":" << (profile.executed ? "false" : "true") << "}}";
+        if (profile.executed) {
+            out << ",\n{\"name\":";
+            writeJsonString(out, profile.name);
+            out << ",\"cat\":\"execute\",\"ph\":\"X\",\"pid\":0,\"tid\":1"
+                << ",\"ts\":" << us(profile.executeStart - epoch).count()
+                << ",\"dur\":" << us(profile.executeTime).count()
+                << ",\"args\":{\"commands\":" << profile.commandCount << "}}";
+        }
+    }
+    out << "\n]}" << utils::io::endl;
+}
+
 // avoid creating a .o just for these
 FrameGraphPassExecutor::FrameGraphPassExecutor() = default;
 FrameGraphPassExecutor::~FrameGraphPassExecutor() = default;
@@ -31,8 +31,10 @@
 
 #include <backend/DriverEnums.h>
 
+#include <utils/compiler.h>
 #include <utils/Log.h>
 
+#include <chrono>
 #include <vector>
 #include <memory>
 
@@ -47,6 +49,7 @@
 namespace filament {
 
 class FEngine;
+class FrameGraphCompileCache;
 
 namespace fg {
 struct ResourceNode;
@@ -175,7 +178,11 @@ public:
 
         // call the setup code, which will declare used resources
         Builder builder(*this, node);
+        const Clock::time_point setupStart = mProfiling ? Clock::now() : Clock::time_point{};
         setup(builder, pass->getData());
+        if (UTILS_UNLIKELY(mProfiling)) {
+            mPassProfiles.push_back({ name, setupStart, Clock::now() - setupStart });
+        }
 
         // return a reference to the pass to the user
         return *pass;
@@ -239,6 +246,27 @@ public:
     // allocates concrete resources and culls unreferenced passes
     FrameGraph& compile() noexcept;
 
+    // same as compile(), but reuses the result of the previous compile() done with this cache
+    // when the graph didn't change (see FrameGraphCompileCache)
+    FrameGraph& compile(FrameGraphCompileCache& cache) noexcept;
+
+    // Textures whose lifetimes don't overlap share the same concrete texture when their
+    // descriptors are compatible. This is enabled by default, and must be set before compile().
+    void setTextureAliasingEnabled(bool enabled) noexcept { mTextureAliasing = enabled; }
+
+    // texture memory needed by the graph, computed by compile()
+    struct TextureMemoryStatistics {
+        size_t totalSize = 0;           // all the textures, if each had its own memory
+        size_t peakSize = 0;            // largest set of textures alive at the same time
+        size_t aliasedSize = 0;         // the concrete textures, once aliased
+        uint32_t textureCount = 0;
+        uint32_t concreteTextureCount = 0;
+    };
+
+    TextureMemoryStatistics const& getTextureMemoryStatistics() const noexcept {
+        return mTextureMemoryStatistics;
+    }
+
     // execute all referenced passes and flush the command queue after each pass
     void execute(FEngine& engine, backend::DriverApi& driver) noexcept;
 
@@ -254,6 +282,13 @@ public:
     // print the frame graph as a graphviz file in the log
     void export_graphviz(utils::io::ostream& out, const char* viewName);
 
+    // Records the CPU time spent in the setup and execute lambdas of each pass, and the number
+    // of driver commands each pass emits. This must be set before adding passes.
+    void setProfilingEnabled(bool enabled) noexcept { mProfiling = enabled; }
+
+    // print the profile of the frame graph as a Chrome trace (JSON), after execute()
+    void export_chrome_trace(utils::io::ostream& out, const char* viewName) const;
+
 private:
     friend class FrameGraphPassResources;
     friend struct FrameGraphTexture;
@@ -267,6 +302,18 @@ private:
         void operator()(T* object) noexcept { fg.mArena.destroy(object); }
     };
 
+    using Clock = std::chrono::steady_clock;
+
+    struct PassProfile {
+        const char* name;
+        Clock::time_point setupStart;
+        Clock::duration setupTime{};
+        Clock::time_point executeStart{};
+        Clock::duration executeTime{};
+        uint32_t commandCount = 0;
+        bool executed = false;      // culled passes are not executed
+    };
+
     template<typename T> using UniquePtr = std::unique_ptr<T, Deleter<T>>;
     template<typename T> using Allocator = utils::STLAllocator<T, LinearAllocatorArena>;
     template<typename T> using Vector = std::vector<T, Allocator<T>>; // 32 bytes
@@ -278,6 +325,7 @@ private:
     FrameGraphHandle createResourceNode(fg::ResourceEntryBase* resource) noexcept;
 
     void executeInternal(fg::PassNode const& node, backend::DriverApi& driver) noexcept;
+    void executeProfiled(fg::PassNode const& node, backend::DriverApi& driver) noexcept;
 
     fg::ResourceAllocatorInterface& getResourceAllocator() noexcept { return mResourceAllocator; }
 
@@ -285,6 +333,14 @@ private:
 
     void moveResourceBase(FrameGraphHandle from, FrameGraphHandle to);
 
+    // assigns concrete textures to the virtual textures, called by compile()
+    void aliasTextures() noexcept;
+
+    // see FrameGraphCompileCache
+    void computeSignature(std::vector<uint32_t>& signature) noexcept;
+    void saveCompiledGraph(FrameGraphCompileCache& cache) noexcept;
+    void loadCompiledGraph(FrameGraphCompileCache const& cache) noexcept;
+
     FrameGraphHandle create(fg::ResourceEntryBase* pResourceEntry) noexcept;
 
     template<typename T>
@@ -326,6 +382,10 @@ private:
     Vector<UniquePtr<fg::ResourceNode>> mResourceNodeEntries;
     Vector<UniquePtr<fg::ResourceEntryBase>> mResourceEntries;
     uint16_t mId = 0;
+    bool mTextureAliasing = true;
+    bool mProfiling = false;
+    TextureMemoryStatistics mTextureMemoryStatistics;
+    Vector<PassProfile> mPassProfiles;  // indexed like mPassNodes, kept by reset()
 };
 
 } // namespace filament
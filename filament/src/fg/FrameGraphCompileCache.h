@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_FRAMEGRAPHCOMPILECACHE_H
+#define TNT_FILAMENT_FRAMEGRAPHCOMPILECACHE_H
+
+#include "FrameGraph.h"
+#include "FrameGraphHandle.h"
+
+#include <backend/DriverEnums.h>
+
+#include <chrono>
+#include <vector>
+
+#include <stdint.h>
+
+namespace filament {
+
+/*
+ * The result of FrameGraph::compile(), kept from one frame to the next.
+ *
+ * A FrameGraph is built again every frame, but its passes and resources are usually the same.
+ * In that case, FrameGraph::compile(FrameGraphCompileCache&) restores the culled passes,
+ * the reference counts, the lifetimes and the aliasing of the resources from the cache instead
+ * of computing them. The setup and execute lambdas of the passes still run every frame.
+ *
+ * The graph is identified by its signature: the connections between passes and resources, and
+ * the descriptors of the textures and render targets. Typically, there is one cache per View.
+ */
+class FrameGraphCompileCache {
+public:
+    struct Statistics {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        std::chrono::nanoseconds compileTime{};     // last compile() without the cache
+        std::chrono::nanoseconds cachedTime{};      // last compile() from the cache
+        std::chrono::nanoseconds savedTime{};       // since the cache was created, estimated
+    };
+
+    Statistics const& getStatistics() const noexcept { return mStatistics; }
+
+    // forget the cached graph, the next compile() won't use the cache
+    void clear() noexcept { mSignature.clear(); }
+
+private:
+    friend class FrameGraph;
+
+    static constexpr uint16_t NONE = 0xFFFF;
+
+    struct Pass {
+        uint32_t refCount;
+        uint32_t devirtualize;      // first entry in mResources
+        uint32_t devirtualizeCount;
+        uint32_t destroy;           // first entry in mResources
+        uint32_t destroyCount;
+    };
+
+    struct Resource {
+        uint32_t refs;
+        uint16_t first;             // index of the passes, or NONE
+        uint16_t last;
+        // textures only
+        backend::TextureUsage usage;
+        uint8_t samples;
+        bool aliased;
+        uint16_t aliasOf;           // index of the resource, or NONE
+        uint16_t concreteDescriptor;// index in mConcreteDescriptors, or NONE
+    };
+
+    std::vector<uint32_t> mSignature;
+    std::vector<uint32_t> mScratch;     // signature of the graph being compiled
+    std::vector<Pass> mPasses;
+    std::vector<uint32_t> mReaderCounts;    // for each resource node
+    std::vector<Resource> mResources;
+    std::vector<uint16_t> mResourceLists;   // devirtualize and destroy lists of the passes
+    std::vector<FrameGraphTexture::Descriptor> mConcreteDescriptors;
+    FrameGraph::TextureMemoryStatistics mTextureMemoryStatistics;
+    Statistics mStatistics;
+};
+
+} // namespace filament
+
+#endif // TNT_FILAMENT_FRAMEGRAPHCOMPILECACHE_H
@@ -22,6 +22,8 @@
 
 #include <utils/Log.h>
 
+#include <algorithm>
+
 using namespace utils;
 
 namespace filament {
@@ -65,7 +67,12 @@ void ResourceAllocator::AssociativeContainer<K, V, H>::emplace(ARGS&& ... args)
 ResourceAllocatorInterface::~ResourceAllocatorInterface() = default;
 
 size_t ResourceAllocator::TextureKey::getSize() const noexcept {
-    size_t pixelCount = width * height * depth;
+    return getTextureSize(format, levels, samples, width, height, depth);
+}
+
+size_t ResourceAllocator::getTextureSize(TextureFormat format, uint8_t levels, uint8_t samples,
+        uint32_t width, uint32_t height, uint32_t depth) noexcept {
+    size_t pixelCount = size_t(width) * height * depth;
     size_t size = pixelCount * FTexture::getFormatSize(format);
     size_t s = std::max(uint8_t(1), samples);
     if (s > 1) {
@@ -132,17 +139,29 @@ backend::TextureHandle ResourceAllocator::createTexture(const char* name,
         auto& textureCache = mTextureCache;
         const TextureKey key{ name, target, levels, format, samples, width, height, depth, usage };
         auto it = textureCache.find(key);
+#if !defined(__EMSCRIPTEN__)
+        if (it == textureCache.end() && !(usage & TextureUsage::SAMPLEABLE)) {
+            // A texture that is not sampled is only used through a viewport (like above), so
+            // a slightly larger one will do.
+            it = findLargerTexture(key);
+            mDebugCounters.fuzzyHits += it != textureCache.end() ? 1 : 0;
+        }
+#endif
         if (UTILS_LIKELY(it != textureCache.end())) {
             // we do, move the entry to the in-use list, and remove from the cache
+            // (with its own key, which can differ from the requested one)
             handle = it->second.handle;
             mCacheSize -= it->second.size;
+            mInUseTextures.emplace(handle, it->first);
             textureCache.erase(it);
+            mDebugCounters.hits++;
         } else {
             // we don't, allocate a new texture and populate the in-use list
             handle = mBackend.createTexture(
                     target, levels, format, samples, width, height, depth, usage);
+            mInUseTextures.emplace(handle, key);
+            mDebugCounters.misses++;
         }
-        mInUseTextures.emplace(handle, key);
     } else {
         handle = mBackend.createTexture(
                 target, levels, format, samples, width, height, depth, usage);
@@ -158,7 +177,7 @@ void ResourceAllocator::destroyTexture(TextureHandle h) noexcept {
 
         // move it to the cache
         const TextureKey key = it->second;
-        uint32_t size = key.getSize();
+        size_t size = key.getSize();
 
         mTextureCache.emplace(key, TextureCachePayload{ h, mAge, size });
         mCacheSize += size;
@@ -178,29 +197,62 @@ void ResourceAllocator::gc() noexcept {
 
     // Purging strategy:
     // + remove entries that are older than a certain age
-    // - remove only one entry per gc(), unless we're at capacity
+    // - remove only one entry per gc(), trying to avoid a burst of work
+    // + then remove the least recently used entries until we're within budget, the largest
+    //   first among the ones last used during the same frame
 
     auto& textureCache = mTextureCache;
-    for (auto it = textureCache.begin(); it != textureCache.end();) {
+    for (auto it = textureCache.begin(); it != textureCache.end(); ++it) {
         const size_t ageDiff = age - it->second.age;
         if (ageDiff >= CACHE_MAX_AGE) {
-            mBackend.destroyTexture(it->second.handle);
-            mCacheSize -= it->second.size;
-            //slog.d << "purging " << it->second.handle.getId() << io::endl;
-            it = textureCache.erase(it);
-            if (mCacheSize < CACHE_CAPACITY) {
-                // if we're not at capacity, only purge a single entry per gc, trying to
-                // avoid a burst of work.
-                break;
-            }
-        } else {
-            ++it;
+            evict(it);
+            break;
         }
     }
 
+    const size_t capacity = size_t(std::max(0, mCacheBudget)) << 20u;
+    while (mCacheSize > capacity) {
+        auto lru = std::min_element(textureCache.begin(), textureCache.end(),
+                [](auto const& lhs, auto const& rhs) {
+                    return lhs.second.age < rhs.second.age ||
+                           (lhs.second.age == rhs.second.age && lhs.second.size > rhs.second.size);
+                });
+        evict(lru);
+    }
+
+    mDebugCounters.cacheSize = int(mCacheSize >> 10u);
+    mDebugCounters.cacheEntries = int(textureCache.size());
+
     //if (mAge % 60 == 0) dump();
-    // TODO: maybe purge LRU entries if we have more than a certain number
-    // TODO: maybe purge LRU entries if the size of the cache is too large
+}
+
+ResourceAllocator::TextureCache::iterator ResourceAllocator::evict(
+        TextureCache::iterator it) noexcept {
+    //slog.d << "purging " << it->second.handle.getId() << io::endl;
+    mBackend.destroyTexture(it->second.handle);
+    mCacheSize -= it->second.size;
+    mDebugCounters.evictions++;
+    return mTextureCache.erase(it);
+}
+
+ResourceAllocator::TextureCache::iterator ResourceAllocator::findLargerTexture(
+        TextureKey const& key) noexcept {
+    // the smallest texture that is large enough, but not too large
+    const float maxArea = float(key.width) * float(key.height) * FUZZY_MATCH_MAX_AREA_RATIO;
+    auto& textureCache = mTextureCache;
+    auto best = textureCache.end();
+    for (auto it = textureCache.begin(); it != textureCache.end(); ++it) {
+        TextureKey const& k = it->first;
+        if (k.target == key.target && k.levels == key.levels && k.format == key.format &&
+            k.samples == key.samples && k.depth == key.depth && k.usage == key.usage &&
+            k.width >= key.width && k.height >= key.height &&
+            float(k.width) * float(k.height) <= maxArea) {
+            if (best == textureCache.end() || it->second.size < best->second.size) {
+                best = it;
+            }
+        }
+    }
+    return best;
 }
 
 UTILS_NOINLINE
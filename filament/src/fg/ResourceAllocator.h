@@ -84,13 +84,40 @@ public:
 
     void destroyTexture(backend::TextureHandle h) noexcept override;
 
+    // evicts the textures that weren't used for a while, and the least recently used ones when
+    // the cache exceeds its budget. This is called once per frame.
     void gc() noexcept;
 
+    // Budget of the cache of unused textures, in MiB. This is an int so that it can be changed
+    // through the engine's debug registry.
+    int& getCacheBudget() noexcept { return mCacheBudget; }
+
+    // Counters exposed through the engine's debug registry, hence the ints (see FEngine::init()).
+    // The counts are since the allocator was created.
+    struct DebugCounters {
+        int cacheSize = 0;          // size of the cache in KiB
+        int cacheEntries = 0;       // number of textures in the cache
+        int hits = 0;               // textures found in the cache
+        int fuzzyHits = 0;          // hits of a larger texture than requested (included above)
+        int misses = 0;             // textures created
+        int evictions = 0;          // textures destroyed by gc()
+    };
+
+    DebugCounters& getDebugCounters() noexcept { return mDebugCounters; }
+
+    // estimated size in bytes of a texture, mip-maps and multi-sampling included
+    static size_t getTextureSize(backend::TextureFormat format, uint8_t levels, uint8_t samples,
+            uint32_t width, uint32_t height, uint32_t depth) noexcept;
+
 private:
     // TODO: these should be settings of the engine
-    static constexpr size_t CACHE_CAPACITY = 64u << 20u;   // 64 MiB
+    static constexpr int    CACHE_BUDGET   = 64;    // MiB
     static constexpr size_t CACHE_MAX_AGE  = 30u;
 
+    // A texture that can't be sampled can be replaced by a larger one, as long as it's not
+    // larger than this (in area), see createTexture().
+    static constexpr float FUZZY_MATCH_MAX_AREA_RATIO = 1.25f;
+
     struct TextureKey {
         const char* name; // doesn't participate in the hash
         backend::SamplerType target;
@@ -131,8 +158,8 @@ private:
 
     struct TextureCachePayload {
         backend::TextureHandle handle;
-        size_t age = 0;
-        uint32_t size = 0;
+        size_t age = 0;     // when the texture was last used
+        size_t size = 0;
     };
 
     template<typename T>
@@ -177,11 +204,18 @@ private:
         void emplace(ARGS&&... args);
     };
 
+    using TextureCache = AssociativeContainer<TextureKey, TextureCachePayload>;
+
+    TextureCache::iterator findLargerTexture(TextureKey const& key) noexcept;
+    TextureCache::iterator evict(TextureCache::iterator it) noexcept;
+
     backend::DriverApi& mBackend;
-    AssociativeContainer<TextureKey, TextureCachePayload> mTextureCache;
+    TextureCache mTextureCache;
     AssociativeContainer<backend::TextureHandle, TextureKey> mInUseTextures;
     size_t mAge = 0;
-    uint32_t mCacheSize = 0;
+    size_t mCacheSize = 0;
+    int mCacheBudget = CACHE_BUDGET;
+    DebugCounters mDebugCounters;
     const bool mEnabled = true;
 };
 
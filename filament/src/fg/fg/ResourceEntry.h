@@ -19,6 +19,8 @@
 
 #include "VirtualResource.h"
 
+#include <fg/FrameGraphHandle.h>
+
 #include <stdint.h>
 
 namespace filament {
@@ -29,6 +31,8 @@ namespace fg {
 
 struct PassNode;
 class RenderTargetResourceEntry;
+template<typename T>
+class ResourceEntry;
 
 class ResourceEntryBase : public VirtualResource {
 public:
@@ -40,6 +44,10 @@ public:
         return nullptr;
     }
 
+    virtual ResourceEntry<FrameGraphTexture>* asTextureResourceEntry() noexcept {
+        return nullptr;
+    }
+
     void preExecuteDestroy(FrameGraph& fg) noexcept override {
         discardEnd = true;
     }
@@ -74,6 +82,12 @@ public:
     using Descriptor = typename T::Descriptor;
     Descriptor descriptor;
 
+    // computed during compile(), when this resource shares its concrete resource with other
+    // resources whose lifetimes don't overlap (see FrameGraph::aliasTextures())
+    Descriptor const* concreteDescriptor = nullptr; // if null, the concrete resource uses descriptor
+    ResourceEntry* aliasOf = nullptr;       // previous user of the concrete resource
+    bool aliased = false;                   // whether a later resource uses the concrete resource
+
     ResourceEntry(const char* name, Descriptor const& desc, uint16_t id, uint8_t priority) noexcept
             : ResourceEntryBase(name, id, false, priority), descriptor(desc) {
     }
@@ -83,6 +97,10 @@ public:
             : ResourceEntryBase(name, id, true, priority), resource(r), descriptor(desc) {
     }
 
+    ResourceEntry<FrameGraphTexture>* asTextureResourceEntry() noexcept override {
+        return nullptr;
+    }
+
     T const& getResource() const noexcept { return resource; }
 
     T& getResource() noexcept { return resource; }
@@ -91,17 +109,29 @@ public:
 
     void preExecuteDevirtualize(FrameGraph& fg) noexcept override {
         if (!imported) {
-            resource.create(fg, name, descriptor);
+            if (aliasOf) {
+                // the previous user is done with the concrete resource
+                resource = aliasOf->resource;
+            } else {
+                resource.create(fg, name,
+                        concreteDescriptor ? *concreteDescriptor : descriptor);
+            }
         }
     }
 
     void postExecuteDestroy(FrameGraph& fg) noexcept override {
-        if (!imported) {
+        if (!imported && !aliased) {
             resource.destroy(fg);
         }
     }
 };
 
+template<>
+inline ResourceEntry<FrameGraphTexture>*
+ResourceEntry<FrameGraphTexture>::asTextureResourceEntry() noexcept {
+    return this;
+}
+
 } // namespace fg
 } // namespace filament
 
@@ -17,6 +17,7 @@
 #include <gtest/gtest.h>
 
 #include "fg/FrameGraph.h"
+#include "fg/FrameGraphCompileCache.h"
 #include "fg/FrameGraphPassResources.h"
 #include "fg/ResourceAllocator.h"
 
@@ -24,6 +25,10 @@
 
 #include "private/backend/CommandStream.h"
 
+#include <utils/sstream.h>
+
+#include <string>
+
 using namespace filament;
 using namespace backend;
 
@@ -444,3 +449,220 @@ TEST(FrameGraphTest, MoveGenericResource) {
     EXPECT_EQ(h[1], h[3]);
     EXPECT_EQ(h[3], h[0]);
 }
+
+TEST(FrameGraphTest, TextureAliasing) {
+
+    fg::ResourceAllocator resourceAllocator(driverApi);
+    FrameGraph fg(resourceAllocator);
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> input;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // a chain of passes, each sampling the output of the previous one
+    Handle<HwTexture> textures[3];
+    FrameGraphId<FrameGraphTexture> input;
+    for (size_t i = 0; i < 3; i++) {
+        auto& pass = fg.addPass<PassData>("Pass",
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    if (input.isValid()) {
+                        data.input = builder.sample(input);
+                    }
+                    data.output = builder.createTexture("color", {
+                            .width = 256, .height = 256 });
+                    data.output = builder.write(data.output);
+                    data.rt = builder.createRenderTarget("color", {
+                            .attachments = { data.output } });
+                },
+                [&textures, i](FrameGraphPassResources const& resources,
+                        auto const& data, DriverApi& driver) {
+                    textures[i] = resources.getTexture(data.output);
+                });
+        input = pass.getData().output;
+    }
+
+    fg.present(input);
+    fg.compile();
+
+    // the first texture is no longer used when the third one is needed
+    auto const& stats = fg.getTextureMemoryStatistics();
+    EXPECT_EQ(3, stats.textureCount);
+    EXPECT_EQ(2, stats.concreteTextureCount);
+    EXPECT_EQ(stats.totalSize * 2 / 3, stats.aliasedSize);
+    EXPECT_EQ(stats.aliasedSize, stats.peakSize);
+
+    fg.execute(driverApi);
+
+    EXPECT_TRUE(textures[0]);
+    EXPECT_TRUE(textures[1]);
+    EXPECT_EQ(textures[0], textures[2]);
+    EXPECT_NE(textures[0], textures[1]);
+
+    resourceAllocator.terminate();
+}
+
+TEST(FrameGraphTest, TextureCache) {
+
+    fg::ResourceAllocator resourceAllocator(driverApi);
+    auto const& counters = resourceAllocator.getDebugCounters();
+
+    auto create = [&](uint32_t width, uint32_t height, TextureUsage usage) {
+        return resourceAllocator.createTexture("color", SamplerType::SAMPLER_2D, 1,
+                TextureFormat::RGBA8, 1, width, height, 1, usage);
+    };
+
+    Handle<HwTexture> t0 = create(200, 200, TextureUsage::COLOR_ATTACHMENT);
+    resourceAllocator.destroyTexture(t0);
+
+    // a slightly smaller render target reuses the cached texture
+    Handle<HwTexture> t1 = create(190, 190, TextureUsage::COLOR_ATTACHMENT);
+    EXPECT_EQ(t0, t1);
+    EXPECT_EQ(1, counters.fuzzyHits);
+    resourceAllocator.destroyTexture(t1);
+
+    // but not a texture that is sampled, nor a much smaller one
+    Handle<HwTexture> t2 = create(190, 190,
+            TextureUsage::COLOR_ATTACHMENT | TextureUsage::SAMPLEABLE);
+    Handle<HwTexture> t3 = create(100, 100, TextureUsage::COLOR_ATTACHMENT);
+    EXPECT_NE(t0, t2);
+    EXPECT_NE(t0, t3);
+    EXPECT_EQ(1, counters.hits);
+    EXPECT_EQ(3, counters.misses);
+    resourceAllocator.destroyTexture(t2);
+    resourceAllocator.destroyTexture(t3);
+
+    resourceAllocator.gc();
+    EXPECT_EQ(3, counters.cacheEntries);
+
+    // everything is evicted when the cache has no budget
+    resourceAllocator.getCacheBudget() = 0;
+    resourceAllocator.gc();
+    EXPECT_EQ(0, counters.cacheEntries);
+    EXPECT_EQ(0, counters.cacheSize);
+    EXPECT_EQ(3, counters.evictions);
+
+    resourceAllocator.terminate();
+}
+
+TEST(FrameGraphTest, CompileCache) {
+
+    fg::ResourceAllocator resourceAllocator(driverApi);
+    FrameGraphCompileCache cache;
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> input;
+        FrameGraphId<FrameGraphTexture> output;
+        FrameGraphRenderTargetHandle rt;
+    };
+
+    // the same graph as in TextureAliasing, with an extra pass that gets culled
+    auto render = [&](uint32_t size, Handle<HwTexture>* textures, bool* culledExecuted) {
+        FrameGraph fg(resourceAllocator);
+        FrameGraphId<FrameGraphTexture> input;
+        for (size_t i = 0; i < 3; i++) {
+            auto& pass = fg.addPass<PassData>("Pass",
+                    [&](FrameGraph::Builder& builder, auto& data) {
+                        if (input.isValid()) {
+                            data.input = builder.sample(input);
+                        }
+                        data.output = builder.createTexture("color", {
+                                .width = size, .height = size });
+                        data.output = builder.write(data.output);
+                        data.rt = builder.createRenderTarget("color", {
+                                .attachments = { data.output } });
+                    },
+                    [textures, i](FrameGraphPassResources const& resources,
+                            auto const& data, DriverApi& driver) {
+                        textures[i] = resources.getTexture(data.output);
+                    });
+            input = pass.getData().output;
+        }
+        fg.addPass<PassData>("Culled",
+                [&](FrameGraph::Builder& builder, auto& data) {
+                    data.input = builder.sample(input);
+                    data.output = builder.createTexture("unused", {});
+                    data.output = builder.write(data.output);
+                },
+                [culledExecuted](FrameGraphPassResources const& resources,
+                        auto const& data, DriverApi& driver) {
+                    *culledExecuted = true;
+                });
+        fg.present(input);
+        fg.compile(cache);
+        fg.execute(driverApi);
+    };
+
+    Handle<HwTexture> textures[2][3];
+    bool culledExecuted = false;
+    render(256, textures[0], &culledExecuted);
+    EXPECT_EQ(0, cache.getStatistics().hits);
+    EXPECT_EQ(1, cache.getStatistics().misses);
+
+    // the second frame uses the cached result
+    render(256, textures[1], &culledExecuted);
+    EXPECT_EQ(1, cache.getStatistics().hits);
+    EXPECT_EQ(1, cache.getStatistics().misses);
+    EXPECT_FALSE(culledExecuted);
+    EXPECT_TRUE(textures[1][0]);
+    EXPECT_TRUE(textures[1][1]);
+    EXPECT_EQ(textures[1][0], textures[1][2]);
+    EXPECT_NE(textures[1][0], textures[1][1]);
+
+    // a change of descriptor compiles the graph again
+    render(128, textures[1], &culledExecuted);
+    EXPECT_EQ(1, cache.getStatistics().hits);
+    EXPECT_EQ(2, cache.getStatistics().misses);
+
+    resourceAllocator.terminate();
+}
+
+TEST(FrameGraphTest, ChromeTrace) {
+
+    fg::ResourceAllocator resourceAllocator(driverApi);
+    FrameGraph fg(resourceAllocator);
+    fg.setProfilingEnabled(true);
+
+    struct PassData {
+        FrameGraphId<FrameGraphTexture> output;
+    };
+
+    auto& pass = fg.addPass<PassData>("Draw",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.output = builder.createTexture("color", {});
+                data.output = builder.write(data.output);
+            },
+            [](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+                driver.pushGroupMarker("marker");
+                driver.popGroupMarker();
+            });
+
+    fg.addPass<PassData>("Culled",
+            [&](FrameGraph::Builder& builder, auto& data) {
+                data.output = builder.createTexture("unused", {});
+                data.output = builder.write(data.output);
+            },
+            [](FrameGraphPassResources const& resources, auto const& data, DriverApi& driver) {
+            });
+
+    fg.present(pass.getData().output);
+    fg.compile();
+    fg.execute(driverApi);
+
+    utils::io::sstream out;
+    fg.export_chrome_trace(out, "view");
+    std::string const trace(out.c_str());
+
+    EXPECT_EQ(0, trace.find("{\"traceEvents\":["));
+    EXPECT_NE(std::string::npos, trace.find("{\"name\":\"view\"}"));
+    // both passes are set up, only Draw and Present are executed
+    EXPECT_NE(std::string::npos, trace.find("{\"name\":\"Draw\",\"cat\":\"setup\""));
+    EXPECT_NE(std::string::npos, trace.find("{\"name\":\"Draw\",\"cat\":\"execute\""));
+    EXPECT_NE(std::string::npos, trace.find("{\"name\":\"Culled\",\"cat\":\"setup\""));
+    EXPECT_EQ(std::string::npos, trace.find("{\"name\":\"Culled\",\"cat\":\"execute\""));
+    EXPECT_NE(std::string::npos, trace.find("{\"name\":\"Present\",\"cat\":\"execute\""));
+    EXPECT_NE(std::string::npos, trace.find("\"commands\":"));
+
+    resourceAllocator.terminate();
+}
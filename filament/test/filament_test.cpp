@@ -14,8 +14,11 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -23,14 +26,26 @@
 #include <math/vec4.h>
 #include <math/mat3.h>
 #include <math/mat4.h>
+#include <math/quat.h>
 #include <math/scalar.h>
 
+#include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
+#include <utils/Panic.h>
+
 #include <filament/Box.h>
 #include <filament/Camera.h>
 #include <filament/Color.h>
+#include <filament/ColorGrading.h>
 #include <filament/Frustum.h>
+#include <filament/IndexBuffer.h>
 #include <filament/Material.h>
 #include <filament/Engine.h>
+#include <filament/RenderableManager.h>
+#include <filament/Scene.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+#include <filament/Viewport.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
 #include <private/filament/UibGenerator.h>
@@ -38,10 +53,22 @@
 #include "details/Allocators.h"
 #include "details/Material.h"
 #include "details/Camera.h"
+#include "details/ColorGrading.h"
+#include "details/Culler.h"
+#include "details/CullingBvh.h"
 #include "details/Froxelizer.h"
+#include "details/IndexBuffer.h"
+#include "details/OcclusionCuller.h"
+#include "details/ShadowAtlas.h"
+#include "details/ShadowMap.h"
 #include "details/Engine.h"
+#include "details/RenderPrimitive.h"
+#include "details/Scene.h"
+#include "details/VertexBuffer.h"
+#include "details/View.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
+#include "RenderPass.h"
 #include "UniformBuffer.h"
 
 using namespace filament;
@@ -276,6 +303,231 @@ TEST(FilamentTest, TransformManager) {
     EXPECT_EQ(c, tcm.getChildCount(newParent));
 }
 
+TEST(FilamentTest, TransformManagerChangeJournal) {
+    filament::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 3> entities;
+    em.create(entities.size(), entities.data());
+
+    tcm.create(entities[0]);
+    tcm.create(entities[1], tcm.getInstance(entities[0]), mat4f{});
+    tcm.create(entities[2]);
+    ChangeJournal const& journal = tcm.getChangeJournal();
+    ChangeJournal::Sequence sequence = journal.getSequence();
+
+    // creating components invalidates the journal
+    tcm.create(em.create());
+    Slice<const Entity> changes;
+    EXPECT_FALSE(journal.getChangesSince(sequence, changes));
+    sequence = journal.getSequence();
+    EXPECT_TRUE(journal.getChangesSince(sequence, changes));
+    EXPECT_EQ(changes.size(), 0u);
+
+    // children are journaled along with their parent
+    tcm.setTransform(tcm.getInstance(entities[0]), mat4f{ float4{ 2 }});
+    EXPECT_TRUE(journal.getChangesSince(sequence, changes));
+    ASSERT_EQ(changes.size(), 2u);
+    EXPECT_EQ(changes[0], entities[0]);
+    EXPECT_EQ(changes[1], entities[1]);
+    sequence = journal.getSequence();
+
+    // only the transforms that changed are journaled by a transaction
+    tcm.openLocalTransformTransaction();
+    tcm.setTransform(tcm.getInstance(entities[0]), mat4f{ float4{ 2 }});
+    tcm.setTransform(tcm.getInstance(entities[2]), mat4f{ float4{ 4 }});
+    tcm.commitLocalTransformTransaction();
+    EXPECT_TRUE(journal.getChangesSince(sequence, changes));
+    ASSERT_EQ(changes.size(), 1u);
+    EXPECT_EQ(changes[0], entities[2]);
+
+    // changes are discarded after a few frames
+    for (size_t i = 0; i < 8; i++) {
+        tcm.gc(em);
+    }
+    EXPECT_FALSE(journal.getChangesSince(sequence, changes));
+    sequence = journal.getSequence();
+    EXPECT_TRUE(journal.getChangesSince(sequence, changes));
+}
+
+TEST(FilamentTest, TransformManagerTrs) {
+    filament::FTransformManager tcm;
+    EntityManager& em = EntityManager::get();
+    std::array<Entity, 2> entities;
+    em.create(entities.size(), entities.data());
+    tcm.create(entities[0]);
+    tcm.create(entities[1]);
+
+    auto near = [](mat4f const& a, mat4f const& b) {
+        for (size_t i = 0; i < 4; i++) {
+            if (length(a[i] - b[i]) > 1e-5f) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // the TRS is kept as is
+    auto i = tcm.getInstance(entities[0]);
+    quatf const rotation = quatf::fromAxisAngle(float3{ 0, 1, 0 }, F_PI_4);
+    tcm.setTransform(i, float3{ 1, 2, 3 }, rotation, float3{ 2 });
+    EXPECT_EQ(tcm.getTranslation(i), float3(1, 2, 3));
+    EXPECT_EQ(tcm.getRotation(i), rotation);
+    EXPECT_EQ(tcm.getScale(i), float3(2));
+    EXPECT_TRUE(near(tcm.getTransform(i),
+            mat4f::translation(float3{ 1, 2, 3 }) * mat4f(rotation) * mat4f::scaling(2.0f)));
+
+    // setting a component keeps the others
+    tcm.setTranslation(i, float3{ 4, 5, 6 });
+    tcm.setScale(i, float3{ 1, 2, 3 });
+    EXPECT_EQ(tcm.getRotation(i), rotation);
+    EXPECT_TRUE(near(tcm.getWorldTransform(i), mat4f::translation(float3{ 4, 5, 6 }) *
+            mat4f(rotation) * mat4f::scaling(float3{ 1, 2, 3 })));
+
+    // a matrix is decomposed when needed
+    i = tcm.getInstance(entities[1]);
+    tcm.setTransform(i, mat4f::translation(float3{ 1, 2, 3 }) * mat4f::scaling(float3{ 2 }));
+    EXPECT_EQ(tcm.getTranslation(i), float3(1, 2, 3));
+    EXPECT_EQ(tcm.getScale(i), float3(2));
+    tcm.setRotation(i, rotation);
+    EXPECT_TRUE(near(tcm.getTransform(i),
+            mat4f::translation(float3{ 1, 2, 3 }) * mat4f(rotation) * mat4f::scaling(2.0f)));
+
+    // the TRS follows the components when they're sorted
+    tcm.setParent(tcm.getInstance(entities[0]), tcm.getInstance(entities[1]));
+    tcm.openLocalTransformTransaction();
+    tcm.commitLocalTransformTransaction();
+    EXPECT_EQ(tcm.getTranslation(tcm.getInstance(entities[0])), float3(4, 5, 6));
+    EXPECT_EQ(tcm.getScale(tcm.getInstance(entities[1])), float3(2));
+}
+
+TEST(FilamentTest, TransformManagerBatchUpdate) {
+    filament::FTransformManager single;
+    filament::FTransformManager batch;
+    EntityManager& em = EntityManager::get();
+    std::vector<Entity> entities(1000);
+    em.create(entities.size(), entities.data());
+    std::default_random_engine generator(82828); // NOLINT
+    for (Entity e : entities) {
+        single.create(e);
+        batch.create(e);
+    }
+    auto randomizeHierarchy = [&]() {
+        for (size_t k = 1; k < entities.size(); k++) {
+            size_t const p = std::uniform_int_distribution<size_t>(0, k - 1)(generator);
+            single.setParent(single.getInstance(entities[k]), single.getInstance(entities[p]));
+            batch.setParent(batch.getInstance(entities[k]), batch.getInstance(entities[p]));
+        }
+    };
+
+    std::uniform_int_distribution<int> offset(-8, 8);
+    for (size_t frame = 0; frame < 4; frame++) {
+        if (frame == 0 || frame == 2) {
+            randomizeHierarchy();
+        }
+
+        // update a few transforms, always including a deep one
+        std::vector<TransformManager::Instance> instances;
+        std::vector<mat4f> transforms;
+        for (size_t k = frame; k < entities.size(); k += 1 + frame * 7) {
+            mat4f const m = mat4f::translation(float3{
+                    offset(generator), offset(generator), offset(generator) });
+            single.setTransform(single.getInstance(entities[k]), m);
+            instances.push_back(batch.getInstance(entities[k]));
+            transforms.push_back(m);
+        }
+        ChangeJournal::Sequence sequence = batch.getChangeJournal().getSequence();
+        batch.setTransforms(instances.data(), transforms.data(), instances.size());
+
+        for (Entity e : entities) {
+            EXPECT_EQ(batch.getWorldTransform(batch.getInstance(e)),
+                    single.getWorldTransform(single.getInstance(e)));
+        }
+
+        // the journal is invalidated when the hierarchy is sorted
+        Slice<const Entity> changes;
+        EXPECT_EQ(batch.getChangeJournal().getChangesSince(sequence, changes), bool(frame & 1u));
+    }
+
+    // local transforms from translation, rotation and scale
+    TransformManager::Instance const instance = batch.getInstance(entities[0]);
+    float3 const translation{ 1, 2, 3 };
+    quatf const rotation = quatf::fromAxisAngle(float3{ 0, 0, 1 }, F_PI_2);
+    float3 const scale{ 2, 3, 4 };
+    batch.setTransforms(&instance, &translation, &rotation, &scale, 1);
+    mat4f const expected = mat4f::translation(translation) * mat4f(rotation) * mat4f::scaling(scale);
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_LT(length(batch.getTransform(instance)[i] - expected[i]), 1e-5f);
+    }
+    batch.setTransforms(&instance, &translation, &rotation, nullptr, 1);
+    EXPECT_LT(length(batch.getTransform(instance)[0] - float4{ 0, 1, 0, 0 }), 1e-5f);
+}
+
+TEST(FilamentTest, TransformManagerParallelUpdate) {
+    JobSystem js;
+    js.adopt();
+
+    filament::FTransformManager serial;
+    filament::FTransformManager parallel(&js);
+    parallel.setParallelTransformUpdateEnabled(true);
+
+    // a random hierarchy, large enough for some levels to be computed in parallel. The
+    // components are created in random order, so that children often come before their parent.
+    EntityManager& em = EntityManager::get();
+    std::vector<Entity> entities(10000);
+    em.create(entities.size(), entities.data());
+    std::vector<size_t> order(entities.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::default_random_engine generator(82828); // NOLINT
+    std::shuffle(order.begin(), order.end(), generator);
+    for (size_t k : order) {
+        serial.create(entities[k]);
+        parallel.create(entities[k]);
+    }
+    std::uniform_int_distribution<int> offset(-8, 8);
+    for (size_t k = 1; k < entities.size(); k++) {
+        size_t const p = std::uniform_int_distribution<size_t>(0, k - 1)(generator);
+        serial.setParent(serial.getInstance(entities[k]), serial.getInstance(entities[p]));
+        parallel.setParent(parallel.getInstance(entities[k]), parallel.getInstance(entities[p]));
+    }
+
+    for (size_t frame = 0; frame < 2; frame++) {
+        serial.openLocalTransformTransaction();
+        parallel.openLocalTransformTransaction();
+        for (size_t k = frame; k < entities.size(); k += 2) {
+            // translations by integers, which are computed exactly
+            mat4f const m = mat4f::translation(float3{
+                    offset(generator), offset(generator), offset(generator) });
+            serial.setTransform(serial.getInstance(entities[k]), m);
+            parallel.setTransform(parallel.getInstance(entities[k]), m);
+        }
+        serial.commitLocalTransformTransaction();
+        parallel.commitLocalTransformTransaction();
+
+        for (Entity e : entities) {
+            auto i = parallel.getInstance(e);
+            EXPECT_EQ(parallel.getWorldTransform(i), serial.getWorldTransform(serial.getInstance(e)));
+            // parents are sorted before their children
+            Entity p = parallel.getParent(i);
+            if (p) {
+                EXPECT_LT(parallel.getInstance(p), i);
+            }
+        }
+    }
+
+    // the transforms that didn't change aren't journaled
+    ChangeJournal const& journal = parallel.getChangeJournal();
+    ChangeJournal::Sequence sequence = journal.getSequence();
+    parallel.openLocalTransformTransaction();
+    parallel.setTransform(parallel.getInstance(entities[0]),
+            parallel.getTransform(parallel.getInstance(entities[0])));
+    parallel.commitLocalTransformTransaction();
+    Slice<const Entity> changes;
+    EXPECT_TRUE(journal.getChangesSince(sequence, changes));
+    EXPECT_EQ(changes.size(), 0u);
+
+    js.emancipate();
+}
+
 TEST(FilamentTest, UniformInterfaceBlock) {
 
     UniformInterfaceBlock::Builder b;
@@ -580,6 +832,446 @@ TEST(FilamentTest, SphereCulling) {
     EXPECT_TRUE(frustum.intersects({ 0, 200 }));
 }
 
+TEST(FilamentTest, CullingKernels) {
+    Frustum frustum(mat4f::frustum(-1, 1, -1, 1, 1, 100));
+
+    // an odd multiple of 8, so that wide kernels have to handle a remainder
+    constexpr size_t COUNT = 8 * 37;
+    std::default_random_engine gen;
+    std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+    std::vector<float3> centers(COUNT);
+    std::vector<float3> extents(COUNT);
+    std::vector<float4> spheres(COUNT);
+    for (size_t i = 0; i < COUNT; i++) {
+        float const z = 1.0f + 100.0f * std::abs(rand(gen));
+        centers[i] = { 2.0f * z * rand(gen), 2.0f * z * rand(gen), -z };
+        extents[i] = { 5.0f * std::abs(rand(gen)), 5.0f * std::abs(rand(gen)), 5.0f * std::abs(rand(gen)) };
+        spheres[i] = { centers[i], 5.0f * std::abs(rand(gen)) };
+    }
+
+    std::vector<Culler::result_type> expected(COUNT);
+    std::vector<Culler::result_type> results(COUNT);
+
+    Culler::Test::intersectsPortable(expected.data(), frustum, spheres.data(), COUNT);
+    Culler::Test::intersects(results.data(), frustum, spheres.data(), COUNT);
+    EXPECT_EQ(expected, results) << Culler::Test::getKernelName();
+
+    std::fill(expected.begin(), expected.end(), 0);
+    Culler::Test::intersectsPortable(expected.data(), frustum, centers.data(), extents.data(), COUNT);
+
+    // the visibility bit must be merged with the other bits
+    for (size_t bit = 0; bit < 8; bit++) {
+        std::fill(results.begin(), results.end(), Culler::result_type(0x5A & ~(1u << bit)));
+        Culler::intersects(results.data(), frustum, centers.data(), extents.data(), COUNT, bit);
+        for (size_t i = 0; i < COUNT; i++) {
+            EXPECT_EQ(Culler::result_type((0x5A & ~(1u << bit)) | (expected[i] << bit)), results[i]);
+        }
+    }
+}
+
+TEST(FilamentTest, CullingBvh) {
+    JobSystem js;
+    js.adopt();
+
+    // enough boxes to exercise the parallel traversal
+    constexpr size_t COUNT = 10000;
+    std::default_random_engine gen;
+    std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+    std::vector<float3> centers(Culler::round(COUNT));
+    std::vector<float3> extents(Culler::round(COUNT));
+    for (size_t i = 0; i < COUNT; i++) {
+        centers[i] = { 500.0f * rand(gen), 10.0f * rand(gen), 500.0f * rand(gen) };
+        extents[i] = { 5.0f * std::abs(rand(gen)), 5.0f * std::abs(rand(gen)), 5.0f * std::abs(rand(gen)) };
+    }
+
+    CullingBvh bvh;
+    bvh.build(centers.data(), extents.data(), COUNT);
+    EXPECT_EQ(COUNT, bvh.size());
+
+    auto check = [&](float3 const& translation) {
+        std::vector<float3> translated(centers.size());
+        for (size_t i = 0; i < COUNT; i++) {
+            translated[i] = centers[i] + translation;
+        }
+        bvh.setTranslation(translation);
+        for (float3 eye : { float3{ 0, 0, 0 }, float3{ 200, 0, -100 }, float3{ -400, 5, 300 } }) {
+            mat4f const view = mat4f::lookAt(eye, eye + float3{ 1, 0, 1 }, float3{ 0, 1, 0 });
+            Frustum const frustum(mat4f::perspective(60, 1, 0.1f, 200) * inverse(view));
+
+            std::vector<Culler::result_type> expected(centers.size(), 0x40);
+            std::vector<Culler::result_type> results(centers.size(), 0x40);
+            Culler::intersects(expected.data(), frustum,
+                    translated.data(), extents.data(), COUNT, 1);
+            bvh.cull(js, results.data(), frustum, 1);
+            EXPECT_EQ(expected, results);
+        }
+    };
+
+    check({ 0, 0, 0 });
+    check({ 10, -20, 30 });
+
+    // move some boxes, and refit the hierarchy
+    std::vector<uint32_t> moved;
+    for (uint32_t i = 0; i < COUNT; i += 97) {
+        centers[i] = { 500.0f * rand(gen), 100.0f * rand(gen), 500.0f * rand(gen) };
+        moved.push_back(i);
+    }
+    bvh.refit(centers.data(), extents.data(), moved.data(), moved.size());
+    check({ 0, 0, 0 });
+
+    js.emancipate();
+}
+
+TEST(FilamentTest, LightCullingBvh) {
+    using namespace filament;
+
+    // enough point lights for the scene to build a hierarchy over them
+    constexpr size_t count = FScene::CULLING_BVH_MIN_LIGHTS + 100;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FLightManager& lcm = fengine.getLightManager();
+    JobSystem& js = fengine.getJobSystem();
+
+    std::default_random_engine gen;
+    std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+    auto randomPosition = [&]() {
+        return float3{ 500.0f * rand(gen), 10.0f * rand(gen), 500.0f * rand(gen) };
+    };
+
+    Scene* scene = engine->createScene();
+    FScene& fscene = upcast(*scene);
+    fscene.setCullingHierarchyEnabled(true);
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (Entity entity : entities) {
+        LightManager::Builder(LightManager::Type::POINT)
+                .position(randomPosition())
+                .falloff(10.0f * std::abs(rand(gen)))
+                .build(*engine, entity);
+        scene->addEntity(entity);
+    }
+
+    // the hierarchy must find the same lights as testing all their spheres
+    auto check = [&]() {
+        fscene.prepare(js, mat4f());
+        CullingBvh const* bvh = fscene.getLightCullingBvh();
+        ASSERT_TRUE(bvh);
+        FScene::LightSoa const& lightData = fscene.getLightData();
+        size_t const lightCount = lightData.size() - FScene::DIRECTIONAL_LIGHTS_COUNT;
+        EXPECT_EQ(bvh->size(), lightCount);
+        float4 const* spheres =
+                lightData.data<FScene::POSITION_RADIUS>() + FScene::DIRECTIONAL_LIGHTS_COUNT;
+        for (float3 eye : { float3{ 0, 0, 0 }, float3{ 200, 0, -100 }, float3{ -400, 5, 300 } }) {
+            mat4f const view = mat4f::lookAt(eye, eye + float3{ 1, 0, 1 }, float3{ 0, 1, 0 });
+            Frustum const frustum(mat4f::perspective(60, 1, 0.1f, 200) * inverse(view));
+            std::vector<Culler::result_type> expected(lightCount);
+            std::vector<Culler::result_type> results(Culler::round(lightCount), 0);
+            bvh->cull(js, results.data(), frustum, 0);
+            for (size_t i = 0; i < lightCount; i++) {
+                expected[i] = Culler::intersects(frustum, spheres[i]);
+                results[i] = results[i] ? Culler::intersects(frustum, spheres[i]) : 0;
+            }
+            results.resize(lightCount);
+            EXPECT_EQ(expected, results);
+        }
+    };
+
+    check();
+
+    // moving some lights refits the hierarchy
+    for (size_t i = 0; i < count; i += 97) {
+        lcm.setPosition(lcm.getInstance(entities[i]), randomPosition());
+    }
+    check();
+
+    // removing lights rebuilds it
+    for (size_t i = 0; i < count; i += 13) {
+        scene->remove(entities[i]);
+    }
+    check();
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(count, entities.data());
+    engine->destroy(scene);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, SelectLargest) {
+    using namespace filament;
+
+    std::vector<float> scratch;
+    auto select = [&](std::vector<float> const& sizes, size_t maxCount) {
+        std::vector<uint8_t> selected(sizes.size(), 0x40);
+        FView::selectLargest(sizes.data(), sizes.size(), maxCount, selected.data(), scratch);
+        return selected;
+    };
+
+    // everything is selected when there is enough room
+    EXPECT_EQ(select({ 3, 1, 2 }, 3), std::vector<uint8_t>({ 1, 1, 1 }));
+    EXPECT_EQ(select({ 3, 1, 2 }, 5), std::vector<uint8_t>({ 1, 1, 1 }));
+
+    // otherwise the largest, and the first ones of those equal to the smallest selected
+    EXPECT_EQ(select({ 3, 1, 2, 5 }, 2), std::vector<uint8_t>({ 1, 0, 0, 1 }));
+    EXPECT_EQ(select({ 1, 2, 2, 3, 2 }, 3), std::vector<uint8_t>({ 0, 1, 1, 1, 0 }));
+    EXPECT_EQ(select({ 2, 2, 2, 2 }, 1), std::vector<uint8_t>({ 1, 0, 0, 0 }));
+    EXPECT_EQ(select({ 1, -std::numeric_limits<float>::infinity(), 2 }, 2),
+            std::vector<uint8_t>({ 1, 0, 1 }));
+
+    // the same as a stable sort
+    std::default_random_engine gen;
+    std::uniform_int_distribution<int> rand(0, 100);
+    std::vector<float> sizes(1000);
+    for (float& size : sizes) {
+        size = float(rand(gen));
+    }
+    constexpr size_t maxCount = 300;
+    std::vector<uint32_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) {
+        return sizes[lhs] > sizes[rhs];
+    });
+    std::vector<uint8_t> expected(sizes.size(), 0);
+    for (size_t i = 0; i < maxCount; i++) {
+        expected[order[i]] = 1;
+    }
+    EXPECT_EQ(select(sizes, maxCount), expected);
+}
+
+TEST(FilamentTest, OcclusionCulling) {
+    JobSystem js;
+    js.adopt();
+
+    // a wall facing the camera, 10m away, and a floor crossing the near plane
+    float3 const wall[] = { { -5, -3, -10 }, { 5, -3, -10 }, { 5, 3, -10 }, { -5, 3, -10 } };
+    float3 const floor[] = { { -20, -2, 5 }, { 20, -2, 5 }, { 20, -2, -50 }, { -20, -2, -50 } };
+    uint16_t const indices[] = { 0, 1, 2, 0, 2, 3 };
+
+    OcclusionCuller culler;
+    culler.begin(mat4f::perspective(60, 1, 0.1f, 100), 128, 128);
+    culler.addOccluder(mat4f{}, wall, indices, 6);
+    culler.addOccluder(mat4f::translation(float3{ 0, -1, 0 }), floor, indices, 6);
+    culler.rasterize(js);
+
+    // behind the wall
+    EXPECT_TRUE(culler.isOccluded({ 0, 0, -20 }, { 1, 1, 1 }));
+    // in front of the wall
+    EXPECT_FALSE(culler.isOccluded({ 0, 0, -5 }, { 1, 1, 1 }));
+    // behind the wall, but sticking out of it
+    EXPECT_FALSE(culler.isOccluded({ 0, 0, -20 }, { 10, 1, 1 }));
+    // crossing the wall
+    EXPECT_FALSE(culler.isOccluded({ 0, 0, -10 }, { 1, 1, 1 }));
+    // under the floor
+    EXPECT_TRUE(culler.isOccluded({ 0, -5, -25 }, { 5, 1, 10 }));
+    // crossing the near plane
+    EXPECT_FALSE(culler.isOccluded({ 0, 0, 0 }, { 1, 1, 1 }));
+
+    // without occluders nothing is hidden
+    culler.begin(mat4f::perspective(60, 1, 0.1f, 100), 128, 128);
+    culler.rasterize(js);
+    EXPECT_FALSE(culler.isOccluded({ 0, 0, -20 }, { 1, 1, 1 }));
+
+    js.emancipate();
+}
+
+TEST(FilamentTest, ShadowAtlas) {
+    EXPECT_EQ(1024u, ShadowAtlas::getLayerDimension(1024));
+    EXPECT_EQ(1008u, ShadowAtlas::getLayerDimension(1001));
+    EXPECT_EQ(0u, ShadowAtlas::getLevel(1024, 1024));
+    EXPECT_EQ(0u, ShadowAtlas::getLevel(1024, 600));
+    EXPECT_EQ(1u, ShadowAtlas::getLevel(1024, 512));
+    EXPECT_EQ(ShadowAtlas::MAX_LEVEL, ShadowAtlas::getLevel(1024, 3));
+
+    // one full layer, then mixed sizes spilling over to the next layer
+    uint8_t const levels[] = { 0, 1, 1, 1, 2, 2, 2, 2, 2, 3 };
+    ShadowAtlas atlas;
+    atlas.reset(1024, 2);
+    EXPECT_EQ(2u, atlas.getLayerCount());
+
+    std::vector<ShadowAtlas::Tile> tiles;
+    for (uint8_t level : levels) {
+        tiles.push_back(atlas.allocate(level));
+        EXPECT_EQ(1024u >> level, tiles.back().size);
+    }
+    EXPECT_EQ(2u, tiles[0].layer);
+    EXPECT_EQ(3u, tiles[1].layer);
+    EXPECT_EQ(4u, tiles[9].layer);
+    EXPECT_EQ(5u, atlas.getLayerCount());
+
+    // tiles fit in their layer and don't overlap
+    for (size_t i = 0; i < tiles.size(); i++) {
+        ShadowAtlas::Tile const& a = tiles[i];
+        EXPECT_LE(a.x + a.size, 1024u);
+        EXPECT_LE(a.y + a.size, 1024u);
+        for (size_t j = 0; j < i; j++) {
+            ShadowAtlas::Tile const& b = tiles[j];
+            bool const disjoint = a.layer != b.layer ||
+                    a.x + a.size <= b.x || b.x + b.size <= a.x ||
+                    a.y + a.size <= b.y || b.y + b.size <= a.y;
+            EXPECT_TRUE(disjoint);
+        }
+    }
+}
+
+TEST(FilamentTest, ShadowMapVisitScene) {
+    using namespace filament;
+
+    // enough renderables to be visited in parallel
+    constexpr size_t count = 3000;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FTransformManager& tcm = fengine.getTransformManager();
+
+    std::default_random_engine gen;
+    std::uniform_real_distribution<float> rand(-1.0f, 1.0f);
+
+    Scene* scene = engine->createScene();
+    FScene& fscene = upcast(*scene);
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (size_t i = 0; i < count; i++) {
+        RenderableManager::Builder(0)
+                .boundingBox({{ 0, 0, 0 }, { std::abs(rand(gen)), 1, std::abs(rand(gen)) }})
+                .castShadows(i % 3 != 0)
+                .receiveShadows(i % 5 != 0)
+                .layerMask(0xFF, i % 7 ? 0x1 : 0x2)
+                .build(*engine, entities[i]);
+        tcm.setTransform(tcm.getInstance(entities[i]), mat4f::translation(
+                float3{ 100.0f * rand(gen), 10.0f * rand(gen), 100.0f * rand(gen) }));
+        scene->addEntity(entities[i]);
+    }
+    fscene.prepare(fengine.getJobSystem(), mat4f());
+    ASSERT_EQ(fscene.getRenderableData().size(), count);
+
+    // the parallel reduction must give the same bounds as visiting the renderables in order
+    mat4f const Mv = mat4f::lookAt(float3{ 0 }, float3{ 1, -1, 1 }, float3{ 0, 1, 0 });
+    mat4f const V = inverse(mat4f::lookAt(float3{ 10, 2, 0 }, float3{ 0, 0, -1 }, float3{ 0, 1, 0 }));
+    for (uint32_t visibleLayers : { 0x1u, 0x3u }) {
+        ShadowMap::CascadeParameters parallel;
+        ShadowMap::CascadeParameters serial;
+        ShadowMap::visitScene(fengine.getJobSystem(), fscene, visibleLayers, Mv, V, parallel);
+        ShadowMap::visitScene(fscene, visibleLayers, Mv, V, serial, 0, count);
+        EXPECT_EQ(parallel.wsShadowCastersVolume.min, serial.wsShadowCastersVolume.min);
+        EXPECT_EQ(parallel.wsShadowCastersVolume.max, serial.wsShadowCastersVolume.max);
+        EXPECT_EQ(parallel.wsShadowReceiversVolume.min, serial.wsShadowReceiversVolume.min);
+        EXPECT_EQ(parallel.wsShadowReceiversVolume.max, serial.wsShadowReceiversVolume.max);
+        EXPECT_EQ(parallel.lsNearFar, serial.lsNearFar);
+        EXPECT_EQ(parallel.vsNearFar, serial.vsNearFar);
+    }
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(count, entities.data());
+    engine->destroy(scene);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, ShadowMapParallelUpdate) {
+    using namespace filament;
+
+    constexpr size_t cascadeCount = 3;
+    constexpr size_t spotCount = 2;
+    constexpr size_t renderableCount = 20;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FTransformManager& tcm = fengine.getTransformManager();
+    std::vector<Entity> entities(1 + 1 + spotCount + renderableCount);
+    EntityManager::get().create(entities.size(), entities.data());
+
+    // the camera looks down -z from the origin
+    Camera* camera = engine->createCamera(entities[0]);
+    camera->setProjection(45.0, 1.0, 0.1, 100.0);
+    Scene* scene = engine->createScene();
+    View* view = engine->createView();
+    const Viewport viewport{ 0, 0, 512, 512 };
+    view->setViewport(viewport);
+    view->setScene(scene);
+    view->setCamera(camera);
+    view->setShadowsEnabled(true);
+    FView& fview = upcast(*view);
+
+    LightManager::ShadowOptions shadowOptions;
+    shadowOptions.shadowCascades = cascadeCount;
+    LightManager::Builder(LightManager::Type::DIRECTIONAL)
+            .direction({ 0.5f, -1, -0.5f })
+            .castShadows(true)
+            .shadowOptions(shadowOptions)
+            .build(*engine, entities[1]);
+    scene->addEntity(entities[1]);
+    for (size_t i = 0; i < spotCount; i++) {
+        Entity const spot = entities[2 + i];
+        LightManager::Builder(LightManager::Type::SPOT)
+                .position({ 4.0f * float(i) - 2.0f, 5, -10 })
+                .direction({ 0, -1, 0 })
+                .falloff(20)
+                .spotLightCone(0.5f, 0.8f)
+                .castShadows(true)
+                .build(*engine, spot);
+        scene->addEntity(spot);
+    }
+    for (size_t i = 0; i < renderableCount; i++) {
+        Entity const entity = entities[2 + spotCount + i];
+        RenderableManager::Builder(0)
+                .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                .castShadows(true)
+                .receiveShadows(true)
+                .build(*engine, entity);
+        tcm.setTransform(tcm.getInstance(entity), mat4f::translation(
+                float3{ float(i % 5) - 2.0f, float(i % 3) - 1.0f, -5.0f - 4.0f * float(i) }));
+        scene->addEntity(entity);
+    }
+
+    struct Result {
+        mat4f lightSpace;
+        bool hasVisibleShadows;
+    };
+    auto prepare = [&]() {
+        LinearAllocatorArena arena("FRenderer: per-frame allocator",
+                FEngine::CONFIG_PER_RENDER_PASS_ARENA_SIZE);
+        filament::ArenaScope scope(arena);
+        fview.prepare(fengine, fengine.getDriverApi(), scope, viewport, float4{});
+        ShadowMapManager const& manager = fview.getShadowMapManager();
+        std::vector<Result> results;
+        for (size_t c = 0; c < cascadeCount; c++) {
+            ShadowMap const* map = manager.getCascadeShadowMap(c);
+            results.push_back({ map->getLightSpaceMatrix(), map->hasVisibleShadows() });
+        }
+        for (size_t i = 0; i < spotCount; i++) {
+            ShadowMap const* map = manager.getSpotShadowMap(i);
+            results.push_back({ map->getLightSpaceMatrix(), map->hasVisibleShadows() });
+        }
+        return results;
+    };
+
+    // the first frame initializes the debug near/far hints, the next ones only read them
+    prepare();
+    auto parallel = prepare();
+    fengine.debug.shadowmap.parallel_update = false;
+    auto serial = prepare();
+    fengine.debug.shadowmap.parallel_update = true;
+
+    ASSERT_EQ(parallel.size(), serial.size());
+    for (size_t i = 0; i < parallel.size(); i++) {
+        EXPECT_TRUE(parallel[i].hasVisibleShadows) << i;
+        EXPECT_EQ(parallel[i].hasVisibleShadows, serial[i].hasVisibleShadows) << i;
+        EXPECT_EQ(parallel[i].lightSpace, serial[i].lightSpace) << i;
+    }
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(entities.size(), entities.data());
+    engine->destroy(view);
+    engine->destroy(scene);
+    engine->destroyCameraComponent(entities[0]);
+    Engine::destroy(&engine);
+}
+
 TEST(FilamentTest, ColorConversion) {
     // Linear to Gamma
     // 0.0 stays 0.0
@@ -711,6 +1403,8 @@ TEST(FilamentTest, FroxelData) {
         EXPECT_TRUE(pos == float4( 0, 0, -3, 1 ));
 
         froxelData.froxelizeLights(*engine, {}, lights);
+        EXPECT_EQ(1, froxelData.getFroxelizedLightCount());
+        EXPECT_TRUE(froxelData.isCommitNeeded());
         auto const& froxelBuffer = froxelData.getFroxelBufferUser();
         auto const& recordBuffer = froxelData.getRecordBufferUser();
         size_t pointCount = 0;
@@ -721,11 +1415,934 @@ TEST(FilamentTest, FroxelData) {
         EXPECT_GT(pointCount, 0);
     }
 
+    {
+        // nothing changed, the froxel data is reused
+        froxelData.froxelizeLights(*engine, {}, lights);
+        EXPECT_EQ(0, froxelData.getFroxelizedLightCount());
+        EXPECT_FALSE(froxelData.isCommitNeeded());
+    }
+
+    {
+        // more lights than fit in 8 bits
+        constexpr size_t count = 600;
+        lights.clear();
+        lights.push_back({}, {}, {}, {}, {}, {});
+        for (size_t i = 0; i < count; i++) {
+            float4 const sphere{ float(i % 10) - 4.5f, float(i / 10 % 6) - 2.5f, -6 - i * 0.05f, 1 };
+            lights.push_back(sphere, {}, instance, 1, {}, {});
+        }
+
+        froxelData.froxelizeLights(*engine, {}, lights);
+        EXPECT_EQ(count, froxelData.getFroxelizedLightCount());
+        auto const& froxelBuffer = froxelData.getFroxelBufferUser();
+        auto const& recordBuffer = froxelData.getRecordBufferUser();
+        size_t maxIndex = 0;
+        for (size_t i = 0, c = froxelData.getFroxelCount(); i < c; i++) {
+            auto const& entry = froxelBuffer[i];
+            for (size_t j = 0; j < entry.count; j++) {
+                size_t const index = recordBuffer[entry.offset + j];
+                EXPECT_LT(index, count);
+                maxIndex = std::max(maxIndex, index);
+                if (j) {
+                    // each froxel lists its lights in increasing order
+                    EXPECT_LT(recordBuffer[entry.offset + j - 1], index);
+                }
+            }
+        }
+        EXPECT_GT(maxIndex, 255);
+    }
+
     froxelData.terminate(engine->getDriverApi());
 
     Engine::destroy((Engine **)&engine);
 }
 
+TEST(FilamentTest, ColorGradingLutCache) {
+    using namespace filament;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FColorGrading::LutCache const& cache = upcast(engine)->getColorGradingLutCache();
+
+    // the engine's default color grading has its own LUT
+    const size_t initialCount = cache.getLutCount();
+    EXPECT_EQ(cache.getUnusedLutCount(), 0u);
+
+    // identical settings share a LUT
+    ColorGrading* a = ColorGrading::Builder().contrast(1.5f).build(*engine);
+    ColorGrading* b = ColorGrading::Builder().contrast(1.5f).build(*engine);
+    EXPECT_EQ(upcast(a)->getHwHandle(), upcast(b)->getHwHandle());
+    EXPECT_EQ(cache.getLutCount(), initialCount + 1);
+
+    // the default settings share the LUT of the default color grading
+    ColorGrading* defaults = ColorGrading::Builder().build(*engine);
+    EXPECT_EQ(upcast(defaults)->getHwHandle(),
+            upcast(engine)->getDefaultColorGrading()->getHwHandle());
+    EXPECT_EQ(cache.getLutCount(), initialCount + 1);
+
+    // different settings don't
+    ColorGrading* c = ColorGrading::Builder().contrast(0.5f).build(*engine);
+    EXPECT_NE(upcast(c)->getHwHandle(), upcast(a)->getHwHandle());
+    EXPECT_EQ(cache.getLutCount(), initialCount + 2);
+
+    // the LUT stays alive as long as a color grading uses it
+    engine->destroy(a);
+    EXPECT_EQ(cache.getUnusedLutCount(), 0u);
+    ColorGrading* d = ColorGrading::Builder().contrast(1.5f).build(*engine);
+    EXPECT_EQ(upcast(d)->getHwHandle(), upcast(b)->getHwHandle());
+    engine->destroy(b);
+    engine->destroy(d);
+    EXPECT_EQ(cache.getUnusedLutCount(), 1u);
+
+    // going back to recent settings reuses the unused LUT
+    ColorGrading* e = ColorGrading::Builder().contrast(1.5f).build(*engine);
+    EXPECT_EQ(cache.getUnusedLutCount(), 0u);
+    EXPECT_EQ(cache.getLutCount(), initialCount + 2);
+    engine->destroy(e);
+
+    // only the most recently used of the unused LUTs are kept
+    for (size_t i = 0; i < FColorGrading::LutCache::MAX_UNUSED_COUNT + 3; i++) {
+        ColorGrading* f = ColorGrading::Builder().saturation(0.1f * (i + 1)).build(*engine);
+        engine->destroy(f);
+        EXPECT_LE(cache.getUnusedLutCount(), FColorGrading::LutCache::MAX_UNUSED_COUNT);
+    }
+    EXPECT_EQ(cache.getUnusedLutCount(), FColorGrading::LutCache::MAX_UNUSED_COUNT);
+    EXPECT_EQ(cache.getLutCount(), initialCount + 1 + FColorGrading::LutCache::MAX_UNUSED_COUNT);
+
+    engine->destroy(c);
+    engine->destroy(defaults);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, DrawBatching) {
+    using namespace filament;
+
+    // more than fits in a single instanced draw
+    constexpr size_t count = CONFIG_MAX_BATCH_COUNT + 8;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FRenderableManager& rcm = fengine.getRenderableManager();
+    HwRenderPrimitiveFactory const& factory = fengine.getHwRenderPrimitiveFactory();
+    const size_t initialPrimitiveCount = factory.getPrimitiveCount();
+
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(3)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    MaterialInstance const* mi = fengine.getDefaultMaterial()->getDefaultInstance();
+
+    // renderables built from the same buffers share their HwRenderPrimitive
+    Scene* scene = engine->createScene();
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (Entity entity : entities) {
+        RenderableManager::Builder(1)
+                .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+                .material(0, mi)
+                .build(*engine, entity);
+        scene->addEntity(entity);
+    }
+    auto handle = rcm.getRenderPrimitives(rcm.getInstance(entities[0]), 0)[0].getHwHandle();
+    for (Entity entity : entities) {
+        EXPECT_EQ(rcm.getRenderPrimitives(rcm.getInstance(entity), 0)[0].getHwHandle(), handle);
+    }
+    EXPECT_EQ(factory.getPrimitiveCount(), initialPrimitiveCount + 1);
+
+    // a different range gets its own HwRenderPrimitive, and switches back when restored
+    rcm.setGeometryAt(rcm.getInstance(entities[0]), 0, 0,
+            RenderableManager::PrimitiveType::TRIANGLES, 0, 0, 2, 2);
+    EXPECT_NE(rcm.getRenderPrimitives(rcm.getInstance(entities[0]), 0)[0].getHwHandle(), handle);
+    EXPECT_EQ(factory.getPrimitiveCount(), initialPrimitiveCount + 2);
+    rcm.setGeometryAt(rcm.getInstance(entities[0]), 0, 0,
+            RenderableManager::PrimitiveType::TRIANGLES, upcast(vb), upcast(ib), 0, 3);
+    EXPECT_EQ(rcm.getRenderPrimitives(rcm.getInstance(entities[0]), 0)[0].getHwHandle(), handle);
+    EXPECT_EQ(factory.getPrimitiveCount(), initialPrimitiveCount + 1);
+
+    // their commands collapse into instanced draws of at most CONFIG_MAX_BATCH_COUNT instances
+    FScene& fscene = upcast(*scene);
+    fscene.prepare(fengine.getJobSystem(), mat4f());
+    FScene::RenderableSoa& soa = fscene.getRenderableData();
+    for (size_t i = 0; i < count; i++) {
+        soa.elementAt<FScene::VISIBLE_MASK>(i) = VISIBLE_RENDERABLE;
+    }
+
+    std::vector<RenderPass::Command> storage(count * 4);
+    RenderPass pass(fengine, { storage.data(), storage.size() });
+    pass.setGeometry(soa, { 0, uint32_t(count) }, fscene.getRenderableUBO());
+    pass.setCamera(CameraInfo{});
+    pass.appendCommands(RenderPass::COLOR);
+    pass.sortCommands();
+    EXPECT_EQ(size_t(pass.end() - pass.begin()), count);
+
+    fengine.debug.renderer.draw_batching = true;
+    pass.executeCommands("test");
+    EXPECT_EQ(pass.getMergedDrawCount(), count - 2);
+
+    fengine.debug.renderer.draw_batching = false;
+    pass.executeCommands("test");
+    EXPECT_EQ(pass.getMergedDrawCount(), 0u);
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EXPECT_EQ(factory.getPrimitiveCount(), initialPrimitiveCount);
+    EntityManager::get().destroy(count, entities.data());
+    engine->destroy(scene);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, ParallelRecording) {
+    using namespace filament;
+    using namespace filament::backend;
+
+    // enough commands to be recorded in parallel
+    constexpr size_t count = RenderPass::PARALLEL_RECORDING_MIN_COMMANDS + 1000;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(3)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    Material const* material = fengine.getDefaultMaterial();
+    std::array<MaterialInstance*, 3> mis{};
+    for (MaterialInstance*& mi : mis) {
+        mi = material->createInstance();
+    }
+
+    // runs of renderables that can be batched, interrupted by skinned ones, with a few
+    // material instances so that the chunks don't all start with the same one
+    Scene* scene = engine->createScene();
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (size_t i = 0; i < count; i++) {
+        RenderableManager::Builder builder(1);
+        builder.boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+                .material(0, mis[(i / 500) % mis.size()]);
+        if (i % 97 == 0) {
+            builder.skinning(1);
+        }
+        builder.build(*engine, entities[i]);
+        scene->addEntity(entities[i]);
+    }
+
+    FScene& fscene = upcast(*scene);
+    fscene.prepare(fengine.getJobSystem(), mat4f());
+    FScene::RenderableSoa& soa = fscene.getRenderableData();
+    for (size_t i = 0; i < count; i++) {
+        soa.elementAt<FScene::VISIBLE_MASK>(i) = VISIBLE_RENDERABLE;
+    }
+
+    std::vector<RenderPass::Command> storage(count * 4);
+    RenderPass pass(fengine, { storage.data(), storage.size() });
+    pass.setGeometry(soa, { 0, uint32_t(count) }, fscene.getRenderableUBO());
+    pass.setCamera(CameraInfo{});
+    pass.appendCommands(RenderPass::COLOR);
+    pass.sortCommands();
+    ASSERT_GE(size_t(pass.end() - pass.begin()), RenderPass::PARALLEL_RECORDING_MIN_COMMANDS);
+
+    // records the pass in a sub-stream, and returns the type and size of each driver command
+    FEngine::DriverApi& driver = fengine.getDriverApi();
+    std::vector<char> memory(64 * 1024 * 1024);
+    auto record = [&](bool parallel) {
+        CircularBuffer buffer(memory.data(), memory.size());
+        FEngine::DriverApi stream = driver.createSubStream(buffer);
+        if (parallel) {
+            pass.recordDriverCommands(stream, pass.begin(), pass.end());
+        } else {
+            pass.recordDriverCommandsRange(stream, pass.begin(), pass.end(),
+                    fengine.debug.renderer.draw_batching);
+        }
+        std::vector<std::pair<uintptr_t, size_t>> commands;
+        Driver& noop = fengine.getDriver();
+        CommandBase* command = static_cast<CommandBase*>(buffer.getTail());
+        while (command != buffer.getHead()) {
+            uintptr_t execute;
+            memcpy(&execute, command, sizeof(execute));
+            CommandBase* const next = command->execute(noop);
+            commands.emplace_back(execute, size_t((char*)next - (char*)command));
+            command = next;
+        }
+        EXPECT_EQ(stream.getCommandCount() - driver.getCommandCount(), commands.size());
+        return commands;
+    };
+
+    for (bool batching : { true, false }) {
+        fengine.debug.renderer.draw_batching = batching;
+        auto serial = record(false);
+        auto parallel = record(true);
+        EXPECT_FALSE(serial.empty());
+        EXPECT_EQ(parallel, serial);
+    }
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(count, entities.data());
+    for (MaterialInstance* mi : mis) {
+        engine->destroy(mi);
+    }
+    engine->destroy(scene);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, CommandCache) {
+    using namespace filament;
+
+    constexpr size_t count = 16;
+    constexpr auto commandTypeFlags = RenderPass::CommandTypeFlags(
+            RenderPass::COLOR | RenderPass::DEPTH);
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FRenderableManager& rcm = fengine.getRenderableManager();
+    FTransformManager& tcm = fengine.getTransformManager();
+
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(3)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    Material const* material = fengine.getDefaultMaterial();
+    MaterialInstance* mi = material->createInstance();
+
+    Scene* scene = engine->createScene();
+    FScene& fscene = upcast(*scene);
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (size_t i = 0; i < count; i++) {
+        RenderableManager::Builder(1)
+                .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+                .material(0, mi)
+                .build(*engine, entities[i]);
+        tcm.setTransform(tcm.getInstance(entities[i]),
+                mat4f::translation(float3{ 0, 0, -10.0f * float(i + 1) }));
+        scene->addEntity(entities[i]);
+    }
+
+    // generates the sorted commands of a frame, with or without a cache
+    RenderPass::CommandCache cache;
+    CameraInfo camera;
+    auto generate = [&](RenderPass::CommandCache* commandCache) {
+        fscene.prepare(fengine.getJobSystem(), mat4f());
+        FScene::RenderableSoa& soa = fscene.getRenderableData();
+        for (size_t i = 0; i < soa.size(); i++) {
+            soa.elementAt<FScene::VISIBLE_MASK>(i) = VISIBLE_RENDERABLE;
+        }
+        std::vector<RenderPass::Command> storage(count * 4);
+        RenderPass pass(fengine, { storage.data(), storage.size() });
+        pass.setGeometry(soa, { 0, uint32_t(soa.size()) }, fscene.getRenderableUBO());
+        pass.setCamera(camera);
+        pass.setCommandCache(commandCache);
+        pass.appendCommands(commandTypeFlags);
+        pass.sortCommands();
+        return std::vector<RenderPass::Command>(pass.begin(), pass.end());
+    };
+
+    // the cached commands must be the same as the generated ones
+    auto check = [&](size_t expectedReusedCount) {
+        auto cached = generate(&cache);
+        EXPECT_EQ(cache.getReusedCount(), expectedReusedCount);
+        auto expected = generate(nullptr);
+        EXPECT_EQ(cached.size(), expected.size());
+        EXPECT_TRUE(std::equal(cached.begin(), cached.end(), expected.begin(), expected.end(),
+                [](RenderPass::Command const& lhs, RenderPass::Command const& rhs) {
+                    return !memcmp(&lhs, &rhs, sizeof(RenderPass::Command));
+                }));
+        return cached;
+    };
+
+    // nothing is cached the first frame, everything is reused the next one
+    auto first = check(0);
+    EXPECT_EQ(first.size(), count * 2);
+    check(count);
+
+    // the distances to the camera of the reused commands are patched
+    camera.model = mat4f::translation(float3{ 0, 0, -1000.0f });
+    auto moved = check(count);
+    EXPECT_FALSE(std::equal(first.begin(), first.end(), moved.begin(), moved.end(),
+            [](RenderPass::Command const& lhs, RenderPass::Command const& rhs) {
+                return lhs.key == rhs.key;
+            }));
+
+    // so are the UBO slots, when renderables are removed
+    scene->remove(entities[0]);
+    check(count - 1);
+    scene->addEntity(entities[0]);
+    check(count - 1);
+
+    // only the changed renderables are regenerated
+    rcm.setBlendOrderAt(rcm.getInstance(entities[3]), 0, 0, 1);
+    check(count - 1);
+
+    // a material instance state change invalidates everything, but only if the state changes
+    mi->setCullingMode(MaterialInstance::CullingMode::FRONT);
+    auto culled = check(0);
+    EXPECT_TRUE(std::all_of(culled.begin(), culled.end(), [](RenderPass::Command const& cmd) {
+        return cmd.primitive.rasterState.culling == MaterialInstance::CullingMode::FRONT;
+    }));
+    mi->setCullingMode(MaterialInstance::CullingMode::FRONT);
+    check(count);
+    mi->setDepthWrite(false);
+    check(0);
+
+    // so does the creation or destruction of a material instance, whose memory can be reused
+    engine->destroy(material->createInstance());
+    check(0);
+    check(count);
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(count, entities.data());
+    engine->destroy(mi);
+    engine->destroy(scene);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, PersistentRenderableUBO) {
+    using namespace filament;
+
+    constexpr size_t count = 80;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FRenderableManager& rcm = fengine.getRenderableManager();
+    FTransformManager& tcm = fengine.getTransformManager();
+
+    Scene* scene = engine->createScene();
+    FScene& fscene = upcast(*scene);
+    fscene.setIncrementalPreparationEnabled(true);
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (Entity entity : entities) {
+        RenderableManager::Builder(1)
+                .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                .build(*engine, entity);
+        scene->addEntity(entity);
+    }
+
+    // prepares the scene and uploads the uniforms of all its renderables
+    auto update = [&](mat4f const& worldOrigin = {}) {
+        fscene.prepare(fengine.getJobSystem(), worldOrigin);
+        fscene.updateUBOs({ 0, uint32_t(count) }, {});
+        return fscene.getRenderableUBOUpdates();
+    };
+
+    // the first frame uploads everything at once
+    auto updates = update();
+    EXPECT_EQ(updates.rangeCount, 1u);
+    EXPECT_EQ(updates.renderableCount, count);
+    EXPECT_TRUE(fscene.getRenderableUBO());
+
+    // the entity of each UBO slot
+    std::vector<Entity> slots(count);
+    FScene::RenderableSoa const& soa = fscene.getRenderableData();
+    for (size_t i = 0; i < count; i++) {
+        slots[soa.elementAt<FScene::UBO_SLOT>(i)] =
+                rcm.getEntity(soa.elementAt<FScene::RENDERABLE_INSTANCE>(i));
+    }
+    auto move = [&](size_t slot) {
+        tcm.setTransform(tcm.getInstance(slots[slot]), mat4f::translation(float3{ 1, 0, 0 }));
+    };
+
+    // nothing changed, nothing is uploaded
+    updates = update();
+    EXPECT_EQ(updates.rangeCount, 0u);
+    EXPECT_EQ(updates.renderableCount, 0u);
+
+    // each range of contiguous slots that changed is a separate upload
+    move(1);
+    move(2);
+    move(5);
+    updates = update();
+    EXPECT_EQ(updates.rangeCount, 2u);
+    EXPECT_EQ(updates.renderableCount, 3u);
+
+    // past a number of ranges, everything is uploaded at once
+    for (size_t i = 0; i < count; i += 2) {
+        move(i);
+    }
+    updates = update();
+    EXPECT_EQ(updates.rangeCount, 1u);
+    EXPECT_EQ(updates.renderableCount, count);
+
+    // all the world transforms change with the world origin
+    updates = update(mat4f::translation(float3{ 0, 1, 0 }));
+    EXPECT_EQ(updates.rangeCount, 1u);
+    EXPECT_EQ(updates.renderableCount, count);
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(count, entities.data());
+    engine->destroy(scene);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, IncrementalRenderableRows) {
+    using namespace filament;
+
+    constexpr size_t count = 80;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FRenderableManager& rcm = fengine.getRenderableManager();
+    FTransformManager& tcm = fengine.getTransformManager();
+
+    Scene* scene = engine->createScene();
+    FScene& fscene = upcast(*scene);
+    fscene.setIncrementalPreparationEnabled(true);
+    std::vector<Entity> entities(count);
+    EntityManager::get().create(count, entities.data());
+    for (Entity entity : entities) {
+        RenderableManager::Builder(1)
+                .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+                .build(*engine, entity);
+        scene->addEntity(entity);
+    }
+
+    FScene::RenderableSoa& soa = fscene.getRenderableData();
+    auto prepare = [&](mat4f const& worldOrigin = {}) {
+        fscene.prepare(fengine.getJobSystem(), worldOrigin);
+        return fscene.getRenderableRowCopies();
+    };
+    // each row of the renderable data holds the renderable of its UBO slot, at its position
+    auto rowsAreValid = [&](float3 const& position) {
+        for (size_t i = 0; i < count; i++) {
+            Entity const entity = rcm.getEntity(soa.elementAt<FScene::RENDERABLE_INSTANCE>(i));
+            float3 const expected = (mat4f::translation(position) *
+                    tcm.getTransform(tcm.getInstance(entity)))[3].xyz;
+            if (soa.elementAt<FScene::UBO_SLOT>(i) != i ||
+                    soa.elementAt<FScene::WORLD_TRANSFORM>(i)[3].xyz != expected) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // the first frame copies every row
+    EXPECT_EQ(prepare(), count);
+    EXPECT_TRUE(rowsAreValid({}));
+
+    // the rows of the renderables that didn't change are kept
+    EXPECT_EQ(prepare(), 0u);
+    EXPECT_TRUE(rowsAreValid({}));
+
+    // only the rows of the renderables that changed are copied
+    Entity const moved = rcm.getEntity(soa.elementAt<FScene::RENDERABLE_INSTANCE>(5));
+    tcm.setTransform(tcm.getInstance(moved), mat4f::translation(float3{ 1, 0, 0 }));
+    EXPECT_EQ(prepare(), 1u);
+    EXPECT_TRUE(rowsAreValid({}));
+    EXPECT_EQ(soa.elementAt<FScene::WORLD_TRANSFORM>(5)[3].xyz, (float3{ 1, 0, 0 }));
+
+    // the rows reordered by a view are restored
+    soa.swap(0, 1);
+    soa.swap(2, 3);
+    EXPECT_EQ(prepare(), 4u);
+    EXPECT_TRUE(rowsAreValid({}));
+
+    // all the world transforms change with the world origin
+    EXPECT_EQ(prepare(mat4f::translation(float3{ 0, 1, 0 })), count);
+    EXPECT_TRUE(rowsAreValid({ 0, 1, 0 }));
+    EXPECT_EQ(prepare(mat4f::translation(float3{ 0, 1, 0 })), 0u);
+
+    // removing an entity from the scene copies every row again
+    scene->remove(entities.back());
+    EXPECT_EQ(prepare(), count - 1);
+    EXPECT_EQ(soa.size(), count - 1);
+
+    for (Entity entity : entities) {
+        engine->destroy(entity);
+    }
+    EntityManager::get().destroy(count, entities.data());
+    engine->destroy(scene);
+    Engine::destroy(&engine);
+}
+
+#if defined(__EXCEPTIONS) || defined(NDEBUG)
+
+// the preconditions of the builders throw when exceptions are enabled, otherwise (in release
+// builds) they're only logged
+static bool buildFails(RenderableManager::Builder& builder, Engine& engine, Entity entity) {
+#if defined(__EXCEPTIONS)
+    try {
+        return builder.build(engine, entity) != RenderableManager::Builder::Success;
+    } catch (utils::Panic const&) {
+        return true;
+    }
+#else
+    return builder.build(engine, entity) != RenderableManager::Builder::Success;
+#endif
+}
+
+TEST(FilamentTest, InstancesBuildLimits) {
+    using namespace filament;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FRenderableManager& rcm = upcast(engine)->getRenderableManager();
+    Entity entity = EntityManager::get().create();
+    const Box box = {{ 0, 0, 0 }, { 1, 1, 1 }};
+
+    // between 1 and CONFIG_MAX_INSTANCES instances
+    RenderableManager::Builder none(1);
+    none.boundingBox(box).instances(0);
+    EXPECT_TRUE(buildFails(none, *engine, entity));
+    EXPECT_FALSE(rcm.hasComponent(entity));
+
+    RenderableManager::Builder tooMany(1);
+    tooMany.boundingBox(box).instances(CONFIG_MAX_INSTANCES + 1);
+    EXPECT_TRUE(buildFails(tooMany, *engine, entity));
+    EXPECT_FALSE(rcm.hasComponent(entity));
+
+    RenderableManager::Builder max(1);
+    max.boundingBox(box).instances(CONFIG_MAX_INSTANCES);
+    EXPECT_FALSE(buildFails(max, *engine, entity));
+    EXPECT_EQ(rcm.getInstanceCount(rcm.getInstance(entity)), CONFIG_MAX_INSTANCES);
+    rcm.destroy(entity);
+
+    // the instances are stored in the bones UBO
+    RenderableManager::Builder skinned(1);
+    skinned.boundingBox(box).instances(2).skinning(4);
+    EXPECT_TRUE(buildFails(skinned, *engine, entity));
+    EXPECT_FALSE(rcm.hasComponent(entity));
+
+    RenderableManager::Builder morphed(1);
+    morphed.boundingBox(box).instances(2).morphing(true);
+    EXPECT_TRUE(buildFails(morphed, *engine, entity));
+    EXPECT_FALSE(rcm.hasComponent(entity));
+
+    // a single instance can be combined with skinning
+    RenderableManager::Builder single(1);
+    single.boundingBox(box).instances(1).skinning(4);
+    EXPECT_FALSE(buildFails(single, *engine, entity));
+    EXPECT_EQ(rcm.getInstanceCount(rcm.getInstance(entity)), 1u);
+    rcm.destroy(entity);
+
+    EntityManager::get().destroy(entity);
+    Engine::destroy(&engine);
+}
+
+#endif
+
+TEST(FilamentTest, InstanceTransforms) {
+    using namespace filament;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FRenderableManager& rcm = upcast(engine)->getRenderableManager();
+    Entity entities[2];
+    EntityManager::get().create(2, entities);
+
+    RenderableManager::Builder(1)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .instances(4)
+            .build(*engine, entities[0]);
+    auto ri = rcm.getInstance(entities[0]);
+    EXPECT_EQ(rcm.getInstanceCount(ri), 4u);
+    FRenderableManager::Instances const* instances = rcm.getInstances(ri);
+    ASSERT_NE(instances, nullptr);
+    auto translation = [instances](size_t i) { return instances->transforms[i][3].xyz; };
+
+    // the instances are at the origin by default
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(translation(i), float3(0));
+    }
+
+    // only the given range is updated, and the bounds follow
+    const mat4f transforms[2] = {
+            mat4f::translation(float3{ 1, 0, 0 }), mat4f::translation(float3{ 2, 0, 0 }) };
+    rcm.setInstanceTransforms(ri, transforms, 2, 1);
+    EXPECT_EQ(translation(0), float3(0));
+    EXPECT_EQ(translation(1), float3(1, 0, 0));
+    EXPECT_EQ(translation(2), float3(2, 0, 0));
+    EXPECT_EQ(translation(3), float3(0));
+    EXPECT_EQ(instances->bounds.getMin(), float3(-1, -1, -1));
+    EXPECT_EQ(instances->bounds.getMax(), float3(3, 1, 1));
+
+    // the transforms past the last instance are ignored
+    rcm.setInstanceTransforms(ri, transforms, 2, 3);
+    EXPECT_EQ(translation(2), float3(2, 0, 0));
+    EXPECT_EQ(translation(3), float3(1, 0, 0));
+    rcm.setInstanceTransforms(ri, transforms, 1, 4);
+    EXPECT_EQ(translation(3), float3(1, 0, 0));
+    EXPECT_EQ(rcm.getInstanceCount(ri), 4u);
+
+    // and so are the renderables that aren't instanced
+    RenderableManager::Builder(1)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .build(*engine, entities[1]);
+    auto other = rcm.getInstance(entities[1]);
+    rcm.setInstanceTransforms(other, transforms, 1, 0);
+    EXPECT_EQ(rcm.getInstances(other), nullptr);
+    EXPECT_EQ(rcm.getInstanceCount(other), 1u);
+
+    rcm.destroy(entities[0]);
+    rcm.destroy(entities[1]);
+    EntityManager::get().destroy(2, entities);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, InstanceCulling) {
+    using namespace filament;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FRenderableManager& rcm = fengine.getRenderableManager();
+    Entity entities[2];
+    EntityManager::get().create(2, entities);
+
+    // the camera looks down -z from the origin, at z=-10 the frustum is about 8m wide
+    Camera* camera = engine->createCamera(entities[0]);
+    camera->setProjection(45.0, 1.0, 0.1, 100.0);
+    Scene* scene = engine->createScene();
+    View* view = engine->createView();
+    const Viewport viewport{ 0, 0, 512, 512 };
+    view->setViewport(viewport);
+    view->setScene(scene);
+    view->setCamera(camera);
+
+    auto at = [](float x) { return mat4f::translation(float3{ x, 0, -10 }); };
+    const mat4f someVisible[3] = { at(-1), at(1), at(50) };
+    // the union of these instances intersects the frustum, but none of them does
+    const mat4f noneVisible[3] = { at(-50), at(50), at(50) };
+
+    RenderableManager::Builder(1)
+            .boundingBox({{ 0, 0, 0 }, { 1, 1, 1 }})
+            .instances(3, someVisible)
+            .build(*engine, entities[1]);
+    scene->addEntity(entities[1]);
+    auto ri = rcm.getInstance(entities[1]);
+    FRenderableManager::Instances const* instances = rcm.getInstances(ri);
+    ASSERT_NE(instances, nullptr);
+
+    // prepares the view, and returns whether the renderable is visible
+    auto prepare = [&]() {
+        LinearAllocatorArena arena("FRenderer: per-frame allocator",
+                FEngine::CONFIG_PER_RENDER_PASS_ARENA_SIZE);
+        filament::ArenaScope scope(arena);
+        FView& fview = upcast(*view);
+        fview.prepare(fengine, fengine.getDriverApi(), scope, viewport, float4{});
+        FScene::RenderableSoa const& soa = upcast(scene)->getRenderableData();
+        auto const* renderables = soa.data<FScene::RENDERABLE_INSTANCE>();
+        auto const& vr = fview.getVisibleRenderables();
+        return std::find(renderables + vr.first, renderables + vr.last, ri) !=
+                renderables + vr.last;
+    };
+
+    // only the visible instances are drawn
+    EXPECT_TRUE(prepare());
+    EXPECT_EQ(instances->visibleCount, 2u);
+
+    // the renderable isn't drawn when none of its instances is visible
+    rcm.setInstanceTransforms(ri, noneVisible, 3);
+    EXPECT_FALSE(prepare());
+    EXPECT_EQ(instances->visibleCount, 0u);
+
+    // all the instances are drawn when culling is disabled
+    rcm.setCulling(ri, false);
+    EXPECT_TRUE(prepare());
+    EXPECT_EQ(instances->visibleCount, 3u);
+    rcm.setCulling(ri, true);
+
+    // the instances of the renderables in hidden layers aren't culled nor uploaded
+    rcm.setInstanceTransforms(ri, someVisible, 3);
+    view->setVisibleLayers(0xFF, 0x2);
+    EXPECT_FALSE(prepare());
+    EXPECT_EQ(instances->visibleCount, 3u);
+    view->setVisibleLayers(0xFF, 0x1);
+    EXPECT_TRUE(prepare());
+    EXPECT_EQ(instances->visibleCount, 2u);
+
+    rcm.destroy(entities[1]);
+    engine->destroyCameraComponent(entities[0]);
+    engine->destroy(view);
+    engine->destroy(scene);
+    EntityManager::get().destroy(2, entities);
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, LevelOfDetailSelection) {
+    using namespace filament;
+
+    // level 1 below half the screen, level 2 below a quarter
+    const FRenderableManager::LevelOfDetail lod{ 3, { 0.0f, 0.5f, 0.25f }};
+    auto select = [&lod](uint8_t level, float screenSize, float hysteresis = 0.0f) {
+        return FView::selectLevelOfDetail(lod, level, screenSize, hysteresis);
+    };
+
+    EXPECT_EQ(select(0, 1.0f), 0);
+    EXPECT_EQ(select(0, 0.4f), 1);
+    EXPECT_EQ(select(0, 0.1f), 2);
+    EXPECT_EQ(select(2, 1.0f), 0);
+    EXPECT_EQ(select(7, 0.4f), 1);
+
+    // the thresholds must be crossed by more than the hysteresis margin
+    EXPECT_EQ(select(0, 0.47f, 0.1f), 0);
+    EXPECT_EQ(select(0, 0.44f, 0.1f), 1);
+    EXPECT_EQ(select(1, 0.53f, 0.1f), 1);
+    EXPECT_EQ(select(1, 0.56f, 0.1f), 0);
+    EXPECT_EQ(select(1, 0.24f, 0.1f), 1);
+    EXPECT_EQ(select(1, 0.22f, 0.1f), 2);
+}
+
+TEST(FilamentTest, LevelOfDetail) {
+    using namespace filament;
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    FEngine& fengine = upcast(*engine);
+    FRenderableManager& rcm = fengine.getRenderableManager();
+    Entity entities[3];
+    EntityManager::get().create(3, entities);
+    Entity const a = entities[1];
+    Entity const b = entities[2];
+
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(6)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(6)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    MaterialInstance const* mi = fengine.getDefaultMaterial()->getDefaultInstance();
+
+    // the camera looks down -z from the origin
+    Camera* camera = engine->createCamera(entities[0]);
+    camera->setProjection(45.0, 1.0, 0.1, 100.0);
+    Scene* scene = engine->createScene();
+    View* view = engine->createView();
+    const Viewport viewport{ 0, 0, 512, 512 };
+    view->setViewport(viewport);
+    view->setScene(scene);
+    view->setCamera(camera);
+    FView& fview = upcast(*view);
+
+    auto prepare = [&]() {
+        LinearAllocatorArena arena("FRenderer: per-frame allocator",
+                FEngine::CONFIG_PER_RENDER_PASS_ARENA_SIZE);
+        filament::ArenaScope scope(arena);
+        fview.prepare(fengine, fengine.getDriverApi(), scope, viewport, float4{});
+        fview.updatePrimitivesLod(fengine, fview.getCameraInfo(),
+                upcast(scene)->getRenderableData(), fview.getVisibleRenderables());
+    };
+
+    // returns the level of detail drawn for the given renderable, -1 if it's not visible
+    auto levelOf = [&](Entity entity) {
+        auto ri = rcm.getInstance(entity);
+        FScene::RenderableSoa const& soa = upcast(scene)->getRenderableData();
+        auto const& vr = fview.getVisibleRenderables();
+        for (uint32_t i = vr.first; i < vr.last; i++) {
+            if (soa.elementAt<FScene::RENDERABLE_INSTANCE>(i) == ri) {
+                auto const& primitives = soa.elementAt<FScene::PRIMITIVES>(i);
+                for (uint8_t level = 0; level < rcm.getLevelOfDetailCount(ri); level++) {
+                    if (primitives.begin() == rcm.getRenderPrimitives(ri, level).begin()) {
+                        return int(level);
+                    }
+                }
+            }
+        }
+        return -1;
+    };
+
+    // the screen size of the renderables below
+    prepare();
+    const float3 center{ 0, 0, -10 };
+    const float3 extent{ 1, 1, 1 };
+    const float screenSize = fview.getScreenSize(center, extent);
+    ASSERT_GT(screenSize, 0.0f);
+
+    // the level 2 inherits the geometry of the level 1
+    auto build = [&](Entity entity, float threshold) {
+        RenderableManager::Builder(2)
+                .boundingBox({ center, extent })
+                .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, 0, 6)
+                .geometry(1, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, 0, 6)
+                .geometry(0, 1, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, 0, 3)
+                .geometry(1, 1, RenderableManager::PrimitiveType::TRIANGLES, vb, ib, 3, 3)
+                .levelOfDetail(1, threshold)
+                .levelOfDetail(2, threshold * 0.01f)
+                .material(0, mi)
+                .material(1, mi)
+                .build(*engine, entity);
+        scene->addEntity(entity);
+    };
+    build(a, screenSize * 0.01f);
+    build(b, screenSize * 1.05f);
+
+    // getRenderPrimitives() returns the primitives of the requested level
+    auto ri = rcm.getInstance(b);
+    EXPECT_EQ(rcm.getLevelOfDetailCount(ri), 3u);
+    auto level0 = rcm.getRenderPrimitives(ri, 0);
+    auto level1 = rcm.getRenderPrimitives(ri, 1);
+    auto level2 = rcm.getRenderPrimitives(ri, 2);
+    ASSERT_EQ(level0.size(), 2u);
+    ASSERT_EQ(level1.size(), 2u);
+    ASSERT_EQ(level2.size(), 2u);
+    EXPECT_NE(level0[0].getHwHandle(), level1[0].getHwHandle());
+    EXPECT_NE(level1[0].getHwHandle(), level1[1].getHwHandle());
+    EXPECT_EQ(level1[0].getHwHandle(), level2[0].getHwHandle());
+    EXPECT_EQ(level1[1].getHwHandle(), level2[1].getHwHandle());
+
+    // without hysteresis, b switches to the level 1 as soon as it's below its threshold
+    view->setLevelOfDetailOptions({ .bias = 0, .hysteresis = 0.0f });
+    prepare();
+    EXPECT_EQ(levelOf(a), 0);
+    EXPECT_EQ(levelOf(b), 1);
+
+    // b is within the hysteresis margin of its threshold, so it stays at its current level
+    view->setLevelOfDetailOptions({ .bias = 0, .hysteresis = 0.1f });
+    prepare();
+    EXPECT_EQ(levelOf(a), 0);
+    EXPECT_EQ(levelOf(b), 1);
+
+    // the bias is applied after the selection, and clamped to the levels
+    view->setLevelOfDetailOptions({ .bias = 4, .hysteresis = 0.1f });
+    prepare();
+    EXPECT_EQ(levelOf(a), 2);
+    EXPECT_EQ(levelOf(b), 2);
+    view->setLevelOfDetailOptions({ .bias = 0, .hysteresis = 0.1f });
+
+    // destroying a moves b to another instance, which must not affect its current level
+    scene->remove(a);
+    rcm.destroy(a);
+    prepare();
+    EXPECT_EQ(levelOf(b), 1);
+
+    rcm.destroy(b);
+    engine->destroyCameraComponent(entities[0]);
+    engine->destroy(view);
+    engine->destroy(scene);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    EntityManager::get().destroy(3, entities);
+    Engine::destroy(&engine);
+}
+
 TEST(FilamentTest, Bones) {
 
     struct Shader {
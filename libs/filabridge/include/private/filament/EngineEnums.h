@@ -34,7 +34,7 @@ namespace BindingPoints {
     constexpr uint8_t PER_VIEW                = 0;    // uniforms/samplers updated per view
     constexpr uint8_t PER_RENDERABLE          = 1;    // uniforms/samplers updated per renderable
     constexpr uint8_t PER_RENDERABLE_BONES    = 2;    // bones data, per renderable
-    constexpr uint8_t LIGHTS                  = 3;    // lights data array
+    constexpr uint8_t LIGHTS                  = 3;    // unused, lights data are in a per-view sampler
     constexpr uint8_t SHADOW                  = 4;    // punctual shadow data
     constexpr uint8_t PER_MATERIAL_INSTANCE   = 5;    // uniforms/samplers updates per material
     constexpr uint8_t COUNT                   = 6;
@@ -44,16 +44,22 @@ namespace BindingPoints {
 static_assert(BindingPoints::PER_MATERIAL_INSTANCE == BindingPoints::COUNT - 1,
         "Dynamically sized sampler buffer must be the last binding point.");
 
-// This value is limited by UBO size, ES3.0 only guarantees 16 KiB.
+// Point and spot lights data are stored in a texture (64 bytes per light).
+// This value is limited by the size of the light indices in the froxel records (16 bits).
 // Values <= 256, use less CPU and GPU resources.
-constexpr size_t CONFIG_MAX_LIGHT_COUNT = 256;
+constexpr size_t CONFIG_MAX_LIGHT_COUNT = 4096;
 constexpr size_t CONFIG_MAX_LIGHT_INDEX = CONFIG_MAX_LIGHT_COUNT - 1;
 
+// The froxels are stored in a (1 << CONFIG_FROXEL_BUFFER_WIDTH_SHIFT) x CONFIG_FROXEL_BUFFER_HEIGHT
+// texture, 4 per texel, followed by the point and spot lights data (see Froxelizer).
+// These values are passed to the shaders as defines.
+constexpr size_t CONFIG_FROXEL_BUFFER_WIDTH_SHIFT = 6;
+constexpr size_t CONFIG_FROXEL_BUFFER_HEIGHT = 32;
+
 // The maximum number of spot lights in a scene that can cast shadows.
-// Light space coordinates are computed in the vertex shader and interpolated across fragments.
-// Thus, each additional shadow-casting spot light adds 4 additional varying components. Higher
-// values may cause the number of varyings to exceed the driver limit.
-constexpr size_t CONFIG_MAX_SHADOW_CASTING_SPOTS = 2;
+// Light space coordinates are computed in the fragment shader, so this is only limited by the
+// bits of the visibility mask (see View.h).
+constexpr size_t CONFIG_MAX_SHADOW_CASTING_SPOTS = 6;
 
 // The maximum number of shadow cascades that can be used for directional lights.
 constexpr size_t CONFIG_MAX_SHADOW_CASCADES = 4;
@@ -62,6 +68,16 @@ constexpr size_t CONFIG_MAX_SHADOW_CASCADES = 4;
 // We store 64 bytes per bone.
 constexpr size_t CONFIG_MAX_BONE_COUNT = 256;
 
+// The maximum number of instances of an instanced renderable, they're all drawn with a single
+// draw call. This is also limited by UBO size, we store 128 bytes per instance.
+constexpr size_t CONFIG_MAX_INSTANCES = 128;
+
+// The maximum number of consecutive renderables drawn with a single instanced draw call, when
+// they use the same primitive and material (see RenderPass). The uniforms of all of them must be
+// visible to the shader, this is limited by UBO size, ES3.0 only guarantees 16 KiB.
+// We store 256 bytes per renderable.
+constexpr size_t CONFIG_MAX_BATCH_COUNT = 64;
+
 } // namespace filament
 
 #endif // TNT_FILAMENT_driver/EngineEnums.h
@@ -30,9 +30,9 @@ class UibGenerator {
 public:
     static UniformInterfaceBlock const& getPerViewUib() noexcept;
     static UniformInterfaceBlock const& getPerRenderableUib() noexcept;
-    static UniformInterfaceBlock const& getLightsUib() noexcept;
     static UniformInterfaceBlock const& getShadowUib() noexcept;
     static UniformInterfaceBlock const& getPerRenderableBonesUib() noexcept;
+    static UniformInterfaceBlock const& getPerRenderableInstancesUib() noexcept;
 };
 
 /*
@@ -139,13 +139,13 @@ struct alignas(256) PerRenderableUib {
     int32_t skinningEnabled; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
     int32_t morphingEnabled; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
     uint32_t screenSpaceContactShadows; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
-    float padding0;
+    int32_t instancingEnabled; // 0=disabled, 1=enabled, ignored unless variant & SKINNING_OR_MORPHING
+    filament::math::float4 reserved[7];
 };
 
+// Point and spot lights data, stored after the froxels in the froxel texture
+// (see PerViewSib::FROXELS) as 4 texels of 4 x 32 bits each.
 struct LightsUib {
-    static const UniformInterfaceBlock& getUib() noexcept {
-        return UibGenerator::getLightsUib();
-    }
     filament::math::float4 positionFalloff;   // { float3(pos), 1/falloff^2 }
     filament::math::float4 colorIntensity;    // { float3(col), intensity }
     filament::math::float4 directionIES;      // { float3(dir), IES index }
@@ -172,6 +172,14 @@ struct PerRenderableUibBone {
     filament::math::float4 ns = { 1, 1, 1, 0 };
 };
 
+// This is not the UBO proper, but just an element of an instance array. Instances are stored in
+// the bones UBO, which instanced renderables don't otherwise use.
+struct PerRenderableUibInstance {
+    filament::math::mat4f transform;            // relative to worldFromModelMatrix
+    filament::math::float4 normalTransform[3];  // mat3f expanded to 48 bytes
+    filament::math::float4 index;               // { index of the instance, 0, 0, 0 }
+};
+
 } // namespace filament
 
 #endif // TNT_FILABRIDGE_UIBGENERATOR_H
@@ -32,7 +32,7 @@ SamplerInterfaceBlock const& SibGenerator::getPerViewSib() noexcept {
             .name("Light")
             .add("shadowMap",     Type::SAMPLER_2D_ARRAY,   Format::SHADOW, Precision::MEDIUM)
             .add("records",       Type::SAMPLER_2D,         Format::UINT,   Precision::MEDIUM)
-            .add("froxels",       Type::SAMPLER_2D,         Format::UINT,   Precision::MEDIUM)
+            .add("froxels",       Type::SAMPLER_2D,         Format::UINT,   Precision::HIGH)
             .add("iblDFG",        Type::SAMPLER_2D,         Format::FLOAT,  Precision::MEDIUM)
             .add("iblSpecular",   Type::SAMPLER_CUBEMAP,    Format::FLOAT,  Precision::MEDIUM)
             .add("ssao",          Type::SAMPLER_2D,         Format::FLOAT,  Precision::MEDIUM)
@@ -28,9 +28,16 @@ using namespace backend;
 static_assert(sizeof(PerRenderableUib) % 256 == 0,
         "sizeof(Transform) should be a multiple of 256");
 
+static_assert(CONFIG_MAX_BATCH_COUNT * sizeof(PerRenderableUib) <= 16384,
+        "Batched renderables exceed max UBO size");
+
 static_assert(CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone) <= 16384,
         "Bones exceed max UBO size");
 
+static_assert(CONFIG_MAX_INSTANCES * sizeof(PerRenderableUibInstance) <=
+        CONFIG_MAX_BONE_COUNT * sizeof(PerRenderableUibBone),
+        "Instances exceed the bones UBO size");
+
 static_assert(CONFIG_MAX_SHADOW_CASCADES == 4,
         "Changing CONFIG_MAX_SHADOW_CASCADES affects PerView size and breaks materials.");
 
@@ -120,16 +127,14 @@ UniformInterfaceBlock const& UibGenerator::getPerRenderableUib() noexcept {
             .add("skinningEnabled", 1, UniformInterfaceBlock::Type::INT)
             .add("morphingEnabled", 1, UniformInterfaceBlock::Type::INT)
             .add("screenSpaceContactShadows", 1, UniformInterfaceBlock::Type::UINT)
-            .add("padding0", 1, UniformInterfaceBlock::Type::FLOAT)
+            .add("instancingEnabled", 1, UniformInterfaceBlock::Type::INT)
+            // bring the std140 size to sizeof(PerRenderableUib), which is the stride of the
+            // renderables in the UBO
+            .add("reserved", 7, UniformInterfaceBlock::Type::FLOAT4)
             .build();
-    return uib;
-}
 
-UniformInterfaceBlock const& UibGenerator::getLightsUib() noexcept {
-    static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
-            .name("LightsUniforms")
-            .add("lights", CONFIG_MAX_LIGHT_COUNT, UniformInterfaceBlock::Type::MAT4, Precision::HIGH)
-            .build();
+    assert(uib.getSize() == sizeof(PerRenderableUib));
+
     return uib;
 }
 
@@ -150,4 +155,13 @@ UniformInterfaceBlock const& UibGenerator::getPerRenderableBonesUib() noexcept {
     return uib;
 }
 
+UniformInterfaceBlock const& UibGenerator::getPerRenderableInstancesUib() noexcept {
+    // same block as getPerRenderableBonesUib(), the transforms of the instances need high precision
+    static UniformInterfaceBlock uib = UniformInterfaceBlock::Builder()
+            .name("BonesUniforms")
+            .add("bones", CONFIG_MAX_BONE_COUNT * 4, UniformInterfaceBlock::Type::FLOAT4, Precision::HIGH)
+            .build();
+    return uib;
+}
+
 } // namespace filament
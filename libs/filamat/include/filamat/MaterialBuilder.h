@@ -400,6 +400,13 @@ public:
     //! Enable / disable flipping of the Y coordinate of UV attributes, enabled by default.
     MaterialBuilder& flipUV(bool flipUV) noexcept;
 
+    /**
+     * Enable / disable high precision transforms for instanced renderables, disabled by default.
+     * This should be enabled for the materials of renderables built with instances(), it makes
+     * skinning more expensive on mobile.
+     */
+    MaterialBuilder& instanced(bool instanced) noexcept;
+
     //! Enable / disable multi-bounce ambient occlusion, disabled by default on mobile.
     MaterialBuilder& multiBounceAmbientOcclusion(bool multiBounceAO) noexcept;
 
@@ -599,6 +606,8 @@ private:
 
     bool mFlipUV = true;
 
+    bool mInstanced = false;
+
     bool mMultiBounceAO = false;
     bool mMultiBounceAOSet = false;
 
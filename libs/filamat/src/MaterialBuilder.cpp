@@ -308,6 +308,11 @@ MaterialBuilder& MaterialBuilder::flipUV(bool flipUV) noexcept {
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::instanced(bool instanced) noexcept {
+    mInstanced = instanced;
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::multiBounceAmbientOcclusion(bool multiBounceAO) noexcept {
     mMultiBounceAO = multiBounceAO;
     mMultiBounceAOSet = true;
@@ -412,6 +417,7 @@ void MaterialBuilder::prepareToBuild(MaterialInfo& info) noexcept {
     info.specularAntiAliasing = mSpecularAntiAliasing;
     info.clearCoatIorChange = mClearCoatIorChange;
     info.flipUV = mFlipUV;
+    info.instanced = mInstanced;
     info.requiredAttributes = mRequiredAttributes;
     info.blendingMode = mBlendingMode;
     info.postLightingBlendingMode = mPostLightingBlendingMode;
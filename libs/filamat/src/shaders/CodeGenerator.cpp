@@ -236,7 +236,7 @@ const char* CodeGenerator::getUniformPrecisionQualifier(UniformType type, Precis
 }
 
 io::sstream& CodeGenerator::generateUniforms(io::sstream& out, ShaderType shaderType,
-        uint8_t binding, const UniformInterfaceBlock& uib) const {
+        uint8_t binding, const UniformInterfaceBlock& uib, size_t arraySize) const {
     auto const& infos = uib.getUniformInfoList();
     if (infos.empty()) {
         return out;
@@ -249,12 +249,21 @@ io::sstream& CodeGenerator::generateUniforms(io::sstream& out, ShaderType shader
     Precision uniformPrecision = getDefaultUniformPrecision();
     Precision defaultPrecision = getDefaultPrecision(shaderType);
 
-    out << "\nlayout(";
-    if (mTargetLanguage == TargetLanguage::SPIRV) {
-        uint32_t bindingIndex = (uint32_t) binding; // avoid char output
-        out << "binding = " << bindingIndex << ", ";
+    auto generateBlockDeclaration = [&]() {
+        out << "\nlayout(";
+        if (mTargetLanguage == TargetLanguage::SPIRV) {
+            uint32_t bindingIndex = (uint32_t) binding; // avoid char output
+            out << "binding = " << bindingIndex << ", ";
+        }
+        out << "std140) uniform " << blockName.c_str() << " {\n";
+    };
+
+    if (arraySize) {
+        // the uniforms are the fields of a structure, the block is an array of those
+        out << "\nstruct " << blockName.c_str() << "Data {\n";
+    } else {
+        generateBlockDeclaration();
     }
-    out << "std140) uniform " << blockName.c_str() << " {\n";
     for (auto const& info : infos) {
         char const* const type = getUniformTypeName(info.type);
         char const* const precision = getUniformPrecisionQualifier(info.type, info.precision,
@@ -267,7 +276,14 @@ io::sstream& CodeGenerator::generateUniforms(io::sstream& out, ShaderType shader
         }
         out << ";\n";
     }
-    out << "} " << instanceName << ";\n";
+    if (arraySize) {
+        out << "};\n";
+        generateBlockDeclaration();
+        out << "    " << blockName.c_str() << "Data data[" << arraySize << "];\n";
+        out << "} " << instanceName << "Array;\n";
+    } else {
+        out << "} " << instanceName << ";\n";
+    }
 
     return out;
 }
@@ -91,9 +91,10 @@ public:
     // generate no-op shader for depth prepass
     utils::io::sstream& generateDepthShaderMain(utils::io::sstream& out, ShaderType type) const;
 
-    // generate uniforms
+    // generate uniforms. If arraySize is not 0, the block holds an array of arraySize structures
+    // with the uniforms, named <instance>Array.data[] (e.g. objectUniformsArray.data[])
     utils::io::sstream& generateUniforms(utils::io::sstream& out, ShaderType type, uint8_t binding,
-            const filament::UniformInterfaceBlock& uib) const;
+            const filament::UniformInterfaceBlock& uib, size_t arraySize = 0) const;
 
     // generate samplers
     utils::io::sstream& generateSamplers(
@@ -39,6 +39,7 @@ struct UTILS_PUBLIC MaterialInfo {
     bool specularAntiAliasing;
     bool clearCoatIorChange;
     bool flipUV;
+    bool instanced;
     bool multiBounceAO;
     bool multiBounceAOSet;
     bool specularAOSet;
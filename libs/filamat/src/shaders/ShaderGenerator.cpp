@@ -181,8 +181,6 @@ std::string ShaderGenerator::createVertexProgram(filament::backend::ShaderModel
 
     cg.generateProlog(vs, ShaderType::VERTEX, material.hasExternalSamplers);
 
-    cg.generateDefine(vs, "MAX_SHADOW_CASTING_SPOTS", uint32_t(CONFIG_MAX_SHADOW_CASTING_SPOTS));
-
     cg.generateDefine(vs, "FLIP_UV_ATTRIBUTE", material.flipUV);
 
     bool litVariants = lit || material.hasShadowMultiplier;
@@ -221,15 +219,14 @@ std::string ShaderGenerator::createVertexProgram(filament::backend::ShaderModel
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
     cg.generateUniforms(vs, ShaderType::VERTEX,
-            BindingPoints::PER_RENDERABLE, UibGenerator::getPerRenderableUib());
-    if (litVariants && variant.hasShadowReceiver()) {
-        cg.generateUniforms(vs, ShaderType::VERTEX,
-                BindingPoints::SHADOW, UibGenerator::getShadowUib());
-    }
+            BindingPoints::PER_RENDERABLE, UibGenerator::getPerRenderableUib(),
+            CONFIG_MAX_BATCH_COUNT);
     if (variant.hasSkinningOrMorphing()) {
         cg.generateUniforms(vs, ShaderType::VERTEX,
                 BindingPoints::PER_RENDERABLE_BONES,
-                UibGenerator::getPerRenderableBonesUib());
+                material.instanced ?
+                        UibGenerator::getPerRenderableInstancesUib() :
+                        UibGenerator::getPerRenderableBonesUib());
     }
     cg.generateUniforms(vs, ShaderType::VERTEX,
             BindingPoints::PER_MATERIAL_INSTANCE, material.uib);
@@ -301,7 +298,9 @@ std::string ShaderGenerator::createFragmentProgram(filament::backend::ShaderMode
 
     cg.generateDefine(fs, "CLEAR_COAT_IOR_CHANGE", material.clearCoatIorChange);
 
-    cg.generateDefine(fs, "MAX_SHADOW_CASTING_SPOTS", uint32_t(CONFIG_MAX_SHADOW_CASTING_SPOTS));
+    // layout of the froxel buffer, see Froxelizer
+    cg.generateDefine(fs, "FROXEL_BUFFER_WIDTH_SHIFT", uint32_t(CONFIG_FROXEL_BUFFER_WIDTH_SHIFT));
+    cg.generateDefine(fs, "FROXEL_BUFFER_HEIGHT", uint32_t(CONFIG_FROXEL_BUFFER_HEIGHT));
 
     auto defaultSpecularAO = isMobileTarget(shaderModel) ?
             SpecularAmbientOcclusion::NONE : SpecularAmbientOcclusion::SIMPLE;
@@ -408,11 +407,14 @@ std::string ShaderGenerator::createFragmentProgram(filament::backend::ShaderMode
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
-            BindingPoints::PER_RENDERABLE, UibGenerator::getPerRenderableUib());
-    cg.generateUniforms(fs, ShaderType::FRAGMENT,
-            BindingPoints::LIGHTS, UibGenerator::getLightsUib());
+            BindingPoints::PER_RENDERABLE, UibGenerator::getPerRenderableUib(),
+            CONFIG_MAX_BATCH_COUNT);
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::PER_MATERIAL_INSTANCE, material.uib);
+    if (litVariants && variant.hasShadowReceiver()) {
+        cg.generateUniforms(fs, ShaderType::FRAGMENT,
+                BindingPoints::SHADOW, UibGenerator::getShadowUib());
+    }
     cg.generateSeparator(fs);
     cg.generateSamplers(fs,
             material.samplerBindings.getBlockOffset(BindingPoints::PER_VIEW),
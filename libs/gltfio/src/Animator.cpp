@@ -245,18 +245,11 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
         }
         float t = deltaTime == 0 ? 0.0f : ((time - prevTime) / deltaTime);
 
-        // Perform the interpolation. This is a simple but inefficient implementation; Filament
-        // stores transforms as mat4's but glTF animation is based on TRS (translation rotation
-        // scale).
+        // Perform the interpolation. The TransformManager keeps the translation, rotation and
+        // scale of the nodes, so each channel only changes one of them.
         size_t prevIndex = prevIter->second;
         size_t nextIndex = nextIter->second;
 
-        mat4f xform = transformManager->getTransform(node);
-        float3 scale;
-        quatf rotation;
-        float3 translation;
-        decomposeMatrix(xform, &translation, &rotation, &scale);
-
         if (sampler->interpolation == Sampler::STEP) {
             t = 0.0f;
         }
@@ -270,9 +263,10 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                     float3 tang0 = srcVec3[prevIndex * 3 + 2];
                     float3 tang1 = srcVec3[nextIndex * 3];
                     float3 vert1 = srcVec3[nextIndex * 3 + 1];
-                    scale = cubicSpline(vert0, tang0, vert1, tang1, t);
+                    transformManager->setScale(node, cubicSpline(vert0, tang0, vert1, tang1, t));
                 } else {
-                    scale = ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]);
+                    transformManager->setScale(node,
+                            ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]));
                 }
                 break;
             }
@@ -284,9 +278,10 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                     float3 tang0 = srcVec3[prevIndex * 3 + 2];
                     float3 tang1 = srcVec3[nextIndex * 3];
                     float3 vert1 = srcVec3[nextIndex * 3 + 1];
-                    translation = cubicSpline(vert0, tang0, vert1, tang1, t);
+                    transformManager->setTranslation(node, cubicSpline(vert0, tang0, vert1, tang1, t));
                 } else {
-                    translation = ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]);
+                    transformManager->setTranslation(node,
+                            ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]));
                 }
                 break;
             }
@@ -298,9 +293,11 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
                     quatf tang0 = srcQuat[prevIndex * 3 + 2];
                     quatf tang1 = srcQuat[nextIndex * 3];
                     quatf vert1 = srcQuat[nextIndex * 3 + 1];
-                    rotation = normalize(cubicSpline(vert0, tang0, vert1, tang1, t));
+                    transformManager->setRotation(node,
+                            normalize(cubicSpline(vert0, tang0, vert1, tang1, t)));
                 } else {
-                    rotation = slerp(srcQuat[prevIndex], srcQuat[nextIndex], t);
+                    transformManager->setRotation(node,
+                            slerp(srcQuat[prevIndex], srcQuat[nextIndex], t));
                 }
                 break;
             }
@@ -337,12 +334,9 @@ void Animator::applyAnimation(size_t animationIndex, float time) const {
 
                 auto renderable = renderableManager->getInstance(channel.targetEntity);
                 renderableManager->setMorphWeights(renderable, weights);
-                continue;
+                break;
             }
         }
-
-        xform = composeMatrix(translation, rotation, scale);
-        transformManager->setTransform(node, xform);
     }
 }
 
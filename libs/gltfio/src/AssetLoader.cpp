@@ -340,19 +340,21 @@ void FAssetLoader::createEntity(const cgltf_node* node, Entity parent, bool enab
     Entity entity = mEntityManager.create();
 
     // Always create a transform component to reflect the original hierarchy.
-    mat4f localTransform;
+    auto parentTransform = mTransformManager.getInstance(parent);
     if (node->has_matrix) {
+        mat4f localTransform;
         memcpy(&localTransform[0][0], &node->matrix[0], 16 * sizeof(float));
+        mTransformManager.create(entity, parentTransform, localTransform);
     } else {
+        // keep the TRS, so that animating the node doesn't need to decompose its transform
         quatf* rotation = (quatf*) &node->rotation[0];
         float3* scale = (float3*) &node->scale[0];
         float3* translation = (float3*) &node->translation[0];
-        localTransform = composeMatrix(*translation, *rotation, *scale);
+        mTransformManager.create(entity, parentTransform);
+        mTransformManager.setTransform(mTransformManager.getInstance(entity),
+                *translation, *rotation, *scale);
     }
 
-    auto parentTransform = mTransformManager.getInstance(parent);
-    mTransformManager.create(entity, parentTransform, localTransform);
-
     // Update the asset's entity list and private node mapping.
     mResult->mEntities.push_back(entity);
     if (instance) {
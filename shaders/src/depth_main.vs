@@ -3,6 +3,8 @@
 void materialVertex(inout MaterialVertexInputs m) { }
 
 void main() {
+    vertex_objectUniformsIndex = getObjectUniformsIndex();
+
 #if defined(VERTEX_DOMAIN_DEVICE)
     gl_Position = getPosition();
 #else
@@ -1,3 +1,6 @@
+// the index of the renderable's uniforms is computed by the vertex shader, see getters.vs
+#define objectUniforms objectUniformsArray.data[vertex_objectUniformsIndex]
+
 #if defined(HAS_ATTRIBUTE_COLOR)
 /** @public-api */
 vec4 getColor() {
@@ -96,12 +99,6 @@ highp vec3 getNormalizedViewportCoord() {
     return vec3(shading_normalizedViewportCoord, gl_FragCoord.z);
 }
 
-#if defined(HAS_SHADOWING) && defined(HAS_DYNAMIC_LIGHTING)
-highp vec3 getSpotLightSpacePosition(uint index) {
-    highp vec4 position = vertex_spotLightSpacePosition[index];
-    return position.xyz * (1.0 / position.w);
-}
-#endif
 
 #if defined(MATERIAL_HAS_DOUBLE_SIDED_CAPABILITY)
 bool isDoubleSided() {
@@ -136,3 +133,15 @@ highp vec3 getCascadeLightSpacePosition(uint cascade) {
 }
 
 #endif
+
+#if defined(HAS_SHADOWING) && defined(HAS_DYNAMIC_LIGHTING)
+highp vec3 getSpotLightSpacePosition(uint index) {
+    // Computed here rather than interpolated, so the number of shadow-casting spot lights isn't
+    // limited by the number of varyings.
+    highp vec4 directionShadowBias = shadowUniforms.directionShadowBias[index];
+    highp vec4 pos = computeLightSpacePosition(getWorldPosition(), getWorldNormalVector(),
+        directionShadowBias.xyz, directionShadowBias.w,
+        shadowUniforms.spotLightFromWorldMatrix[index]);
+    return pos.xyz * (1.0 / pos.w);
+}
+#endif
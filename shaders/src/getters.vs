@@ -6,19 +6,70 @@ mat4 getLightFromWorldMatrix() {
     return frameUniforms.lightFromWorldMatrix[0];
 }
 
-#if defined(HAS_SHADOWING)
-mat4 getSpotLightFromWorldMatrix(uint index) {
-    return shadowUniforms.spotLightFromWorldMatrix[index];
+/**
+ * Returns the index of the renderable's uniforms in objectUniformsArray. Consecutive draws of
+ * the same primitive and material are batched into a single instanced draw, where each instance
+ * is a renderable (see RenderPass).
+ */
+highp int getObjectUniformsIndex() {
+    // the instances of an instanced renderable all share its uniforms, see getInstanceIndex()
+    if (objectUniformsArray.data[0].instancingEnabled == 1) {
+        return 0;
+    }
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    return gl_InstanceIndex;
+#else
+    return gl_InstanceID;
+#endif
+}
+
+#define objectUniforms objectUniformsArray.data[getObjectUniformsIndex()]
+
+#if defined(HAS_SKINNING_OR_MORPHING)
+// The visible instances of an instanced renderable are stored in the bones uniform buffer,
+// see PerRenderableUibInstance
+uint getInstanceOffset() {
+#if defined(TARGET_VULKAN_ENVIRONMENT)
+    return uint(gl_InstanceIndex) * 8u;
+#else
+    return uint(gl_InstanceID) * 8u;
+#endif
 }
 #endif
 
+/** @public-api */
+int getInstanceIndex() {
+#if defined(HAS_SKINNING_OR_MORPHING)
+    if (objectUniforms.instancingEnabled == 1) {
+        return int(bonesUniforms.bones[getInstanceOffset() + 7u].x);
+    }
+#endif
+    return 0;
+}
+
 /** @public-api */
 mat4 getWorldFromModelMatrix() {
+#if defined(HAS_SKINNING_OR_MORPHING)
+    if (objectUniforms.instancingEnabled == 1) {
+        uint i = getInstanceOffset();
+        return objectUniforms.worldFromModelMatrix * mat4(
+                bonesUniforms.bones[i + 0u], bonesUniforms.bones[i + 1u],
+                bonesUniforms.bones[i + 2u], bonesUniforms.bones[i + 3u]);
+    }
+#endif
     return objectUniforms.worldFromModelMatrix;
 }
 
 /** @public-api */
 mat3 getWorldFromModelNormalMatrix() {
+#if defined(HAS_SKINNING_OR_MORPHING)
+    if (objectUniforms.instancingEnabled == 1) {
+        uint i = getInstanceOffset();
+        return objectUniforms.worldFromModelNormalMatrix * mat3(
+                bonesUniforms.bones[i + 4u].xyz, bonesUniforms.bones[i + 5u].xyz,
+                bonesUniforms.bones[i + 6u].xyz);
+    }
+#endif
     return objectUniforms.worldFromModelNormalMatrix;
 }
 
@@ -15,6 +15,8 @@ LAYOUT_LOCATION(6) SHADING_INTERPOLATION in mediump vec4 vertex_worldTangent;
 
 LAYOUT_LOCATION(7) in highp vec4 vertex_position;
 
+LAYOUT_LOCATION(8) flat in highp int vertex_objectUniformsIndex;
+
 #if defined(HAS_ATTRIBUTE_COLOR)
 LAYOUT_LOCATION(9) in mediump vec4 vertex_color;
 #endif
@@ -29,8 +31,4 @@ LAYOUT_LOCATION(10) in highp vec4 vertex_uv01;
 LAYOUT_LOCATION(11) in highp vec4 vertex_lightSpacePosition;
 #endif
 
-#if defined(HAS_SHADOWING) && defined(HAS_DYNAMIC_LIGHTING)
-LAYOUT_LOCATION(12) in highp vec4 vertex_spotLightSpacePosition[MAX_SHADOW_CASTING_SPOTS];
-#endif
-
 layout(location = 0) out vec4 fragColor;
@@ -66,6 +66,8 @@ LAYOUT_LOCATION(6) SHADING_INTERPOLATION out mediump vec4 vertex_worldTangent;
 
 LAYOUT_LOCATION(7) out highp vec4 vertex_position;
 
+LAYOUT_LOCATION(8) flat out highp int vertex_objectUniformsIndex;
+
 #if defined(HAS_ATTRIBUTE_COLOR)
 LAYOUT_LOCATION(9) out mediump vec4 vertex_color;
 #endif
@@ -79,7 +81,3 @@ LAYOUT_LOCATION(10) out highp vec4 vertex_uv01;
 #if defined(HAS_SHADOWING) && defined(HAS_DIRECTIONAL_LIGHTING)
 LAYOUT_LOCATION(11) out highp vec4 vertex_lightSpacePosition;
 #endif
-
-#if defined(HAS_SHADOWING)
-LAYOUT_LOCATION(12) out highp vec4 vertex_spotLightSpacePosition[MAX_SHADOW_CASTING_SPOTS];
-#endif
@@ -2,15 +2,20 @@
 // Punctual lights evaluation
 //------------------------------------------------------------------------------
 
-// Make sure this matches the same constants in Froxel.cpp
-#define FROXEL_BUFFER_WIDTH_SHIFT   6u
-#define FROXEL_BUFFER_WIDTH         (1u << FROXEL_BUFFER_WIDTH_SHIFT)
+// FROXEL_BUFFER_WIDTH_SHIFT and FROXEL_BUFFER_HEIGHT are defined by the material compiler
+#define FROXEL_BUFFER_WIDTH         (1u << uint(FROXEL_BUFFER_WIDTH_SHIFT))
 #define FROXEL_BUFFER_WIDTH_MASK    (FROXEL_BUFFER_WIDTH - 1u)
 
 #define RECORD_BUFFER_WIDTH_SHIFT   5u
 #define RECORD_BUFFER_WIDTH         (1u << RECORD_BUFFER_WIDTH_SHIFT)
 #define RECORD_BUFFER_WIDTH_MASK    (RECORD_BUFFER_WIDTH - 1u)
 
+// Make sure this matches the same constants in Scene.h
+// The lights are stored after the froxels, in the light_froxels texture
+#define LIGHT_BUFFER_WIDTH_SHIFT    6u
+#define LIGHT_BUFFER_WIDTH          (1u << LIGHT_BUFFER_WIDTH_SHIFT)
+#define LIGHT_BUFFER_WIDTH_MASK     (LIGHT_BUFFER_WIDTH - 1u)
+
 #define LIGHT_TYPE_POINT            0u
 #define LIGHT_TYPE_SPOT             1u
 
@@ -52,9 +57,11 @@ uint getFroxelIndex(const highp vec3 fragCoords) {
 
 /**
  * Computes the texture coordinates of the froxel data given a froxel index.
+ * Each texel holds the data of 4 froxels.
  */
 ivec2 getFroxelTexCoord(uint froxelIndex) {
-    return ivec2(froxelIndex & FROXEL_BUFFER_WIDTH_MASK, froxelIndex >> FROXEL_BUFFER_WIDTH_SHIFT);
+    uint texel = froxelIndex >> 2u;
+    return ivec2(texel & FROXEL_BUFFER_WIDTH_MASK, texel >> FROXEL_BUFFER_WIDTH_SHIFT);
 }
 
 /**
@@ -63,23 +70,34 @@ ivec2 getFroxelTexCoord(uint froxelIndex) {
  */
 FroxelParams getFroxelParams(uint froxelIndex) {
     ivec2 texCoord = getFroxelTexCoord(froxelIndex);
-    uvec2 entry = texelFetch(light_froxels, texCoord, 0).rg;
+    highp uint entry = texelFetch(light_froxels, texCoord, 0)[froxelIndex & 3u];
 
     FroxelParams froxel;
-    froxel.recordOffset = entry.r;
-    froxel.count = entry.g & 0xFFu;
+    froxel.recordOffset = entry & 0xFFFFu;
+    froxel.count = (entry >> 16u) & 0xFFu;
     return froxel;
 }
 
 /**
  * Returns the coordinates of the light record in the light_records texture
  * given the specified index. A light record is a single uint index into the
- * lights data buffer (lightsUniforms UBO).
+ * lights data (see getLightData()).
  */
 ivec2 getRecordTexCoord(uint index) {
     return ivec2(index & RECORD_BUFFER_WIDTH_MASK, index >> RECORD_BUFFER_WIDTH_SHIFT);
 }
 
+/**
+ * Returns the i-th of the 4 texels that contain the data of the specified light,
+ * in the light_froxels texture, after the froxels.
+ */
+highp uvec4 getLightData(uint lightIndex, uint i) {
+    uint texel = lightIndex * 4u + i;
+    ivec2 texCoord = ivec2(texel & LIGHT_BUFFER_WIDTH_MASK,
+            uint(FROXEL_BUFFER_HEIGHT) + (texel >> LIGHT_BUFFER_WIDTH_SHIFT));
+    return texelFetch(light_froxels, texCoord, 0);
+}
+
 float getSquareFalloffAttenuation(float distanceSquare, float falloff) {
     float factor = distanceSquare * falloff;
     float smoothFactor = saturate(1.0 - factor * factor);
@@ -107,17 +125,17 @@ float getAngleAttenuation(const vec3 lightDir, const vec3 l, const vec2 scaleOff
  * in the w component.
  *
  * The light parameters used to compute the Light structure are fetched from the
- * lightsUniforms uniform buffer.
+ * lights data (see getLightData()).
  */
 Light getLight(const uint index) {
 
-    // retrieve the light data from the UBO
+    // retrieve the light data from the texture
     ivec2 texCoord = getRecordTexCoord(index);
     uint lightIndex = texelFetch(light_records, texCoord, 0).r;
-    highp vec4 positionFalloff       = lightsUniforms.lights[lightIndex][0];
-    highp vec4 colorIntensity        = lightsUniforms.lights[lightIndex][1];
-          vec4 directionIES          = lightsUniforms.lights[lightIndex][2];
-    highp vec4 scaleOffsetShadowType = lightsUniforms.lights[lightIndex][3];
+    highp vec4 positionFalloff        = uintBitsToFloat(getLightData(lightIndex, 0u));
+    highp vec4 colorIntensity         = uintBitsToFloat(getLightData(lightIndex, 1u));
+          vec4 directionIES           = uintBitsToFloat(getLightData(lightIndex, 2u));
+    highp uvec4 scaleOffsetShadowType = getLightData(lightIndex, 3u);
 
     // poition-to-light vector
     highp vec3 worldPosition = vertex_worldPosition;
@@ -131,10 +149,11 @@ Light getLight(const uint index) {
     light.attenuation = getDistanceAttenuation(posToLight, positionFalloff.w);
     light.NoL = saturate(dot(shading_normal, light.l));
 
-    uint type = floatBitsToUint(scaleOffsetShadowType.w);
+    uint type = scaleOffsetShadowType.w;
     if (type == LIGHT_TYPE_SPOT) {
-        light.attenuation *= getAngleAttenuation(-directionIES.xyz, light.l, scaleOffsetShadowType.xy);
-        uint shadowBits = floatBitsToUint(scaleOffsetShadowType.z);
+        light.attenuation *= getAngleAttenuation(-directionIES.xyz, light.l,
+                uintBitsToFloat(scaleOffsetShadowType.xy));
+        uint shadowBits = scaleOffsetShadowType.z;
         light.castsShadows = bool(shadowBits & 0x1u);
         light.contactShadows = bool((shadowBits >> 1u) & 0x1u);
         light.shadowIndex = (shadowBits >> 2u) & 0xFu;
@@ -158,7 +177,7 @@ void evaluatePunctualLights(const PixelParams pixel, inout vec3 color) {
     // the current fragment. A froxel also contains a record offset that
     // tells us where the indices of those lights are in the records
     // texture. The records texture contains the indices of the actual
-    // light data in the lightsUniforms uniform buffer
+    // light data in the lights texture
 
     uint index = froxel.recordOffset;
     uint end = index + froxel.count;
@@ -1,4 +1,6 @@
 void main() {
+    vertex_objectUniformsIndex = getObjectUniformsIndex();
+
     // Initialize the inputs to sensible default values, see material_inputs.vs
     MaterialVertexInputs material;
     initMaterialVertex(material);
@@ -35,9 +37,10 @@ void main() {
         // because we ensure the worldFromModelNormalMatrix pre-scales the normal such that
         // all its components are < 1.0. This precents the bitangent to exceed the range of fp16
         // in the fragment shader, where we renormalize after interpolation
-        vertex_worldTangent.xyz = objectUniforms.worldFromModelNormalMatrix * vertex_worldTangent.xyz;
+        mat3 worldFromModelNormalMatrix = getWorldFromModelNormalMatrix();
+        vertex_worldTangent.xyz = worldFromModelNormalMatrix * vertex_worldTangent.xyz;
         vertex_worldTangent.w = mesh_tangents.w;
-        material.worldNormal = objectUniforms.worldFromModelNormalMatrix * material.worldNormal;
+        material.worldNormal = worldFromModelNormalMatrix * material.worldNormal;
     #else // MATERIAL_NEEDS_TBN
         // Without anisotropy or normal mapping we only need the normal vector
         toTangentFrame(mesh_tangents, material.worldNormal);
@@ -48,7 +51,7 @@ void main() {
             }
         #endif
 
-        material.worldNormal = objectUniforms.worldFromModelNormalMatrix * material.worldNormal;
+        material.worldNormal = getWorldFromModelNormalMatrix() * material.worldNormal;
 
     #endif // MATERIAL_HAS_ANISOTROPY || MATERIAL_HAS_NORMAL || MATERIAL_HAS_CLEAR_COAT_NORMAL
 #endif // HAS_ATTRIBUTE_TANGENTS
@@ -92,15 +95,6 @@ void main() {
             frameUniforms.lightDirection, frameUniforms.shadowBias.y, getLightFromWorldMatrix());
 #endif
 
-#if defined(HAS_SHADOWING)
-    for (uint l = 0u; l < uint(MAX_SHADOW_CASTING_SPOTS); l++) {
-        vec3 dir = shadowUniforms.directionShadowBias[l].xyz;
-        float bias = shadowUniforms.directionShadowBias[l].w;
-        vertex_spotLightSpacePosition[l] = computeLightSpacePosition(vertex_worldPosition,
-                vertex_worldNormal, dir, bias, getSpotLightFromWorldMatrix(l));
-    }
-#endif
-
 #if defined(VERTEX_DOMAIN_DEVICE)
     // The other vertex domains are handled in initMaterialVertex()->computeWorldPosition()
     gl_Position = getPosition();
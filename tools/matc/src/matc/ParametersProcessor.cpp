@@ -423,6 +423,11 @@ static bool processFlipUV(MaterialBuilder& builder, const JsonishValue& value) {
     return true;
 }
 
+static bool processInstanced(MaterialBuilder& builder, const JsonishValue& value) {
+    builder.instanced(value.toJsonBool()->getBool());
+    return true;
+}
+
 static bool processMultiBounceAO(MaterialBuilder& builder, const JsonishValue& value) {
     builder.multiBounceAmbientOcclusion(value.toJsonBool()->getBool());
     return true;
@@ -575,6 +580,7 @@ ParametersProcessor::ParametersProcessor() {
     mParameters["specularAntiAliasingThreshold"] = { &processSpecularAntiAliasingThreshold, Type::NUMBER };
     mParameters["clearCoatIorChange"]            = { &processClearCoatIorChange, Type::BOOL };
     mParameters["flipUV"]                        = { &processFlipUV, Type::BOOL };
+    mParameters["instanced"]                     = { &processInstanced, Type::BOOL };
     mParameters["multiBounceAmbientOcclusion"]   = { &processMultiBounceAO, Type::BOOL };
     mParameters["specularAmbientOcclusion"]      = { &processSpecularAmbientOcclusion, Type::STRING };
     mParameters["domain"]                        = { &processDomain, Type::STRING };